@@ -0,0 +1,487 @@
+/* Replay an allocation trace recorded by libmalloctrace.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Usage: bench-malloc-replay TRACE
+
+   TRACE is a file written by a program run with
+   LD_PRELOAD=libmalloctrace.so and MALLOCTRACE_OUTPUT=TRACE.  The
+   records are sorted by their timestamps and each block of the trace
+   is given a slot.  Every thread of the trace is replayed by a thread
+   of its own, which performs the calls of the original thread in
+   order and writes to every page of the blocks it allocates.  A call
+   which frees or reallocates a block allocated by another thread waits
+   until that thread has allocated it.  Since such a block was always
+   allocated earlier in the trace, the threads cannot deadlock.
+
+   The benchmark reports the time of the replay, the peak resident set
+   size it added to the process, and the largest amount of memory
+   requested by the trace at any time.  The fragmentation is the share
+   of the peak resident set size which was not requested.  The tables
+   of the replay are mapped directly, so that they do not disturb the
+   heap.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+#include "../malloc/malloctrace.h"
+
+/* Largest number of threads in a trace.  */
+#define MAX_THREADS		4096
+
+#define NO_SLOT			UINT32_MAX
+#define NO_OP			SIZE_MAX
+
+struct op
+{
+  uint8_t type;
+  uint8_t align_log2;
+  /* The block allocated, and the one freed or reallocated.  */
+  uint32_t slot;
+  uint32_t old_slot;
+  uint64_t size;
+};
+
+struct slot
+{
+  void *ptr;
+  int ready;
+};
+
+struct replay_thread
+{
+  uint32_t tid;
+  size_t first;
+  size_t count;
+  /* The last operation of the thread while the records are converted,
+     if it frees the block at LAST_FREE_PTR, or NO_OP.  */
+  size_t last_free;
+  uint64_t last_free_ptr;
+  pthread_t thread;
+};
+
+static const struct malloctrace_record *records;
+static size_t nrecords;
+static struct op *ops;
+static struct slot *slots;
+static struct replay_thread threads[MAX_THREADS];
+static size_t nthreads;
+static pthread_barrier_t start_barrier;
+static size_t page_size;
+
+static void *
+xmap (size_t size)
+{
+  void *p = mmap (NULL, size ? size : 1, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      perror ("mmap");
+      exit (1);
+    }
+  return p;
+}
+
+static int
+compare_records (const void *a, const void *b)
+{
+  uint32_t i = *(const uint32_t *) a;
+  uint32_t j = *(const uint32_t *) b;
+  if (records[i].time != records[j].time)
+    return records[i].time < records[j].time ? -1 : 1;
+  return i < j ? -1 : i > j;
+}
+
+/* Return the index of thread TID, adding it if necessary.  */
+static size_t
+thread_index (uint32_t tid)
+{
+  static size_t last;
+
+  if (last < nthreads && threads[last].tid == tid)
+    return last;
+  for (size_t i = 0; i < nthreads; i++)
+    if (threads[i].tid == tid)
+      return last = i;
+  if (nthreads == MAX_THREADS)
+    {
+      fprintf (stderr, "too many threads in the trace\n");
+      exit (1);
+    }
+  threads[nthreads].tid = tid;
+  threads[nthreads].last_free = NO_OP;
+  return last = nthreads++;
+}
+
+/* Map from the addresses of the trace to slots, with open addressing.
+   Entries are never removed; freed blocks map to NO_SLOT.  */
+struct address_entry
+{
+  uint64_t ptr;
+  uint32_t slot;
+};
+
+static struct address_entry *addresses;
+static size_t addresses_mask;
+
+static struct address_entry *
+address_lookup (uint64_t ptr)
+{
+  uint64_t hash = (ptr >> 4) * 0x9e3779b97f4a7c15ULL;
+  size_t i = hash ^ (hash >> 32);
+  for (i &= addresses_mask; ; i = (i + 1) & addresses_mask)
+    {
+      if (addresses[i].ptr == 0)
+	{
+	  addresses[i].ptr = ptr;
+	  addresses[i].slot = NO_SLOT;
+	}
+      if (addresses[i].ptr == ptr)
+	return &addresses[i];
+    }
+}
+
+/* Convert the records into the operations of the replay threads.
+   Return the largest amount of memory requested at any time.  */
+static uint64_t
+prepare (size_t *nops)
+{
+  uint32_t *order = xmap (nrecords * sizeof (uint32_t));
+  for (size_t i = 0; i < nrecords; i++)
+    order[i] = i;
+  qsort (order, nrecords, sizeof (uint32_t), compare_records);
+
+  size_t table_size = 16;
+  while (table_size < 2 * nrecords)
+    table_size *= 2;
+  addresses = xmap (table_size * sizeof (struct address_entry));
+  addresses_mask = table_size - 1;
+
+  struct op *sorted = xmap (nrecords * sizeof (struct op));
+  uint16_t *owner = xmap (nrecords * sizeof (uint16_t));
+  uint64_t *sizes = xmap (nrecords * sizeof (uint64_t));
+  uint32_t nslots = 0;
+  uint64_t live = 0, max_live = 0;
+  size_t n = 0;
+
+  for (size_t i = 0; i < nrecords; i++)
+    {
+      const struct malloctrace_record *r = &records[order[i]];
+      struct op *op = &sorted[n];
+      struct address_entry *e;
+      struct replay_thread *t;
+      bool merged = false;
+
+      op->type = r->type;
+      op->align_log2 = r->align_log2;
+      op->size = r->size;
+      op->slot = NO_SLOT;
+      op->old_slot = NO_SLOT;
+
+      switch (r->type)
+	{
+	case MALLOCTRACE_FREE:
+	  e = address_lookup (r->ptr);
+	  /* Blocks allocated before the trace started are skipped.  */
+	  if (e->slot == NO_SLOT)
+	    continue;
+	  op->old_slot = e->slot;
+	  live -= sizes[e->slot];
+	  e->slot = NO_SLOT;
+	  break;
+	case MALLOCTRACE_REALLOC:
+	  /* realloc records the old block as freed before the call.
+	     Turn that free into the realloc, since another thread may
+	     have been given the old address in between.  */
+	  t = &threads[thread_index (r->tid)];
+	  if (r->old_ptr != 0 && t->last_free != NO_OP
+	      && t->last_free_ptr == r->old_ptr)
+	    {
+	      op = &sorted[t->last_free];
+	      op->type = MALLOCTRACE_REALLOC;
+	      op->size = r->size;
+	      merged = true;
+	    }
+	  /* Traces which only have the realloc record.  */
+	  else if (r->old_ptr != 0)
+	    {
+	      e = address_lookup (r->old_ptr);
+	      if (e->slot != NO_SLOT)
+		{
+		  op->old_slot = e->slot;
+		  live -= sizes[e->slot];
+		  e->slot = NO_SLOT;
+		}
+	    }
+	  /* Fall through.  */
+	case MALLOCTRACE_MALLOC:
+	case MALLOCTRACE_CALLOC:
+	case MALLOCTRACE_MEMALIGN:
+	  /* If the address is still in use, the block was freed in a
+	     way the trace missed, and is leaked by the replay.  */
+	  e = address_lookup (r->ptr);
+	  e->slot = op->slot = nslots;
+	  sizes[nslots++] = r->size;
+	  live += r->size;
+	  if (live > max_live)
+	    max_live = live;
+	  break;
+	default:
+	  continue;
+	}
+
+      /* The realloc was merged into an earlier operation.  */
+      if (merged)
+	{
+	  t->last_free = NO_OP;
+	  continue;
+	}
+
+      owner[n] = thread_index (r->tid);
+      t = &threads[owner[n]];
+      t->count++;
+      t->last_free = r->type == MALLOCTRACE_FREE ? n : NO_OP;
+      t->last_free_ptr = r->ptr;
+      n++;
+    }
+
+  /* Group the operations by thread, keeping their order.  */
+  ops = xmap (n * sizeof (struct op));
+  slots = xmap (nslots * sizeof (struct slot));
+  size_t first = 0;
+  for (size_t t = 0; t < nthreads; t++)
+    {
+      threads[t].first = first;
+      first += threads[t].count;
+      threads[t].count = 0;
+    }
+  for (size_t i = 0; i < n; i++)
+    {
+      struct replay_thread *t = &threads[owner[i]];
+      ops[t->first + t->count++] = sorted[i];
+    }
+
+  munmap (order, nrecords * sizeof (uint32_t));
+  munmap (addresses, table_size * sizeof (struct address_entry));
+  munmap (sorted, nrecords * sizeof (struct op));
+  munmap (owner, nrecords * sizeof (uint16_t));
+  munmap (sizes, nrecords * sizeof (uint64_t));
+
+  *nops = n;
+  return max_live;
+}
+
+/* Return the block of slot S once it has been allocated.  */
+static void *
+wait_slot (uint32_t s)
+{
+  if (s == NO_SLOT)
+    return NULL;
+  while (!__atomic_load_n (&slots[s].ready, __ATOMIC_ACQUIRE))
+    sched_yield ();
+  return slots[s].ptr;
+}
+
+static void *
+replay_thread (void *arg)
+{
+  struct replay_thread *t = arg;
+
+  pthread_barrier_wait (&start_barrier);
+
+  for (size_t i = t->first; i < t->first + t->count; i++)
+    {
+      struct op *op = &ops[i];
+      char *p;
+
+      switch (op->type)
+	{
+	case MALLOCTRACE_MALLOC:
+	  p = malloc (op->size);
+	  break;
+	case MALLOCTRACE_CALLOC:
+	  p = calloc (1, op->size);
+	  break;
+	case MALLOCTRACE_MEMALIGN:
+	  p = memalign ((size_t) 1 << op->align_log2, op->size);
+	  break;
+	case MALLOCTRACE_REALLOC:
+	  p = realloc (wait_slot (op->old_slot), op->size);
+	  break;
+	case MALLOCTRACE_FREE:
+	  free (wait_slot (op->old_slot));
+	  continue;
+	default:
+	  continue;
+	}
+
+      /* Make the block resident, as the traced program did.  */
+      if (p != NULL)
+	for (size_t j = 0; j < op->size; j += page_size)
+	  p[j] = 1;
+      slots[op->slot].ptr = p;
+      __atomic_store_n (&slots[op->slot].ready, 1, __ATOMIC_RELEASE);
+    }
+
+  return NULL;
+}
+
+/* Return the value of FIELD in /proc/self/status in bytes, or 0.  */
+static size_t
+proc_status (const char *field)
+{
+  char line[256];
+  size_t len = strlen (field);
+  size_t value = 0;
+  FILE *f = fopen ("/proc/self/status", "r");
+
+  if (f == NULL)
+    return 0;
+  while (fgets (line, sizeof (line), f) != NULL)
+    if (strncmp (line, field, len) == 0 && line[len] == ':')
+      {
+	value = strtoull (line + len + 1, NULL, 10) * 1024;
+	break;
+      }
+  fclose (f);
+  return value;
+}
+
+/* Reset the peak resident set size of the process.  */
+static void
+reset_peak_rss (void)
+{
+  int fd = open ("/proc/self/clear_refs", O_WRONLY);
+  if (fd >= 0)
+    {
+      write (fd, "5", 1);
+      close (fd);
+    }
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: TRACE\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  json_ctx_t json_ctx;
+  timing_t start, stop, elapsed;
+  struct stat st;
+
+  if (argc != 2)
+    usage (argv[0]);
+
+  page_size = sysconf (_SC_PAGESIZE);
+
+  int fd = open (argv[1], O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      perror (argv[1]);
+      exit (1);
+    }
+  const struct malloctrace_header *h
+    = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if ((size_t) st.st_size < sizeof (*h) || h == MAP_FAILED
+      || memcmp (h->magic, MALLOCTRACE_MAGIC, sizeof (h->magic)) != 0
+      || h->version != MALLOCTRACE_VERSION
+      || h->record_size != sizeof (struct malloctrace_record))
+    {
+      fprintf (stderr, "%s: not a malloc trace\n", argv[1]);
+      exit (1);
+    }
+  records = (const struct malloctrace_record *) (h + 1);
+  nrecords = (st.st_size - sizeof (*h)) / sizeof (struct malloctrace_record);
+
+  size_t nops;
+  uint64_t max_live = prepare (&nops);
+
+  pthread_barrier_init (&start_barrier, NULL, nthreads + 1);
+  for (size_t t = 0; t < nthreads; t++)
+    if (pthread_create (&threads[t].thread, NULL, replay_thread,
+			&threads[t]) != 0)
+      {
+	perror ("pthread_create");
+	exit (1);
+      }
+
+  reset_peak_rss ();
+  size_t base_rss = proc_status ("VmRSS");
+
+  pthread_barrier_wait (&start_barrier);
+  TIMING_NOW (start);
+  for (size_t t = 0; t < nthreads; t++)
+    pthread_join (threads[t].thread, NULL);
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+
+  size_t peak_rss = proc_status ("VmHWM");
+  peak_rss = peak_rss > base_rss ? peak_rss - base_rss : 0;
+  struct mallinfo2 mi = mallinfo2 ();
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  json_attr_double (&json_ctx, "duration", elapsed);
+  json_attr_double (&json_ctx, "iterations", nops);
+  json_attr_double (&json_ctx, "time_per_iteration",
+		    nops ? (double) elapsed / nops : 0);
+  json_attr_double (&json_ctx, "threads", nthreads);
+  json_attr_double (&json_ctx, "max_requested_bytes", max_live);
+  json_attr_double (&json_ctx, "peak_rss", peak_rss);
+  json_attr_double (&json_ctx, "fragmentation",
+		    peak_rss > max_live
+		    ? 1 - (double) max_live / peak_rss : 0);
+  json_attr_double (&json_ctx, "heap_size", mi.arena + mi.hblkhd);
+  json_attr_double (&json_ctx, "heap_in_use", mi.uordblks + mi.hblkhd);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -0,0 +1,289 @@
+/* Benchmark malloc and free of many small objects.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The benchmark first measures the memory footprint of a large number
+   of live objects of 16 to 64 bytes, as the growth of the resident set
+   size compared to the number of bytes requested, before and after
+   half of them are replaced by objects of other sizes.  Then each
+   thread keeps a working set of such objects and replaces random ones
+   for a fixed time, which measures the throughput.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Benchmark duration in seconds.  */
+#define BENCHMARK_DURATION	10
+#define RAND_SEED		88
+
+#define MIN_ALLOCATION_SIZE	16
+#define MAX_ALLOCATION_SIZE	64
+
+/* Number of objects in the footprint test, and in the working set of
+   each thread in the throughput test.  */
+#define NUM_FOOTPRINT_OBJECTS	(1 << 20)
+#define NUM_WORKING_SET		4096
+
+#define NUM_RANDOM_VALUES	(1 << 16)
+
+static unsigned int random_values[NUM_RANDOM_VALUES];
+
+static void
+init_random_values (void)
+{
+  srand (RAND_SEED);
+  for (size_t i = 0; i < NUM_RANDOM_VALUES; i++)
+    random_values[i] = rand ();
+}
+
+static size_t
+random_size (size_t i)
+{
+  return (MIN_ALLOCATION_SIZE
+	  + random_values[i % NUM_RANDOM_VALUES]
+	  % (MAX_ALLOCATION_SIZE - MIN_ALLOCATION_SIZE + 1));
+}
+
+/* Return the resident set size of the process, without allocating
+   memory.  */
+static size_t
+get_rss (void)
+{
+  char buf[128];
+  int fd = open ("/proc/self/statm", O_RDONLY);
+  ssize_t len = fd >= 0 ? read (fd, buf, sizeof (buf) - 1) : -1;
+
+  if (fd >= 0)
+    close (fd);
+  if (len <= 0)
+    return 0;
+  buf[len] = '\0';
+
+  char *p = strchr (buf, ' ');
+  return p != NULL ? strtoul (p + 1, NULL, 10) * sysconf (_SC_PAGESIZE) : 0;
+}
+
+static void
+footprint (json_ctx_t *json_ctx)
+{
+  void **objs = calloc (NUM_FOOTPRINT_OBJECTS, sizeof (void *));
+  size_t requested = 0;
+
+  if (objs == NULL)
+    {
+      perror ("calloc");
+      exit (1);
+    }
+
+  size_t rss_start = get_rss ();
+  for (size_t i = 0; i < NUM_FOOTPRINT_OBJECTS; i++)
+    {
+      size_t size = random_size (i);
+      objs[i] = malloc (size);
+      memset (objs[i], 0, size);
+      requested += size;
+    }
+  size_t rss_filled = get_rss ();
+
+  /* Replace every other object with one of a different size.  */
+  for (size_t i = 0; i < NUM_FOOTPRINT_OBJECTS; i += 2)
+    {
+      free (objs[i]);
+      requested -= random_size (i);
+    }
+  for (size_t i = 0; i < NUM_FOOTPRINT_OBJECTS; i += 2)
+    {
+      size_t size = random_size (i + 1);
+      objs[i] = malloc (size);
+      memset (objs[i], 0, size);
+      requested += size;
+    }
+  size_t rss_mixed = get_rss ();
+
+  json_attr_double (json_ctx, "footprint_objects", NUM_FOOTPRINT_OBJECTS);
+  json_attr_double (json_ctx, "footprint_requested", requested);
+  json_attr_double (json_ctx, "footprint_rss", rss_filled - rss_start);
+  json_attr_double (json_ctx, "footprint_rss_mixed", rss_mixed - rss_start);
+  json_attr_double (json_ctx, "footprint_overhead",
+		    (double) (rss_mixed - rss_start) / requested);
+
+  for (size_t i = 0; i < NUM_FOOTPRINT_OBJECTS; i++)
+    free (objs[i]);
+  free (objs);
+}
+
+static volatile bool timeout;
+
+static void
+alarm_handler (int signum)
+{
+  timeout = true;
+}
+
+struct thread_args
+{
+  size_t seed;
+  size_t iters;
+  timing_t elapsed;
+};
+
+static void *
+benchmark_thread (void *arg)
+{
+  struct thread_args *args = arg;
+  void *working_set[NUM_WORKING_SET];
+  size_t r = args->seed;
+  size_t iters = 0;
+  timing_t start, stop;
+
+  for (size_t i = 0; i < NUM_WORKING_SET; i++)
+    working_set[i] = malloc (random_size (r++));
+
+  TIMING_NOW (start);
+  while (!timeout)
+    {
+      for (size_t i = 0; i < 1024; i++)
+	{
+	  size_t idx = random_values[r % NUM_RANDOM_VALUES] % NUM_WORKING_SET;
+	  free (working_set[idx]);
+	  working_set[idx] = malloc (random_size (r + 1));
+	  r += 2;
+	}
+      iters += 1024;
+    }
+  TIMING_NOW (stop);
+
+  for (size_t i = 0; i < NUM_WORKING_SET; i++)
+    free (working_set[i]);
+
+  TIMING_DIFF (args->elapsed, start, stop);
+  args->iters = iters;
+
+  return NULL;
+}
+
+static timing_t
+do_benchmark (size_t num_threads, size_t *iters)
+{
+  timing_t elapsed = 0;
+  struct thread_args args[num_threads];
+  pthread_t threads[num_threads];
+
+  for (size_t i = 0; i < num_threads; i++)
+    {
+      args[i].seed = i * 7919;
+      pthread_create (&threads[i], NULL, benchmark_thread, &args[i]);
+    }
+
+  *iters = 0;
+  for (size_t i = 0; i < num_threads; i++)
+    {
+      pthread_join (threads[i], NULL);
+      TIMING_ACCUM (elapsed, args[i].elapsed);
+      *iters += args[i].iters;
+    }
+
+  return elapsed;
+}
+
+static void usage(const char *name)
+{
+  fprintf (stderr, "%s: <num_threads>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  timing_t cur;
+  size_t iters = 0, num_threads = 1;
+  json_ctx_t json_ctx;
+  double d_total_s, d_total_i;
+  struct sigaction act;
+
+  if (argc == 2)
+    {
+      long ret;
+
+      errno = 0;
+      ret = strtol (argv[1], NULL, 10);
+
+      if (errno || ret <= 0)
+	usage (argv[0]);
+
+      num_threads = ret;
+    }
+  else if (argc != 1)
+    usage (argv[0]);
+
+  init_random_values ();
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  footprint (&json_ctx);
+
+  memset (&act, 0, sizeof (act));
+  act.sa_handler = &alarm_handler;
+
+  sigaction (SIGALRM, &act, NULL);
+
+  alarm (BENCHMARK_DURATION);
+
+  cur = do_benchmark (num_threads, &iters);
+
+  d_total_s = cur;
+  d_total_i = iters;
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "random_seed", RAND_SEED);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+/* Benchmark TLB misses on the heaps of secondary arenas.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A thread, which gets a secondary arena, allocates a working set of
+   small objects much larger than the reach of the TLB with 4 KiB
+   pages, links them in a random cycle and follows the links.  The
+   number of data TLB read misses is read from the performance
+   counters if the kernel provides them, so that runs with and without
+   glibc.malloc.hugetlb=1 can be compared.  Without the counter, only
+   the time per access is reported.  */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define RAND_SEED		88
+
+/* Size of the objects, and of the working set.  */
+#define OBJECT_SIZE		64
+#define WORKING_SET		(64 * 1024 * 1024)
+#define NUM_OBJECTS		(WORKING_SET / OBJECT_SIZE)
+
+/* Number of links followed in the measurement.  */
+#define NUM_ACCESSES		(16 * NUM_OBJECTS)
+
+struct object
+{
+  struct object *next;
+  char payload[OBJECT_SIZE - sizeof (struct object *)];
+};
+
+struct result
+{
+  timing_t elapsed;
+  long long dtlb_misses;
+  uintptr_t sink;
+};
+
+/* Open a counter of the data TLB read misses of the calling thread.
+   Return -1 if it is not available.  */
+static int
+open_dtlb_counter (void)
+{
+#if defined __linux__ && defined SYS_perf_event_open
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof (attr);
+  attr.config = (PERF_COUNT_HW_CACHE_DTLB
+		 | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+		 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static void
+counter_enable (int fd, int enable)
+{
+#ifdef __linux__
+  if (fd < 0)
+    return;
+  if (enable)
+    {
+      ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  else
+    ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+
+static long long
+counter_read (int fd)
+{
+  long long value;
+
+  if (fd < 0 || read (fd, &value, sizeof (value)) != sizeof (value))
+    return -1;
+  return value;
+}
+
+static void *
+benchmark_thread (void *arg)
+{
+  struct result *res = arg;
+  struct object **objs = malloc (NUM_OBJECTS * sizeof (struct object *));
+  size_t *order = malloc (NUM_OBJECTS * sizeof (size_t));
+  timing_t start, stop;
+
+  if (objs == NULL || order == NULL)
+    {
+      perror ("malloc");
+      exit (1);
+    }
+
+  for (size_t i = 0; i < NUM_OBJECTS; i++)
+    {
+      objs[i] = malloc (sizeof (struct object));
+      if (objs[i] == NULL)
+	{
+	  perror ("malloc");
+	  exit (1);
+	}
+      memset (objs[i], 0, sizeof (struct object));
+      order[i] = i;
+    }
+
+  /* Link the objects in a random cycle.  */
+  srand (RAND_SEED);
+  for (size_t i = NUM_OBJECTS - 1; i > 0; i--)
+    {
+      size_t j = (((size_t) rand () << 16) ^ rand ()) % (i + 1);
+      size_t tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+  for (size_t i = 0; i < NUM_OBJECTS; i++)
+    objs[order[i]]->next = objs[order[(i + 1) % NUM_OBJECTS]];
+
+  int fd = open_dtlb_counter ();
+  struct object *p = objs[order[0]];
+
+  counter_enable (fd, 1);
+  TIMING_NOW (start);
+  for (size_t i = 0; i < NUM_ACCESSES; i++)
+    p = p->next;
+  TIMING_NOW (stop);
+  counter_enable (fd, 0);
+
+  TIMING_DIFF (res->elapsed, start, stop);
+  res->dtlb_misses = counter_read (fd);
+  res->sink = (uintptr_t) p;
+  if (fd >= 0)
+    close (fd);
+
+  for (size_t i = 0; i < NUM_OBJECTS; i++)
+    free (objs[i]);
+  free (order);
+  free (objs);
+
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  json_ctx_t json_ctx;
+  struct result res;
+  pthread_t thread;
+
+  /* The main thread uses the main arena, so do the work in another
+     thread.  */
+  pthread_create (&thread, NULL, benchmark_thread, &res);
+  pthread_join (thread, NULL);
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  json_attr_double (&json_ctx, "duration", res.elapsed);
+  json_attr_double (&json_ctx, "iterations", NUM_ACCESSES);
+  json_attr_double (&json_ctx, "time_per_iteration",
+		    (double) res.elapsed / NUM_ACCESSES);
+  json_attr_double (&json_ctx, "working_set", WORKING_SET);
+  json_attr_double (&json_ctx, "object_size", OBJECT_SIZE);
+  json_attr_double (&json_ctx, "dtlb_misses", res.dtlb_misses);
+  if (res.dtlb_misses >= 0)
+    json_attr_double (&json_ctx, "dtlb_misses_per_iteration",
+		      (double) res.dtlb_misses / NUM_ACCESSES);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -0,0 +1,262 @@
+/* Benchmark malloc and free with blocks freed by other threads.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Each pair of threads consists of a producer, which allocates blocks
+   and passes them through a ring buffer, and a consumer, which frees
+   them.  The blocks are larger than the tcache and fastbin limits, so
+   every free goes to the arena of the producer.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Benchmark duration in seconds.  */
+#define BENCHMARK_DURATION	10
+#define RAND_SEED		88
+
+/* Number of blocks in flight between a producer and its consumer.  */
+#define RING_SIZE		1024
+
+#define MIN_ALLOCATION_SIZE	1100
+#define MAX_ALLOCATION_SIZE	16384
+
+#define NUM_BLOCK_SIZES		4096
+
+static unsigned int random_block_sizes[NUM_BLOCK_SIZES];
+
+static void
+init_random_values (void)
+{
+  srand (RAND_SEED);
+  for (size_t i = 0; i < NUM_BLOCK_SIZES; i++)
+    random_block_sizes[i] = (MIN_ALLOCATION_SIZE
+			     + rand () % (MAX_ALLOCATION_SIZE
+					  - MIN_ALLOCATION_SIZE));
+}
+
+static volatile bool timeout;
+
+static void
+alarm_handler (int signum)
+{
+  timeout = true;
+}
+
+/* Single producer, single consumer ring of blocks.  */
+struct ring
+{
+  void *slots[RING_SIZE];
+  size_t head __attribute__ ((aligned (64)));
+  size_t tail __attribute__ ((aligned (64)));
+  bool done;
+};
+
+struct pair_args
+{
+  struct ring ring;
+  size_t iters;
+  timing_t elapsed;
+};
+
+static void *
+producer_thread (void *arg)
+{
+  struct pair_args *args = arg;
+  struct ring *ring = &args->ring;
+  unsigned int block_idx = 0;
+  size_t head = 0;
+  size_t iters = 0;
+  timing_t start, stop;
+
+  TIMING_NOW (start);
+  while (!timeout)
+    {
+      size_t tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+      if (head - tail == RING_SIZE)
+	{
+	  sched_yield ();
+	  continue;
+	}
+
+      ring->slots[head % RING_SIZE] = malloc (random_block_sizes[block_idx]);
+      block_idx = (block_idx + 1) % NUM_BLOCK_SIZES;
+      __atomic_store_n (&ring->head, ++head, __ATOMIC_RELEASE);
+      iters++;
+    }
+  TIMING_NOW (stop);
+
+  __atomic_store_n (&ring->done, true, __ATOMIC_RELEASE);
+
+  TIMING_DIFF (args->elapsed, start, stop);
+  args->iters = iters;
+
+  return NULL;
+}
+
+static void *
+consumer_thread (void *arg)
+{
+  struct pair_args *args = arg;
+  struct ring *ring = &args->ring;
+  size_t tail = 0;
+
+  while (true)
+    {
+      bool done = __atomic_load_n (&ring->done, __ATOMIC_ACQUIRE);
+      size_t head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+      if (head == tail)
+	{
+	  if (done)
+	    break;
+	  sched_yield ();
+	  continue;
+	}
+
+      while (tail != head)
+	{
+	  free (ring->slots[tail % RING_SIZE]);
+	  tail++;
+	}
+      __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+  return NULL;
+}
+
+static timing_t
+do_benchmark (size_t num_pairs, size_t *iters)
+{
+  timing_t elapsed = 0;
+  struct pair_args *args = calloc (num_pairs, sizeof (*args));
+  pthread_t producers[num_pairs];
+  pthread_t consumers[num_pairs];
+
+  if (args == NULL)
+    {
+      perror ("calloc");
+      exit (1);
+    }
+
+  for (size_t i = 0; i < num_pairs; i++)
+    {
+      pthread_create (&consumers[i], NULL, consumer_thread, &args[i]);
+      pthread_create (&producers[i], NULL, producer_thread, &args[i]);
+    }
+
+  *iters = 0;
+  for (size_t i = 0; i < num_pairs; i++)
+    {
+      pthread_join (producers[i], NULL);
+      pthread_join (consumers[i], NULL);
+      TIMING_ACCUM (elapsed, args[i].elapsed);
+      *iters += args[i].iters;
+    }
+
+  free (args);
+  return elapsed;
+}
+
+static void usage(const char *name)
+{
+  fprintf (stderr, "%s: <num_pairs>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  timing_t cur;
+  size_t iters = 0, num_pairs = 1;
+  json_ctx_t json_ctx;
+  double d_total_s, d_total_i;
+  struct sigaction act;
+
+  if (argc == 2)
+    {
+      long ret;
+
+      errno = 0;
+      ret = strtol (argv[1], NULL, 10);
+
+      if (errno || ret <= 0)
+	usage (argv[0]);
+
+      num_pairs = ret;
+    }
+  else if (argc != 1)
+    usage (argv[0]);
+
+  init_random_values ();
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+
+  memset (&act, 0, sizeof (act));
+  act.sa_handler = &alarm_handler;
+
+  sigaction (SIGALRM, &act, NULL);
+
+  alarm (BENCHMARK_DURATION);
+
+  cur = do_benchmark (num_pairs, &iters);
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  d_total_s = cur;
+  d_total_i = iters;
+
+  json_attr_double (&json_ctx, "duration", d_total_s);
+  json_attr_double (&json_ctx, "iterations", d_total_i);
+  json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
+  json_attr_double (&json_ctx, "max_rss", usage.ru_maxrss);
+
+  json_attr_double (&json_ctx, "pairs", num_pairs);
+  json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "random_seed", RAND_SEED);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
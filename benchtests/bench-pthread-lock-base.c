@@ -36,6 +36,10 @@ static pthread_barrier_t barrier;
 
 #define START_ITERS 1000
 
+#ifndef LOCK_TYPE
+# define LOCK_TYPE "adaptive"
+#endif
+
 #pragma GCC push_options
 #pragma GCC optimize(1)
 
@@ -55,7 +59,8 @@ do_filler (void)
   memcpy (buf1, buf2, f);
 }
 
-static void
+/* Unused when the including benchmark overrides UNIT_WORK_CRT.  */
+static void __attribute__ ((unused))
 do_filler_shared (void)
 {
   static char buf1[512], buf2[512];
@@ -65,7 +70,9 @@ do_filler_shared (void)
 
 #pragma GCC pop_options
 
-#define UNIT_WORK_CRT do_filler_shared ()
+#ifndef UNIT_WORK_CRT
+# define UNIT_WORK_CRT do_filler_shared ()
+#endif
 #define UNIT_WORK_NON_CRT do_filler ()
 
 static inline void
@@ -260,7 +267,7 @@ do_bench (void)
   threads[th_conf++] = nprocs + nprocs / 4;
 
   LOCK_ATTR_INIT (&attr);
-  snprintf (name, sizeof name, "type=adaptive");
+  snprintf (name, sizeof name, "type=%s", LOCK_TYPE);
 
   for (k = 0; k < (sizeof (non_crt_lens) / sizeof (int)); k++)
     {
@@ -276,6 +283,18 @@ do_bench (void)
 	}
     }
 
+#ifdef HIGH_CONTENTION
+  /* Let every thread up to one per CPU ask for the lock again as soon
+     as it has released it, so that the lock moves between CPUs all the
+     time.  Oversubscription is left out, since preempted waiters make
+     the results meaningless for spinning locks.  */
+  snprintf (name, sizeof name, "type=%s,contention=high", LOCK_TYPE);
+  for (j = 0; j < (sizeof (crt_lens) / sizeof (int)) && crt_lens[j] <= 4;
+       j++)
+    for (i = 0; i < th_conf - 1; i++)
+      do_bench_one (name, threads[i], crt_lens[j], 0, &json_ctx);
+#endif
+
   json_attr_object_end (&json_ctx);
 
   return rv;
@@ -0,0 +1,40 @@
+/* Measure rwlock_rdlock for different threads and critical sections.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef KIND
+# define KIND PTHREAD_RWLOCK_DEFAULT_NP
+# define LOCK_TYPE "default"
+# define TEST_NAME "pthread-rwlock-rdlock"
+#endif
+
+#define LOCK(lock) pthread_rwlock_rdlock (lock)
+#define UNLOCK(lock) pthread_rwlock_unlock (lock)
+#define LOCK_INIT(lock, attr) pthread_rwlock_init (lock, attr)
+#define LOCK_DESTROY(lock) pthread_rwlock_destroy (lock)
+#define LOCK_ATTR_INIT(attr)                                                  \
+  pthread_rwlockattr_init (attr);                                             \
+  pthread_rwlockattr_setkind_np (attr, KIND);
+
+#define bench_lock_t pthread_rwlock_t
+#define bench_lock_attr_t pthread_rwlockattr_t
+
+/* All threads only read, so the time spent with the lock held does not
+   limit the scaling, but the cost of updating the lock does.  */
+#define UNIT_WORK_CRT do_filler ()
+
+#include "bench-pthread-lock-base.c"
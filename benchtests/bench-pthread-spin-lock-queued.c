@@ -0,0 +1,27 @@
+/* Measure pthread_spin_queued_lock_np for different threads and critical
+   sections.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#define LOCK(lock) pthread_spin_queued_lock_np (lock)
+#define UNLOCK(lock) pthread_spin_queued_unlock_np (lock)
+#define LOCK_INIT(lock, attr) pthread_spin_queued_init_np (lock, *(attr))
+
+#define TEST_NAME "pthread-spin-lock-queued"
+#define LOCK_TYPE "queued"
+
+#include "bench-pthread-spin-lock.c"
@@ -16,15 +16,20 @@
    License along with the GNU C Library; if not, see
    <https://www.gnu.org/licenses/>.  */
 
-#define LOCK(lock) pthread_spin_lock (lock)
-#define UNLOCK(lock) pthread_spin_unlock (lock)
-#define LOCK_INIT(lock, attr) pthread_spin_init (lock, *(attr))
+#ifndef LOCK
+# define LOCK(lock) pthread_spin_lock (lock)
+# define UNLOCK(lock) pthread_spin_unlock (lock)
+# define LOCK_INIT(lock, attr) pthread_spin_init (lock, *(attr))
+#endif
 #define LOCK_DESTROY(lock) pthread_spin_destroy (lock)
 #define LOCK_ATTR_INIT(attr) *(attr) = 0
 
 #define bench_lock_t pthread_spinlock_t
 #define bench_lock_attr_t int
 
-#define TEST_NAME "pthread-spin-lock"
+#ifndef TEST_NAME
+# define TEST_NAME "pthread-spin-lock"
+#endif
+#define HIGH_CONTENTION
 
 #include "bench-pthread-lock-base.c"
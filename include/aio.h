@@ -10,6 +10,10 @@ extern void __aio_init (const struct aioinit *__init);
    element.  */
 #define LIO_NO_INDIVIDUAL_EVENT	128
 
+/* Called from fork so that the new subprocess does not use the
+   asynchronous I/O interface of the kernel set up by the parent.  */
+extern void __aio_fork_subprocess (void) attribute_hidden;
+
 # if __TIMESIZE == 64
 #  define __aio_suspend_time64 __aio_suspend
 # else
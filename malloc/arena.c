@@ -121,6 +121,33 @@ static mstate free_list;
    acquired.  */
 __libc_lock_define_initialized (static, list_lock);
 
+/* slab_lock protects the pool of slabs in malloc-slab.c.  No other lock
+   must be acquired after slab_lock has been acquired.  */
+__libc_lock_define_initialized (static, slab_lock);
+
+/* Per-CPU arenas.  If glibc.malloc.arena_percpu is set, arena_get
+   selects the arena from the CPU the calling thread is running on
+   instead of using the arena attached to the thread.  The table is
+   indexed by CPU number and is populated lazily under list_lock.
+   Arenas in this table stay attached to their CPU slot, so they are
+   never put on free_list by __malloc_arena_thread_freeres.  */
+#if IS_IN (libc)
+static mstate *percpu_arenas;
+static size_t percpu_narenas;
+#endif
+
+/* NUMA mode.  If glibc.malloc.arena_numa is set and the system has more
+   than one NUMA node, numa_cpu_node maps each CPU to its node, the heaps
+   of new arenas are bound to a node, and threads are attached to
+   arenas on the node they are running on.  numa_thread_node is one
+   more than the node the arena of the thread was selected for, or 0 if
+   the node is not known.  */
+#if IS_IN (libc)
+static int *numa_cpu_node;
+static int numa_ncpus;
+static __thread int numa_thread_node;
+#endif
+
 /* Already initialized? */
 static bool __malloc_initialized = false;
 
@@ -136,17 +163,79 @@ static bool __malloc_initialized = false;
    in the new arena. */
 
 #define arena_get(ptr, size) do { \
+      if (__glibc_unlikely (percpu_arenas != NULL)			      \
+	  && (ptr = percpu_arena_get (size)) != NULL)			      \
+	break;								      \
       ptr = thread_arena;						      \
+      if (__glibc_unlikely (numa_cpu_node != NULL))			      \
+	ptr = numa_arena_check (ptr);					      \
       arena_lock (ptr, size);						      \
   } while (0)
 
 #define arena_lock(ptr, size) do {					      \
       if (ptr)								      \
-        __libc_lock_lock (ptr->mutex);					      \
+        arena_mutex_lock (ptr);						      \
       else								      \
         ptr = arena_get2 ((size), NULL);				      \
   } while (0)
 
+#if IS_IN (libc)
+static mstate percpu_arena_get (size_t size);
+
+/* Return the NUMA node of the CPU the calling thread is running on, or
+   -1 if it is not known.  */
+static __always_inline int
+numa_current_node (void)
+{
+  int cpu = malloc_getcpu ();
+  if (__glibc_unlikely (cpu < 0 || cpu >= numa_ncpus))
+    return -1;
+  return numa_cpu_node[cpu];
+}
+
+/* Return A, the arena attached to the calling thread, unless the thread
+   has moved to another NUMA node since A was selected.  In that case,
+   return NULL, so that arena_get2 selects an arena on the new node.  */
+static __always_inline mstate
+numa_arena_check (mstate a)
+{
+  int node = numa_current_node ();
+  if (node < 0 || node == numa_thread_node - 1)
+    return a;
+
+  numa_thread_node = node + 1;
+  return NULL;
+}
+#endif
+
+/* Acquire the lock of arena AV after it was found busy, and account
+   for the time spent waiting in the statistics of the arena.  */
+static void
+arena_mutex_lock_wait (mstate av)
+{
+  struct __timespec64 start, end;
+
+  __clock_gettime64 (CLOCK_MONOTONIC, &start);
+  __libc_lock_lock (av->mutex);
+  __clock_gettime64 (CLOCK_MONOTONIC, &end);
+
+  atomic_fetch_add_relaxed (&av->stats.lock_waits, 1);
+  atomic_fetch_add_relaxed (&av->stats.lock_wait_ns,
+			    (end.tv_sec - start.tv_sec) * 1000000000
+			    + end.tv_nsec - start.tv_nsec);
+}
+
+/* Acquire the lock of arena AV.  The lock is only tried first if
+   glibc.malloc.stats is set, so that contention can be counted.  */
+static __always_inline void
+arena_mutex_lock (mstate av)
+{
+  if (__glibc_likely (!mp_.stats))
+    __libc_lock_lock (av->mutex);
+  else if (__libc_lock_trylock (av->mutex) != 0)
+    arena_mutex_lock_wait (av);
+}
+
 /* find the heap and corresponding arena for a given ptr */
 
 static inline heap_info *
@@ -191,6 +280,7 @@ __malloc_fork_lock_parent (void)
       if (ar_ptr == &main_arena)
         break;
     }
+  __libc_lock_lock (slab_lock);
 }
 
 void
@@ -199,6 +289,7 @@ __malloc_fork_unlock_parent (void)
   if (!__malloc_initialized)
     return;
 
+  __libc_lock_unlock (slab_lock);
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_unlock (ar_ptr->mutex);
@@ -216,18 +307,32 @@ __malloc_fork_unlock_child (void)
     return;
 
   /* Push all arenas to the free list, except thread_arena, which is
-     attached to the current thread.  */
+     attached to the current thread, and the per-CPU arenas, which stay
+     attached to their CPU slot.  */
   __libc_lock_init (free_list_lock);
+  __libc_lock_init (slab_lock);
+  for (mstate ar_ptr = &main_arena;; )
+    {
+      __libc_lock_init (ar_ptr->mutex);
+      /* This arena is no longer attached to any thread.  */
+      ar_ptr->attached_threads = 0;
+      ar_ptr = ar_ptr->next;
+      if (ar_ptr == &main_arena)
+        break;
+    }
   if (thread_arena != NULL)
     thread_arena->attached_threads = 1;
+#if IS_IN (libc)
+  if (percpu_arenas != NULL)
+    for (size_t i = 0; i < percpu_narenas; ++i)
+      if (percpu_arenas[i] != NULL)
+	percpu_arenas[i]->attached_threads = 1;
+#endif
   free_list = NULL;
   for (mstate ar_ptr = &main_arena;; )
     {
-      __libc_lock_init (ar_ptr->mutex);
-      if (ar_ptr != thread_arena)
+      if (ar_ptr->attached_threads == 0)
         {
-	  /* This arena is no longer attached to any thread.  */
-	  ar_ptr->attached_threads = 0;
           ar_ptr->next_free = free_list;
           free_list = ar_ptr;
         }
@@ -256,10 +361,21 @@ TUNABLE_CALLBACK_FNDECL (set_perturb_byte, int32_t)
 TUNABLE_CALLBACK_FNDECL (set_trim_threshold, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_arena_test, size_t)
+TUNABLE_CALLBACK_FNDECL (set_arena_percpu, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_arena_numa, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_consolidate_budget, size_t)
+TUNABLE_CALLBACK_FNDECL (set_remote_free, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_decay_time, size_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_rate, size_t)
+TUNABLE_CALLBACK_FNDECL (set_profile_signal, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_slab_max, size_t)
+TUNABLE_CALLBACK_FNDECL (set_stats, int32_t)
 #if USE_TCACHE
 TUNABLE_CALLBACK_FNDECL (set_tcache_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_count, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_unsorted_limit, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_batch, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_budget, size_t)
 #endif
 TUNABLE_CALLBACK_FNDECL (set_mxfast, size_t)
 TUNABLE_CALLBACK_FNDECL (set_hugetlb, size_t)
@@ -303,6 +419,15 @@ next_env_entry (char ***position)
 #if USE_TCACHE
 static void tcache_key_initialize (void);
 #endif
+#if IS_IN (libc)
+static void percpu_arena_init (void);
+static void numa_arena_init (void);
+static void profile_init (void);
+static void slab_init (void);
+static void slab_thread_shutdown (void);
+static void region_init (void);
+static void region_thread_shutdown (void);
+#endif
 
 static void
 ptmalloc_init (void)
@@ -351,11 +476,25 @@ ptmalloc_init (void)
   TUNABLE_GET (mmap_max, int32_t, TUNABLE_CALLBACK (set_mmaps_max));
   TUNABLE_GET (arena_max, size_t, TUNABLE_CALLBACK (set_arena_max));
   TUNABLE_GET (arena_test, size_t, TUNABLE_CALLBACK (set_arena_test));
+  TUNABLE_GET (arena_percpu, int32_t, TUNABLE_CALLBACK (set_arena_percpu));
+  TUNABLE_GET (arena_numa, int32_t, TUNABLE_CALLBACK (set_arena_numa));
+  TUNABLE_GET (consolidate_budget, size_t,
+	       TUNABLE_CALLBACK (set_consolidate_budget));
+  TUNABLE_GET (remote_free, int32_t, TUNABLE_CALLBACK (set_remote_free));
+  TUNABLE_GET (decay_time, size_t, TUNABLE_CALLBACK (set_decay_time));
+  TUNABLE_GET (profile_rate, size_t, TUNABLE_CALLBACK (set_profile_rate));
+  TUNABLE_GET (profile_signal, int32_t,
+	       TUNABLE_CALLBACK (set_profile_signal));
+  mp_.profile_file = TUNABLE_GET (profile_file, const char *, NULL);
+  TUNABLE_GET (slab_max, size_t, TUNABLE_CALLBACK (set_slab_max));
+  TUNABLE_GET (stats, int32_t, TUNABLE_CALLBACK (set_stats));
 # if USE_TCACHE
   TUNABLE_GET (tcache_max, size_t, TUNABLE_CALLBACK (set_tcache_max));
   TUNABLE_GET (tcache_count, size_t, TUNABLE_CALLBACK (set_tcache_count));
   TUNABLE_GET (tcache_unsorted_limit, size_t,
 	       TUNABLE_CALLBACK (set_tcache_unsorted_limit));
+  TUNABLE_GET (tcache_batch, size_t, TUNABLE_CALLBACK (set_tcache_batch));
+  TUNABLE_GET (tcache_budget, size_t, TUNABLE_CALLBACK (set_tcache_budget));
 # endif
   TUNABLE_GET (mxfast, size_t, TUNABLE_CALLBACK (set_mxfast));
   TUNABLE_GET (hugetlb, size_t, TUNABLE_CALLBACK (set_hugetlb));
@@ -427,6 +566,16 @@ ptmalloc_init (void)
         }
     }
 #endif
+
+#if IS_IN (libc)
+  if (mp_.arena_numa)
+    numa_arena_init ();
+  if (mp_.arena_percpu)
+    percpu_arena_init ();
+  profile_init ();
+  slab_init ();
+  region_init ();
+#endif
 }
 
 /* Managing heaps and arenas (for concurrent threads) */
@@ -476,11 +625,12 @@ dump_heap (heap_info *heap)
 static char *aligned_heap_area;
 
 /* Create a new heap.  size is automatically rounded up to a multiple
-   of the page size. */
+   of the page size.  If node is not negative, the pages of the heap are
+   allocated on that NUMA node if possible.  */
 
 static heap_info *
 alloc_new_heap  (size_t size, size_t top_pad, size_t pagesize,
-		 int mmap_flags)
+		 int mmap_flags, int node)
 {
   char *p1, *p2;
   unsigned long ul;
@@ -548,29 +698,53 @@ alloc_new_heap  (size_t size, size_t top_pad, size_t pagesize,
       return 0;
     }
 
-  madvise_thp (p2, size);
+  /* Bind the whole reservation, so that the policy also applies to the
+     pages made accessible later by grow_heap.  */
+  if (node >= 0)
+    malloc_bind_node (p2, max_size, node);
+
+  /* Likewise, advise the whole reservation, so that the parts made
+     accessible later are also backed by transparent huge pages.  */
+  madvise_thp (p2, max_size);
 
   h = (heap_info *) p2;
   h->size = size;
   h->mprotect_size = size;
   h->pagesize = pagesize;
+  atomic_fetch_add_relaxed (&mp_.mmap_count, 1);
   LIBC_PROBE (memory_heap_new, 2, h, h->size);
   return h;
 }
 
 static heap_info *
-new_heap (size_t size, size_t top_pad)
+new_heap (size_t size, size_t top_pad, int node)
 {
 #if HAVE_TUNABLES
   if (__glibc_unlikely (mp_.hp_pagesize != 0))
     {
       heap_info *h = alloc_new_heap (size, top_pad, mp_.hp_pagesize,
-				     mp_.hp_flags);
+				     mp_.hp_flags, node);
+      if (h != NULL)
+	return h;
+    }
+
+  /* With transparent huge pages, grow and shrink the heap in huge page
+     steps, so that the kernel can back it with huge pages and trimming
+     does not split them.  The heap is aligned to heap_max_size, so all
+     steps are aligned.  Together with the heap, the arena header at its
+     start is on the first huge page, which is also where the first
+     chunks, such as the tcache of the threads, are allocated.  If the
+     heap cannot be grown in such steps, fall back to regular pages.  */
+  if (__glibc_unlikely (mp_.thp_pagesize != 0)
+      && mp_.thp_pagesize < heap_max_size ())
+    {
+      heap_info *h = alloc_new_heap (size, top_pad, mp_.thp_pagesize, 0,
+				     node);
       if (h != NULL)
 	return h;
     }
 #endif
-  return alloc_new_heap (size, top_pad, GLRO (dl_pagesize), 0);
+  return alloc_new_heap (size, top_pad, GLRO (dl_pagesize), 0, node);
 }
 
 /* Grow a heap.  size is automatically rounded up to a
@@ -668,6 +842,7 @@ heap_trim (heap_info *heap, size_t pad)
       if ((char *) heap + max_size == aligned_heap_area)
 	aligned_heap_area = NULL;
       __munmap (heap, max_size);
+      atomic_fetch_add_relaxed (&mp_.munmap_count, 1);
       heap = prev_heap;
       if (!prev_inuse (p)) /* consolidate backward */
         {
@@ -730,8 +905,11 @@ detach_arena (mstate replaced_arena)
     }
 }
 
+/* Allocate a new heap holding an arena with initial size SIZE, on NUMA
+   node NODE if it is not negative.  The arena is not yet linked into
+   the list of arenas and it is not attached to the calling thread.  */
 static mstate
-_int_new_arena (size_t size)
+alloc_new_arena (size_t size, int node)
 {
   mstate a;
   heap_info *h;
@@ -739,19 +917,21 @@ _int_new_arena (size_t size)
   unsigned long misalign;
 
   h = new_heap (size + (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT),
-                mp_.top_pad);
+                mp_.top_pad, node);
   if (!h)
     {
       /* Maybe size is too large to fit in a single heap.  So, just try
          to create a minimally-sized arena and let _int_malloc() attempt
          to deal with the large request via mmap_chunk().  */
-      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad);
+      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad,
+		    node);
       if (!h)
         return 0;
     }
   a = h->ar_ptr = (mstate) (h + 1);
   malloc_init_state (a);
   a->attached_threads = 1;
+  a->node = node;
   /*a->next = NULL;*/
   a->system_mem = a->max_system_mem = h->size;
 
@@ -764,20 +944,36 @@ _int_new_arena (size_t size)
   set_head (top (a), (((char *) h + h->size) - ptr) | PREV_INUSE);
 
   LIBC_PROBE (memory_arena_new, 2, a, size);
-  mstate replaced_arena = thread_arena;
-  thread_arena = a;
   __libc_lock_init (a->mutex);
 
-  __libc_lock_lock (list_lock);
+  return a;
+}
 
-  /* Add the new arena to the global list.  */
+/* Add the new arena A to the global list.  list_lock must have been
+   acquired by the caller.  */
+static void
+link_new_arena (mstate a)
+{
   a->next = main_arena.next;
   /* FIXME: The barrier is an attempt to synchronize with read access
      in reused_arena, which does not acquire list_lock while
      traversing the list.  */
   atomic_write_barrier ();
   main_arena.next = a;
+}
 
+static mstate
+_int_new_arena (size_t size)
+{
+  mstate a = alloc_new_arena (size, numa_thread_node - 1);
+  if (a == NULL)
+    return 0;
+
+  mstate replaced_arena = thread_arena;
+  thread_arena = a;
+
+  __libc_lock_lock (list_lock);
+  link_new_arena (a);
   __libc_lock_unlock (list_lock);
 
   __libc_lock_lock (free_list_lock);
@@ -800,7 +996,8 @@ _int_new_arena (size_t size)
 }
 
 
-/* Remove an arena from free_list.  */
+/* Remove an arena from free_list.  In NUMA mode, only an arena on the
+   node of the calling thread is taken.  */
 static mstate
 get_free_list (void)
 {
@@ -808,11 +1005,19 @@ get_free_list (void)
   mstate result = free_list;
   if (result != NULL)
     {
+      int node = numa_thread_node - 1;
+      mstate *previous = &free_list;
+
       __libc_lock_lock (free_list_lock);
-      result = free_list;
+      for (result = free_list; result != NULL; result = result->next_free)
+	{
+	  if (node < 0 || result->node == node)
+	    break;
+	  previous = &result->next_free;
+	}
       if (result != NULL)
 	{
-	  free_list = result->next_free;
+	  *previous = result->next_free;
 
 	  /* The arena will be attached to this thread.  */
 	  assert (result->attached_threads == 0);
@@ -825,7 +1030,7 @@ get_free_list (void)
       if (result != NULL)
         {
           LIBC_PROBE (memory_arena_reuse_free_list, 1, result);
-          __libc_lock_lock (result->mutex);
+          arena_mutex_lock (result);
 	  thread_arena = result;
         }
     }
@@ -865,12 +1070,17 @@ reused_arena (mstate avoid_arena)
   if (next_to_use == NULL)
     next_to_use = &main_arena;
 
+  /* In NUMA mode, only consider arenas on the node of the calling
+     thread, unless there is none.  */
+  int node = numa_thread_node - 1;
+
   /* Iterate over all arenas (including those linked from
      free_list).  */
   result = next_to_use;
   do
     {
-      if (!__libc_lock_trylock (result->mutex))
+      if ((node < 0 || result->node == node)
+	  && !__libc_lock_trylock (result->mutex))
         goto out;
 
       /* FIXME: This is a data race, see _int_new_arena.  */
@@ -878,6 +1088,15 @@ reused_arena (mstate avoid_arena)
     }
   while (result != next_to_use);
 
+  if (node >= 0)
+    do
+      {
+	if (result->node == node && result != avoid_arena)
+	  break;
+	result = result->next;
+      }
+    while (result != next_to_use);
+
   /* Avoid AVOID_ARENA as we have already failed to allocate memory
      in that arena and it is currently locked.   */
   if (result == avoid_arena)
@@ -885,7 +1104,7 @@ reused_arena (mstate avoid_arena)
 
   /* No arena available without contention.  Wait for the next in line.  */
   LIBC_PROBE (memory_arena_reuse_wait, 3, &result->mutex, result, avoid_arena);
-  __libc_lock_lock (result->mutex);
+  arena_mutex_lock (result);
 
 out:
   /* Attach the arena to the current thread.  */
@@ -967,6 +1186,109 @@ arena_get2 (size_t size, mstate avoid_arena)
   return a;
 }
 
+/* Allocate the per-CPU arena table.  The main arena serves CPU 0, the
+   other slots are filled on first use by percpu_arena_get.  If the
+   table cannot be allocated, arenas remain bound to threads.  */
+static void
+percpu_arena_init (void)
+{
+  int n = __get_nprocs_conf ();
+  if (n <= 1)
+    return;
+
+  size_t size = ALIGN_UP (n * sizeof (mstate), GLRO (dl_pagesize));
+  mstate *table = (mstate *) MMAP (0, size, PROT_READ | PROT_WRITE, 0);
+  if (table == MAP_FAILED)
+    return;
+
+  table[0] = &main_arena;
+  percpu_narenas = n;
+  percpu_arenas = table;
+}
+
+/* Read the NUMA layout of the system.  NUMA mode is only enabled if
+   there is more than one node.  The main arena is considered to be on
+   the node of the CPU running the initialization.  */
+static void
+numa_arena_init (void)
+{
+  int n = __get_nprocs_conf ();
+  if (n <= 1)
+    return;
+
+  size_t size = ALIGN_UP (n * sizeof (int), GLRO (dl_pagesize));
+  int *table = (int *) MMAP (0, size, PROT_READ | PROT_WRITE, 0);
+  if (table == MAP_FAILED)
+    return;
+
+  for (int i = 0; i < n; ++i)
+    table[i] = -1;
+  if (malloc_numa_layout (table, n) <= 1)
+    {
+      __munmap (table, size);
+      return;
+    }
+
+  numa_ncpus = n;
+  numa_cpu_node = table;
+
+  int node = numa_current_node ();
+  main_arena.node = node;
+  numa_thread_node = node + 1;
+}
+
+/* Create the arena for CPU and store it in the per-CPU table.  Returns
+   the arena now serving CPU, which is not locked, or NULL if a new
+   arena could not be allocated.  */
+static mstate
+percpu_arena_create (int cpu, size_t size)
+{
+  __libc_lock_lock (list_lock);
+
+  /* Another thread running on the same CPU may have created the arena
+     while we were waiting for list_lock.  */
+  mstate a = percpu_arenas[cpu];
+  if (a == NULL)
+    {
+      int node = -1;
+      if (numa_cpu_node != NULL && cpu < numa_ncpus)
+	node = numa_cpu_node[cpu];
+      a = alloc_new_arena (size, node);
+      if (a != NULL)
+	{
+	  link_new_arena (a);
+	  atomic_store_release (&percpu_arenas[cpu], a);
+	  catomic_increment (&narenas);
+	}
+    }
+
+  __libc_lock_unlock (list_lock);
+
+  return a;
+}
+
+/* Lock and return the arena for the CPU the calling thread is running
+   on.  Returns NULL if the CPU is not known, in which case the caller
+   falls back to the arena attached to the thread.  */
+static mstate
+percpu_arena_get (size_t size)
+{
+  int cpu = malloc_getcpu ();
+  if (__glibc_unlikely (cpu < 0 || cpu >= percpu_narenas))
+    return NULL;
+
+  mstate a = atomic_load_acquire (&percpu_arenas[cpu]);
+  if (__glibc_unlikely (a == NULL))
+    {
+      a = percpu_arena_create (cpu, size);
+      if (a == NULL)
+	return NULL;
+    }
+
+  arena_mutex_lock (a);
+  return a;
+}
+
 /* If we don't have the main arena, then maybe the failure is due to running
    out of mmapped areas, so we can try allocating on the main arena.
    Otherwise, it is likely that sbrk() has failed and there is still a chance
@@ -979,7 +1301,7 @@ arena_get_retry (mstate ar_ptr, size_t bytes)
     {
       __libc_lock_unlock (ar_ptr->mutex);
       ar_ptr = &main_arena;
-      __libc_lock_lock (ar_ptr->mutex);
+      arena_mutex_lock (ar_ptr);
     }
   else
     {
@@ -998,6 +1320,10 @@ __malloc_arena_thread_freeres (void)
      the thread arena, so do this before we put the arena on the free
      list.  */
   tcache_thread_shutdown ();
+#if IS_IN (libc)
+  slab_thread_shutdown ();
+  region_thread_shutdown ();
+#endif
 
   mstate a = thread_arena;
   thread_arena = NULL;
@@ -213,6 +213,20 @@ __debug_free (void *mem)
 }
 strong_alias (__debug_free, free)
 
+static void
+__debug_free_sized (void *mem, size_t size)
+{
+  __debug_free (mem);
+}
+strong_alias (__debug_free_sized, free_sized)
+
+static void
+__debug_free_aligned_sized (void *mem, size_t alignment, size_t size)
+{
+  __debug_free (mem);
+}
+strong_alias (__debug_free_aligned_sized, free_aligned_sized)
+
 static void *
 __debug_realloc (void *oldmem, size_t bytes)
 {
@@ -643,6 +657,9 @@ compat_symbol (libc_malloc_debug, malloc_set_state, malloc_set_state,
 compat_symbol (libc_malloc_debug, aligned_alloc, aligned_alloc, GLIBC_2_16);
 compat_symbol (libc_malloc_debug, calloc, calloc, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, free, free, GLIBC_2_0);
+compat_symbol (libc_malloc_debug, free_aligned_sized, free_aligned_sized,
+	       GLIBC_2_38);
+compat_symbol (libc_malloc_debug, free_sized, free_sized, GLIBC_2_38);
 compat_symbol (libc_malloc_debug, mallinfo2, mallinfo2, GLIBC_2_33);
 compat_symbol (libc_malloc_debug, mallinfo, mallinfo, GLIBC_2_0);
 compat_symbol (libc_malloc_debug, malloc_info, malloc_info, GLIBC_2_10);
@@ -0,0 +1,375 @@
+/* Sampling heap profiler.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* When glibc.malloc.profile_rate is set to N, roughly one allocation
+   per N bytes requested through malloc and calloc is sampled.  Each
+   thread counts down the number of bytes left until its next sample,
+   so the fast path only subtracts the request size from a thread-local
+   counter.  The distance between two samples is chosen at random in
+   [N/2, 3N/2) so that periodic allocation patterns cannot hide from
+   the profiler.
+
+   Sampled blocks are always mmapped, so each of them takes at least a
+   whole page, however small the request.  The NON_MAIN_ARENA bit marks
+   them so that munmap_chunk and mremap_chunk can drop or move their
+   record.  The bit is otherwise never set for mmapped chunks, and must
+   not be used to find the arena of a chunk before checking
+   chunk_is_mmapped, which all callers of arena_for_chunk already do.
+   The records are kept in a fixed-size open addressing table which is
+   updated with atomic operations only, so that it can be read from a
+   signal handler and survives fork without any lock handling.  */
+
+#include <execinfo.h>
+#include <signal.h>
+
+/* Number of records in the sample table.  Must be a power of two.  */
+#define PROFILE_SLOTS 8192
+/* Maximum number of return addresses recorded for each sample.  */
+#define PROFILE_DEPTH 32
+
+/* Values of the mem field of a record which is not in use.  They can
+   never be the address of a chunk.  */
+#define PROFILE_EMPTY 0
+#define PROFILE_TOMBSTONE 1
+#define PROFILE_BUSY 2
+
+#define PROFILE_SAMPLED NON_MAIN_ARENA
+#define chunk_is_sampled(p) ((chunksize_nomask (p) & PROFILE_SAMPLED) != 0)
+
+struct profile_sample
+{
+  /* Address returned to the application, or one of the values
+     above.  */
+  uintptr_t mem;
+  /* Requested size, and the number of bytes this sample stands
+     for.  */
+  size_t size;
+  size_t weight;
+  int depth;
+  void *frames[PROFILE_DEPTH];
+};
+
+static struct profile_sample *profile_table;
+
+static __always_inline size_t
+profile_hash (uintptr_t mem)
+{
+  return ((mem >> 4) * 2654435761U) & (PROFILE_SLOTS - 1);
+}
+
+/* Drop the record of the sampled block MEM, which is about to be
+   unmapped.  Records are never returned to the empty state,
+   so the search can stop at the first empty slot.  */
+static void
+profile_forget (void *mem)
+{
+  uintptr_t key = (uintptr_t) mem;
+  size_t hash = profile_hash (key);
+
+  if (profile_table == NULL)
+    return;
+
+  for (size_t n = 0; n < PROFILE_SLOTS; ++n)
+    {
+      struct profile_sample *s
+	= &profile_table[(hash + n) & (PROFILE_SLOTS - 1)];
+      uintptr_t cur = atomic_load_relaxed (&s->mem);
+      if (cur == key)
+	{
+	  atomic_store_release (&s->mem, PROFILE_TOMBSTONE);
+	  return;
+	}
+      if (cur == PROFILE_EMPTY)
+	return;
+    }
+}
+
+/* Store a record for the sampled block MEM.  Return false if the table
+   is full.  */
+static bool
+profile_record (void *mem, size_t size, void **frames, int depth)
+{
+  uintptr_t key = (uintptr_t) mem;
+  size_t hash = profile_hash (key);
+
+  for (size_t n = 0; n < PROFILE_SLOTS; ++n)
+    {
+      struct profile_sample *s
+	= &profile_table[(hash + n) & (PROFILE_SLOTS - 1)];
+      uintptr_t cur = atomic_load_relaxed (&s->mem);
+
+      if ((cur == PROFILE_EMPTY || cur == PROFILE_TOMBSTONE)
+	  && atomic_compare_exchange_weak_acquire (&s->mem, &cur,
+						   PROFILE_BUSY))
+	{
+	  s->size = size;
+	  s->weight = MAX (size, mp_.profile_rate);
+	  s->depth = depth;
+	  memcpy (s->frames, frames, depth * sizeof (void *));
+	  atomic_store_release (&s->mem, key);
+	  return true;
+	}
+    }
+  return false;
+}
+
+/* The sampled block OLDMEM has been moved to NEWMEM.  Move its record,
+   and return false if there is none or the table is full, in which case
+   the block is no longer sampled.  */
+static bool
+profile_move (void *oldmem, void *newmem)
+{
+  uintptr_t key = (uintptr_t) oldmem;
+  size_t hash = profile_hash (key);
+
+  if (profile_table == NULL)
+    return false;
+
+  for (size_t n = 0; n < PROFILE_SLOTS; ++n)
+    {
+      struct profile_sample *s
+	= &profile_table[(hash + n) & (PROFILE_SLOTS - 1)];
+      uintptr_t cur = atomic_load_relaxed (&s->mem);
+      if (cur == key)
+	{
+	  if (atomic_compare_and_exchange_bool_acq (&s->mem, PROFILE_BUSY,
+						    key))
+	    return false;
+	  struct profile_sample sample = *s;
+	  atomic_store_release (&s->mem, PROFILE_TOMBSTONE);
+	  return profile_record (newmem, sample.size, sample.frames,
+				 sample.depth);
+	}
+      if (cur == PROFILE_EMPTY)
+	return false;
+    }
+  return false;
+}
+
+#if IS_IN (libc)
+# ifndef SHARED
+/* Static programs get the unwinder, and the backtraces of the samples,
+   only if they use backtrace themselves.  */
+weak_extern (__backtrace)
+# endif
+
+/* Number of bytes which the current thread can still allocate before
+   the next sample is taken.  It starts at zero so that the first
+   allocation of each thread takes the slow path once, which sets it to
+   SIZE_MAX if profiling is disabled.  */
+static __thread size_t profile_countdown;
+/* Set while the current thread records a sample, so that allocations
+   made by __backtrace are not sampled.  */
+static __thread bool profile_busy;
+
+/* Slow path of the sampling check in malloc and calloc, taken when the
+   request of BYTES exhausts the countdown of the current thread.
+   Return a sampled block, or NULL if the request should be served
+   normally.  Not inlined, so that the number of frames to skip in the
+   backtrace is known.  */
+static __attribute_noinline__ void *
+profile_malloc (size_t bytes)
+{
+  size_t rate = mp_.profile_rate;
+
+  if (profile_table == NULL)
+    {
+      profile_countdown = SIZE_MAX;
+      return NULL;
+    }
+
+  profile_countdown = rate / 2 + random_bits () % rate;
+  if (profile_busy)
+    return NULL;
+
+  size_t nb = checked_request2size (bytes);
+  if (nb == 0)
+    return NULL;
+
+  profile_busy = true;
+
+  void *mem = sysmalloc_mmap (nb, GLRO (dl_pagesize), 0, &main_arena);
+  if (mem == MAP_FAILED)
+    mem = NULL;
+  else
+    {
+      void *frames[PROFILE_DEPTH + 2];
+      int depth = 0;
+# ifndef SHARED
+      if (__backtrace != NULL)
+# endif
+	depth = __backtrace (frames, PROFILE_DEPTH + 2);
+
+      /* Skip the frames of profile_malloc and the allocation function
+	 itself.  */
+      depth = depth > 2 ? depth - 2 : 0;
+      if (profile_record (mem, bytes, frames + 2, depth))
+	set_non_main_arena (mem2chunk (mem));
+    }
+
+  profile_busy = false;
+  return mem;
+}
+
+/* Buffered output for __malloc_profile_dump, which must not allocate
+   memory so that it can be called from a signal handler.  */
+struct profile_writer
+{
+  int fd;
+  bool failed;
+  size_t len;
+  char buf[512];
+};
+
+static void
+profile_flush (struct profile_writer *w)
+{
+  size_t off = 0;
+
+  while (off < w->len && !w->failed)
+    {
+      ssize_t n = __write_nocancel (w->fd, w->buf + off, w->len - off);
+      if (n > 0)
+	off += n;
+      else if (n == 0 || errno != EINTR)
+	w->failed = true;
+    }
+  w->len = 0;
+}
+
+static void
+profile_puts (struct profile_writer *w, const char *s)
+{
+  for (; *s != '\0'; ++s)
+    {
+      if (w->len == sizeof (w->buf))
+	profile_flush (w);
+      w->buf[w->len++] = *s;
+    }
+}
+
+static void
+profile_putnum (struct profile_writer *w, uintptr_t value, unsigned int base)
+{
+  char buf[3 * sizeof (uintptr_t) + 1];
+
+  buf[sizeof (buf) - 1] = '\0';
+  profile_puts (w, _itoa_word (value, &buf[sizeof (buf) - 1], base, 0));
+}
+
+static void
+profile_puthex (struct profile_writer *w, uintptr_t value)
+{
+  profile_puts (w, "\"0x");
+  profile_putnum (w, value, 16);
+  profile_puts (w, "\"");
+}
+
+int
+__malloc_profile_dump (int fd)
+{
+  struct profile_writer w = { .fd = fd };
+  bool first = true;
+
+  profile_puts (&w, "{\"version\":1,\"rate\":");
+  profile_putnum (&w, profile_table != NULL ? mp_.profile_rate : 0, 10);
+  profile_puts (&w, ",\"samples\":[");
+
+  for (size_t i = 0; profile_table != NULL && i < PROFILE_SLOTS; ++i)
+    {
+      struct profile_sample *s = &profile_table[i];
+      uintptr_t mem = atomic_load_acquire (&s->mem);
+      if (mem == PROFILE_EMPTY || mem == PROFILE_TOMBSTONE
+	  || mem == PROFILE_BUSY)
+	continue;
+
+      /* Copy the record and check that it was not reused meanwhile.  */
+      struct profile_sample copy = *s;
+      atomic_thread_fence_acquire ();
+      if (atomic_load_relaxed (&s->mem) != mem)
+	continue;
+
+      profile_puts (&w, first ? "\n" : ",\n");
+      first = false;
+      profile_puts (&w, "{\"address\":");
+      profile_puthex (&w, mem);
+      profile_puts (&w, ",\"size\":");
+      profile_putnum (&w, copy.size, 10);
+      profile_puts (&w, ",\"weight\":");
+      profile_putnum (&w, copy.weight, 10);
+      profile_puts (&w, ",\"frames\":[");
+      for (int j = 0; j < copy.depth && j < PROFILE_DEPTH; ++j)
+	{
+	  if (j > 0)
+	    profile_puts (&w, ",");
+	  profile_puthex (&w, (uintptr_t) copy.frames[j]);
+	}
+      profile_puts (&w, "]}");
+    }
+
+  profile_puts (&w, "\n]}\n");
+  profile_flush (&w);
+
+  return w.failed ? -1 : 0;
+}
+
+/* Handler of glibc.malloc.profile_signal, which writes the live
+   samples to glibc.malloc.profile_file.  */
+static void
+profile_signal_handler (int sig)
+{
+  int saved_errno = errno;
+
+  int fd = __open64_nocancel (mp_.profile_file,
+			      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd >= 0)
+    {
+      __malloc_profile_dump (fd);
+      __close_nocancel_nostatus (fd);
+    }
+
+  __set_errno (saved_errno);
+}
+
+/* Set up the sample table and the dump signal handler if profiling is
+   enabled.  Called once from ptmalloc_init.  */
+static void
+profile_init (void)
+{
+  if (mp_.profile_rate == 0)
+    return;
+
+  void *table = MMAP (NULL, PROFILE_SLOTS * sizeof (struct profile_sample),
+		      PROT_READ | PROT_WRITE, 0);
+  if (table == MAP_FAILED)
+    return;
+  profile_table = table;
+
+  if (mp_.profile_signal != 0)
+    {
+      if (mp_.profile_file == NULL)
+	mp_.profile_file = "malloc-profile.json";
+
+      struct sigaction sa;
+      memset (&sa, 0, sizeof (sa));
+      sa.sa_handler = profile_signal_handler;
+      sa.sa_flags = SA_RESTART;
+      __sigaction (mp_.profile_signal, &sa, NULL);
+    }
+}
+#endif /* IS_IN (libc) */
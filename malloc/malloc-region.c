@@ -0,0 +1,278 @@
+/* Regions with bulk release.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A region hands out memory by bumping a pointer through a chain of
+   blocks, and releases all of it at once.  Blocks have a fixed size of
+   at least REGION_BLOCK_SIZE, rounded up to the huge page size if
+   glibc.malloc.hugetlb is set, so that regions get the same huge page
+   treatment as the heaps of the arenas.  The region structure lives in
+   its first block.  Requests larger than a quarter of a block get a
+   mapping of their own.
+
+   Released blocks are kept on a cache of the calling thread and reused
+   by the next regions it creates or grows, without any locking.  A
+   whole chain of blocks is moved to the cache at once, so that
+   malloc_region_reset and malloc_region_destroy only take constant
+   time, apart from unmapping large allocations and blocks beyond
+   REGION_CACHE_MAX.  A region itself is not thread-safe, but it can be
+   reset or destroyed by another thread than the one which created it;
+   its blocks then go to the cache of that thread.  */
+
+#define REGION_BLOCK_SIZE (64 * 1024)
+
+/* Maximum number of blocks in the cache of each thread.  */
+#define REGION_CACHE_MAX 16
+
+struct region_block
+{
+  struct region_block *next;
+  /* Size of the mapping.  */
+  size_t size;
+};
+
+#define REGION_HEADER_SIZE \
+  ALIGN_UP (sizeof (struct region_block), MALLOC_ALIGNMENT)
+
+struct malloc_region
+{
+  /* Free space in the current block.  */
+  char *ptr;
+  char *end;
+  /* The block which holds this structure.  */
+  struct region_block *first;
+  /* The other blocks, newest first, the oldest of them, and their
+     number.  */
+  struct region_block *blocks;
+  struct region_block *last;
+  size_t nblocks;
+  /* Mappings of large allocations.  */
+  struct region_block *large;
+};
+
+#define REGION_FIRST_SIZE \
+  (REGION_HEADER_SIZE \
+   + ALIGN_UP (sizeof (struct malloc_region), MALLOC_ALIGNMENT))
+
+#if IS_IN (libc)
+/* Size of the regular blocks, set by region_init.  */
+static size_t region_block_size = REGION_BLOCK_SIZE;
+
+static __thread struct region_block *region_cache;
+static __thread size_t region_cache_count;
+
+/* Map a block of SIZE bytes, which is a multiple of the page size.  Use
+   huge pages as configured by glibc.malloc.hugetlb.  */
+static struct region_block *
+region_map (size_t size)
+{
+  void *p = MAP_FAILED;
+
+#if HAVE_TUNABLES
+  if (mp_.hp_pagesize != 0 && size % mp_.hp_pagesize == 0)
+    p = MMAP (NULL, size, PROT_READ | PROT_WRITE, mp_.hp_flags);
+#endif
+  if (p == MAP_FAILED)
+    {
+      p = MMAP (NULL, size, PROT_READ | PROT_WRITE, 0);
+      if (p == MAP_FAILED)
+	return NULL;
+      madvise_thp (p, size);
+    }
+
+  struct region_block *b = p;
+  b->size = size;
+  return b;
+}
+
+static void
+region_unmap (struct region_block *b)
+{
+  __munmap (b, b->size);
+}
+
+/* Return a regular block, from the cache if possible.  */
+static struct region_block *
+region_get_block (void)
+{
+  struct region_block *b = region_cache;
+  if (b != NULL)
+    {
+      region_cache = b->next;
+      --region_cache_count;
+      return b;
+    }
+  return region_map (region_block_size);
+}
+
+/* Put the chain of COUNT regular blocks from FIRST to LAST on the cache
+   of the calling thread, and unmap the blocks beyond REGION_CACHE_MAX.  */
+static void
+region_put_blocks (struct region_block *first, struct region_block *last,
+		   size_t count)
+{
+  last->next = region_cache;
+  region_cache = first;
+  region_cache_count += count;
+
+  while (region_cache_count > REGION_CACHE_MAX)
+    {
+      struct region_block *b = region_cache;
+      region_cache = b->next;
+      --region_cache_count;
+      region_unmap (b);
+    }
+}
+
+struct malloc_region *
+__malloc_region_create (void)
+{
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  struct region_block *b = region_get_block ();
+  if (b == NULL)
+    return NULL;
+
+  struct malloc_region *r
+    = (struct malloc_region *) ((char *) b + REGION_HEADER_SIZE);
+  r->first = b;
+  r->ptr = (char *) b + REGION_FIRST_SIZE;
+  r->end = (char *) b + region_block_size;
+  r->blocks = NULL;
+  r->last = NULL;
+  r->nblocks = 0;
+  r->large = NULL;
+  return r;
+}
+
+/* Slow path of __malloc_region_alloc, for a request of SIZE bytes, a
+   multiple of MALLOC_ALIGNMENT, which does not fit in the current
+   block.  */
+static void *
+region_alloc_slow (struct malloc_region *r, size_t size)
+{
+  if (size > (region_block_size - REGION_HEADER_SIZE) / 4)
+    {
+      size_t pagesize = GLRO (dl_pagesize);
+      if (size > PTRDIFF_MAX - REGION_HEADER_SIZE - pagesize)
+	{
+	  __set_errno (ENOMEM);
+	  return NULL;
+	}
+      struct region_block *b
+	= region_map (ALIGN_UP (size + REGION_HEADER_SIZE, pagesize));
+      if (b == NULL)
+	return NULL;
+      b->next = r->large;
+      r->large = b;
+      return (char *) b + REGION_HEADER_SIZE;
+    }
+
+  struct region_block *b = region_get_block ();
+  if (b == NULL)
+    return NULL;
+  b->next = r->blocks;
+  r->blocks = b;
+  if (r->last == NULL)
+    r->last = b;
+  ++r->nblocks;
+
+  void *p = (char *) b + REGION_HEADER_SIZE;
+  r->ptr = (char *) p + size;
+  r->end = (char *) b + region_block_size;
+  return p;
+}
+
+void *
+__malloc_region_alloc (struct malloc_region *r, size_t bytes)
+{
+  size_t size = ALIGN_UP (bytes, MALLOC_ALIGNMENT);
+
+  /* Zero-sized requests still get distinct pointers.  */
+  if (__glibc_unlikely (size == 0))
+    size = bytes == 0 ? MALLOC_ALIGNMENT : SIZE_MAX;
+
+  if (__glibc_likely (size <= (size_t) (r->end - r->ptr)))
+    {
+      void *p = r->ptr;
+      r->ptr += size;
+      return p;
+    }
+  return region_alloc_slow (r, size);
+}
+
+void
+__malloc_region_reset (struct malloc_region *r)
+{
+  struct region_block *b = r->large;
+  while (b != NULL)
+    {
+      struct region_block *next = b->next;
+      region_unmap (b);
+      b = next;
+    }
+  r->large = NULL;
+
+  if (r->blocks != NULL)
+    region_put_blocks (r->blocks, r->last, r->nblocks);
+  r->blocks = NULL;
+  r->last = NULL;
+  r->nblocks = 0;
+
+  r->ptr = (char *) r->first + REGION_FIRST_SIZE;
+  r->end = (char *) r->first + region_block_size;
+}
+
+void
+__malloc_region_destroy (struct malloc_region *r)
+{
+  if (r == NULL)
+    return;
+
+  __malloc_region_reset (r);
+  struct region_block *b = r->first;
+  region_put_blocks (b, b, 1);
+}
+
+/* Unmap the block cache of the calling thread, which is exiting.  */
+static void
+region_thread_shutdown (void)
+{
+  struct region_block *b = region_cache;
+  region_cache = NULL;
+  region_cache_count = 0;
+  while (b != NULL)
+    {
+      struct region_block *next = b->next;
+      region_unmap (b);
+      b = next;
+    }
+}
+
+/* Choose the block size.  Called once from ptmalloc_init.  */
+static void
+region_init (void)
+{
+#if HAVE_TUNABLES
+  size_t pagesize = mp_.hp_pagesize != 0 ? mp_.hp_pagesize
+					 : mp_.thp_pagesize;
+  if (pagesize > region_block_size)
+    region_block_size = pagesize;
+#endif
+}
+#endif /* IS_IN (libc) */
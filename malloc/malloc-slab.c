@@ -0,0 +1,572 @@
+/* Slab allocator for small objects.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* When glibc.malloc.slab_max is set, malloc and calloc requests of up
+   to that many bytes are served from slabs instead of chunks.  A slab
+   is a SLAB_SIZE run of objects of one size class, a multiple of
+   MALLOC_ALIGNMENT, preceded by a small header with a bitmap of its
+   free objects.  Objects have no header of their own, so a 16-byte
+   request uses 16 bytes instead of a 32-byte chunk.
+
+   All slabs are carved from a single region reserved at startup, so
+   free recognizes a slab object by its address alone and finds the
+   header by rounding the address down to SLAB_SIZE.  The region is
+   committed in SLAB_COMMIT_SIZE steps as slabs are needed.  When it is
+   exhausted, requests fall back to the regular allocator.
+
+   Each thread allocates from one slab per size class, which it owns.
+   The owner allocates and frees without atomic operations.  Other
+   threads set the bit of the objects they free in a second bitmap,
+   which the owner merges into its own when it runs out of objects.  A
+   slab with no free object left is detached from its owner and put
+   back on the available list of its class by the first thread which
+   frees one of its objects.  When a thread exits, its slabs are put on
+   the available lists.
+
+   A slab which is not owned by any thread is moved to the empty list
+   as soon as all its objects are free, so that it can be reused for any
+   size class.  Each thread keeps its current slab of each class even if
+   it is empty.  Empty slabs beyond the trim threshold are given back to
+   the system with MADV_DONTNEED.  Their header is lost, so their
+   numbers are kept in the separate slab_released stack.  */
+
+/* Size and alignment of a slab.  */
+#define SLAB_SIZE 4096
+
+/* Largest object size, and number of size classes.  */
+#define SLAB_MAX_SIZE DEFAULT_MXFAST
+#define SLAB_CLASSES (SLAB_MAX_SIZE / MALLOC_ALIGNMENT)
+
+#define SLAB_WORD_BITS (sizeof (unsigned long) * 8)
+#define SLAB_MAP_WORDS (SLAB_SIZE / MALLOC_ALIGNMENT / SLAB_WORD_BITS)
+
+/* Size of the address space reserved for slabs, and the amount of
+   memory committed at once.  */
+#if __WORDSIZE == 64
+# define SLAB_REGION_SIZE ((size_t) 1 << 30)
+#else
+# define SLAB_REGION_SIZE ((size_t) 1 << 26)
+#endif
+#define SLAB_COMMIT_SIZE (64 * 1024)
+
+/* Values of the state member of struct slab.  */
+enum
+{
+  /* Owned by a thread, which allocates from it.  */
+  SLAB_OWNED,
+  /* Detached from its owner because it had no free object, and not on
+     any list.  */
+  SLAB_FULL,
+  /* On slab_available.  */
+  SLAB_AVAILABLE,
+  /* On slab_empty.  */
+  SLAB_EMPTY
+};
+
+struct slab
+{
+  /* slab_current of the owning thread, or NULL.  Only the owner writes
+     the non-null value, so other threads never find their own.  */
+  void *owner;
+  /* Links of slab_available or slab_empty, which only use next.  */
+  struct slab *next;
+  struct slab *prev;
+  int state;
+  /* Object size, offset of the first object and number of objects.  */
+  unsigned int size;
+  unsigned int start;
+  unsigned int nobjs;
+  /* ceil (2^32 / size), to compute object indices with a
+     multiplication.  */
+  uint32_t inverse;
+  /* Index of the first word of free_map which may be non-zero.  */
+  unsigned int first;
+  /* Number of objects in free_map, only maintained while the slab is
+     not owned, and number of bits set in remote_map.  */
+  unsigned int nfree;
+  unsigned int nremote;
+  /* Free objects.  Only accessed by the owner.  */
+  unsigned long free_map[SLAB_MAP_WORDS];
+  /* Objects freed by other threads, not yet merged into free_map.  */
+  unsigned long remote_map[SLAB_MAP_WORDS];
+};
+
+#if IS_IN (libc)
+/* The reserved region.  slab_size is zero if slabs are disabled.  */
+static char *slab_base;
+static size_t slab_size;
+
+/* The following variables are protected by slab_lock in arena.c.
+   Slabs between slab_top and slab_committed are committed but have
+   never been used.  slab_top is also read without the lock, to check
+   the pointers passed to free.  */
+static char *slab_top;
+static char *slab_committed;
+static struct slab *slab_available[SLAB_CLASSES];
+static struct slab *slab_empty;
+static size_t slab_nempty;
+
+/* Numbers of the slabs given back to the system, allocated when the
+   first slab is released.  Also protected by slab_lock.  */
+static uint32_t *slab_released;
+static size_t slab_nreleased;
+
+/* The slab each thread allocates from, for each size class.  Its
+   address identifies the thread in the owner member of the slabs.  */
+static __thread struct slab *slab_current[SLAB_CLASSES];
+
+static __always_inline bool
+slab_contains (void *mem)
+{
+  return (uintptr_t) mem - (uintptr_t) slab_base < slab_size;
+}
+
+static __always_inline size_t
+slab_class (size_t bytes)
+{
+  return (bytes - 1) / MALLOC_ALIGNMENT;
+}
+
+/* Return the slab of MEM, which is in the slab region.  Terminate the
+   process with message STR if the slab has never been used: it may not
+   even be committed.  slab_top only grows, so it is above the slab of
+   any object handed out.  */
+static __always_inline struct slab *
+slab_for_mem (void *mem, const char *str)
+{
+  if (__glibc_unlikely ((char *) mem >= atomic_load_relaxed (&slab_top)))
+    malloc_printerr (str);
+  return PTR_ALIGN_DOWN (mem, SLAB_SIZE);
+}
+
+/* Take a free object from slab S, which the current thread owns.  */
+static __always_inline void *
+slab_pop (struct slab *s)
+{
+  for (unsigned int i = s->first; i < SLAB_MAP_WORDS; ++i)
+    {
+      unsigned long word = s->free_map[i];
+      if (word != 0)
+	{
+	  s->free_map[i] = word & (word - 1);
+	  s->first = i;
+	  return ((char *) s + s->start
+		  + (i * SLAB_WORD_BITS + __builtin_ctzl (word)) * s->size);
+	}
+    }
+  s->first = SLAB_MAP_WORDS;
+  return NULL;
+}
+
+/* Merge the objects freed by other threads into the free map of S,
+   which the current thread owns.  Return false if there were none.  */
+static bool
+slab_collect (struct slab *s)
+{
+  bool found = false;
+
+  for (unsigned int i = 0; i < SLAB_MAP_WORDS; ++i)
+    if (atomic_load_relaxed (&s->remote_map[i]) != 0)
+      {
+	unsigned long word = atomic_exchange_acquire (&s->remote_map[i], 0);
+	s->free_map[i] |= word;
+	s->first = MIN (s->first, i);
+	atomic_fetch_add_relaxed (&s->nremote,
+				  -(unsigned int) __builtin_popcountl (word));
+	found = true;
+      }
+  return found;
+}
+
+/* Return word I of the free map of slab S when all its objects are
+   free.  */
+static unsigned long
+slab_all_free (struct slab *s, unsigned int i)
+{
+  unsigned int bits = s->nobjs - MIN (s->nobjs, i * SLAB_WORD_BITS);
+
+  return bits >= SLAB_WORD_BITS ? -1UL : (1UL << bits) - 1;
+}
+
+static void
+slab_format (struct slab *s, size_t class)
+{
+  s->size = (class + 1) * MALLOC_ALIGNMENT;
+  s->start = ALIGN_UP (sizeof (struct slab), MALLOC_ALIGNMENT);
+  s->nobjs = (SLAB_SIZE - s->start) / s->size;
+  s->inverse = 0xffffffffU / s->size + 1;
+  s->first = 0;
+  s->nfree = s->nobjs;
+  s->nremote = 0;
+  for (unsigned int i = 0; i < SLAB_MAP_WORDS; ++i)
+    {
+      s->free_map[i] = slab_all_free (s, i);
+      s->remote_map[i] = 0;
+    }
+}
+
+/* Put slab S on the available list of CLASS.  Called with slab_lock
+   held.  */
+static void
+slab_list_push (size_t class, struct slab *s)
+{
+  s->prev = NULL;
+  s->next = slab_available[class];
+  if (s->next != NULL)
+    s->next->prev = s;
+  slab_available[class] = s;
+  atomic_store_relaxed (&s->state, SLAB_AVAILABLE);
+}
+
+/* Remove slab S from the available list of CLASS.  Called with
+   slab_lock held.  */
+static void
+slab_list_remove (size_t class, struct slab *s)
+{
+  if (s->prev != NULL)
+    s->prev->next = s->next;
+  else
+    slab_available[class] = s->next;
+  if (s->next != NULL)
+    s->next->prev = s->prev;
+}
+
+/* Give the memory of slab S back to the system.  Return false if this
+   is not possible, because slabs are smaller than pages or the stack
+   of released slabs cannot be allocated.  Called with slab_lock
+   held.  */
+static bool
+slab_release (struct slab *s)
+{
+  if (GLRO (dl_pagesize) > SLAB_SIZE)
+    return false;
+
+  if (slab_released == NULL)
+    {
+      size_t size = ALIGN_UP (slab_size / SLAB_SIZE * sizeof (uint32_t),
+			      GLRO (dl_pagesize));
+      void *p = MMAP (NULL, size, PROT_READ | PROT_WRITE, MAP_NORESERVE);
+      if (p == MAP_FAILED)
+	return false;
+      slab_released = p;
+    }
+
+  __madvise (s, SLAB_SIZE, MADV_DONTNEED);
+  slab_released[slab_nreleased++] = ((char *) s - slab_base) / SLAB_SIZE;
+  return true;
+}
+
+/* Put slab S, none of whose objects is in use, on the empty list, or
+   release it if the empty slabs already exceed the trim threshold.
+   Called with slab_lock held.  */
+static void
+slab_put_empty (struct slab *s)
+{
+  if (slab_nempty * SLAB_SIZE >= mp_.trim_threshold && slab_release (s))
+    return;
+
+  atomic_store_relaxed (&s->state, SLAB_EMPTY);
+  s->next = slab_empty;
+  slab_empty = s;
+  ++slab_nempty;
+}
+
+/* Return a slab of class CLASS which is not owned by any thread, or
+   NULL if the region is exhausted.  Called with slab_lock held.  */
+static struct slab *
+slab_get_locked (size_t class)
+{
+  struct slab *s = slab_available[class];
+  if (s != NULL)
+    {
+      slab_list_remove (class, s);
+      return s;
+    }
+
+  s = slab_empty;
+  if (s != NULL)
+    {
+      slab_empty = s->next;
+      --slab_nempty;
+    }
+  else if (slab_nreleased > 0)
+    {
+      size_t n = slab_released[--slab_nreleased];
+      s = (struct slab *) (slab_base + n * SLAB_SIZE);
+    }
+  else
+    {
+      if (slab_top == slab_committed)
+	{
+	  size_t grow = ALIGN_UP (SLAB_COMMIT_SIZE, GLRO (dl_pagesize));
+	  if (grow > slab_base + slab_size - slab_committed
+	      || __mprotect (slab_committed, grow,
+			     PROT_READ | PROT_WRITE) != 0)
+	    return NULL;
+	  slab_committed += grow;
+	}
+      s = (struct slab *) slab_top;
+      atomic_store_relaxed (&slab_top, slab_top + SLAB_SIZE);
+    }
+  slab_format (s, class);
+  return s;
+}
+
+/* Slow path of slab_malloc, taken when the current slab of CLASS has no
+   free object left.  */
+static __attribute_noinline__ void *
+slab_refill (size_t class)
+{
+  struct slab *s = slab_current[class];
+
+  if (s != NULL)
+    {
+      if (slab_collect (s))
+	return slab_pop (s);
+
+      /* Detach the slab.  A thread which frees one of its objects from
+	 now on puts it back on the available list.  Objects freed
+	 before the state change are collected below; the fence pairs
+	 with the one in slab_free_remote, so that one of the two
+	 threads notices the other.  */
+      atomic_store_relaxed (&s->owner, NULL);
+      atomic_store_relaxed (&s->nfree, 0);
+      atomic_store_relaxed (&s->state, SLAB_FULL);
+      atomic_thread_fence_seq_cst ();
+      slab_current[class] = NULL;
+      for (unsigned int i = 0; i < SLAB_MAP_WORDS; ++i)
+	if (atomic_load_relaxed (&s->remote_map[i]) != 0)
+	  {
+	    int expected = SLAB_FULL;
+	    while (expected == SLAB_FULL)
+	      if (atomic_compare_exchange_weak_acquire (&s->state, &expected,
+							SLAB_OWNED))
+		{
+		  atomic_store_relaxed (&s->owner, (void *) slab_current);
+		  slab_current[class] = s;
+		  slab_collect (s);
+		  return slab_pop (s);
+		}
+	    break;
+	  }
+    }
+
+  __libc_lock_lock (slab_lock);
+  s = slab_get_locked (class);
+  if (s != NULL)
+    atomic_store_relaxed (&s->state, SLAB_OWNED);
+  __libc_lock_unlock (slab_lock);
+
+  if (s == NULL)
+    return NULL;
+
+  atomic_store_relaxed (&s->owner, (void *) slab_current);
+  slab_current[class] = s;
+  slab_collect (s);
+  return slab_pop (s);
+}
+
+/* Allocate an object for a request of BYTES, which must be between 1
+   and mp_.slab_max.  Return NULL if no slab can be obtained.  */
+static __always_inline void *
+slab_malloc (size_t bytes)
+{
+  size_t class = slab_class (bytes);
+  struct slab *s = slab_current[class];
+  void *mem;
+
+  if (s != NULL && (mem = slab_pop (s)) != NULL)
+    return mem;
+  return slab_refill (class);
+}
+
+/* Return the index of object MEM in slab S, and terminate the process
+   if MEM is not the start of an object.  */
+static __always_inline size_t
+slab_index (struct slab *s, void *mem)
+{
+  size_t off = (char *) mem - (char *) s - s->start;
+  size_t idx = ((uint64_t) off * s->inverse) >> 32;
+
+  if (__glibc_unlikely (off >= SLAB_SIZE || idx * s->size != off
+			|| idx >= s->nobjs))
+    malloc_printerr ("free(): invalid pointer");
+  return idx;
+}
+
+/* Return true if all objects of slab S, which is not owned, are free.
+   NREMOTE is the number of objects freed by other threads.  */
+static __always_inline bool
+slab_is_empty (struct slab *s, unsigned int nremote)
+{
+  return atomic_load_relaxed (&s->nfree) + nremote == s->nobjs;
+}
+
+/* Move slab S, which is on the available list, to the empty list if
+   all its objects are free.  Called with slab_lock held.  */
+static void
+slab_check_empty (struct slab *s)
+{
+  if (atomic_load_relaxed (&s->state) == SLAB_AVAILABLE
+      && slab_is_empty (s, atomic_load_relaxed (&s->nremote)))
+    {
+      slab_list_remove (slab_class (s->size), s);
+      slab_put_empty (s);
+    }
+}
+
+static __attribute_noinline__ void
+slab_free_remote (struct slab *s, size_t idx)
+{
+  unsigned long mask = 1UL << (idx % SLAB_WORD_BITS);
+  unsigned long old = atomic_fetch_or_release
+    (&s->remote_map[idx / SLAB_WORD_BITS], mask);
+
+  if (__glibc_unlikely (old & mask))
+    malloc_printerr ("free(): double free detected in slab");
+  unsigned int nremote = atomic_fetch_add_relaxed (&s->nremote, 1) + 1;
+
+  /* Pairs with the fences in slab_refill and slab_thread_shutdown.  */
+  atomic_thread_fence_seq_cst ();
+  int state = atomic_load_relaxed (&s->state);
+  if (state == SLAB_OWNED
+      || (state == SLAB_AVAILABLE && !slab_is_empty (s, nremote)))
+    return;
+
+  /* The owner of a full slab may take it back without slab_lock, so
+     the state is changed with a CAS.  */
+  __libc_lock_lock (slab_lock);
+  if (atomic_compare_and_exchange_bool_acq (&s->state, SLAB_AVAILABLE,
+					    SLAB_FULL) == 0)
+    slab_list_push (slab_class (s->size), s);
+  slab_check_empty (s);
+  __libc_lock_unlock (slab_lock);
+}
+
+/* Free object MEM and return its size.  */
+static __always_inline size_t
+slab_free (void *mem)
+{
+  struct slab *s = slab_for_mem (mem, "free(): invalid pointer");
+  size_t idx = slab_index (s, mem);
+  size_t size = s->size;
+
+  if (atomic_load_relaxed (&s->owner) != (void *) slab_current)
+    {
+      slab_free_remote (s, idx);
+      return size;
+    }
+
+  unsigned int i = idx / SLAB_WORD_BITS;
+  unsigned long mask = 1UL << (idx % SLAB_WORD_BITS);
+  if (__glibc_unlikely (s->free_map[i] & mask))
+    malloc_printerr ("free(): double free detected in slab");
+  s->free_map[i] |= mask;
+  s->first = MIN (s->first, i);
+  return size;
+}
+
+/* Return the size of MEM, which has just been returned by
+   slab_malloc.  */
+static __always_inline size_t
+slab_object_size (void *mem)
+{
+  return ((struct slab *) PTR_ALIGN_DOWN (mem, SLAB_SIZE))->size;
+}
+
+static __always_inline size_t
+slab_usable (void *mem)
+{
+  return slab_for_mem (mem, "malloc_usable_size(): invalid pointer")->size;
+}
+
+static void *
+slab_realloc (void *oldmem, size_t bytes)
+{
+  struct slab *s = slab_for_mem (oldmem, "realloc(): invalid pointer");
+  slab_index (s, oldmem);
+  size_t oldsize = s->size;
+
+  if (bytes <= oldsize)
+    return oldmem;
+
+  void *newmem = __libc_malloc (bytes);
+  if (newmem != NULL)
+    {
+      memcpy (newmem, oldmem, oldsize);
+      __libc_free (oldmem);
+    }
+  return newmem;
+}
+
+/* Give the slabs of the exiting thread back to the pool.  */
+static void
+slab_thread_shutdown (void)
+{
+  for (size_t class = 0; class < SLAB_CLASSES; ++class)
+    {
+      struct slab *s = slab_current[class];
+      if (s == NULL)
+	continue;
+      slab_current[class] = NULL;
+
+      slab_collect (s);
+      atomic_store_relaxed (&s->owner, NULL);
+
+      unsigned int nfree = 0;
+      for (unsigned int i = 0; i < SLAB_MAP_WORDS; ++i)
+	nfree += __builtin_popcountl (s->free_map[i]);
+      atomic_store_relaxed (&s->nfree, nfree);
+
+      /* Objects freed by other threads while the slab was still owned
+	 are only noticed here, after the fence which pairs with the one
+	 in slab_free_remote.  */
+      __libc_lock_lock (slab_lock);
+      slab_list_push (class, s);
+      atomic_thread_fence_seq_cst ();
+      slab_check_empty (s);
+      __libc_lock_unlock (slab_lock);
+    }
+}
+
+/* Reserve the slab region if glibc.malloc.slab_max is set.  Called once
+   from ptmalloc_init.  Slab objects carry no tag, so slabs are not used
+   if memory tagging is enabled.  */
+static void
+slab_init (void)
+{
+  if (mp_.slab_max == 0 || mtag_enabled)
+    {
+      mp_.slab_max = 0;
+      return;
+    }
+
+  char *base = (char *) MMAP (NULL, SLAB_REGION_SIZE, PROT_NONE,
+			      MAP_NORESERVE);
+  if (base == MAP_FAILED)
+    {
+      mp_.slab_max = 0;
+      return;
+    }
+
+  slab_base = base;
+  slab_top = slab_committed = base;
+  slab_size = SLAB_REGION_SIZE;
+}
+
+#endif /* IS_IN (libc) */
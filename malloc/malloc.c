@@ -256,6 +256,9 @@
 #include <sys/random.h>
 #include <not-cancel.h>
 
+/* For arena_decay.  */
+#include <time.h>
+
 /*
   Debugging:
 
@@ -604,6 +607,16 @@ libc_hidden_proto (__libc_malloc)
 void     __libc_free(void*);
 libc_hidden_proto (__libc_free)
 
+/*
+  free_sized(void* p, size_t n)
+  free_aligned_sized(void* p, size_t alignment, size_t n)
+  Like free, for a chunk allocated with a request of n bytes (and the
+  given alignment).  If the chunk fits in the tcache, it is put there
+  without the overhead of free.
+*/
+void     __libc_free_sized(void*, size_t);
+void     __libc_free_aligned_sized(void*, size_t, size_t);
+
 /*
   calloc(size_t n_elements, size_t element_size);
   Returns a pointer to n_elements * element_size bytes, with all locations
@@ -1086,6 +1099,11 @@ typedef struct malloc_chunk* mchunkptr;
 
 static void*  _int_malloc(mstate, size_t);
 static void     _int_free(mstate, mchunkptr, int);
+static void     _int_free_chunk (mstate, mchunkptr, INTERNAL_SIZE_T, int);
+static INTERNAL_SIZE_T _int_free_merge_chunk (mstate, mchunkptr,
+					      INTERNAL_SIZE_T);
+static void     _int_free_maybe_trim (mstate, INTERNAL_SIZE_T);
+static void     remote_free_push (mstate, mchunkptr);
 static void*  _int_realloc(mstate, mchunkptr, INTERNAL_SIZE_T,
 			   INTERNAL_SIZE_T);
 static void*  _int_memalign(mstate, size_t, size_t);
@@ -1803,6 +1821,23 @@ get_max_fast (void)
  */
 
 
+/* Counters of an arena, updated with relaxed atomic operations if
+   glibc.malloc.stats is set.  Allocations and frees are counted in the
+   arena the chunk belongs to, whichever thread performs them, and
+   mmapped chunks in the main arena.  */
+struct arena_stats
+{
+  size_t nmalloc[MALLOC_STATS_CLASSES];
+  size_t nfree[MALLOC_STATS_CLASSES];
+  /* Size of the chunks of the arena allocated by the application.
+     Chunks held in a tcache are counted as free.  */
+  size_t in_use;
+  size_t tcache_hits;
+  size_t tcache_misses;
+  size_t lock_waits;
+  size_t lock_wait_ns;
+};
+
 struct malloc_state
 {
   /* Serialize access.  */
@@ -1818,6 +1853,15 @@ struct malloc_state
   /* Fastbins */
   mfastbinptr fastbinsY[NFASTBINS];
 
+  /* Chunks freed by threads which could not acquire the arena lock.
+     Other threads push chunks onto this list with a CAS, the thread
+     holding the arena lock drains it with remote_free_drain.  */
+  mchunkptr remote_free;
+
+  /* Fastbin where the next incremental consolidation starts, see
+     malloc_consolidate_step.  */
+  unsigned int consolidate_next;
+
   /* Base of the topmost chunk -- not otherwise kept in a bin */
   mchunkptr top;
 
@@ -1842,9 +1886,22 @@ struct malloc_state
      free_list_lock in arena.c.  */
   INTERNAL_SIZE_T attached_threads;
 
+  /* NUMA node the heaps of this arena are bound to, or -1.  Only
+     meaningful in NUMA mode, see arena.c.  */
+  int node;
+
   /* Memory allocated from the system in this arena.  */
   INTERNAL_SIZE_T system_mem;
   INTERNAL_SIZE_T max_system_mem;
+
+  /* Number of calls to _int_malloc since arena_decay last checked the
+     clock, and the time in milliseconds of the last purge of idle free
+     chunks.  */
+  unsigned int decay_ticks;
+  size_t decay_last;
+
+  /* Statistics reported by malloc_statistics.  */
+  struct arena_stats stats;
 };
 
 struct malloc_par
@@ -1855,6 +1912,37 @@ struct malloc_par
   INTERNAL_SIZE_T mmap_threshold;
   INTERNAL_SIZE_T arena_test;
   INTERNAL_SIZE_T arena_max;
+  /* Nonzero if arenas are selected by the current CPU instead of being
+     bound to threads.  */
+  int arena_percpu;
+  /* Nonzero if arenas are bound to and selected by NUMA node.  */
+  int arena_numa;
+
+  /* Nonzero if frees from threads not attached to the arena are
+     deferred to the remote free list of the arena when its lock is
+     contended.  */
+  int remote_free;
+
+  /* Time in milliseconds after which the pages of idle free chunks are
+     returned to the system.  0 disables purging.  */
+  size_t decay_time;
+
+  /* Maximum number of fastbin chunks consolidated by one call of malloc
+     or free, 0 if the fastbins are always consolidated at once.  */
+  size_t consolidate_budget;
+
+  /* Average number of bytes allocated between two samples of the heap
+     profiler, 0 if it is disabled; the signal which dumps the samples
+     and the file they are written to.  */
+  size_t profile_rate;
+  int profile_signal;
+  const char *profile_file;
+
+  /* Nonzero if the counters of struct arena_stats are maintained.  */
+  int stats;
+
+  /* Largest request served from slabs, 0 if slabs are disabled.  */
+  size_t slab_max;
 
 #if HAVE_TUNABLES
   /* Transparent Large Page support.  */
@@ -1877,6 +1965,9 @@ struct malloc_par
   /* Statistics */
   INTERNAL_SIZE_T mmapped_mem;
   INTERNAL_SIZE_T max_mmapped_mem;
+  /* Number of chunks and heaps mapped and unmapped.  */
+  size_t mmap_count;
+  size_t munmap_count;
 
   /* First address handed out by MORECORE/sbrk.  */
   char *sbrk_base;
@@ -1890,6 +1981,13 @@ struct malloc_par
   /* Maximum number of chunks to remove from the unsorted list, which
      aren't used to prefill the cache.  */
   size_t tcache_unsorted_limit;
+  /* Number of chunks to move between a tcache bin and the arena in one
+     acquisition of the arena lock.  0 disables batching.  */
+  size_t tcache_batch;
+  /* Maximum number of bytes each thread can hold in its tcache when the
+     bin limits are adjusted to the allocation pattern.  0 keeps the
+     limits fixed at tcache_count.  */
+  size_t tcache_budget;
 #endif
 };
 
@@ -1925,6 +2023,50 @@ static struct malloc_par mp_ =
 #endif
 };
 
+/*
+   Decay-based purging.
+
+   If glibc.malloc.decay_time is set, free chunks which span at least one
+   whole page carry the time at which they were freed, in the word after
+   the malloc_chunk fields.  arena_decay periodically returns the pages
+   of chunks which have been free for longer than the decay time to the
+   system and marks them with DECAY_PURGED, so they are not purged again
+   until they are freed anew.
+ */
+
+#define decay_stamp(p) \
+  (*(size_t *) ((char *) (p) + sizeof (struct malloc_chunk)))
+#define DECAY_PURGED ((size_t) -1)
+
+/* Number of calls to _int_malloc between two checks of the clock.  */
+#define DECAY_TICKS 256
+
+#ifdef CLOCK_MONOTONIC_COARSE
+# define DECAY_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+# define DECAY_CLOCK CLOCK_MONOTONIC
+#endif
+
+/* Current time in milliseconds.  */
+static size_t
+decay_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (DECAY_CLOCK, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Record the current time in the free chunk P of SIZE bytes, if it is
+   large enough to have pages purged.  */
+static __always_inline void
+decay_stamp_chunk (mchunkptr p, INTERNAL_SIZE_T size)
+{
+  if (__glibc_unlikely (mp_.decay_time != 0)
+      && size >= GLRO (dl_pagesize) + sizeof (struct malloc_chunk)
+		 + sizeof (size_t))
+    decay_stamp (p) = decay_now ();
+}
+
 /*
    Initialize a malloc_state struct.
 
@@ -1963,6 +2105,21 @@ malloc_init_state (mstate av)
 static void *sysmalloc (INTERNAL_SIZE_T, mstate);
 static int      systrim (size_t, mstate);
 static void     malloc_consolidate (mstate);
+static void     malloc_consolidate_step (mstate);
+static void     malloc_consolidate_bin (mstate);
+static void     remote_free_drain (mstate);
+static void     arena_decay (mstate);
+
+/* Consolidate the fastbins of AV, in bounded steps if
+   glibc.malloc.consolidate_budget is set.  */
+static __always_inline void
+malloc_consolidate_some (mstate av)
+{
+  if (mp_.consolidate_budget != 0)
+    malloc_consolidate_step (av);
+  else
+    malloc_consolidate (av);
+}
 
 
 /* -------------- Early definitions for debugging hooks ---------------- */
@@ -2464,6 +2621,7 @@ sysmalloc_mmap (INTERNAL_SIZE_T nb, size_t pagesize, int extra_flags, mstate av)
   /* update statistics */
   int new = atomic_fetch_add_relaxed (&mp_.n_mmaps, 1) + 1;
   atomic_max (&mp_.max_n_mmaps, new);
+  atomic_fetch_add_relaxed (&mp_.mmap_count, 1);
 
   unsigned long sum;
   sum = atomic_fetch_add_relaxed (&mp_.mmapped_mem, size) + size;
@@ -2504,6 +2662,7 @@ sysmalloc_mmap_fallback (long int *s, INTERNAL_SIZE_T nb,
 			       extra_flags));
   if (mbrk == MAP_FAILED)
     return MAP_FAILED;
+  atomic_fetch_add_relaxed (&mp_.mmap_count, 1);
 
 #ifdef MAP_HUGETLB
   if (!(extra_flags & MAP_HUGETLB))
@@ -2614,7 +2773,8 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           set_head (old_top, (((char *) old_heap + old_heap->size) - (char *) old_top)
                     | PREV_INUSE);
         }
-      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad)))
+      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad,
+				 av->node)))
         {
           /* Use a newly allocated heap.  */
           heap->ar_ptr = av;
@@ -3015,6 +3175,10 @@ systrim (size_t pad, mstate av)
   return 0;
 }
 
+#include "malloc-profile.c"
+#include "malloc-slab.c"
+#include "malloc-region.c"
+
 static void
 munmap_chunk (mchunkptr p)
 {
@@ -3035,8 +3199,12 @@ munmap_chunk (mchunkptr p)
       || __glibc_unlikely (!powerof2 (mem & (pagesize - 1))))
     malloc_printerr ("munmap_chunk(): invalid pointer");
 
+  if (chunk_is_sampled (p))
+    profile_forget ((void *) mem);
+
   atomic_fetch_add_relaxed (&mp_.n_mmaps, -1);
   atomic_fetch_add_relaxed (&mp_.mmapped_mem, -total_size);
+  atomic_fetch_add_relaxed (&mp_.munmap_count, 1);
 
   /* If munmap failed the process virtual memory address space is in a
      bad shape.  Just leave the block hanging around, the process will
@@ -3070,6 +3238,8 @@ mremap_chunk (mchunkptr p, size_t new_size)
   if (total_size == new_size)
     return p;
 
+  bool sampled = chunk_is_sampled (p);
+
   cp = (char *) __mremap ((char *) block, total_size, new_size,
                           MREMAP_MAYMOVE);
 
@@ -3085,6 +3255,12 @@ mremap_chunk (mchunkptr p, size_t new_size)
   assert (prev_size (p) == offset);
   set_head (p, (new_size - offset) | IS_MMAPPED);
 
+  /* Keep a sampled block in the profile, under its new address if it
+     has moved.  */
+  if (sampled
+      && (cp == (char *) block || profile_move ((void *) mem, chunk2mem (p))))
+    set_non_main_arena (p);
+
   INTERNAL_SIZE_T new;
   new = atomic_fetch_add_relaxed (&mp_.mmapped_mem, new_size - size - offset)
         + new_size - size - offset;
@@ -3115,8 +3291,27 @@ typedef struct tcache_perthread_struct
 {
   uint16_t counts[TCACHE_MAX_BINS];
   tcache_entry *entries[TCACHE_MAX_BINS];
+  /* Maximum number of chunks in each bin.  These start at
+     mp_.tcache_count and are adjusted by tcache_adapt if
+     glibc.malloc.tcache_budget is set.  */
+  uint16_t limits[TCACHE_MAX_BINS];
+  /* Number of allocations which found the bin empty and of frees which
+     found it full since the limits were last adjusted.  */
+  uint16_t misses[TCACHE_MAX_BINS];
+  uint16_t overflows[TCACHE_MAX_BINS];
+  /* Lowest number of chunks left in each bin by an allocation since
+     the limits were last adjusted, or UINT16_MAX if there was none.  */
+  uint16_t lows[TCACHE_MAX_BINS];
+  /* Sum of the misses and overflows of all bins.  */
+  unsigned int events;
+  /* Number of bytes the bins can hold with the current limits.  */
+  size_t capacity;
 } tcache_perthread_struct;
 
+/* Number of tcache misses and overflows after which the bin limits are
+   adjusted to the observed allocation pattern.  */
+# define TCACHE_ADAPT_EVENTS 256
+
 static __thread bool tcache_shutting_down = false;
 static __thread tcache_perthread_struct *tcache = NULL;
 
@@ -3171,10 +3366,219 @@ tcache_get (size_t tc_idx)
     malloc_printerr ("malloc(): unaligned tcache chunk detected");
   tcache->entries[tc_idx] = REVEAL_PTR (e->next);
   --(tcache->counts[tc_idx]);
+  if (tcache->counts[tc_idx] < tcache->lows[tc_idx])
+    tcache->lows[tc_idx] = tcache->counts[tc_idx];
   e->key = 0;
   return (void *) e;
 }
 
+/* Aligned allocations whose chunks fit into the tcache are served from
+   aligned size classes.  The chunk size of a class is the request size
+   rounded up to the alignment, so that chunks carved back to back from
+   one aligned block are all aligned.  The spare chunks of a block go to
+   the tcache bin of the class, where later aligned allocations find
+   them without taking the arena lock or splitting another chunk.  */
+
+/* Largest number of chunks carved from one aligned block.  */
+# define TCACHE_ALIGNED_BATCH 8
+
+/* Number of tcache entries examined for an aligned chunk.  The bins of
+   the aligned size classes also hold chunks freed after plain malloc
+   calls, so keep the walk short.  */
+# define TCACHE_ALIGNED_SCAN 4
+
+/* Like tcache_get, but return one of the first TCACHE_ALIGNED_SCAN
+   chunks of the bin whose memory is aligned to ALIGNMENT, or NULL if
+   there is none.  */
+static __always_inline void *
+tcache_get_aligned (size_t tc_idx, size_t alignment)
+{
+  tcache_entry *prev = NULL;
+  tcache_entry *e = tcache->entries[tc_idx];
+  for (int i = 0; i < TCACHE_ALIGNED_SCAN && e != NULL; ++i)
+    {
+      if (__glibc_unlikely (!aligned_OK (e)))
+	malloc_printerr ("memalign(): unaligned tcache chunk detected");
+      tcache_entry *next = REVEAL_PTR (e->next);
+      if (((uintptr_t) e & (alignment - 1)) == 0)
+	{
+	  if (prev == NULL)
+	    tcache->entries[tc_idx] = next;
+	  else
+	    prev->next = PROTECT_PTR (&prev->next, next);
+	  --(tcache->counts[tc_idx]);
+	  if (tcache->counts[tc_idx] < tcache->lows[tc_idx])
+	    tcache->lows[tc_idx] = tcache->counts[tc_idx];
+	  e->key = 0;
+	  return (void *) e;
+	}
+      prev = e;
+      e = next;
+    }
+  return NULL;
+}
+
+/* Split the in-use chunk of MEM, returned by _int_memalign for a
+   request of at least COUNT * CSIZE bytes of the aligned size class of
+   tcache bin TC_IDX, into COUNT chunks of CSIZE bytes.  The last chunk
+   also gets the excess.  Put the others into the tcache, which must
+   have room for them, and return the last one.  */
+static void *
+tcache_carve_aligned (void *mem, size_t csize, size_t count, size_t tc_idx)
+{
+  mchunkptr p = mem2chunk (mem);
+  if (chunk_is_mmapped (p))
+    return mem;
+
+  size_t size = chunksize (p);
+  size_t arena_bit = chunk_main_arena (p) ? 0 : NON_MAIN_ARENA;
+
+  set_head_size (p, csize);
+  for (size_t i = 1; i < count; ++i)
+    {
+      tcache_put (p, tc_idx);
+      p = chunk_at_offset (p, csize);
+      set_head (p, (i < count - 1 ? csize : size - i * csize)
+		| PREV_INUSE | arena_bit);
+    }
+  return chunk2mem (p);
+}
+
+/* Keep the KEEP most recently freed chunks in tcache bin TC_IDX and
+   return the others to their arenas.  Consecutive chunks belonging to
+   the same arena are freed under a single acquisition of its lock.
+   The caller must not hold any arena lock.  */
+static void
+tcache_release (size_t tc_idx, size_t keep)
+{
+  tcache_entry *rest;
+
+  if (keep >= tcache->counts[tc_idx])
+    return;
+
+  if (keep == 0)
+    {
+      rest = tcache->entries[tc_idx];
+      tcache->entries[tc_idx] = NULL;
+    }
+  else
+    {
+      tcache_entry *e = tcache->entries[tc_idx];
+      for (size_t i = 1; i < keep; ++i)
+	{
+	  if (__glibc_unlikely (!aligned_OK (e)))
+	    malloc_printerr ("tcache_release(): "
+			     "unaligned tcache chunk detected");
+	  e = REVEAL_PTR (e->next);
+	}
+      rest = REVEAL_PTR (e->next);
+      e->next = PROTECT_PTR (&e->next, NULL);
+    }
+  tcache->counts[tc_idx] = keep;
+
+  mstate locked = NULL;
+  while (rest != NULL)
+    {
+      if (__glibc_unlikely (!aligned_OK (rest)))
+	malloc_printerr ("tcache_release(): unaligned tcache chunk detected");
+      tcache_entry *next = REVEAL_PTR (rest->next);
+      rest->key = 0;
+
+      mchunkptr p = mem2chunk (rest);
+      if (chunk_is_mmapped (p))
+	munmap_chunk (p);
+      else
+	{
+	  mstate av = arena_for_chunk (p);
+	  if (av != locked)
+	    {
+	      if (locked != NULL)
+		__libc_lock_unlock (locked->mutex);
+	      arena_mutex_lock (av);
+	      locked = av;
+	    }
+	  _int_free_chunk (av, p, chunksize (p), 1);
+	}
+      rest = next;
+    }
+
+  if (locked != NULL)
+    __libc_lock_unlock (locked->mutex);
+}
+
+/* Return the older half of the chunks in tcache bin TC_IDX to their
+   arenas.  */
+static void
+tcache_flush (size_t tc_idx)
+{
+  tcache_release (tc_idx, tcache->counts[tc_idx]
+			  - tcache->counts[tc_idx] / 2);
+}
+
+/* Adjust the limits of the tcache bins to the misses and overflows
+   seen since the last call.  Bins which did not overflow shrink by half
+   the number of chunks they did not need: all of their chunks if the
+   bin was not used at all, otherwise the lowest number of chunks it
+   held after an allocation.  Bins which are used down to their last
+   chunk keep their limits.  The excess chunks are returned to the
+   arenas.  Then bins which missed or overflowed at least as often as
+   they can hold chunks are doubled, as long as the capacity of the
+   tcache stays within glibc.malloc.tcache_budget.  The caller must not
+   hold any arena lock.  */
+static void
+tcache_adapt (void)
+{
+  for (size_t i = 0; i < mp_.tcache_bins; ++i)
+    {
+      size_t unused;
+      if (tcache->overflows[i] != 0)
+	continue;
+      if (tcache->lows[i] != UINT16_MAX)
+	unused = MIN (tcache->lows[i], tcache->counts[i]);
+      else if (tcache->misses[i] == 0)
+	unused = tcache->limits[i];
+      else
+	continue;
+
+      size_t limit = tcache->limits[i]
+		     - MIN ((unused + 1) / 2, tcache->limits[i]);
+      tcache->capacity -= (tcache->limits[i] - limit) * tidx2usize (i);
+      tcache->limits[i] = limit;
+      tcache_release (i, limit);
+    }
+
+  for (size_t i = 0; i < mp_.tcache_bins; ++i)
+    {
+      size_t activity = tcache->misses[i] + tcache->overflows[i];
+      size_t limit = tcache->limits[i];
+      if (activity > 0 && activity >= limit
+	  && tcache->capacity < mp_.tcache_budget)
+	{
+	  size_t grow = MAX (limit, 1);
+	  grow = MIN (grow, MAX_TCACHE_COUNT - limit);
+	  grow = MIN (grow, (mp_.tcache_budget - tcache->capacity)
+			    / tidx2usize (i));
+	  tcache->limits[i] = limit + grow;
+	  tcache->capacity += grow * tidx2usize (i);
+	}
+      tcache->misses[i] = 0;
+      tcache->overflows[i] = 0;
+      tcache->lows[i] = UINT16_MAX;
+    }
+
+  tcache->events = 0;
+}
+
+/* Record an allocation which found tcache bin TC_IDX empty.  */
+static __always_inline void
+tcache_note_miss (size_t tc_idx)
+{
+  if (tcache->misses[tc_idx] < UINT16_MAX)
+    ++tcache->misses[tc_idx];
+  if (++tcache->events >= TCACHE_ADAPT_EVENTS)
+    tcache_adapt ();
+}
+
 static void
 tcache_thread_shutdown (void)
 {
@@ -3238,6 +3642,13 @@ tcache_init(void)
     {
       tcache = (tcache_perthread_struct *) victim;
       memset (tcache, 0, sizeof (tcache_perthread_struct));
+      for (size_t i = 0; i < TCACHE_MAX_BINS; ++i)
+	{
+	  tcache->limits[i] = mp_.tcache_count;
+	  tcache->lows[i] = UINT16_MAX;
+	}
+      for (size_t i = 0; i < mp_.tcache_bins; ++i)
+	tcache->capacity += mp_.tcache_count * tidx2usize (i);
     }
 
 }
@@ -3258,6 +3669,125 @@ tcache_thread_shutdown (void)
 #endif /* !USE_TCACHE  */
 
 #if IS_IN (libc)
+/*------------------------ Statistics. ------------------------------------*/
+
+/* Chunk sizes up to STATS_SMALL_MAX have one size class each.  Larger
+   sizes are grouped by powers of two, and the last class holds all the
+   remaining ones.  */
+#define STATS_SMALL_CLASSES 64
+#define STATS_SMALL_MAX \
+  (MINSIZE + (STATS_SMALL_CLASSES - 1) * MALLOC_ALIGNMENT)
+
+/* Whether an allocation could be served by the tcache, and if so
+   whether it was.  */
+enum
+{
+  STATS_TCACHE_NONE,
+  STATS_TCACHE_HIT,
+  STATS_TCACHE_MISS
+};
+
+/* Return the base 2 logarithm of X rounded up, for X > 1.  */
+static __always_inline unsigned int
+stats_log2_up (size_t x)
+{
+  return sizeof (unsigned long) * 8 - __builtin_clzl (x - 1);
+}
+
+static __always_inline size_t
+stats_class (INTERNAL_SIZE_T size)
+{
+  if (size <= STATS_SMALL_MAX)
+    return (size - MINSIZE) / MALLOC_ALIGNMENT;
+
+  size_t class = (STATS_SMALL_CLASSES + stats_log2_up (size)
+		  - stats_log2_up (STATS_SMALL_MAX + 1));
+  return MIN (class, MALLOC_STATS_CLASSES - 1);
+}
+
+/* Return the largest chunk size of size class CLASS.  */
+static size_t
+stats_class_size (size_t class)
+{
+  if (class < STATS_SMALL_CLASSES)
+    return MINSIZE + class * MALLOC_ALIGNMENT;
+  if (class == MALLOC_STATS_CLASSES - 1)
+    return SIZE_MAX;
+
+  unsigned int bits = (stats_log2_up (STATS_SMALL_MAX + 1) + class
+		       - STATS_SMALL_CLASSES);
+  return bits < sizeof (size_t) * 8 ? (size_t) 1 << bits : SIZE_MAX;
+}
+
+/* Return the arena whose counters account for chunk P.  */
+static __always_inline mstate
+stats_arena (mchunkptr p)
+{
+  return chunk_is_mmapped (p) ? &main_arena : arena_for_chunk (p);
+}
+
+static void
+stats_malloc (mchunkptr p, int tcache)
+{
+  mstate av = stats_arena (p);
+  INTERNAL_SIZE_T size = chunksize (p);
+
+  atomic_fetch_add_relaxed (&av->stats.nmalloc[stats_class (size)], 1);
+  if (!chunk_is_mmapped (p))
+    atomic_fetch_add_relaxed (&av->stats.in_use, size);
+  if (tcache == STATS_TCACHE_HIT)
+    atomic_fetch_add_relaxed (&av->stats.tcache_hits, 1);
+  else if (tcache == STATS_TCACHE_MISS)
+    atomic_fetch_add_relaxed (&av->stats.tcache_misses, 1);
+}
+
+/* Account for the free of a chunk of SIZE bytes, counted in arena AV.
+   MMAPPED is true if the chunk was mmapped.  */
+static void
+stats_free_size (mstate av, INTERNAL_SIZE_T size, bool mmapped)
+{
+  atomic_fetch_add_relaxed (&av->stats.nfree[stats_class (size)], 1);
+  if (!mmapped)
+    atomic_fetch_add_relaxed (&av->stats.in_use, -size);
+}
+
+/* Account for the allocation of MEM, if it is not NULL, by one of the
+   public allocation functions.  TCACHE is one of the STATS_TCACHE_*
+   values.  */
+static __always_inline void
+stats_count_malloc (void *mem, int tcache)
+{
+  if (__glibc_unlikely (mp_.stats) && mem != NULL)
+    stats_malloc (mem2chunk (mem), tcache);
+}
+
+/* Account for a chunk of SIZE bytes in arena AV being given back by
+   the application.  Free and realloc only count the chunk once it has
+   passed the checks of munmap_chunk, mremap_chunk, _int_free or
+   _int_realloc.  */
+static __always_inline void
+stats_count_freed (mstate av, INTERNAL_SIZE_T size, bool mmapped)
+{
+  if (__glibc_unlikely (mp_.stats))
+    stats_free_size (av, size, mmapped);
+}
+
+/* Account for the allocation, if ALLOC, or the free of a slab object of
+   SIZE bytes.  Slab objects are counted in the main arena, in the size
+   class of the chunk which would have held them, and not in in_use.  */
+static __always_inline void
+stats_count_slab (size_t size, bool alloc)
+{
+  if (__glibc_unlikely (mp_.stats))
+    {
+      size_t class = stats_class (request2size (size));
+      if (alloc)
+	atomic_fetch_add_relaxed (&main_arena.stats.nmalloc[class], 1);
+      else
+	atomic_fetch_add_relaxed (&main_arena.stats.nfree[class], 1);
+    }
+}
+
 void *
 __libc_malloc (size_t bytes)
 {
@@ -3269,6 +3799,31 @@ __libc_malloc (size_t bytes)
 
   if (!__malloc_initialized)
     ptmalloc_init ();
+
+  if (__glibc_unlikely (profile_countdown <= bytes))
+    {
+      victim = profile_malloc (bytes);
+      if (victim != NULL)
+	{
+	  stats_count_malloc (victim, STATS_TCACHE_NONE);
+	  return tag_new_usable (victim);
+	}
+    }
+  else
+    profile_countdown -= bytes;
+
+  if (bytes - 1 < mp_.slab_max)
+    {
+      /* The profiler has already seen this allocation.  */
+      victim = slab_malloc (bytes);
+      if (victim != NULL)
+	{
+	  stats_count_slab (slab_object_size (victim), true);
+	  return victim;
+	}
+    }
+
+  int stats_tcache = STATS_TCACHE_NONE;
 #if USE_TCACHE
   /* int_free also calls request2size, be careful to not pad twice.  */
   size_t tbytes = checked_request2size (bytes);
@@ -3287,8 +3842,13 @@ __libc_malloc (size_t bytes)
       && tcache->counts[tc_idx] > 0)
     {
       victim = tcache_get (tc_idx);
+      stats_count_malloc (victim, STATS_TCACHE_HIT);
       return tag_new_usable (victim);
     }
+  if (mp_.tcache_budget != 0 && tc_idx < mp_.tcache_bins && tcache)
+    tcache_note_miss (tc_idx);
+  if (tc_idx < mp_.tcache_bins && tcache)
+    stats_tcache = STATS_TCACHE_MISS;
   DIAG_POP_NEEDS_COMMENT;
 #endif
 
@@ -3297,6 +3857,7 @@ __libc_malloc (size_t bytes)
       victim = tag_new_usable (_int_malloc (&main_arena, bytes));
       assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (victim)));
+      stats_count_malloc (victim, stats_tcache);
       return victim;
     }
 
@@ -3319,6 +3880,7 @@ __libc_malloc (size_t bytes)
 
   assert (!victim || chunk_is_mmapped (mem2chunk (victim)) ||
           ar_ptr == arena_for_chunk (mem2chunk (victim)));
+  stats_count_malloc (victim, stats_tcache);
   return victim;
 }
 libc_hidden_def (__libc_malloc)
@@ -3332,6 +3894,12 @@ __libc_free (void *mem)
   if (mem == 0)                              /* free(0) has no effect */
     return;
 
+  if (slab_contains (mem))
+    {
+      stats_count_slab (slab_free (mem), false);
+      return;
+    }
+
   /* Quickly check that the freed pointer matches the tag for the memory.
      This gives a useful double-free detection.  */
   if (__glibc_unlikely (mtag_enabled))
@@ -3340,6 +3908,7 @@ __libc_free (void *mem)
   int err = errno;
 
   p = mem2chunk (mem);
+  INTERNAL_SIZE_T size = chunksize (p);
 
   if (chunk_is_mmapped (p))                       /* release mmapped memory. */
     {
@@ -3355,6 +3924,7 @@ __libc_free (void *mem)
                       mp_.mmap_threshold, mp_.trim_threshold);
         }
       munmap_chunk (p);
+      stats_count_freed (&main_arena, size, true);
     }
   else
     {
@@ -3365,12 +3935,74 @@ __libc_free (void *mem)
 
       ar_ptr = arena_for_chunk (p);
       _int_free (ar_ptr, p, 0);
+      stats_count_freed (ar_ptr, size, false);
     }
 
   __set_errno (err);
 }
 libc_hidden_def (__libc_free)
 
+/* Fast path of free_sized and free_aligned_sized.  If the chunk of MEM
+   has exactly the size of a request for SIZE bytes, or of its aligned
+   size class for a non-zero ALIGNMENT, and fits into the tcache, put
+   it there and return true.  Comparing the size field
+   with the size given by the caller subsumes the size checks of
+   _int_free, and also rejects mmapped chunks, whose IS_MMAPPED bit is
+   set.  A chunk which looks like it is already in the tcache takes the
+   slow path, which walks the bin to detect a double free.  */
+static __always_inline bool
+free_sized_tcache (void *mem, size_t size, size_t alignment)
+{
+#if USE_TCACHE
+  if (__glibc_unlikely (mtag_enabled || mp_.stats)
+      || tcache == NULL || size > mp_.tcache_max_bytes || slab_contains (mem))
+    return false;
+
+  mchunkptr p = mem2chunk (mem);
+  size_t nb = request2size (size);
+  size_t csize = chunksize_nomask (p) & ~(PREV_INUSE | NON_MAIN_ARENA);
+  if (csize != nb
+      && (alignment <= MALLOC_ALIGNMENT || !powerof2 (alignment)
+	  || alignment > GLRO (dl_pagesize)
+	  || csize != ALIGN_UP (nb, alignment)))
+    return false;
+  if (__glibc_unlikely (misaligned_chunk (p)))
+    return false;
+
+  size_t tc_idx = csize2tidx (csize);
+  if (tc_idx >= mp_.tcache_bins
+      || tcache->counts[tc_idx] >= tcache->limits[tc_idx]
+      || __glibc_unlikely (((tcache_entry *) mem)->key == tcache_key))
+    return false;
+
+  tcache_put (p, tc_idx);
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* C23 sized deallocation.  SIZE must be the size passed to malloc,
+   calloc or realloc when MEM was allocated.  */
+void
+__libc_free_sized (void *mem, size_t size)
+{
+  if (mem != NULL && free_sized_tcache (mem, size, 0))
+    return;
+  __libc_free (mem);
+}
+
+/* Likewise for memory allocated by aligned_alloc with ALIGNMENT.  The
+   chunks of aligned allocations have either the requested size or the
+   size of its aligned size class, so the same fast path applies.  */
+void
+__libc_free_aligned_sized (void *mem, size_t alignment, size_t size)
+{
+  if (mem != NULL && free_sized_tcache (mem, size, alignment))
+    return;
+  __libc_free (mem);
+}
+
 void *
 __libc_realloc (void *oldmem, size_t bytes)
 {
@@ -3393,6 +4025,9 @@ __libc_realloc (void *oldmem, size_t bytes)
   if (oldmem == 0)
     return __libc_malloc (bytes);
 
+  if (slab_contains (oldmem))
+    return slab_realloc (oldmem, bytes);
+
   /* Perform a quick check to ensure that the pointer's tag matches the
      memory's tag.  */
   if (__glibc_unlikely (mtag_enabled))
@@ -3434,6 +4069,11 @@ __libc_realloc (void *oldmem, size_t bytes)
       return NULL;
     }
 
+  /* The statistics count a successful reallocation as the free of the
+     old block and the allocation of the new one, once the old block has
+     passed the checks of mremap_chunk, _int_realloc or _int_free.
+     Blocks obtained from __libc_malloc are already counted.  */
+
   if (chunk_is_mmapped (oldp))
     {
       void *newmem;
@@ -3443,6 +4083,8 @@ __libc_realloc (void *oldmem, size_t bytes)
       if (newp)
 	{
 	  void *newmem = chunk2mem_tag (newp);
+	  stats_count_freed (&main_arena, oldsize, true);
+	  stats_count_malloc (newmem, STATS_TCACHE_NONE);
 	  /* Give the new block a different tag.  This helps to ensure
 	     that stale handles to the previous mapping are not
 	     reused.  There's a performance hit for both us and the
@@ -3453,15 +4095,20 @@ __libc_realloc (void *oldmem, size_t bytes)
 #endif
       /* Note the extra SIZE_SZ overhead. */
       if (oldsize - SIZE_SZ >= nb)
-        return oldmem;                         /* do nothing */
+	{
+	  stats_count_freed (&main_arena, oldsize, true);
+	  stats_count_malloc (oldmem, STATS_TCACHE_NONE);
+	  return oldmem;                       /* do nothing */
+	}
 
       /* Must alloc, copy, free. */
       newmem = __libc_malloc (bytes);
       if (newmem == 0)
-        return 0;              /* propagate failure */
+	return 0;            /* propagate failure */
 
       memcpy (newmem, oldmem, oldsize - CHUNK_HDR_SZ);
       munmap_chunk (oldp);
+      stats_count_freed (&main_arena, oldsize, true);
       return newmem;
     }
 
@@ -3471,10 +4118,15 @@ __libc_realloc (void *oldmem, size_t bytes)
       assert (!newp || chunk_is_mmapped (mem2chunk (newp)) ||
 	      ar_ptr == arena_for_chunk (mem2chunk (newp)));
 
+      if (newp != NULL)
+	{
+	  stats_count_freed (ar_ptr, oldsize, false);
+	  stats_count_malloc (newp, STATS_TCACHE_NONE);
+	}
       return newp;
     }
 
-  __libc_lock_lock (ar_ptr->mutex);
+  arena_mutex_lock (ar_ptr);
 
   newp = _int_realloc (ar_ptr, oldp, oldsize, nb);
 
@@ -3493,8 +4145,14 @@ __libc_realloc (void *oldmem, size_t bytes)
 	  memcpy (newp, oldmem, sz);
 	  (void) tag_region (chunk2mem (oldp), sz);
           _int_free (ar_ptr, oldp, 0);
+	  stats_count_freed (ar_ptr, oldsize, false);
         }
     }
+  else
+    {
+      stats_count_freed (ar_ptr, oldsize, false);
+      stats_count_malloc (newp, STATS_TCACHE_NONE);
+    }
 
   return newp;
 }
@@ -3542,11 +4200,67 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
       alignment = a;
     }
 
+  int stats_tcache = STATS_TCACHE_NONE;
+#if USE_TCACHE
+  size_t nb = checked_request2size (bytes);
+  if (nb == 0)
+    {
+      __set_errno (ENOMEM);
+      return NULL;
+    }
+
+  MAYBE_INIT_TCACHE ();
+
+  /* Use the aligned size class for alignments up to the page size, and
+     otherwise look for a chunk of the exact size which happens to be
+     aligned, such as one freed after an earlier aligned allocation.  */
+  size_t csize = nb;
+  size_t count = 1;
+  size_t tc_idx = mp_.tcache_bins;
+  if (tcache != NULL)
+    {
+      if (alignment <= GLRO (dl_pagesize))
+	csize = ALIGN_UP (nb, alignment);
+      tc_idx = csize2tidx (csize);
+      if (tc_idx >= mp_.tcache_bins && csize != nb)
+	{
+	  csize = nb;
+	  tc_idx = csize2tidx (nb);
+	}
+    }
+  if (tc_idx < mp_.tcache_bins)
+    {
+      p = tcache_get_aligned (tc_idx, alignment);
+      if (p != NULL)
+	{
+	  stats_count_malloc (p, STATS_TCACHE_HIT);
+	  return tag_new_usable (p);
+	}
+      stats_tcache = STATS_TCACHE_MISS;
+
+      /* Carve the chunks for the tcache from the same block.  Memory
+	 tagging colours the chunks of the tcache, so leave it alone.  */
+      if (csize != nb && !mtag_enabled
+	  && tcache->counts[tc_idx] < tcache->limits[tc_idx])
+	{
+	  count = tcache->limits[tc_idx] - tcache->counts[tc_idx] + 1;
+	  count = MIN (count, TCACHE_ALIGNED_BATCH);
+	  if (count > 1)
+	    bytes = count * csize - SIZE_SZ;
+	}
+    }
+#endif
+
   if (SINGLE_THREAD_P)
     {
       p = _int_memalign (&main_arena, alignment, bytes);
       assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
 	      &main_arena == arena_for_chunk (mem2chunk (p)));
+#if USE_TCACHE
+      if (p != NULL && count > 1)
+	p = tcache_carve_aligned (p, csize, count, tc_idx);
+#endif
+      stats_count_malloc (p, stats_tcache);
       return tag_new_usable (p);
     }
 
@@ -3565,6 +4279,11 @@ _mid_memalign (size_t alignment, size_t bytes, void *address)
 
   assert (!p || chunk_is_mmapped (mem2chunk (p)) ||
           ar_ptr == arena_for_chunk (mem2chunk (p)));
+#if USE_TCACHE
+  if (p != NULL && count > 1)
+    p = tcache_carve_aligned (p, csize, count, tc_idx);
+#endif
+  stats_count_malloc (p, stats_tcache);
   return tag_new_usable (p);
 }
 /* For ISO C11.  */
@@ -3629,6 +4348,31 @@ __libc_calloc (size_t n, size_t elem_size)
 
   MAYBE_INIT_TCACHE ();
 
+  if (__glibc_unlikely (profile_countdown <= sz))
+    {
+      /* Sampled blocks are freshly mmapped, so already cleared.  */
+      mem = profile_malloc (sz);
+      if (mem != NULL)
+	{
+	  stats_count_malloc (mem, STATS_TCACHE_NONE);
+	  if (__glibc_unlikely (mtag_enabled))
+	    return tag_new_zero_region (mem, memsize (mem2chunk (mem)));
+	  return mem;
+	}
+    }
+  else
+    profile_countdown -= sz;
+
+  if (sz - 1 < mp_.slab_max)
+    {
+      mem = slab_malloc (sz);
+      if (mem != NULL)
+	{
+	  stats_count_slab (slab_object_size (mem), true);
+	  return memset (mem, 0, sz);
+	}
+    }
+
   if (SINGLE_THREAD_P)
     av = &main_arena;
   else
@@ -3683,6 +4427,8 @@ __libc_calloc (size_t n, size_t elem_size)
   if (mem == 0)
     return 0;
 
+  stats_count_malloc (mem, STATS_TCACHE_NONE);
+
   mchunkptr p = mem2chunk (mem);
 
   /* If we are using memory tagging, then we need to set the tags
@@ -3776,6 +4522,9 @@ _int_malloc (mstate av, size_t bytes)
   size_t tcache_unsorted_count;	    /* count of unsorted chunks processed */
 #endif
 
+  bool consolidated = false;        /* fastbins consolidated once */
+  bool bin_consolidated = false;    /* one fastbin consolidated fully */
+
   /*
      Convert request size to internal form by adding SIZE_SZ bytes
      overhead plus possibly more to obtain necessary alignment and/or
@@ -3802,6 +4551,15 @@ _int_malloc (mstate av, size_t bytes)
       return p;
     }
 
+  /* Merge the chunks other threads freed into this arena while we did
+     not hold the lock, so they can be used for this request.  */
+  if (atomic_load_relaxed (&av->remote_free) != NULL)
+    remote_free_drain (av);
+
+  if (__glibc_unlikely (mp_.decay_time != 0)
+      && ++av->decay_ticks >= DECAY_TICKS)
+    arena_decay (av);
+
   /*
      If the size qualifies as a fastbin, first check corresponding bin.
      This code is safe to execute even if av is not yet initialized, so we
@@ -3852,7 +4610,7 @@ _int_malloc (mstate av, size_t bytes)
 		  mchunkptr tc_victim;
 
 		  /* While bin not empty and tcache not full, copy chunks.  */
-		  while (tcache->counts[tc_idx] < mp_.tcache_count
+		  while (tcache->counts[tc_idx] < tcache->limits[tc_idx]
 			 && (tc_victim = *fb) != NULL)
 		    {
 		      if (__glibc_unlikely (misaligned_chunk (tc_victim)))
@@ -3910,7 +4668,7 @@ _int_malloc (mstate av, size_t bytes)
 	      mchunkptr tc_victim;
 
 	      /* While bin not empty and tcache not full, copy chunks over.  */
-	      while (tcache->counts[tc_idx] < mp_.tcache_count
+	      while (tcache->counts[tc_idx] < tcache->limits[tc_idx]
 		     && (tc_victim = last (bin)) != bin)
 		{
 		  if (tc_victim != 0)
@@ -3948,7 +4706,10 @@ _int_malloc (mstate av, size_t bytes)
     {
       idx = largebin_index (nb);
       if (atomic_load_relaxed (&av->have_fastchunks))
-        malloc_consolidate (av);
+        {
+          malloc_consolidate_some (av);
+          consolidated = true;
+        }
     }
 
   /*
@@ -4026,6 +4787,7 @@ _int_malloc (mstate av, size_t bytes)
                         (av != &main_arena ? NON_MAIN_ARENA : 0));
               set_head (remainder, remainder_size | PREV_INUSE);
               set_foot (remainder, remainder_size);
+              decay_stamp_chunk (remainder, remainder_size);
 
               check_malloced_chunk (av, victim, nb);
               void *p = chunk2mem (victim);
@@ -4048,7 +4810,7 @@ _int_malloc (mstate av, size_t bytes)
 	      /* Fill cache first, return to user only if cache fills.
 		 We may return one of these chunks later.  */
 	      if (tcache_nb
-		  && tcache->counts[tc_idx] < mp_.tcache_count)
+		  && tcache->counts[tc_idx] < tcache->limits[tc_idx])
 		{
 		  tcache_put (victim, tc_idx);
 		  return_cached = 1;
@@ -4218,6 +4980,7 @@ _int_malloc (mstate av, size_t bytes)
                             (av != &main_arena ? NON_MAIN_ARENA : 0));
                   set_head (remainder, remainder_size | PREV_INUSE);
                   set_foot (remainder, remainder_size);
+                  decay_stamp_chunk (remainder, remainder_size);
                 }
               check_malloced_chunk (av, victim, nb);
               void *p = chunk2mem (victim);
@@ -4326,6 +5089,7 @@ _int_malloc (mstate av, size_t bytes)
                             (av != &main_arena ? NON_MAIN_ARENA : 0));
                   set_head (remainder, remainder_size | PREV_INUSE);
                   set_foot (remainder, remainder_size);
+                  decay_stamp_chunk (remainder, remainder_size);
                 }
               check_malloced_chunk (av, victim, nb);
               void *p = chunk2mem (victim);
@@ -4360,6 +5124,25 @@ _int_malloc (mstate av, size_t bytes)
         {
           remainder_size = size - nb;
           remainder = chunk_at_offset (victim, nb);
+#if USE_TCACHE
+	  /* Carve further chunks of this size off the top chunk and
+	     stash them in the tcache, so that the next allocations of
+	     this size do not need the arena lock.  */
+	  if (tcache_nb && mp_.tcache_batch > 1)
+	    {
+	      size_t n = mp_.tcache_batch - 1;
+	      while (n-- > 0
+		     && tcache->counts[tc_idx] < tcache->limits[tc_idx]
+		     && remainder_size >= nb + MINSIZE)
+		{
+		  set_head (remainder, nb | PREV_INUSE |
+			    (av != &main_arena ? NON_MAIN_ARENA : 0));
+		  tcache_put (remainder, tc_idx);
+		  remainder = chunk_at_offset (remainder, nb);
+		  remainder_size -= nb;
+		}
+	    }
+#endif
           av->top = remainder;
           set_head (victim, nb | PREV_INUSE |
                     (av != &main_arena ? NON_MAIN_ARENA : 0));
@@ -4372,14 +5155,30 @@ _int_malloc (mstate av, size_t bytes)
         }
 
       /* When we are using atomic ops to free fast chunks we can get
-         here for all block sizes.  */
-      else if (atomic_load_relaxed (&av->have_fastchunks))
+         here for all block sizes.  With a consolidation budget, the
+         fastbins are only consolidated in one bounded step per
+         request.  If that was not enough, the rest of the fastbin in
+         which the step stopped is consolidated before the heap is
+         grown, and the request is then served by sysmalloc, so that
+         its cost stays bounded.  */
+      else if (atomic_load_relaxed (&av->have_fastchunks)
+	       && (mp_.consolidate_budget == 0 || !consolidated
+		   || !bin_consolidated))
         {
-          malloc_consolidate (av);
-          /* restore original bin index */
-          if (in_smallbin_range (nb))
-            idx = smallbin_index (nb);
-          else
+          if (mp_.consolidate_budget == 0 || !consolidated)
+            {
+              malloc_consolidate_some (av);
+              consolidated = true;
+            }
+          else
+            {
+              malloc_consolidate_bin (av);
+              bin_consolidated = true;
+            }
+          /* restore original bin index */
+          if (in_smallbin_range (nb))
+            idx = smallbin_index (nb);
+          else
             idx = largebin_index (nb);
         }
 
@@ -4404,13 +5203,6 @@ static void
 _int_free (mstate av, mchunkptr p, int have_lock)
 {
   INTERNAL_SIZE_T size;        /* its size */
-  mfastbinptr *fb;             /* associated fastbin */
-  mchunkptr nextchunk;         /* next contiguous chunk */
-  INTERNAL_SIZE_T nextsize;    /* its size */
-  int nextinuse;               /* true if nextchunk is used */
-  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
-  mchunkptr bck;               /* misc temp for linking */
-  mchunkptr fwd;               /* misc temp for linking */
 
   size = chunksize (p);
 
@@ -4449,7 +5241,7 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 		 tmp;
 		 tmp = REVEAL_PTR (tmp->next), ++cnt)
 	      {
-		if (cnt >= mp_.tcache_count)
+		if (cnt >= tcache->limits[tc_idx])
 		  malloc_printerr ("free(): too many chunks detected in tcache");
 		if (__glibc_unlikely (!aligned_OK (tmp)))
 		  malloc_printerr ("free(): unaligned chunk detected in tcache 2");
@@ -4460,8 +5252,36 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	      }
 	  }
 
-	if (tcache->counts[tc_idx] < mp_.tcache_count)
+	if (tcache->counts[tc_idx] < tcache->limits[tc_idx])
+	  {
+	    tcache_put (p, tc_idx);
+	    return;
+	  }
+
+	if (mp_.tcache_budget != 0)
+	  {
+	    if (tcache->overflows[tc_idx] < UINT16_MAX)
+	      ++tcache->overflows[tc_idx];
+	    /* Adjusting the limits may need arena locks.  If the caller
+	       holds one, this is done by the next miss or overflow.  */
+	    if (++tcache->events >= TCACHE_ADAPT_EVENTS && !have_lock)
+	      {
+		tcache_adapt ();
+		if (tcache->counts[tc_idx] < tcache->limits[tc_idx])
+		  {
+		    tcache_put (p, tc_idx);
+		    return;
+		  }
+	      }
+	  }
+
+	/* The bin is full.  Return the older half of it to the arenas,
+	   which makes room for this chunk and for the next frees of this
+	   size.  This needs arena locks, so it cannot be done if the
+	   caller already holds one.  */
+	if (mp_.tcache_batch > 0 && !have_lock && tcache->limits[tc_idx] > 1)
 	  {
+	    tcache_flush (tc_idx);
 	    tcache_put (p, tc_idx);
 	    return;
 	  }
@@ -4469,6 +5289,16 @@ _int_free (mstate av, mchunkptr p, int have_lock)
   }
 #endif
 
+  _int_free_chunk (av, p, size, have_lock);
+}
+
+/* Free the chunk P of SIZE bytes to the arena AV, bypassing the
+   tcache.  */
+static void
+_int_free_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size, int have_lock)
+{
+  mfastbinptr *fb;             /* associated fastbin */
+
   /*
     If eligible, place chunk on a fastbin so it can be found
     and used quickly in malloc.
@@ -4496,7 +5326,7 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	   getting the lock.  */
 	if (!have_lock)
 	  {
-	    __libc_lock_lock (av->mutex);
+	    arena_mutex_lock (av);
 	    fail = (chunksize_nomask (chunk_at_offset (p, size)) <= CHUNK_HDR_SZ
 		    || chunksize (chunk_at_offset (p, size)) >= av->system_mem);
 	    __libc_lock_unlock (av->mutex);
@@ -4557,132 +5387,213 @@ _int_free (mstate av, mchunkptr p, int have_lock)
       have_lock = true;
 
     if (!have_lock)
-      __libc_lock_lock (av->mutex);
-
-    nextchunk = chunk_at_offset(p, size);
-
-    /* Lightweight tests: check whether the block is already the
-       top block.  */
-    if (__glibc_unlikely (p == av->top))
-      malloc_printerr ("double free or corruption (top)");
-    /* Or whether the next chunk is beyond the boundaries of the arena.  */
-    if (__builtin_expect (contiguous (av)
-			  && (char *) nextchunk
-			  >= ((char *) av->top + chunksize(av->top)), 0))
-	malloc_printerr ("double free or corruption (out)");
-    /* Or whether the block is actually not marked used.  */
-    if (__glibc_unlikely (!prev_inuse(nextchunk)))
-      malloc_printerr ("double free or corruption (!prev)");
-
-    nextsize = chunksize(nextchunk);
-    if (__builtin_expect (chunksize_nomask (nextchunk) <= CHUNK_HDR_SZ, 0)
-	|| __builtin_expect (nextsize >= av->system_mem, 0))
-      malloc_printerr ("free(): invalid next size (normal)");
-
-    free_perturb (chunk2mem(p), size - CHUNK_HDR_SZ);
-
-    /* consolidate backward */
-    if (!prev_inuse(p)) {
-      prevsize = prev_size (p);
-      size += prevsize;
-      p = chunk_at_offset(p, -((long) prevsize));
-      if (__glibc_unlikely (chunksize(p) != prevsize))
-        malloc_printerr ("corrupted size vs. prev_size while consolidating");
-      unlink_chunk (av, p);
-    }
-
-    if (nextchunk != av->top) {
-      /* get and clear inuse bit */
-      nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
+      {
+	/* Do not wait for the lock of an arena owned by other threads.
+	   Instead, leave the chunk on its remote free list, to be merged
+	   by the next thread which acquires the lock.  */
+	if (mp_.remote_free && av != thread_arena)
+	  {
+	    if (__libc_lock_trylock (av->mutex) != 0)
+	      {
+		remote_free_push (av, p);
+		return;
+	      }
+	  }
+	else
+	  arena_mutex_lock (av);
+      }
 
-      /* consolidate forward */
-      if (!nextinuse) {
-	unlink_chunk (av, nextchunk);
-	size += nextsize;
-      } else
-	clear_inuse_bit_at_offset(nextchunk, 0);
+    size = _int_free_merge_chunk (av, p, size);
+    _int_free_maybe_trim (av, size);
 
-      /*
-	Place the chunk in unsorted chunk list. Chunks are
-	not placed into regular bins until after they have
-	been given one chance to be used in malloc.
-      */
+    if (!have_lock)
+      __libc_lock_unlock (av->mutex);
+  }
+  /*
+    If the chunk was allocated via mmap, release via munmap().
+  */
 
-      bck = unsorted_chunks(av);
-      fwd = bck->fd;
-      if (__glibc_unlikely (fwd->bk != bck))
-	malloc_printerr ("free(): corrupted unsorted chunks");
-      p->fd = fwd;
-      p->bk = bck;
-      if (!in_smallbin_range(size))
-	{
-	  p->fd_nextsize = NULL;
-	  p->bk_nextsize = NULL;
-	}
-      bck->fd = p;
-      fwd->bk = p;
+  else {
+    munmap_chunk (p);
+  }
+}
 
-      set_head(p, size | PREV_INUSE);
-      set_foot(p, size);
+/* Merge the chunk P of size SIZE, which was freed into the arena AV,
+   with its free neighbours and put the result in the unsorted bin, or
+   into the top chunk.  The arena lock must be held.  Returns the size
+   of the resulting free chunk.  */
+static INTERNAL_SIZE_T
+_int_free_merge_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size)
+{
+  mchunkptr nextchunk;         /* next contiguous chunk */
+  INTERNAL_SIZE_T nextsize;    /* its size */
+  int nextinuse;               /* true if nextchunk is used */
+  INTERNAL_SIZE_T prevsize;    /* size of previous contiguous chunk */
+  mchunkptr bck;               /* misc temp for linking */
+  mchunkptr fwd;               /* misc temp for linking */
 
-      check_free_chunk(av, p);
-    }
+  nextchunk = chunk_at_offset(p, size);
+
+  /* Lightweight tests: check whether the block is already the
+     top block.  */
+  if (__glibc_unlikely (p == av->top))
+    malloc_printerr ("double free or corruption (top)");
+  /* Or whether the next chunk is beyond the boundaries of the arena.  */
+  if (__builtin_expect (contiguous (av)
+			&& (char *) nextchunk
+			>= ((char *) av->top + chunksize(av->top)), 0))
+      malloc_printerr ("double free or corruption (out)");
+  /* Or whether the block is actually not marked used.  */
+  if (__glibc_unlikely (!prev_inuse(nextchunk)))
+    malloc_printerr ("double free or corruption (!prev)");
+
+  nextsize = chunksize(nextchunk);
+  if (__builtin_expect (chunksize_nomask (nextchunk) <= CHUNK_HDR_SZ, 0)
+      || __builtin_expect (nextsize >= av->system_mem, 0))
+    malloc_printerr ("free(): invalid next size (normal)");
+
+  free_perturb (chunk2mem(p), size - CHUNK_HDR_SZ);
+
+  /* consolidate backward */
+  if (!prev_inuse(p)) {
+    prevsize = prev_size (p);
+    size += prevsize;
+    p = chunk_at_offset(p, -((long) prevsize));
+    if (__glibc_unlikely (chunksize(p) != prevsize))
+      malloc_printerr ("corrupted size vs. prev_size while consolidating");
+    unlink_chunk (av, p);
+  }
 
-    /*
-      If the chunk borders the current high end of memory,
-      consolidate into top
-    */
+  if (nextchunk != av->top) {
+    /* get and clear inuse bit */
+    nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
 
-    else {
+    /* consolidate forward */
+    if (!nextinuse) {
+      unlink_chunk (av, nextchunk);
       size += nextsize;
-      set_head(p, size | PREV_INUSE);
-      av->top = p;
-      check_chunk(av, p);
-    }
+    } else
+      clear_inuse_bit_at_offset(nextchunk, 0);
 
     /*
-      If freeing a large space, consolidate possibly-surrounding
-      chunks. Then, if the total unused topmost memory exceeds trim
-      threshold, ask malloc_trim to reduce top.
-
-      Unless max_fast is 0, we don't know if there are fastbins
-      bordering top, so we cannot tell for sure whether threshold
-      has been reached unless fastbins are consolidated.  But we
-      don't want to consolidate on each free.  As a compromise,
-      consolidation is performed if FASTBIN_CONSOLIDATION_THRESHOLD
-      is reached.
+      Place the chunk in unsorted chunk list. Chunks are
+      not placed into regular bins until after they have
+      been given one chance to be used in malloc.
     */
 
-    if ((unsigned long)(size) >= FASTBIN_CONSOLIDATION_THRESHOLD) {
-      if (atomic_load_relaxed (&av->have_fastchunks))
-	malloc_consolidate(av);
-
-      if (av == &main_arena) {
-#ifndef MORECORE_CANNOT_TRIM
-	if ((unsigned long)(chunksize(av->top)) >=
-	    (unsigned long)(mp_.trim_threshold))
-	  systrim(mp_.top_pad, av);
-#endif
-      } else {
-	/* Always try heap_trim(), even if the top chunk is not
-	   large, because the corresponding heap might go away.  */
-	heap_info *heap = heap_for_ptr(top(av));
-
-	assert(heap->ar_ptr == av);
-	heap_trim(heap, mp_.top_pad);
+    bck = unsorted_chunks(av);
+    fwd = bck->fd;
+    if (__glibc_unlikely (fwd->bk != bck))
+      malloc_printerr ("free(): corrupted unsorted chunks");
+    p->fd = fwd;
+    p->bk = bck;
+    if (!in_smallbin_range(size))
+      {
+	p->fd_nextsize = NULL;
+	p->bk_nextsize = NULL;
       }
-    }
+    bck->fd = p;
+    fwd->bk = p;
 
-    if (!have_lock)
-      __libc_lock_unlock (av->mutex);
+    set_head(p, size | PREV_INUSE);
+    set_foot(p, size);
+    decay_stamp_chunk (p, size);
+
+    check_free_chunk(av, p);
   }
+
   /*
-    If the chunk was allocated via mmap, release via munmap().
+    If the chunk borders the current high end of memory,
+    consolidate into top
   */
 
   else {
-    munmap_chunk (p);
+    size += nextsize;
+    set_head(p, size | PREV_INUSE);
+    av->top = p;
+    check_chunk(av, p);
   }
+
+  return size;
+}
+
+/* Called after a free chunk of SIZE bytes has been merged into the
+   arena AV.  The arena lock must be held.  */
+static void
+_int_free_maybe_trim (mstate av, INTERNAL_SIZE_T size)
+{
+  /*
+    If freeing a large space, consolidate possibly-surrounding
+    chunks. Then, if the total unused topmost memory exceeds trim
+    threshold, ask malloc_trim to reduce top.
+
+    Unless max_fast is 0, we don't know if there are fastbins
+    bordering top, so we cannot tell for sure whether threshold
+    has been reached unless fastbins are consolidated.  But we
+    don't want to consolidate on each free.  As a compromise,
+    consolidation is performed if FASTBIN_CONSOLIDATION_THRESHOLD
+    is reached.
+  */
+
+  if ((unsigned long)(size) >= FASTBIN_CONSOLIDATION_THRESHOLD) {
+    if (atomic_load_relaxed (&av->have_fastchunks))
+      malloc_consolidate_some (av);
+
+    if (av == &main_arena) {
+#ifndef MORECORE_CANNOT_TRIM
+      if ((unsigned long)(chunksize(av->top)) >=
+	  (unsigned long)(mp_.trim_threshold))
+	systrim(mp_.top_pad, av);
+#endif
+    } else {
+      /* Always try heap_trim(), even if the top chunk is not
+	 large, because the corresponding heap might go away.  */
+      heap_info *heap = heap_for_ptr(top(av));
+
+      assert(heap->ar_ptr == av);
+      heap_trim(heap, mp_.top_pad);
+    }
+  }
+}
+
+/* Defer the free of the chunk P to the thread which next acquires the
+   lock of the arena AV.  The chunk stays marked as in use until then,
+   so no other data of the arena is accessed here.  */
+static void
+remote_free_push (mstate av, mchunkptr p)
+{
+  mchunkptr old = atomic_load_relaxed (&av->remote_free), old2;
+
+  do
+    {
+      /* Check that the top of the list is not the chunk we are going
+	 to add (i.e., double free).  */
+      if (__glibc_unlikely (old == p))
+	malloc_printerr ("double free or corruption (remote)");
+      old2 = old;
+      p->fd = PROTECT_PTR (&p->fd, old);
+    }
+  while ((old = catomic_compare_and_exchange_val_rel (&av->remote_free,
+						      p, old2)) != old2);
+}
+
+/* Merge all chunks on the remote free list of the arena AV.  The arena
+   lock must be held.  The chunks are only merged into the bins, the top
+   chunk is trimmed by the next local free of a large chunk or by
+   malloc_trim.  */
+static void
+remote_free_drain (mstate av)
+{
+  mchunkptr p = atomic_exchange_acquire (&av->remote_free, NULL);
+
+  while (p != NULL)
+    {
+      if (__glibc_unlikely (misaligned_chunk (p)))
+	malloc_printerr ("remote_free_drain(): unaligned chunk detected");
+      mchunkptr next = REVEAL_PTR (p->fd);
+      _int_free_merge_chunk (av, p, chunksize (p));
+      p = next;
+    }
 }
 
 /*
@@ -4695,11 +5606,12 @@ _int_free (mstate av, mchunkptr p, int have_lock)
   code.
 */
 
-static void malloc_consolidate(mstate av)
+/* Merge the chunk P, taken from the fastbin FB of AV, with its free
+   neighbors and put the result in the unsorted bin, or into top.
+   Return the next chunk of the fastbin list of P.  */
+static __always_inline mchunkptr
+malloc_consolidate_chunk (mstate av, mchunkptr p, mfastbinptr *fb)
 {
-  mfastbinptr*    fb;                 /* current fastbin being consolidated */
-  mfastbinptr*    maxfb;              /* last fastbin (for loop control) */
-  mchunkptr       p;                  /* current chunk being consolidated */
   mchunkptr       nextp;              /* next chunk to consolidate */
   mchunkptr       unsorted_bin;       /* bin header */
   mchunkptr       first_unsorted;     /* chunk to link to */
@@ -4711,9 +5623,78 @@ static void malloc_consolidate(mstate av)
   INTERNAL_SIZE_T prevsize;
   int             nextinuse;
 
-  atomic_store_relaxed (&av->have_fastchunks, false);
+  {
+    if (__glibc_unlikely (misaligned_chunk (p)))
+      malloc_printerr ("malloc_consolidate(): "
+		       "unaligned fastbin chunk detected");
+
+    unsigned int idx = fastbin_index (chunksize (p));
+    if ((&fastbin (av, idx)) != fb)
+      malloc_printerr ("malloc_consolidate(): invalid chunk size");
+  }
+
+  check_inuse_chunk(av, p);
+  nextp = REVEAL_PTR (p->fd);
 
-  unsorted_bin = unsorted_chunks(av);
+  /* Slightly streamlined version of consolidation code in free() */
+  size = chunksize (p);
+  nextchunk = chunk_at_offset(p, size);
+  nextsize = chunksize(nextchunk);
+
+  if (!prev_inuse(p)) {
+    prevsize = prev_size (p);
+    size += prevsize;
+    p = chunk_at_offset(p, -((long) prevsize));
+    if (__glibc_unlikely (chunksize(p) != prevsize))
+      malloc_printerr ("corrupted size vs. prev_size in fastbins");
+    unlink_chunk (av, p);
+  }
+
+  if (nextchunk != av->top) {
+    nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
+
+    if (!nextinuse) {
+      size += nextsize;
+      unlink_chunk (av, nextchunk);
+    } else
+      clear_inuse_bit_at_offset(nextchunk, 0);
+
+    unsorted_bin = unsorted_chunks(av);
+    first_unsorted = unsorted_bin->fd;
+    unsorted_bin->fd = p;
+    first_unsorted->bk = p;
+
+    if (!in_smallbin_range (size)) {
+      p->fd_nextsize = NULL;
+      p->bk_nextsize = NULL;
+    }
+
+    set_head(p, size | PREV_INUSE);
+    p->bk = unsorted_bin;
+    p->fd = first_unsorted;
+    set_foot(p, size);
+    decay_stamp_chunk (p, size);
+  }
+
+  else {
+    size += nextsize;
+    set_head(p, size | PREV_INUSE);
+    av->top = p;
+  }
+
+  return nextp;
+}
+
+static void malloc_consolidate(mstate av)
+{
+  mfastbinptr*    fb;                 /* current fastbin being consolidated */
+  mfastbinptr*    maxfb;              /* last fastbin (for loop control) */
+  mchunkptr       p;                  /* current chunk being consolidated */
+
+  if (atomic_load_relaxed (&av->remote_free) != NULL)
+    remote_free_drain (av);
+
+  atomic_store_relaxed (&av->have_fastchunks, false);
 
   /*
     Remove each chunk from fast bin and consolidate it, placing it
@@ -4727,69 +5708,89 @@ static void malloc_consolidate(mstate av)
   fb = &fastbin (av, 0);
   do {
     p = atomic_exchange_acquire (fb, NULL);
-    if (p != 0) {
-      do {
-	{
-	  if (__glibc_unlikely (misaligned_chunk (p)))
-	    malloc_printerr ("malloc_consolidate(): "
-			     "unaligned fastbin chunk detected");
-
-	  unsigned int idx = fastbin_index (chunksize (p));
-	  if ((&fastbin (av, idx)) != fb)
-	    malloc_printerr ("malloc_consolidate(): invalid chunk size");
-	}
-
-	check_inuse_chunk(av, p);
-	nextp = REVEAL_PTR (p->fd);
-
-	/* Slightly streamlined version of consolidation code in free() */
-	size = chunksize (p);
-	nextchunk = chunk_at_offset(p, size);
-	nextsize = chunksize(nextchunk);
-
-	if (!prev_inuse(p)) {
-	  prevsize = prev_size (p);
-	  size += prevsize;
-	  p = chunk_at_offset(p, -((long) prevsize));
-	  if (__glibc_unlikely (chunksize(p) != prevsize))
-	    malloc_printerr ("corrupted size vs. prev_size in fastbins");
-	  unlink_chunk (av, p);
-	}
+    while (p != 0)
+      p = malloc_consolidate_chunk (av, p, fb);
+  } while (fb++ != maxfb);
+}
 
-	if (nextchunk != av->top) {
-	  nextinuse = inuse_bit_at_offset(nextchunk, nextsize);
+/* Incremental version of malloc_consolidate, used if
+   glibc.malloc.consolidate_budget is set.  Consolidate at most that
+   many fastbin chunks of AV, starting with the fastbin where the
+   previous call stopped, and leave the others for later calls.  Chunks
+   are popped one at a time, like in _int_malloc, so that the chunks
+   which are not processed stay in their fastbins.  */
+static void
+malloc_consolidate_step (mstate av)
+{
+  size_t budget = mp_.consolidate_budget;
+  unsigned int idx = av->consolidate_next;
+  unsigned int empty = 0;
 
-	  if (!nextinuse) {
-	    size += nextsize;
-	    unlink_chunk (av, nextchunk);
-	  } else
-	    clear_inuse_bit_at_offset(nextchunk, 0);
+  if (atomic_load_relaxed (&av->remote_free) != NULL)
+    remote_free_drain (av);
 
-	  first_unsorted = unsorted_bin->fd;
-	  unsorted_bin->fd = p;
-	  first_unsorted->bk = p;
+  atomic_store_relaxed (&av->have_fastchunks, false);
 
-	  if (!in_smallbin_range (size)) {
-	    p->fd_nextsize = NULL;
-	    p->bk_nextsize = NULL;
-	  }
+  /* Stop when the budget is exhausted or all fastbins were found
+     empty in a row.  */
+  while (budget > 0 && empty < NFASTBINS)
+    {
+      mfastbinptr *fb = &fastbin (av, idx);
+      mchunkptr p = atomic_load_acquire (fb);
+      mchunkptr next;
 
-	  set_head(p, size | PREV_INUSE);
-	  p->bk = unsorted_bin;
-	  p->fd = first_unsorted;
-	  set_foot(p, size);
+      if (p == NULL)
+	{
+	  ++empty;
+	  idx = (idx + 1) % NFASTBINS;
+	  continue;
 	}
 
-	else {
-	  size += nextsize;
-	  set_head(p, size | PREV_INUSE);
-	  av->top = p;
+      do
+	{
+	  if (__glibc_unlikely (misaligned_chunk (p)))
+	    malloc_printerr ("malloc_consolidate(): "
+			     "unaligned fastbin chunk detected");
+	  next = REVEAL_PTR (p->fd);
 	}
+      while ((next = catomic_compare_and_exchange_val_acq (fb, next, p))
+	     != p && (p = next) != NULL);
+      if (p == NULL)
+	continue;
+
+      malloc_consolidate_chunk (av, p, fb);
+      empty = 0;
+      --budget;
+    }
 
-      } while ( (p = nextp) != 0);
+  av->consolidate_next = idx;
+  if (empty < NFASTBINS)
+    atomic_store_relaxed (&av->have_fastchunks, true);
+}
+
+/* Consolidate all chunks of the fastbin of AV where the last call of
+   malloc_consolidate_step stopped, or of the next fastbin which is not
+   empty.  Used if glibc.malloc.consolidate_budget is set and a request
+   would otherwise grow the heap.  */
+static void
+malloc_consolidate_bin (mstate av)
+{
+  unsigned int idx = av->consolidate_next;
 
+  for (unsigned int n = 0; n < NFASTBINS; ++n)
+    {
+      mfastbinptr *fb = &fastbin (av, idx);
+      mchunkptr p = atomic_exchange_acquire (fb, NULL);
+      idx = (idx + 1) % NFASTBINS;
+      if (p != NULL)
+	{
+	  while (p != NULL)
+	    p = malloc_consolidate_chunk (av, p, fb);
+	  break;
+	}
     }
-  } while (fb++ != maxfb);
+
+  av->consolidate_next = idx;
 }
 
 /*
@@ -5077,6 +6078,51 @@ mtrim (mstate av, size_t pad)
 #endif
 }
 
+/* Return the pages of the free chunks in AV which have been idle for
+   longer than glibc.malloc.decay_time to the system.  The chunks stay in
+   their bins.  The arena lock must be held.  */
+static void
+arena_decay (mstate av)
+{
+  av->decay_ticks = 0;
+
+  /* Scan the bins at most four times per decay period.  */
+  size_t now = decay_now ();
+  if (now - av->decay_last < mp_.decay_time / 4)
+    return;
+  av->decay_last = now;
+
+  const size_t ps = GLRO (dl_pagesize);
+  int psindex = bin_index (ps);
+
+  for (int i = 1; i < NBINS; ++i)
+    if (i == 1 || i >= psindex)
+      {
+        mbinptr bin = bin_at (av, i);
+
+        for (mchunkptr p = last (bin); p != bin; p = p->bk)
+          {
+            INTERNAL_SIZE_T size = chunksize (p);
+            if (size < ps + sizeof (struct malloc_chunk) + sizeof (size_t))
+              continue;
+
+            /* Keep the stamp, the next chunk's prev_size field and the
+               page containing the chunk header.  */
+            uintptr_t start = ALIGN_UP ((uintptr_t) &decay_stamp (p)
+                                        + sizeof (size_t), ps);
+            uintptr_t end = ALIGN_DOWN ((uintptr_t) p + size, ps);
+            if (end <= start)
+              continue;
+
+            size_t stamp = decay_stamp (p);
+            if (stamp == DECAY_PURGED || now - stamp < mp_.decay_time)
+              continue;
+
+            __madvise ((void *) start, end - start, MADV_DONTNEED);
+            decay_stamp (p) = DECAY_PURGED;
+          }
+      }
+}
 
 int
 __malloc_trim (size_t s)
@@ -5124,6 +6170,8 @@ __malloc_usable_size (void *m)
 {
   if (m == NULL)
     return 0;
+  if (slab_contains (m))
+    return slab_usable (m);
   return musable (m);
 }
 #endif
@@ -5143,6 +6191,9 @@ int_mallinfo (mstate av, struct mallinfo2 *m)
   int nblocks;
   int nfastblocks;
 
+  if (atomic_load_relaxed (&av->remote_free) != NULL)
+    remote_free_drain (av);
+
   check_malloc_state (av);
 
   /* Account for top */
@@ -5363,6 +6414,73 @@ do_set_arena_max (size_t value)
   return 1;
 }
 
+static __always_inline int
+do_set_arena_percpu (int32_t value)
+{
+  mp_.arena_percpu = value != 0;
+  return 1;
+}
+
+static __always_inline int
+do_set_consolidate_budget (size_t value)
+{
+  mp_.consolidate_budget = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_arena_numa (int32_t value)
+{
+  mp_.arena_numa = value != 0;
+  return 1;
+}
+
+static __always_inline int
+do_set_remote_free (int32_t value)
+{
+  mp_.remote_free = value != 0;
+  return 1;
+}
+
+static __always_inline int
+do_set_decay_time (size_t value)
+{
+  mp_.decay_time = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_stats (int32_t value)
+{
+  mp_.stats = value != 0;
+  return 1;
+}
+
+static __always_inline int
+do_set_slab_max (size_t value)
+{
+  if (value <= SLAB_MAX_SIZE)
+    {
+      mp_.slab_max = value;
+      return 1;
+    }
+  return 0;
+}
+
+static __always_inline int
+do_set_profile_rate (size_t value)
+{
+  mp_.profile_rate = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_profile_signal (int32_t value)
+{
+  mp_.profile_signal = value;
+  return 1;
+}
+
 #if USE_TCACHE
 static __always_inline int
 do_set_tcache_max (size_t value)
@@ -5396,6 +6514,24 @@ do_set_tcache_unsorted_limit (size_t value)
   mp_.tcache_unsorted_limit = value;
   return 1;
 }
+
+static __always_inline int
+do_set_tcache_budget (size_t value)
+{
+  mp_.tcache_budget = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_tcache_batch (size_t value)
+{
+  if (value <= MAX_TCACHE_COUNT)
+    {
+      mp_.tcache_batch = value;
+      return 1;
+    }
+  return 0;
+}
 #endif
 
 static __always_inline int
@@ -5871,6 +7007,35 @@ __malloc_info (int options, FILE *fp)
     }
   while (ar_ptr != &main_arena);
 
+#if USE_TCACHE
+  /* Report the per-thread cache of the calling thread.  Only bins which
+     hold chunks or whose limit differs from the default are listed.  */
+  if (tcache != NULL)
+    {
+      size_t tcache_nblocks = 0;
+      size_t tcache_avail = 0;
+
+      fprintf (fp,
+	       "<tcache limit=\"%zu\" capacity=\"%zu\" budget=\"%zu\">\n",
+	       mp_.tcache_count, tcache->capacity, mp_.tcache_budget);
+      for (size_t i = 0; i < mp_.tcache_bins; ++i)
+	{
+	  if (tcache->counts[i] == 0 && tcache->limits[i] == mp_.tcache_count)
+	    continue;
+	  fprintf (fp,
+		   "  <bin size=\"%zu\" count=\"%u\" limit=\"%u\"/>\n",
+		   tidx2usize (i), (unsigned int) tcache->counts[i],
+		   (unsigned int) tcache->limits[i]);
+	  tcache_nblocks += tcache->counts[i];
+	  tcache_avail += tcache->counts[i] * tidx2usize (i);
+	}
+      fprintf (fp,
+	       "<total type=\"tcache\" count=\"%zu\" size=\"%zu\"/>\n"
+	       "</tcache>\n",
+	       tcache_nblocks, tcache_avail);
+    }
+#endif
+
   fprintf (fp,
 	   "<total type=\"fast\" count=\"%zu\" size=\"%zu\"/>\n"
 	   "<total type=\"rest\" count=\"%zu\" size=\"%zu\"/>\n"
@@ -5887,11 +7052,162 @@ __malloc_info (int options, FILE *fp)
 
   return 0;
 }
+
 #if IS_IN (libc)
+/* Add the counters of arena AV to *STATS.  No lock is taken, so the
+   values of the counters may be slightly out of date.  */
+static void
+stats_read_arena (mstate av, struct malloc_statistics *stats)
+{
+  struct arena_stats *as = &av->stats;
+
+  stats->narenas++;
+  stats->arena_bytes += atomic_load_relaxed (&av->system_mem);
+  stats->in_use_bytes += atomic_load_relaxed (&as->in_use);
+  stats->tcache_hits += atomic_load_relaxed (&as->tcache_hits);
+  stats->tcache_misses += atomic_load_relaxed (&as->tcache_misses);
+  stats->lock_waits += atomic_load_relaxed (&as->lock_waits);
+  stats->lock_wait_ns += atomic_load_relaxed (&as->lock_wait_ns);
+  for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+    {
+      stats->classes[i].size = stats_class_size (i);
+      stats->classes[i].nmalloc += atomic_load_relaxed (&as->nmalloc[i]);
+      stats->classes[i].nfree += atomic_load_relaxed (&as->nfree[i]);
+    }
+}
+
+int
+__malloc_statistics (struct malloc_statistics *stats, size_t size)
+{
+  struct malloc_statistics current;
+
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  memset (&current, 0, sizeof (current));
+
+  /* Arenas are never freed, and their next pointers are published
+     before they are linked, so the list can be walked without
+     list_lock.  */
+  mstate ar_ptr = &main_arena;
+  do
+    {
+      stats_read_arena (ar_ptr, &current);
+      ar_ptr = atomic_load_acquire (&ar_ptr->next);
+    }
+  while (ar_ptr != &main_arena);
+
+  current.mmapped_bytes = atomic_load_relaxed (&mp_.mmapped_mem);
+  current.mmap_count = atomic_load_relaxed (&mp_.mmap_count);
+  current.munmap_count = atomic_load_relaxed (&mp_.munmap_count);
+
+  /* A caller built against an older version of the structure only
+     gets the members it knows about.  A caller built against a newer
+     one gets zero in the members added since.  */
+  if (size > sizeof (current))
+    {
+      memset ((char *) stats + sizeof (current), 0, size - sizeof (current));
+      size = sizeof (current);
+    }
+  memcpy (stats, &current, size);
+  return 0;
+}
+
+static void
+stats_print_common (FILE *fp, const struct malloc_statistics *stats)
+{
+  fprintf (fp, "\"system_bytes\":%zu,", stats->arena_bytes);
+
+  /* The space in use is only counted with glibc.malloc.stats.  The
+     fragmentation is the free fraction of the arena memory in parts
+     per million, to keep the output independent of the locale.  */
+  if (mp_.stats)
+    {
+      size_t free_bytes = (stats->arena_bytes > stats->in_use_bytes
+			   ? stats->arena_bytes - stats->in_use_bytes : 0);
+      size_t fragmentation = 0;
+      if (stats->arena_bytes != 0)
+	fragmentation = (size_t) ((double) free_bytes * 1000000
+				  / stats->arena_bytes);
+      fprintf (fp,
+	       "\"in_use_bytes\":%zu,\"free_bytes\":%zu,"
+	       "\"fragmentation_ppm\":%zu,",
+	       stats->in_use_bytes, free_bytes, fragmentation);
+    }
+  else
+    fputs ("\"in_use_bytes\":null,\"free_bytes\":null,"
+	   "\"fragmentation_ppm\":null,", fp);
+
+  fprintf (fp,
+	   "\"tcache_hits\":%zu,\"tcache_misses\":%zu,"
+	   "\"lock_waits\":%zu,\"lock_wait_ns\":%zu,\"classes\":[",
+	   stats->tcache_hits, stats->tcache_misses,
+	   stats->lock_waits, stats->lock_wait_ns);
+
+  const char *sep = "";
+  for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+    if (stats->classes[i].nmalloc != 0 || stats->classes[i].nfree != 0)
+      {
+	fprintf (fp, "%s\n{\"size\":%zu,\"nmalloc\":%zu,\"nfree\":%zu}",
+		 sep, stats->classes[i].size, stats->classes[i].nmalloc,
+		 stats->classes[i].nfree);
+	sep = ",";
+      }
+  fputs ("]", fp);
+}
+
+int
+__malloc_statistics_json (int options, FILE *fp)
+{
+  /* For now, at least.  */
+  if (options != 0)
+    return EINVAL;
+
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  struct malloc_statistics total;
+  memset (&total, 0, sizeof (total));
+
+  fputs ("{\"version\":1,\"heaps\":[", fp);
+
+  /* Each arena is reported as a heap, as in malloc_info.  */
+  mstate ar_ptr = &main_arena;
+  do
+    {
+      struct malloc_statistics stats;
+      memset (&stats, 0, sizeof (stats));
+      stats_read_arena (ar_ptr, &stats);
+
+      fprintf (fp, "%s\n{\"nr\":%zu,", total.narenas != 0 ? "," : "",
+	       total.narenas);
+      stats_print_common (fp, &stats);
+      fputs ("}", fp);
+
+      stats_read_arena (ar_ptr, &total);
+      ar_ptr = atomic_load_acquire (&ar_ptr->next);
+    }
+  while (ar_ptr != &main_arena);
+
+  fprintf (fp, "],\n\"total\":{\"heaps\":%zu,\"mmapped_bytes\":%zu,"
+	   "\"mmap_count\":%zu,\"munmap_count\":%zu,",
+	   total.narenas, atomic_load_relaxed (&mp_.mmapped_mem),
+	   atomic_load_relaxed (&mp_.mmap_count),
+	   atomic_load_relaxed (&mp_.munmap_count));
+  stats_print_common (fp, &total);
+  fputs ("}}\n", fp);
+
+  return 0;
+}
+
 weak_alias (__malloc_info, malloc_info)
+weak_alias (__malloc_statistics, malloc_statistics)
+weak_alias (__malloc_statistics_json, malloc_statistics_json)
 
 strong_alias (__libc_calloc, __calloc) weak_alias (__libc_calloc, calloc)
 strong_alias (__libc_free, __free) strong_alias (__libc_free, free)
+weak_alias (__libc_free_sized, free_sized)
+weak_alias (__libc_free_aligned_sized, free_aligned_sized)
 strong_alias (__libc_malloc, __malloc) strong_alias (__libc_malloc, malloc)
 strong_alias (__libc_memalign, __memalign)
 weak_alias (__libc_memalign, memalign)
@@ -5907,6 +7223,11 @@ strong_alias (__libc_mallopt, __mallopt) weak_alias (__libc_mallopt, mallopt)
 weak_alias (__malloc_stats, malloc_stats)
 weak_alias (__malloc_usable_size, malloc_usable_size)
 weak_alias (__malloc_trim, malloc_trim)
+weak_alias (__malloc_profile_dump, malloc_profile_dump)
+weak_alias (__malloc_region_create, malloc_region_create)
+weak_alias (__malloc_region_alloc, malloc_region_alloc)
+weak_alias (__malloc_region_reset, malloc_region_reset)
+weak_alias (__malloc_region_destroy, malloc_region_destroy)
 #endif
 
 #if SHLIB_COMPAT (libc, GLIBC_2_0, GLIBC_2_26)
@@ -116,6 +116,42 @@ extern struct mallinfo mallinfo (void) __THROW __MALLOC_DEPRECATED;
 /* Returns a copy of the updated current mallinfo. */
 extern struct mallinfo2 mallinfo2 (void) __THROW;
 
+/* Number of size classes reported by malloc_statistics.  */
+#define MALLOC_STATS_CLASSES 96
+
+/* Allocation counts for the chunks of one size class.  */
+struct malloc_class_stats
+{
+  size_t size;     /* largest chunk size in the class */
+  size_t nmalloc;  /* number of allocations */
+  size_t nfree;    /* number of frees */
+};
+
+/* Counters maintained by malloc.  Apart from the mapping and memory
+   totals, they are only updated if the glibc.malloc.stats tunable is
+   set.  */
+struct malloc_statistics
+{
+  size_t narenas;        /* number of arenas */
+  size_t arena_bytes;    /* non-mmapped space allocated from system */
+  size_t in_use_bytes;   /* space in allocated chunks in the arenas */
+  size_t mmapped_bytes;  /* space in mmapped chunks */
+  size_t mmap_count;     /* number of chunks and heaps mapped */
+  size_t munmap_count;   /* number of chunks and heaps unmapped */
+  size_t tcache_hits;    /* allocations served by the thread cache */
+  size_t tcache_misses;  /* cacheable allocations which missed it */
+  size_t lock_waits;     /* arena lock acquisitions which blocked */
+  size_t lock_wait_ns;   /* nanoseconds spent blocked on arena locks */
+  struct malloc_class_stats classes[MALLOC_STATS_CLASSES];
+};
+
+/* Store the current allocator statistics in *__STATS without taking
+   any arena lock.  __SIZE is the size of *__STATS, normally
+   sizeof (struct malloc_statistics), so that members can be added to
+   the structure later.  Return 0.  */
+extern int malloc_statistics (struct malloc_statistics *__stats,
+			      size_t __size) __THROW;
+
 /* SVID2/XPG mallopt options */
 #ifndef M_MXFAST
 # define M_MXFAST  1    /* maximum request size for "fastbins" */
@@ -157,5 +193,33 @@ extern void malloc_stats (void) __THROW;
 /* Output information about state of allocator to stream FP.  */
 extern int malloc_info (int __options, FILE *__fp) __THROW;
 
+/* Output the statistics of malloc_statistics, and their breakdown by
+   arena, to stream FP in JSON format.  */
+extern int malloc_statistics_json (int __options, FILE *__fp) __THROW;
+
+/* Write the live samples of the heap profiler to file descriptor __FD
+   in JSON format.  Return 0 on success, -1 on error.  */
+extern int malloc_profile_dump (int __fd) __THROW;
+
+/* Regions serve many allocations which are released together.  */
+struct malloc_region;
+
+/* Create an empty region.  Return NULL on failure.  */
+extern struct malloc_region *malloc_region_create (void) __THROW __wur;
+
+/* Allocate __SIZE bytes from __REGION.  The memory is released by
+   malloc_region_reset or malloc_region_destroy, it must not be passed
+   to free or realloc.  */
+extern void *malloc_region_alloc (struct malloc_region *__region,
+				  size_t __size)
+     __THROW __attribute_malloc__ __attribute_alloc_size__ ((2)) __wur;
+
+/* Release all the memory allocated from __REGION, which stays usable.  */
+extern void malloc_region_reset (struct malloc_region *__region) __THROW;
+
+/* Release all the memory allocated from __REGION, and __REGION
+   itself.  */
+extern void malloc_region_destroy (struct malloc_region *__region) __THROW;
+
 __END_DECLS
 #endif /* malloc.h */
@@ -0,0 +1,488 @@
+/* Record a binary trace of the allocations of a running program.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* This library is meant to be preloaded with LD_PRELOAD.  If the
+   environment variable MALLOCTRACE_OUTPUT names a file, every call of
+   the allocation functions is recorded there in the format described
+   in malloctrace.h.  The records are collected in a buffer of each
+   thread, which is written out when it is full, when the thread exits
+   and when the program terminates, so the threads do not contend on a
+   lock or on the file for every call.  Records of threads which are
+   still running when the program terminates may be lost.  Child
+   processes created by fork write their trace to a file of their own,
+   whose name is the one given by MALLOCTRACE_OUTPUT followed by a dot
+   and the process ID.  If writing to the file fails, tracing stops.  */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "malloctrace.h"
+
+/* Pointer to the real functions.  These are determined using `dlsym'
+   when really needed.  */
+static void *(*mallocp) (size_t);
+static void *(*callocp) (size_t, size_t);
+static void *(*reallocp) (void *, size_t);
+static void (*freep) (void *);
+static void (*free_sizedp) (void *, size_t);
+static void (*free_aligned_sizedp) (void *, size_t, size_t);
+static void *(*memalignp) (size_t, size_t);
+static void *(*aligned_allocp) (size_t, size_t);
+static int (*posix_memalignp) (void **, size_t, size_t);
+static void *(*vallocp) (size_t);
+static void *(*pvallocp) (size_t);
+
+/* Number of records in the buffer of each thread.  */
+#define BUFFER_RECORDS 2048
+
+struct trace_buffer
+{
+  /* On the list of the buffers of all threads.  */
+  struct trace_buffer *next;
+  struct trace_buffer *prev;
+  uint32_t tid;
+  uint32_t count;
+  struct malloctrace_record records[BUFFER_RECORDS];
+};
+
+/* Value of thread_buffer after the thread has written out its buffer
+   at exit.  Records of later calls are written out one by one.  */
+#define BUFFER_EXITED ((struct trace_buffer *) -1)
+
+static __thread struct trace_buffer *thread_buffer;
+/* Set while the tracer itself calls functions which may allocate.  */
+static __thread bool in_tracer;
+
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer *buffers;
+static pthread_key_t buffer_key;
+
+static const char *outname;
+static int fd = -1;
+static int initialized;
+static bool tracing;
+/* Set once writing to the output file has failed.  */
+static bool write_failed;
+
+
+static uint64_t
+gettime (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static unsigned int
+log2_ceil (size_t align)
+{
+  unsigned int l = 0;
+  while (l < sizeof (size_t) * 8 - 1 && ((size_t) 1 << l) < align)
+    ++l;
+  return l;
+}
+
+/* Write LEN bytes at BUF to the output file, retrying after short
+   writes and interruptions.  If writing fails, stop tracing, so that
+   at most the last record in the file is incomplete.  Return false if
+   the data could not be written.  */
+static bool
+write_output (const void *buf, size_t len)
+{
+  if (write_failed)
+    return false;
+
+  int saved_errno = errno;
+  const char *p = buf;
+  while (len > 0)
+    {
+      ssize_t n = write (fd, p, len);
+      if (n > 0)
+	{
+	  p += n;
+	  len -= n;
+	}
+      else if (n < 0 && errno == EINTR)
+	continue;
+      else
+	{
+	  write_failed = true;
+	  tracing = false;
+	  break;
+	}
+    }
+  errno = saved_errno;
+  return !write_failed;
+}
+
+/* Write out the records of B.  */
+static void
+flush_buffer (struct trace_buffer *b)
+{
+  pthread_mutex_lock (&buffers_lock);
+  if (b->count > 0)
+    write_output (b->records, b->count * sizeof (struct malloctrace_record));
+  b->count = 0;
+  pthread_mutex_unlock (&buffers_lock);
+}
+
+/* Destructor of buffer_key, which runs when a thread exits.  */
+static void
+thread_exit (void *arg)
+{
+  struct trace_buffer *b = arg;
+
+  flush_buffer (b);
+  pthread_mutex_lock (&buffers_lock);
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    buffers = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+  pthread_mutex_unlock (&buffers_lock);
+
+  thread_buffer = BUFFER_EXITED;
+  munmap (b, sizeof (*b));
+}
+
+/* Return the buffer of the calling thread, or NULL if the records have
+   to be written out directly.  */
+static struct trace_buffer *
+get_buffer (void)
+{
+  struct trace_buffer *b = thread_buffer;
+  if (__glibc_likely (b != NULL))
+    return b == BUFFER_EXITED ? NULL : b;
+
+  b = mmap (NULL, sizeof (*b), PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (b == MAP_FAILED)
+    {
+      thread_buffer = BUFFER_EXITED;
+      return NULL;
+    }
+  b->tid = gettid ();
+  b->count = 0;
+  b->prev = NULL;
+
+  pthread_mutex_lock (&buffers_lock);
+  b->next = buffers;
+  if (buffers != NULL)
+    buffers->prev = b;
+  buffers = b;
+  pthread_mutex_unlock (&buffers_lock);
+
+  thread_buffer = b;
+  pthread_setspecific (buffer_key, b);
+  return b;
+}
+
+/* Record a call.  Allocations are recorded after the call returned,
+   and deallocations before the block is passed to the real function, so
+   that the timestamps order the calls of different threads.  */
+static void
+trace (int type, void *ptr, void *old_ptr, size_t size, size_t align)
+{
+  if (!tracing || in_tracer)
+    return;
+
+  in_tracer = true;
+
+  struct malloctrace_record r;
+  r.time = gettime ();
+  r.ptr = (uintptr_t) ptr;
+  r.old_ptr = (uintptr_t) old_ptr;
+  r.size = size;
+  r.type = type;
+  r.align_log2 = log2_ceil (align);
+  r.pad = 0;
+
+  struct trace_buffer *b = get_buffer ();
+  if (b == NULL)
+    {
+      r.tid = gettid ();
+      /* Keep the record in one piece even if the write is short.  */
+      pthread_mutex_lock (&buffers_lock);
+      write_output (&r, sizeof (r));
+      pthread_mutex_unlock (&buffers_lock);
+    }
+  else
+    {
+      r.tid = b->tid;
+      b->records[b->count] = r;
+      if (++b->count == BUFFER_RECORDS)
+	flush_buffer (b);
+    }
+
+  in_tracer = false;
+}
+
+/* Create the output file NAME and write the header.  */
+static bool
+open_output (const char *name)
+{
+  fd = open (name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+	     0666);
+  if (fd == -1)
+    return false;
+  write_failed = false;
+
+  struct malloctrace_header h;
+  memcpy (h.magic, MALLOCTRACE_MAGIC, sizeof (h.magic));
+  h.version = MALLOCTRACE_VERSION;
+  h.record_size = sizeof (struct malloctrace_record);
+  return write_output (&h, sizeof (h));
+}
+
+/* Start a trace of its own in a child process.  The records of the
+   parent are left for the parent to write out, and the buffers of its
+   other threads are released.  */
+static void
+fork_child (void)
+{
+  if (!tracing)
+    return;
+
+  in_tracer = true;
+  struct trace_buffer *b = buffers;
+  while (b != NULL)
+    {
+      struct trace_buffer *next = b->next;
+      if (b != thread_buffer)
+	munmap (b, sizeof (*b));
+      b = next;
+    }
+  buffers = NULL;
+  pthread_mutex_init (&buffers_lock, NULL);
+  if (thread_buffer != NULL && thread_buffer != BUFFER_EXITED)
+    {
+      b = thread_buffer;
+      b->tid = gettid ();
+      b->count = 0;
+      b->next = NULL;
+      b->prev = NULL;
+      buffers = b;
+    }
+
+  char name[4096];
+  close (fd);
+  tracing = ((size_t) snprintf (name, sizeof (name), "%s.%d", outname,
+				getpid ())
+	     < sizeof (name)
+	     && open_output (name));
+  in_tracer = false;
+}
+
+/* Determine the real functions, and open the output file named by the
+   environment variable MALLOCTRACE_OUTPUT.  */
+static void
+me (void)
+{
+  initialized = -1;
+  mallocp = (void *(*) (size_t)) dlsym (RTLD_NEXT, "malloc");
+  callocp = (void *(*) (size_t, size_t)) dlsym (RTLD_NEXT, "calloc");
+  reallocp = (void *(*) (void *, size_t)) dlsym (RTLD_NEXT, "realloc");
+  freep = (void (*) (void *)) dlsym (RTLD_NEXT, "free");
+  free_sizedp = (void (*) (void *, size_t)) dlsym (RTLD_NEXT, "free_sized");
+  free_aligned_sizedp
+    = (void (*) (void *, size_t, size_t)) dlsym (RTLD_NEXT,
+						 "free_aligned_sized");
+  memalignp = (void *(*) (size_t, size_t)) dlsym (RTLD_NEXT, "memalign");
+  aligned_allocp
+    = (void *(*) (size_t, size_t)) dlsym (RTLD_NEXT, "aligned_alloc");
+  posix_memalignp
+    = (int (*) (void **, size_t, size_t)) dlsym (RTLD_NEXT,
+						 "posix_memalign");
+  vallocp = (void *(*) (size_t)) dlsym (RTLD_NEXT, "valloc");
+  pvallocp = (void *(*) (size_t)) dlsym (RTLD_NEXT, "pvalloc");
+  initialized = 1;
+
+  outname = getenv ("MALLOCTRACE_OUTPUT");
+  if (outname == NULL || outname[0] == '\0')
+    return;
+
+  in_tracer = true;
+  if (open_output (outname)
+      && pthread_key_create (&buffer_key, thread_exit) == 0)
+    {
+      pthread_atfork (NULL, NULL, fork_child);
+      tracing = true;
+    }
+  in_tracer = false;
+}
+
+static void
+__attribute__ ((constructor))
+init (void)
+{
+  if (!initialized)
+    me ();
+}
+
+/* Write out the buffers of all threads.  */
+static void
+__attribute__ ((destructor))
+dest (void)
+{
+  if (!tracing)
+    return;
+
+  tracing = false;
+  pthread_mutex_lock (&buffers_lock);
+  for (struct trace_buffer *b = buffers; b != NULL; b = b->next)
+    if (b->count > 0)
+      {
+	write_output (b->records,
+		      b->count * sizeof (struct malloctrace_record));
+	b->count = 0;
+      }
+  pthread_mutex_unlock (&buffers_lock);
+}
+
+#define ENSURE_INITIALIZED(failure)		\
+  if (__glibc_unlikely (initialized <= 0))	\
+    {						\
+      if (initialized == -1)			\
+	return failure;				\
+      me ();					\
+    }
+
+void *
+malloc (size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*mallocp) (len);
+  if (result != NULL)
+    trace (MALLOCTRACE_MALLOC, result, NULL, len, 0);
+  return result;
+}
+
+void *
+calloc (size_t n, size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*callocp) (n, len);
+  if (result != NULL)
+    trace (MALLOCTRACE_CALLOC, result, NULL, n * len, 0);
+  return result;
+}
+
+void *
+realloc (void *old, size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+
+  /* OLD may be freed by the call, and handed out to another thread
+     before the result is recorded, so it is recorded as freed first.
+     If the call fails, OLD stays recorded as freed.  */
+  if (old != NULL)
+    trace (MALLOCTRACE_FREE, old, NULL, 0, 0);
+
+  void *result = (*reallocp) (old, len);
+  if (result != NULL)
+    trace (MALLOCTRACE_REALLOC, result, old, len, 0);
+  return result;
+}
+
+void
+free (void *ptr)
+{
+  ENSURE_INITIALIZED ();
+  if (ptr != NULL)
+    trace (MALLOCTRACE_FREE, ptr, NULL, 0, 0);
+  (*freep) (ptr);
+}
+
+void
+free_sized (void *ptr, size_t size)
+{
+  ENSURE_INITIALIZED ();
+  if (ptr != NULL)
+    trace (MALLOCTRACE_FREE, ptr, NULL, size, 0);
+  (*free_sizedp) (ptr, size);
+}
+
+void
+free_aligned_sized (void *ptr, size_t alignment, size_t size)
+{
+  ENSURE_INITIALIZED ();
+  if (ptr != NULL)
+    trace (MALLOCTRACE_FREE, ptr, NULL, size, alignment);
+  (*free_aligned_sizedp) (ptr, alignment, size);
+}
+
+void *
+memalign (size_t alignment, size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*memalignp) (alignment, len);
+  if (result != NULL)
+    trace (MALLOCTRACE_MEMALIGN, result, NULL, len, alignment);
+  return result;
+}
+
+void *
+aligned_alloc (size_t alignment, size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*aligned_allocp) (alignment, len);
+  if (result != NULL)
+    trace (MALLOCTRACE_MEMALIGN, result, NULL, len, alignment);
+  return result;
+}
+
+int
+posix_memalign (void **memptr, size_t alignment, size_t len)
+{
+  ENSURE_INITIALIZED (ENOMEM);
+  int result = (*posix_memalignp) (memptr, alignment, len);
+  if (result == 0)
+    trace (MALLOCTRACE_MEMALIGN, *memptr, NULL, len, alignment);
+  return result;
+}
+
+void *
+valloc (size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*vallocp) (len);
+  if (result != NULL)
+    trace (MALLOCTRACE_MEMALIGN, result, NULL, len, getpagesize ());
+  return result;
+}
+
+void *
+pvalloc (size_t len)
+{
+  ENSURE_INITIALIZED (NULL);
+  void *result = (*pvallocp) (len);
+  if (result != NULL)
+    trace (MALLOCTRACE_MEMALIGN, result, NULL, len, getpagesize ());
+  return result;
+}
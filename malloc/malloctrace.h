@@ -0,0 +1,77 @@
+/* Binary format of the allocation traces written by libmalloctrace.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _MALLOCTRACE_H
+#define _MALLOCTRACE_H
+
+#include <stdint.h>
+
+/* A trace consists of a header followed by fixed-size records in the
+   byte order of the traced program.  Each thread collects its records
+   in a buffer of its own and writes out the whole buffer at once, so
+   the records of different threads are interleaved in blocks.  Within
+   a thread they are in program order, and the timestamps, taken from
+   CLOCK_MONOTONIC, order them across threads: allocations are stamped
+   after the call returned and deallocations before it started, so a
+   block is always allocated before it is freed by another thread.
+   realloc is recorded as a MALLOCTRACE_FREE of the old block, stamped
+   before the call, followed by a MALLOCTRACE_REALLOC record of the same
+   thread if it returned a block.  */
+
+#define MALLOCTRACE_MAGIC "GLIBCMTR"
+#define MALLOCTRACE_VERSION 1
+
+struct malloctrace_header
+{
+  char magic[8];
+  uint32_t version;
+  /* Size of struct malloctrace_record.  */
+  uint32_t record_size;
+};
+
+/* Values of the type member of struct malloctrace_record.  */
+enum
+{
+  MALLOCTRACE_MALLOC = 1,
+  MALLOCTRACE_CALLOC,
+  MALLOCTRACE_REALLOC,
+  MALLOCTRACE_FREE,
+  /* memalign, aligned_alloc, posix_memalign, valloc and pvalloc.  */
+  MALLOCTRACE_MEMALIGN
+};
+
+struct malloctrace_record
+{
+  /* Nanoseconds since an unspecified starting point.  */
+  uint64_t time;
+  /* The block returned, or freed by free.  */
+  uint64_t ptr;
+  /* The block passed to realloc, or zero.  */
+  uint64_t old_ptr;
+  /* The size of the request.  For calloc, the product of its
+     arguments.  */
+  uint64_t size;
+  /* Thread ID of the caller.  */
+  uint32_t tid;
+  uint8_t type;
+  /* Base 2 logarithm of the alignment of MALLOCTRACE_MEMALIGN.  */
+  uint8_t align_log2;
+  uint16_t pad;
+};
+
+#endif /* malloctrace.h */
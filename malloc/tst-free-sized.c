@@ -0,0 +1,85 @@
+/* Test free_sized and free_aligned_sized.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+
+static const size_t sizes[] =
+  { 1, 8, 24, 25, 100, 1000, 1032, 4000, 100000, 1 << 20 };
+
+static int
+do_test (void)
+{
+  /* Freeing a null pointer has no effect.  */
+  free_sized (NULL, 0);
+  free_sized (NULL, 100);
+  free_aligned_sized (NULL, 64, 64);
+
+  for (size_t i = 0; i < array_length (sizes); ++i)
+    {
+      size_t size = sizes[i];
+
+      /* A block freed with its size is reused for the next request of
+	 the same size if it is kept in the thread cache.  */
+      void *p = xmalloc (size);
+      memset (p, 0xa5, size);
+      free_sized (p, size);
+      void *q = xmalloc (size);
+      if (size <= 1032)
+	TEST_VERIFY (q == p);
+      free_sized (q, size);
+
+      p = xcalloc (1, size);
+      free_sized (p, size);
+
+      /* Blocks shrunk or grown by realloc.  */
+      p = xmalloc (size + 256);
+      p = xrealloc (p, size);
+      free_sized (p, size);
+      p = xmalloc (size);
+      p = xrealloc (p, 2 * size);
+      free_sized (p, 2 * size);
+
+      /* Aligned blocks.  */
+      for (size_t align = 16; align <= 4096; align *= 4)
+	{
+	  size_t asize = (size + align - 1) & -align;
+	  p = aligned_alloc (align, asize);
+	  TEST_VERIFY_EXIT (p != NULL);
+	  TEST_COMPARE ((uintptr_t) p % align, 0);
+	  memset (p, 0x5a, asize);
+	  free_aligned_sized (p, align, asize);
+	}
+    }
+
+  /* errno is preserved.  */
+  void *p = xmalloc (100000);
+  errno = ENOMEM;
+  free_sized (p, 100000);
+  TEST_COMPARE (errno, ENOMEM);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
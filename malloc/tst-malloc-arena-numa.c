@@ -0,0 +1,133 @@
+/* Test NUMA-aware arena selection.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.arena_numa set.  Threads move from
+   CPU to CPU while they allocate, so that on a NUMA system they switch
+   between arenas on different nodes, and free blocks allocated on other
+   CPUs and by other threads.  All blocks must keep their contents.  On
+   a system with a single node, this checks that the tunable does not
+   change the behavior of malloc.  */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { nthreads = 4 };
+enum { nblocks = 2000 };
+
+struct thread_data
+{
+  int index;
+  unsigned char *blocks[nblocks];
+};
+
+static struct thread_data threads[nthreads];
+static int ncpus;
+
+static size_t
+block_size (int i)
+{
+  return 16 + (i * 97) % 4000;
+}
+
+/* Move the calling thread to CPU, if it is allowed to run there.  */
+static void
+move_to_cpu (int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  sched_setaffinity (0, sizeof (set), &set);
+}
+
+static void
+check_block (struct thread_data *data, int i)
+{
+  for (size_t j = 0; j < block_size (i); ++j)
+    if (data->blocks[i][j] != ((data->index + i) & 0xff))
+      FAIL_EXIT1 ("thread %d: block %d corrupted at offset %zu",
+		  data->index, i, j);
+}
+
+static void *
+thread_func (void *closure)
+{
+  struct thread_data *data = closure;
+
+  for (int i = 0; i < nblocks; ++i)
+    {
+      if (i % 100 == 0)
+	move_to_cpu ((data->index + i / 100) % ncpus);
+      data->blocks[i] = xmalloc (block_size (i));
+      memset (data->blocks[i], (data->index + i) & 0xff, block_size (i));
+    }
+
+  /* Free every other block on another CPU, and allocate it again.  */
+  for (int i = 0; i < nblocks; i += 2)
+    {
+      if (i % 100 == 0)
+	move_to_cpu ((data->index + i / 100 + 1) % ncpus);
+      check_block (data, i);
+      free (data->blocks[i]);
+      data->blocks[i] = xmalloc (block_size (i));
+      memset (data->blocks[i], (data->index + i) & 0xff, block_size (i));
+    }
+
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  cpu_set_t set;
+  TEST_COMPARE (sched_getaffinity (0, sizeof (set), &set), 0);
+  ncpus = sysconf (_SC_NPROCESSORS_CONF);
+  if (ncpus > CPU_SETSIZE)
+    ncpus = CPU_SETSIZE;
+  TEST_VERIFY_EXIT (ncpus > 0);
+
+  pthread_t thr[nthreads];
+  for (int i = 0; i < nthreads; ++i)
+    {
+      threads[i].index = i;
+      thr[i] = xpthread_create (NULL, thread_func, &threads[i]);
+    }
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (thr[i]);
+
+  /* The blocks of the threads which have exited are freed by the main
+     thread, which runs on yet another set of CPUs.  */
+  for (int t = 0; t < nthreads; ++t)
+    for (int i = 0; i < nblocks; ++i)
+      {
+	if (i % 500 == 0)
+	  move_to_cpu ((t + i / 500) % ncpus);
+	check_block (&threads[t], i);
+	free (threads[t].blocks[i]);
+      }
+
+  sched_setaffinity (0, sizeof (set), &set);
+  return 0;
+}
+
+#include <support/test-driver.c>
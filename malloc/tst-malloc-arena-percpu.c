@@ -0,0 +1,107 @@
+/* Test per-CPU arena selection.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.arena_percpu set and the thread
+   cache disabled.  A block freed by one thread is returned by the next
+   allocation of the same size in its arena, so a second thread running
+   on the same CPU at the same time must get it too.  With arenas bound
+   to threads, the second thread would use an arena of its own.  The
+   check is repeated in a child process, after the arenas have been
+   reset by fork.  */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/rseq.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum { block_size = 48 };
+
+static pthread_barrier_t barrier;
+static void *freed_block;
+
+static void *
+first_thread (void *closure)
+{
+  freed_block = xmalloc (block_size);
+  free (freed_block);
+  /* Let the second thread allocate, and stay alive meanwhile, so that
+     the arena is not released.  */
+  xpthread_barrier_wait (&barrier);
+  xpthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+static void *
+second_thread (void *closure)
+{
+  xpthread_barrier_wait (&barrier);
+  void *p = xmalloc (block_size);
+  TEST_VERIFY (p == freed_block);
+  xpthread_barrier_wait (&barrier);
+  free (p);
+  return NULL;
+}
+
+static void
+check_shared_arena (void)
+{
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_t thr1 = xpthread_create (NULL, first_thread, NULL);
+  pthread_t thr2 = xpthread_create (NULL, second_thread, NULL);
+  xpthread_join (thr1);
+  xpthread_join (thr2);
+  xpthread_barrier_destroy (&barrier);
+}
+
+static int
+do_test (void)
+{
+  if (sysconf (_SC_NPROCESSORS_CONF) <= 1)
+    FAIL_UNSUPPORTED ("per-CPU arenas need more than one CPU");
+  if (__rseq_size == 0)
+    FAIL_UNSUPPORTED ("rseq is not registered");
+
+  /* Run all threads on the current CPU.  */
+  int cpu = sched_getcpu ();
+  TEST_VERIFY_EXIT (cpu >= 0);
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  TEST_COMPARE (sched_setaffinity (0, sizeof (set), &set), 0);
+
+  check_shared_arena ();
+
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      check_shared_arena ();
+      exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,117 @@
+/* Test incremental fastbin consolidation.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with the tcache disabled and
+   glibc.malloc.consolidate_budget set to 4.  A large request must only
+   consolidate a few fastbin chunks, the others must stay in the
+   fastbins and be consolidated by later requests, and malloc_trim must
+   still consolidate all of them.  A request which does not fit in the
+   top chunk consolidates the rest of the fastbin in which the budget
+   ran out before it extends the heap.  */
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+
+enum { budget = 4 };
+enum { nchunks = 1000 };
+enum { small_size = 32 };
+enum { large_size = 4000 };
+
+static unsigned char *fast[nchunks];
+static unsigned char *live[nchunks];
+
+static size_t
+fastbin_bytes (void)
+{
+  return mallinfo2 ().fsmblks;
+}
+
+static void
+check_live (void)
+{
+  for (int i = 0; i < nchunks; ++i)
+    for (int j = 0; j < small_size; ++j)
+      if (live[i][j] != (i & 0xff))
+	FAIL_EXIT1 ("block %d corrupted at offset %d", i, j);
+}
+
+static int
+do_test (void)
+{
+  /* Interleave the chunks freed into the fastbins with live chunks, so
+     that consolidation cannot merge them with each other.  */
+  for (int i = 0; i < nchunks; ++i)
+    {
+      fast[i] = xmalloc (small_size);
+      live[i] = xmalloc (small_size);
+      memset (live[i], i & 0xff, small_size);
+    }
+  for (int i = 0; i < nchunks; ++i)
+    free (fast[i]);
+
+  size_t chunk = fastbin_bytes () / nchunks;
+  TEST_VERIFY_EXIT (chunk >= small_size);
+
+  /* Each large request consolidates at most BUDGET chunks.  */
+  size_t before = fastbin_bytes ();
+  void *large = xmalloc (large_size);
+  size_t after = fastbin_bytes ();
+  TEST_VERIFY (after < before);
+  TEST_VERIFY (after >= before - budget * chunk);
+  free (large);
+
+  /* Repeated requests make progress until the fastbins are empty.  */
+  for (int i = 0; i < 2 * nchunks / budget && fastbin_bytes () > 0; ++i)
+    free (xmalloc (large_size));
+  TEST_COMPARE (fastbin_bytes (), 0);
+  check_live ();
+
+  /* A request larger than the top chunk consolidates the rest of the
+     fastbin before it extends the heap.  All chunks are in the same
+     fastbin here.  */
+  for (int i = 0; i < nchunks; ++i)
+    fast[i] = xmalloc (small_size);
+  for (int i = 0; i < nchunks; ++i)
+    free (fast[i]);
+  TEST_VERIFY (fastbin_bytes () > budget * chunk);
+  large = xmalloc (mallinfo2 ().keepcost + large_size);
+  TEST_COMPARE (fastbin_bytes (), 0);
+  free (large);
+  check_live ();
+
+  /* malloc_trim consolidates everything at once.  */
+  for (int i = 0; i < nchunks; ++i)
+    fast[i] = xmalloc (small_size);
+  for (int i = 0; i < nchunks; ++i)
+    free (fast[i]);
+  TEST_VERIFY (fastbin_bytes () > budget * chunk);
+  malloc_trim (0);
+  TEST_COMPARE (fastbin_bytes (), 0);
+  check_live ();
+
+  for (int i = 0; i < nchunks; ++i)
+    free (live[i]);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,93 @@
+/* Test purging of the pages of idle free chunks.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.decay_time set to 100 ms.  Blocks
+   which are freed between blocks still in use cannot be trimmed, but
+   their pages must be purged once they have been idle for longer than
+   the decay time and the program keeps allocating.  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+
+enum { nblocks = 32 };
+enum { block_size = 64 * 1024 };
+
+/* Return true if the page in the middle of the block at P is resident.  */
+static bool
+middle_page_resident (void *p)
+{
+  uintptr_t ps = sysconf (_SC_PAGESIZE);
+  uintptr_t page = ((uintptr_t) p + block_size / 2) & ~(ps - 1);
+  unsigned char vec;
+  if (mincore ((void *) page, ps, &vec) != 0)
+    FAIL_EXIT1 ("mincore: %m");
+  return vec & 1;
+}
+
+static int
+do_test (void)
+{
+  void *blocks[nblocks];
+
+  for (int i = 0; i < nblocks; ++i)
+    {
+      blocks[i] = xmalloc (block_size);
+      memset (blocks[i], 0xa5, block_size);
+    }
+
+  /* Free every other block, so that the free chunks cannot be merged
+     with each other or into the top chunk.  */
+  for (int i = 0; i < nblocks; i += 2)
+    free (blocks[i]);
+  for (int i = 0; i < nblocks; i += 2)
+    TEST_VERIFY (middle_page_resident (blocks[i]));
+
+  /* Let the chunks become idle, then keep allocating so that the
+     arena looks for idle chunks.  The requests are too large for the
+     tcache, so each of them goes to the arena.  */
+  struct timespec delay = { 0, 300 * 1000 * 1000 };
+  nanosleep (&delay, NULL);
+  for (int i = 0; i < 4096; ++i)
+    free (xmalloc (2000));
+
+  int purged = 0;
+  for (int i = 0; i < nblocks; i += 2)
+    purged += !middle_page_resident (blocks[i]);
+  TEST_VERIFY (purged > 0);
+
+  for (int i = 1; i < nblocks; i += 2)
+    {
+      unsigned char *p = blocks[i];
+      for (size_t j = 0; j < block_size; ++j)
+	if (p[j] != 0xa5)
+	  FAIL_EXIT1 ("block %d in use was modified at offset %zu", i, j);
+      free (p);
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
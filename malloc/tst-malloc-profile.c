@@ -0,0 +1,152 @@
+/* Test the sampling heap profiler.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.profile_rate set to 4096 bytes and
+   glibc.malloc.profile_signal and glibc.malloc.profile_file set.  Keep
+   many blocks alive, and check that some of them show up in the dumps
+   written by malloc_profile_dump and by the signal handler, that they
+   stay in the dumps when they are reallocated, and that they are
+   dropped from the dumps once freed.  */
+
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/xstdio.h>
+#include <support/xunistd.h>
+
+enum { nblocks = 4096 };
+enum { block_size = 100 };
+
+/* The value of glibc.malloc.profile_signal in the test environment.  */
+enum { profile_signal = 10 };
+
+static void *blocks[nblocks];
+
+static char *
+read_file (const char *name)
+{
+  FILE *fp = xfopen (name, "r");
+  char *buffer = NULL;
+  size_t length = 0;
+  TEST_VERIFY_EXIT (getdelim (&buffer, &length, '\0', fp) > 0);
+  xfclose (fp);
+  return buffer;
+}
+
+/* Check the format of the dump in PROFILE and return the number of
+   samples which are blocks of the test.  */
+static int
+count_samples (const char *profile)
+{
+  TEST_VERIFY_EXIT (strncmp (profile, "{\"version\":1,\"rate\":4096,"
+			     "\"samples\":[", 36) == 0);
+  TEST_VERIFY (strcmp (profile + strlen (profile) - 4, "\n]}\n") == 0);
+
+  int count = 0;
+  for (const char *p = strstr (profile, "{\"address\":"); p != NULL;
+       p = strstr (p + 1, "{\"address\":"))
+    {
+      void *address;
+      size_t size, weight;
+      TEST_COMPARE (sscanf (p, "{\"address\":\"%p\",\"size\":%zu,"
+			    "\"weight\":%zu,\"frames\":[\"0x",
+			    &address, &size, &weight), 3);
+      TEST_VERIFY (weight >= size && weight >= 4096);
+      for (int i = 0; i < nblocks; ++i)
+	if (blocks[i] == address && size == block_size)
+	  ++count;
+    }
+  return count;
+}
+
+static int
+dump_and_count (void)
+{
+  char *name;
+  int fd = create_temp_file ("tst-malloc-profile.", &name);
+  TEST_VERIFY_EXIT (fd >= 0);
+  TEST_COMPARE (malloc_profile_dump (fd), 0);
+  xclose (fd);
+
+  char *profile = read_file (name);
+  int count = count_samples (profile);
+  free (profile);
+  free (name);
+  return count;
+}
+
+static int
+do_test (void)
+{
+  for (int i = 0; i < nblocks; ++i)
+    {
+      blocks[i] = xmalloc (block_size);
+      memset (blocks[i], 0xa5, block_size);
+    }
+
+  /* About 100 samples are expected.  */
+  int sampled = dump_and_count ();
+  printf ("info: %d of %d blocks sampled\n", sampled, nblocks);
+  TEST_VERIFY (sampled > 10);
+  TEST_VERIFY (sampled < nblocks / 4);
+
+  /* The file name is the value of glibc.malloc.profile_file.  */
+  static const char tunable[] = "glibc.malloc.profile_file=";
+  const char *tunables = getenv ("GLIBC_TUNABLES");
+  TEST_VERIFY_EXIT (tunables != NULL);
+  const char *value = strstr (tunables, tunable);
+  TEST_VERIFY_EXIT (value != NULL);
+  value += strlen (tunable);
+  char *file = xstrndup (value, strcspn (value, ":"));
+  unlink (file);
+  TEST_COMPARE (raise (profile_signal), 0);
+  char *profile = read_file (file);
+  TEST_COMPARE (count_samples (profile), sampled);
+  free (profile);
+  unlink (file);
+
+  /* Sampled blocks are mmapped, so they take at least a page, and
+     growing them uses mremap.  They stay in the profile, under their
+     new address if they move.  */
+  for (int i = 0; i < nblocks; ++i)
+    if (malloc_usable_size (blocks[i]) >= 4 * block_size)
+      blocks[i] = xrealloc (blocks[i], 64 * 1024);
+  TEST_COMPARE (dump_and_count (), sampled);
+
+  for (int i = 0; i < nblocks; ++i)
+    {
+      unsigned char *p = blocks[i];
+      for (int j = 0; j < block_size; ++j)
+	if (p[j] != 0xa5)
+	  FAIL_EXIT1 ("block %d corrupted at offset %d", i, j);
+      free (p);
+    }
+  TEST_COMPARE (dump_and_count (), 0);
+
+  free (file);
+  return 0;
+}
+
+#include <support/test-driver.c>
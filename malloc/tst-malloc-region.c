@@ -0,0 +1,112 @@
+/* Test the region allocation functions.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <support/check.h>
+
+enum { nblocks = 20000 };
+
+static unsigned char *blocks[nblocks];
+
+static size_t
+block_size (int i)
+{
+  /* Mostly small blocks, and a few which need a mapping of their
+     own.  */
+  return i % 1000 == 999 ? 100000 + i : i % 200;
+}
+
+static void
+fill (struct malloc_region *r)
+{
+  size_t align = 2 * sizeof (size_t);
+
+  for (int i = 0; i < nblocks; ++i)
+    {
+      blocks[i] = malloc_region_alloc (r, block_size (i));
+      TEST_VERIFY_EXIT (blocks[i] != NULL);
+      TEST_COMPARE ((uintptr_t) blocks[i] % align, 0);
+      memset (blocks[i], i & 0xff, block_size (i));
+    }
+}
+
+static void
+check (void)
+{
+  for (int i = 0; i < nblocks; ++i)
+    for (size_t j = 0; j < block_size (i); ++j)
+      if (blocks[i][j] != (i & 0xff))
+	FAIL_EXIT1 ("block %d corrupted at offset %zu", i, j);
+}
+
+static int
+do_test (void)
+{
+  struct malloc_region *r = malloc_region_create ();
+  TEST_VERIFY_EXIT (r != NULL);
+
+  /* Zero-sized requests get distinct pointers.  */
+  void *p = malloc_region_alloc (r, 0);
+  void *q = malloc_region_alloc (r, 0);
+  TEST_VERIFY (p != NULL && q != NULL && p != q);
+
+  fill (r);
+  check ();
+
+  /* After a reset, the memory of the region is reused.  */
+  malloc_region_reset (r);
+  TEST_VERIFY (malloc_region_alloc (r, 0) == p);
+  fill (r);
+  check ();
+
+  /* A second region does not overlap the first one.  */
+  struct malloc_region *r2 = malloc_region_create ();
+  TEST_VERIFY_EXIT (r2 != NULL);
+  for (int i = 0; i < 1000; ++i)
+    memset (malloc_region_alloc (r2, 100), 0xee, 100);
+  check ();
+  malloc_region_destroy (r2);
+
+  /* Requests which cannot be satisfied fail with ENOMEM.  */
+  errno = 0;
+  TEST_VERIFY (malloc_region_alloc (r, SIZE_MAX) == NULL);
+  TEST_COMPARE (errno, ENOMEM);
+  errno = 0;
+  TEST_VERIFY (malloc_region_alloc (r, PTRDIFF_MAX) == NULL);
+  TEST_COMPARE (errno, ENOMEM);
+
+  malloc_region_destroy (r);
+  malloc_region_destroy (NULL);
+
+  /* Regions can be created again from the cached blocks.  */
+  for (int i = 0; i < 100; ++i)
+    {
+      r = malloc_region_create ();
+      TEST_VERIFY_EXIT (r != NULL);
+      fill (r);
+      malloc_region_destroy (r);
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
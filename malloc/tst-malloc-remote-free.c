@@ -0,0 +1,112 @@
+/* Test freeing chunks from threads other than the allocating one.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The main thread allocates blocks which are too large for the tcache
+   and the fastbins, and keeps allocating while worker threads free
+   them.  With glibc.malloc.remote_free=1 the frees which find the
+   arena lock busy are deferred to the remote free list of the main
+   arena.  Check that the blocks are not corrupted or handed out twice
+   and that the deferred chunks are eventually returned to the arena.  */
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { threads = 4 };
+enum { blocks_per_thread = 4096 };
+enum { rounds = 8 };
+
+static pthread_barrier_t barrier;
+
+static void *blocks[threads][blocks_per_thread];
+
+static size_t
+block_size (int thread, int i)
+{
+  return 1100 + ((thread * blocks_per_thread + i) * 37) % 8000;
+}
+
+static void *
+worker (void *closure)
+{
+  int thread = (uintptr_t) closure;
+
+  xpthread_barrier_wait (&barrier);
+  for (int i = 0; i < blocks_per_thread; ++i)
+    {
+      unsigned char *p = blocks[thread][i];
+      size_t size = block_size (thread, i);
+      for (size_t j = 0; j < size; ++j)
+	if (p[j] != (unsigned char) (thread + i))
+	  FAIL_EXIT1 ("block %d of thread %d corrupted at offset %zu",
+		      i, thread, j);
+      free (p);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  xpthread_barrier_init (&barrier, NULL, threads + 1);
+  size_t in_use = mallinfo2 ().uordblks;
+
+  for (int round = 0; round < rounds; ++round)
+    {
+      for (int t = 0; t < threads; ++t)
+	for (int i = 0; i < blocks_per_thread; ++i)
+	  {
+	    size_t size = block_size (t, i);
+	    blocks[t][i] = xmalloc (size);
+	    memset (blocks[t][i], t + i, size);
+	  }
+
+      pthread_t thr[threads];
+      for (int t = 0; t < threads; ++t)
+	thr[t] = xpthread_create (NULL, worker, (void *) (uintptr_t) t);
+
+      /* Keep the arena lock busy while the workers free.  */
+      xpthread_barrier_wait (&barrier);
+      for (int i = 0; i < blocks_per_thread; ++i)
+	free (xmalloc (block_size (0, i)));
+
+      for (int t = 0; t < threads; ++t)
+	xpthread_join (thr[t]);
+    }
+
+  /* Deferred chunks are merged before the statistics are computed,
+     so none of the blocks allocated by the test are in use anymore.
+     Allow for the memory used by the thread descriptors.  */
+  size_t in_use_after = mallinfo2 ().uordblks;
+  if (in_use_after > in_use + 64 * 1024)
+    FAIL_EXIT1 ("%zu bytes in use after the test, %zu bytes before",
+		in_use_after, in_use);
+
+  malloc_trim (0);
+
+  xpthread_barrier_destroy (&barrier);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,219 @@
+/* Test the slab allocator for small objects.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.slab_max set to 64.  Requests of up
+   to 64 bytes must be served without a per-object header, and objects
+   must keep their contents whichever thread allocates and frees
+   them.  glibc.malloc.trim_threshold is set to 0, so that the slabs of
+   a thread are given back to the system as soon as their objects have
+   all been freed after it has exited.  */
+
+#include <libc-diag.h>
+#include <malloc.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { slab_max = 64 };
+enum { nobjs = 20000 };
+
+static unsigned char *objs[nobjs];
+static size_t sizes[nobjs];
+
+static void
+fill (int i)
+{
+  memset (objs[i], i & 0xff, sizes[i]);
+}
+
+static void
+check (int i)
+{
+  for (size_t j = 0; j < sizes[i]; ++j)
+    if (objs[i][j] != (i & 0xff))
+      FAIL_EXIT1 ("object %d of size %zu corrupted at offset %zu",
+		  i, sizes[i], j);
+}
+
+static void
+allocate (int start, int step)
+{
+  for (int i = start; i < nobjs; i += step)
+    {
+      sizes[i] = 1 + i % slab_max;
+      objs[i] = xmalloc (sizes[i]);
+      fill (i);
+    }
+}
+
+static void
+release (int start, int step)
+{
+  for (int i = start; i < nobjs; i += step)
+    {
+      check (i);
+      free (objs[i]);
+    }
+}
+
+static void *
+allocate_thread (void *closure)
+{
+  allocate (0, 2);
+  return NULL;
+}
+
+static void *
+release_thread (void *closure)
+{
+  release (0, 2);
+  return NULL;
+}
+
+/* Return true if the page holding MEM is resident.  */
+static bool
+resident (void *mem)
+{
+  uintptr_t page = (uintptr_t) mem & -(uintptr_t) getpagesize ();
+  unsigned char vec;
+  TEST_COMPARE (mincore ((void *) page, 1, &vec), 0);
+  return vec & 1;
+}
+
+/* Free a pointer into the slab region, past the slabs in use.  */
+static void
+free_unused (void *closure)
+{
+  /* The pointer is invalid on purpose.  */
+  DIAG_PUSH_NEEDS_COMMENT;
+  DIAG_IGNORE_NEEDS_COMMENT (11, "-Wfree-nonheap-object");
+  free ((char *) closure + (16 << 20));
+  DIAG_POP_NEEDS_COMMENT;
+}
+
+static int
+do_test (void)
+{
+  /* Without a header, the usable size is the request rounded up to the
+     alignment of malloc.  */
+  void *p = xmalloc (1);
+  size_t align = malloc_usable_size (p);
+  free (p);
+  TEST_VERIFY_EXIT (align == 8 || align == 16);
+  for (size_t n = 1; n <= slab_max; ++n)
+    {
+      p = xmalloc (n);
+      TEST_COMPARE (malloc_usable_size (p), (n + align - 1) & -align);
+      TEST_COMPARE ((uintptr_t) p % align, 0);
+      free (p);
+    }
+
+  /* Objects of one size are packed next to each other.  */
+  int adjacent = 0;
+  for (int i = 0; i < 100; ++i)
+    objs[i] = xmalloc (16);
+  for (int i = 1; i < 100; ++i)
+    adjacent += objs[i] - objs[i - 1] == 16;
+  TEST_VERIFY (adjacent > 50);
+  for (int i = 0; i < 100; ++i)
+    free (objs[i]);
+
+  allocate (0, 1);
+  release (1, 2);
+  allocate (1, 2);
+  for (int i = 0; i < nobjs; ++i)
+    check (i);
+  release (0, 1);
+
+  /* Objects allocated by another thread, which has exited when they
+     are freed.  */
+  xpthread_join (xpthread_create (NULL, allocate_thread, NULL));
+  allocate (1, 2);
+  release (0, 1);
+
+  /* The slabs of a thread which has exited are released once their
+     objects are free, if pages are not larger than slabs.  */
+  xpthread_join (xpthread_create (NULL, allocate_thread, NULL));
+  int before = 0;
+  for (int i = 0; i < nobjs; i += 2)
+    before += resident (objs[i]);
+  TEST_COMPARE (before, nobjs / 2);
+  release (0, 2);
+  if (getpagesize () <= 4096)
+    for (int i = 0; i < nobjs; i += 2)
+      TEST_VERIFY (!resident (objs[i]));
+
+  /* Objects freed by another thread, while the owner keeps
+     allocating.  */
+  allocate (0, 1);
+  pthread_t thr = xpthread_create (NULL, release_thread, NULL);
+  for (int round = 0; round < 100; ++round)
+    {
+      void *tmp[64];
+      for (int i = 0; i < 64; ++i)
+	tmp[i] = xmalloc (1 + i);
+      for (int i = 0; i < 64; ++i)
+	free (tmp[i]);
+    }
+  xpthread_join (thr);
+  release (1, 2);
+
+  /* realloc keeps the object if it is large enough, and moves it
+     otherwise.  */
+  p = xmalloc (40);
+  memset (p, 0x5a, 40);
+  TEST_VERIFY (xrealloc (p, 20) == p);
+  unsigned char *q = xrealloc (p, 1000);
+  for (int i = 0; i < 20; ++i)
+    TEST_COMPARE (q[i], 0x5a);
+  free (q);
+
+  /* calloc clears objects which are reused.  */
+  p = xmalloc (48);
+  memset (p, 0xff, 48);
+  free (p);
+  q = xcalloc (1, 48);
+  for (int i = 0; i < 48; ++i)
+    TEST_COMPARE (q[i], 0);
+  free (q);
+
+  /* A pointer to a slab which has never been used is rejected, even if
+     its memory is not committed.  */
+  p = xmalloc (16);
+  struct support_capture_subprocess result
+    = support_capture_subprocess (free_unused, p);
+  TEST_VERIFY (strstr (result.err.buffer, "free(): invalid pointer")
+	       != NULL);
+  TEST_VERIFY (WIFSIGNALED (result.status)
+	       && WTERMSIG (result.status) == SIGABRT);
+  support_capture_subprocess_free (&result);
+  free (p);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,150 @@
+/* Test the allocator statistics of malloc_statistics.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.stats set, and checks that the
+   counters follow the allocations and frees of the test.  Other
+   allocations may happen behind the back of the test, so only lower
+   bounds are checked for the counts.  */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xmemstream.h>
+
+enum { nblocks = 1000 };
+enum { block_size = 100 };
+enum { large_size = 4 * 1024 * 1024 };
+
+static void *blocks[nblocks];
+
+/* Return the size class of the chunk of block P.  */
+static size_t
+class_of (const struct malloc_statistics *stats, void *p)
+{
+  size_t chunk_size = malloc_usable_size (p) + sizeof (size_t);
+  for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+    if (stats->classes[i].size >= chunk_size)
+      return i;
+  FAIL_EXIT1 ("no size class for chunk size %zu", chunk_size);
+}
+
+static int
+do_test (void)
+{
+  struct malloc_statistics before, after;
+
+  TEST_COMPARE (malloc_statistics (&before, sizeof (before)), 0);
+  TEST_VERIFY (before.narenas >= 1);
+  TEST_VERIFY (before.arena_bytes >= before.in_use_bytes);
+  for (size_t i = 1; i < MALLOC_STATS_CLASSES; ++i)
+    TEST_VERIFY (before.classes[i].size >= before.classes[i - 1].size);
+
+  for (int i = 0; i < nblocks; ++i)
+    blocks[i] = xmalloc (block_size);
+  size_t class = class_of (&before, blocks[0]);
+  size_t chunk_size = malloc_usable_size (blocks[0]) + sizeof (size_t);
+
+  TEST_COMPARE (malloc_statistics (&after, sizeof (after)), 0);
+  TEST_VERIFY (after.classes[class].nmalloc
+	       >= before.classes[class].nmalloc + nblocks);
+  TEST_VERIFY (after.in_use_bytes
+	       >= before.in_use_bytes + nblocks * chunk_size);
+
+  for (int i = 0; i < nblocks; ++i)
+    free (blocks[i]);
+  before = after;
+  TEST_COMPARE (malloc_statistics (&after, sizeof (after)), 0);
+  TEST_VERIFY (after.classes[class].nfree
+	       >= before.classes[class].nfree + nblocks);
+  TEST_VERIFY (after.in_use_bytes + nblocks * chunk_size
+	       <= before.in_use_bytes);
+
+  /* Blocks freed to the tcache are handed out again.  */
+  before = after;
+  for (int i = 0; i < nblocks; ++i)
+    free (xmalloc (block_size));
+  TEST_COMPARE (malloc_statistics (&after, sizeof (after)), 0);
+  TEST_VERIFY (after.tcache_hits >= before.tcache_hits + nblocks - 1);
+
+  /* Large blocks are mapped and unmapped.  */
+  before = after;
+  free (xmalloc (large_size));
+  TEST_COMPARE (malloc_statistics (&after, sizeof (after)), 0);
+  TEST_VERIFY (after.mmap_count >= before.mmap_count + 1);
+  TEST_VERIFY (after.munmap_count >= before.munmap_count + 1);
+
+  /* A smaller structure only receives its leading members, and the
+     tail of a larger one is cleared.  */
+  struct
+  {
+    struct malloc_statistics stats;
+    size_t extra[4];
+  } larger;
+  memset (&larger, 0xff, sizeof (larger));
+  TEST_COMPARE (malloc_statistics (&larger.stats,
+				   offsetof (struct malloc_statistics,
+					     mmapped_bytes)), 0);
+  TEST_VERIFY (larger.stats.narenas >= 1);
+  TEST_COMPARE (larger.stats.mmapped_bytes, (size_t) -1);
+  TEST_COMPARE (malloc_statistics (&larger.stats, sizeof (larger)), 0);
+  TEST_VERIFY (larger.stats.narenas >= 1);
+  for (int i = 0; i < 4; ++i)
+    TEST_COMPARE (larger.extra[i], 0);
+
+  struct xmemstream mem;
+  xopen_memstream (&mem);
+  TEST_COMPARE (malloc_statistics_json (1, mem.out), EINVAL);
+  TEST_COMPARE (malloc_statistics_json (0, mem.out), 0);
+  xfclose_memstream (&mem);
+
+  static const char prefix[] = "{\"version\":1,\"heaps\":[\n{\"nr\":0,";
+  TEST_VERIFY (strncmp (mem.buffer, prefix, strlen (prefix)) == 0);
+  TEST_VERIFY (strstr (mem.buffer, "],\n\"total\":{\"heaps\":") != NULL);
+  TEST_VERIFY (strcmp (mem.buffer + strlen (mem.buffer) - 3, "}}\n") == 0);
+
+  /* The fragmentation is an integer, whatever the locale.  */
+  const char *frag = strstr (mem.buffer, "\"fragmentation_ppm\":");
+  TEST_VERIFY_EXIT (frag != NULL);
+  unsigned long int ppm;
+  char after_ppm;
+  TEST_COMPARE (sscanf (frag, "\"fragmentation_ppm\":%lu%c",
+			&ppm, &after_ppm), 2);
+  TEST_VERIFY (ppm <= 1000000);
+  TEST_COMPARE (after_ppm, ',');
+
+  char expected[64];
+  snprintf (expected, sizeof (expected), "{\"size\":%zu,\"nmalloc\":",
+	    after.classes[class].size);
+  if (strstr (mem.buffer, expected) == NULL)
+    {
+      puts (mem.buffer);
+      FAIL_EXIT1 ("size class %zu missing from the JSON output",
+		  after.classes[class].size);
+    }
+
+  free (mem.buffer);
+  return 0;
+}
+
+#include <support/test-driver.c>
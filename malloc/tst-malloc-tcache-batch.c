@@ -0,0 +1,90 @@
+/* Test batched transfers between the tcache and the arenas.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.tcache_batch set, so that misses
+   pre-fill the tcache from the top chunk and full tcache bins are
+   flushed half at a time.  Chunks allocated in one thread are freed in
+   another, so that a flush covers chunks of several arenas.  */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { count = 1000 };
+enum { max_size = 1024 };
+
+static void *
+allocate (void *closure)
+{
+  unsigned char **blocks = closure;
+  for (int i = 0; i < count; ++i)
+    {
+      size_t size = 1 + (i * 17) % max_size;
+      blocks[i] = xmalloc (size);
+      memset (blocks[i], i & 0xff, size);
+    }
+  return NULL;
+}
+
+static void
+check_and_free (unsigned char **blocks)
+{
+  /* Free in the reverse order of the allocation, so that the chunks
+     at the end of the tcache bins come from the start of the heap.  */
+  for (int k = count - 1; k >= 0; --k)
+    {
+      size_t size = 1 + (k * 17) % max_size;
+      for (size_t l = 0; l < size; ++l)
+	if (blocks[k][l] != (k & 0xff))
+	  FAIL_EXIT1 ("block %d corrupted at offset %zu", k, l);
+      free (blocks[k]);
+    }
+}
+
+static int
+do_test (void)
+{
+  static unsigned char *blocks[count];
+
+  for (int round = 0; round < 10; ++round)
+    {
+      /* Allocate and free in the main thread.  */
+      allocate (blocks);
+      check_and_free (blocks);
+
+      /* Free in the main thread chunks allocated by another one.  */
+      xpthread_join (xpthread_create (NULL, allocate, blocks));
+      check_and_free (blocks);
+    }
+
+  /* The freed chunks must all be reusable.  */
+  allocate (blocks);
+  for (int i = 0; i < count; ++i)
+    for (int j = i + 1; j < count && j < i + 16; ++j)
+      TEST_VERIFY (blocks[i] != blocks[j]);
+  check_and_free (blocks);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
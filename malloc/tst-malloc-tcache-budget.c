@@ -0,0 +1,90 @@
+/* Test adaptive tcache bin limits and their report by malloc_info.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.malloc.tcache_budget set.  Allocating and
+   freeing many blocks of one size overflows its tcache bin, so its
+   limit must grow beyond the default, but the total capacity must stay
+   within the budget.  */
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xmemstream.h>
+
+enum { budget = 65536 };
+enum { default_limit = 7 };
+enum { burst = 100 };
+
+static int
+do_test (void)
+{
+  void *blocks[burst];
+
+  for (int round = 0; round < 1000; ++round)
+    {
+      for (int i = 0; i < burst; ++i)
+	blocks[i] = xmalloc (32);
+      for (int i = 0; i < burst; ++i)
+	free (blocks[i]);
+    }
+
+  struct xmemstream mem;
+  xopen_memstream (&mem);
+  TEST_COMPARE (malloc_info (0, mem.out), 0);
+  xfclose_memstream (&mem);
+
+  char *tcache_info = strstr (mem.buffer, "<tcache ");
+  TEST_VERIFY_EXIT (tcache_info != NULL);
+
+  size_t limit, capacity, report_budget;
+  TEST_COMPARE (sscanf (tcache_info,
+			"<tcache limit=\"%zu\" capacity=\"%zu\" budget=\"%zu\">",
+			&limit, &capacity, &report_budget), 3);
+  TEST_COMPARE (limit, default_limit);
+  TEST_COMPARE (report_budget, budget);
+  TEST_VERIFY (capacity <= budget);
+
+  unsigned int max_limit = 0;
+  for (char *line = strstr (tcache_info, "<bin ");
+       line != NULL && line < strstr (tcache_info, "</tcache>");
+       line = strstr (line + 1, "<bin "))
+    {
+      size_t size;
+      unsigned int count, bin_limit;
+      TEST_COMPARE (sscanf (line,
+			    "<bin size=\"%zu\" count=\"%u\" limit=\"%u\"/>",
+			    &size, &count, &bin_limit), 3);
+      TEST_VERIFY (count <= bin_limit);
+      if (bin_limit > max_limit)
+	max_limit = bin_limit;
+    }
+  if (max_limit <= default_limit)
+    {
+      puts (mem.buffer);
+      FAIL_EXIT1 ("no tcache bin grew beyond the default limit");
+    }
+
+  free (mem.buffer);
+  return 0;
+}
+
+#include <support/test-driver.c>
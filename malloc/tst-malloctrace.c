@@ -0,0 +1,141 @@
+/* Test the binary allocation tracer libmalloctrace.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with libmalloctrace preloaded.  The threads write out
+   their records when they exit, so after they have been joined their
+   calls must be in the trace, with their thread IDs and in order, and
+   each realloc must follow a free of its old block.  If
+   the test runs in a process forked by the test driver, its trace is
+   in a file of its own.  */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xstdio.h>
+#include <support/xthread.h>
+
+#include "malloctrace.h"
+
+enum { nthreads = 4 };
+enum { nblocks = 5000 };
+
+/* Requests of the threads have sizes BASE_SIZE + thread * nblocks + i,
+   which do not occur elsewhere in the test.  */
+#define BASE_SIZE 100000
+
+static pid_t tids[nthreads];
+
+static void *
+thread_func (void *closure)
+{
+  int thread = (uintptr_t) closure;
+  void *blocks[nblocks];
+
+  tids[thread] = gettid ();
+  for (int i = 0; i < nblocks; ++i)
+    blocks[i] = xmalloc (BASE_SIZE + thread * nblocks + i);
+  for (int i = 0; i < nblocks; ++i)
+    blocks[i] = xrealloc (blocks[i], 16);
+  for (int i = 0; i < nblocks; ++i)
+    free (blocks[i]);
+
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  const char *name = getenv ("MALLOCTRACE_OUTPUT");
+  if (name == NULL)
+    FAIL_UNSUPPORTED ("libmalloctrace is not preloaded");
+
+  pthread_t threads[nthreads];
+  for (int i = 0; i < nthreads; ++i)
+    threads[i] = xpthread_create (NULL, thread_func, (void *) (uintptr_t) i);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+
+  char *child_name = xasprintf ("%s.%d", name, (int) getpid ());
+  FILE *f = fopen (child_name, "r");
+  if (f == NULL)
+    f = xfopen (name, "r");
+  free (child_name);
+
+  struct malloctrace_header h;
+  TEST_COMPARE (fread (&h, sizeof (h), 1, f), 1);
+  TEST_COMPARE_BLOB (h.magic, sizeof (h.magic),
+		     MALLOCTRACE_MAGIC, strlen (MALLOCTRACE_MAGIC));
+  TEST_COMPARE (h.version, MALLOCTRACE_VERSION);
+  TEST_COMPARE (h.record_size, sizeof (struct malloctrace_record));
+
+  int mallocs[nthreads] = { 0 };
+  int reallocs[nthreads] = { 0 };
+  int frees[nthreads] = { 0 };
+  uint64_t last_time[nthreads] = { 0 };
+  uint64_t last_free[nthreads] = { 0 };
+  struct malloctrace_record r;
+  while (fread (&r, sizeof (r), 1, f) == 1)
+    {
+      int thread;
+      for (thread = 0; thread < nthreads; ++thread)
+	if (r.tid == tids[thread])
+	  break;
+      if (thread == nthreads)
+	continue;
+
+      /* The records of a thread are in order.  */
+      TEST_VERIFY (r.time >= last_time[thread]);
+      last_time[thread] = r.time;
+
+      switch (r.type)
+	{
+	case MALLOCTRACE_MALLOC:
+	  if (r.size == BASE_SIZE + thread * nblocks + mallocs[thread])
+	    ++mallocs[thread];
+	  break;
+	case MALLOCTRACE_REALLOC:
+	  TEST_VERIFY (r.old_ptr != 0);
+	  TEST_COMPARE (r.old_ptr, last_free[thread]);
+	  TEST_COMPARE (r.size, 16);
+	  ++reallocs[thread];
+	  break;
+	case MALLOCTRACE_FREE:
+	  /* Count the frees which follow the reallocations.  */
+	  if (reallocs[thread] == nblocks)
+	    ++frees[thread];
+	  break;
+	}
+      last_free[thread] = r.type == MALLOCTRACE_FREE ? r.ptr : 0;
+    }
+  xfclose (f);
+
+  for (int i = 0; i < nthreads; ++i)
+    {
+      TEST_COMPARE (mallocs[i], nblocks);
+      TEST_COMPARE (reallocs[i], nblocks);
+      TEST_VERIFY (frees[i] >= nblocks);
+    }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,113 @@
+/* Test the aligned size classes of aligned_alloc and posix_memalign.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { nblocks = 100 };
+
+static const size_t sizes[] = { 1, 16, 24, 64, 100, 200, 500, 1000, 3000 };
+
+static unsigned char *blocks[nblocks];
+
+static void
+check_blocks (size_t size)
+{
+  for (int i = 0; i < nblocks; ++i)
+    for (size_t j = 0; j < size; ++j)
+      if (blocks[i][j] != (i & 0xff))
+	FAIL_EXIT1 ("block %d of size %zu corrupted at offset %zu",
+		    i, size, j);
+}
+
+static void
+test_class (size_t align, size_t size)
+{
+  for (int round = 0; round < 3; ++round)
+    {
+      for (int i = 0; i < nblocks; ++i)
+	{
+	  if (i % 2 == 0)
+	    blocks[i] = aligned_alloc (align, size);
+	  else
+	    TEST_COMPARE (posix_memalign ((void **) &blocks[i], align, size),
+			  0);
+	  TEST_VERIFY_EXIT (blocks[i] != NULL);
+	  TEST_COMPARE ((uintptr_t) blocks[i] % align, 0);
+	  TEST_VERIFY (malloc_usable_size (blocks[i]) >= size);
+	  memset (blocks[i], i & 0xff, size);
+	}
+      check_blocks (size);
+
+      /* Free the blocks in a different order than they were allocated
+	 in, and mix them with plain allocations of the same size.  */
+      for (int i = 0; i < nblocks; i += 2)
+	free_aligned_sized (blocks[i], align, size);
+      void *p = xmalloc (size);
+      for (int i = nblocks - 1; i > 0; i -= 2)
+	free (blocks[i]);
+      free (p);
+    }
+}
+
+static void *
+run_tests (void *closure)
+{
+  for (size_t align = 32; align <= 4096; align *= 2)
+    for (size_t i = 0; i < array_length (sizes); ++i)
+      test_class (align, sizes[i]);
+
+  /* Alignments beyond the page size.  */
+  for (size_t i = 0; i < array_length (sizes); ++i)
+    test_class (65536, sizes[i]);
+
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  /* The first allocation of a class fills the tcache with chunks of the
+     same class, so a block freed after the second one is reused.  */
+  void *first = aligned_alloc (64, 64);
+  TEST_VERIFY_EXIT (first != NULL);
+  void *p = aligned_alloc (64, 64);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE ((uintptr_t) p % 64, 0);
+  free (p);
+  void *q = aligned_alloc (64, 64);
+  TEST_VERIFY (q == p);
+  free (q);
+  free (first);
+
+  run_tests (NULL);
+
+  /* Chunks of a secondary arena.  */
+  xpthread_join (xpthread_create (NULL, run_tests, NULL));
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -53,9 +53,11 @@
 #endif
 
 /* Get a stack frame from the cache.  We have to match by size since
-   some blocks might be too small or far too large.  */
+   some blocks might be too small or far too large.  Of the blocks with
+   the same size, we prefer one whose guard area has GUARDSIZE bytes, so
+   that it can be used without changing the protection.  */
 static struct pthread *
-get_cached_stack (size_t *sizep, void **memp)
+get_cached_stack (size_t *sizep, void **memp, size_t guardsize)
 {
   size_t size = *sizep;
   struct pthread *result = NULL;
@@ -63,30 +65,38 @@ get_cached_stack (size_t *sizep, void **memp)
 
   lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
 
-  /* Search the cache for a matching entry.  We search for the
-     smallest stack which has at least the required size.  Note that
-     in normal situations the size of all allocated stacks is the
-     same.  As the very least there are only a few different sizes.
+  /* Search the buckets which can hold usable blocks for the smallest
+     stack which has at least the required size.  Note that in normal
+     situations the size of all allocated stacks is the same.  As the
+     very least there are only a few different sizes.  The buckets are
+     ordered by size, so a bucket with a usable block ends the search,
+     and within a bucket the most recently freed stacks come first.
      Therefore this loop will exit early most of the time with an
      exact match.  */
-  list_for_each (entry, &GL (dl_stack_cache))
-    {
-      struct pthread *curr;
-
-      curr = list_entry (entry, struct pthread, list);
-      if (__nptl_stack_in_use (curr) && curr->stackblock_size >= size)
-	{
-	  if (curr->stackblock_size == size)
-	    {
+  size_t last = (size > SIZE_MAX / 4 ? DL_STACK_CACHE_BUCKETS - 1
+		 : __nptl_stack_bucket (4 * size));
+  for (size_t bucket = __nptl_stack_bucket (size);
+       bucket <= last && result == NULL; ++bucket)
+    list_for_each (entry, &GL (dl_stack_cache_buckets)[bucket])
+      {
+	struct pthread *curr;
+
+	curr = list_entry (entry, struct pthread, stack_bucket);
+	if (__nptl_stack_in_use (curr) && curr->stackblock_size >= size)
+	  {
+	    if (curr->stackblock_size == size && curr->guardsize == guardsize)
+	      {
+		result = curr;
+		break;
+	      }
+
+	    if (result == NULL
+		|| result->stackblock_size > curr->stackblock_size
+		|| (result->stackblock_size == curr->stackblock_size
+		    && curr->guardsize == guardsize))
 	      result = curr;
-	      break;
-	    }
-
-	  if (result == NULL
-	      || result->stackblock_size > curr->stackblock_size)
-	    result = curr;
-	}
-    }
+	  }
+      }
 
   if (__builtin_expect (result == NULL, 0)
       /* Make sure the size difference is not too excessive.  In that
@@ -102,15 +112,12 @@ get_cached_stack (size_t *sizep, void **memp)
   /* Don't allow setxid until cloned.  */
   result->setxid_futex = -1;
 
-  /* Dequeue the entry.  */
-  __nptl_stack_list_del (&result->list);
+  /* Dequeue the entry and decrease the cache size.  */
+  __nptl_stack_cache_remove (result);
 
   /* And add to the list of stacks in use.  */
   __nptl_stack_list_add (&result->list, &GL (dl_stack_used));
 
-  /* And decrease the cache size.  */
-  GL (dl_stack_cache_actsize) -= result->stackblock_size;
-
   /* Release the lock early.  */
   lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
 
@@ -180,6 +187,28 @@ setup_stack_prot (char *mem, size_t size, char *guard, size_t guardsize,
   return 0;
 }
 
+/* Return the pages of the unused stack area at MEM of SIZE bytes to the
+   kernel as selected by __nptl_stack_cache_purge.  With MADV_FREE the
+   pages stay in place until the kernel runs short of memory, so a stack
+   reused from the cache soon afterwards does not fault them in again.  */
+static __always_inline void
+purge_stack_range (void *mem, size_t size)
+{
+  int purge = atomic_load_relaxed (&__nptl_stack_cache_purge);
+#ifdef MADV_FREE
+  if (purge == NPTL_STACK_PURGE_LAZY)
+    {
+      if (__madvise (mem, size, MADV_FREE) == 0)
+	return;
+      /* MADV_FREE needs Linux 4.5.  */
+      purge = NPTL_STACK_PURGE_EAGER;
+      atomic_store_relaxed (&__nptl_stack_cache_purge, purge);
+    }
+#endif
+  if (purge != NPTL_STACK_PURGE_NONE)
+    __madvise (mem, size, MADV_DONTNEED);
+}
+
 /* Mark the memory of the stack as usable to the kernel.  It frees everything
    except for the space used for the TCB itself.  */
 static __always_inline void
@@ -191,7 +220,7 @@ advise_stack_range (void *mem, size_t size, uintptr_t pd, size_t guardsize)
   size_t freesize = (sp - (uintptr_t) mem) & ~pagesize_m1;
   assert (freesize < size);
   if (freesize > PTHREAD_STACK_MIN)
-    __madvise (mem, freesize - PTHREAD_STACK_MIN, MADV_DONTNEED);
+    purge_stack_range (mem, freesize - PTHREAD_STACK_MIN);
 #else
   /* Page aligned start of memory to free (higher than or equal
      to current sp plus the minimum stack size).  */
@@ -201,7 +230,7 @@ advise_stack_range (void *mem, size_t size, uintptr_t pd, size_t guardsize)
     {
       size_t freesize = free_end - freeblock;
       assert (freesize < size);
-      __madvise ((void*) freeblock, freesize, MADV_DONTNEED);
+      purge_stack_range ((void*) freeblock, freesize);
     }
 #endif
 }
@@ -357,7 +386,7 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 
       /* Try to get a stack from the cache.  */
       reqsize = size;
-      pd = get_cached_stack (&size, &mem);
+      pd = get_cached_stack (&size, &mem, guardsize);
       if (pd == NULL)
 	{
 	  /* If a guard page is required, avoid committing memory by first
@@ -378,6 +378,9 @@ struct pthread
   size_t guardsize;
   /* This is what the user specified and what we will report.  */
   size_t reported_guardsize;
+  /* Link on the size bucket of the stack cache while the stack is on
+     GL (dl_stack_cache).  */
+  list_t stack_bucket;
 
   /* Thread Priority Protection data.  */
   struct priority_protection_data *tpp;
@@ -402,6 +405,15 @@ struct pthread
   bool exiting;
   int exit_lock; /* A low-level lock (for use with __libc_lock_init etc).  */
 
+  /* Queue node for pthread_spin_queued_lock_np.  SPIN_QSLOT is one
+     plus the index of the thread in __nptl_spin_queue, zero if it has
+     none yet, or NPTL_SPIN_QUEUE_NOSLOT.  SPIN_QNEXT is the slot of the
+     next thread in the queue, and SPIN_QWAIT is set to 1 when this
+     thread becomes the head of the queue.  */
+  unsigned int spin_qslot;
+  unsigned int spin_qnext;
+  unsigned int spin_qwait;
+
   /* Used on strsignal.  */
   struct tls_internal_t tls_state;
 
@@ -21,6 +21,7 @@
 #include <time.h>
 #include <futex-internal.h>
 #include <kernel-features.h>
+#include <pthreadP.h>
 
 #ifndef __ASSUME_TIME64_SYSCALLS
 static int
@@ -83,6 +84,7 @@ __futex_abstimed_wait_common (unsigned int* futex_word,
   clockbit = (clockid == CLOCK_REALTIME) ? FUTEX_CLOCK_REALTIME : 0;
   int op = __lll_private_flag (FUTEX_WAIT_BITSET | clockbit, private);
 
+  __nptl_runstate_blocked (1);
 #ifdef __ASSUME_TIME64_SYSCALLS
   err = __futex_abstimed_wait_common64 (futex_word, expected, op, abstime,
 					private, cancel);
@@ -99,6 +101,7 @@ __futex_abstimed_wait_common (unsigned int* futex_word,
     err = __futex_abstimed_wait_common32 (futex_word, expected, op, abstime,
                                           private, cancel);
 #endif
+  __nptl_runstate_blocked (0);
 
   switch (err)
     {
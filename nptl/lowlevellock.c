@@ -19,11 +19,17 @@
 #include <sysdep.h>
 #include <futex-internal.h>
 #include <atomic.h>
+#include <pthreadP.h>
+#include <nptl-lock-profile.h>
 #include <stap-probe.h>
 
+struct nptl_runstate __nptl_runstate[NPTL_RUNSTATE_SLOTS];
+
 void
 __lll_lock_wait_private (int *futex)
 {
+  uint64_t wait_start = __nptl_lock_profile_start ();
+
   if (atomic_load_relaxed (futex) == 2)
     goto futex;
 
@@ -31,14 +37,21 @@ __lll_lock_wait_private (int *futex)
     {
     futex:
       LIBC_PROBE (lll_lock_wait_private, 1, futex);
+      __nptl_runstate_blocked (1);
       futex_wait ((unsigned int *) futex, 2, LLL_PRIVATE); /* Wait if *futex == 2.  */
+      __nptl_runstate_blocked (0);
     }
+
+  __nptl_lock_profile_end (futex, __builtin_return_address (0),
+			   NPTL_LOCK_PROFILE_LOCK, wait_start);
 }
 libc_hidden_def (__lll_lock_wait_private)
 
-void
-__lll_lock_wait (int *futex, int private)
+static __always_inline void
+lll_lock_wait (int *futex, int private, void *caller, int type)
 {
+  uint64_t wait_start = __nptl_lock_profile_start ();
+
   if (atomic_load_relaxed (futex) == 2)
     goto futex;
 
@@ -46,11 +59,28 @@ __lll_lock_wait (int *futex, int private)
     {
     futex:
       LIBC_PROBE (lll_lock_wait, 1, futex);
+      __nptl_runstate_blocked (1);
       futex_wait ((unsigned int *) futex, 2, private); /* Wait if *futex == 2.  */
+      __nptl_runstate_blocked (0);
     }
+
+  __nptl_lock_profile_end (futex, caller, type, wait_start);
+}
+
+void
+__lll_lock_wait (int *futex, int private)
+{
+  lll_lock_wait (futex, private, __builtin_return_address (0),
+		 NPTL_LOCK_PROFILE_LOCK);
 }
 libc_hidden_def (__lll_lock_wait)
 
+void
+__lll_lock_wait_mutex (int *futex, int private, void *caller)
+{
+  lll_lock_wait (futex, private, caller, NPTL_LOCK_PROFILE_MUTEX);
+}
+
 void
 __lll_lock_wake_private (int *futex)
 {
@@ -0,0 +1,324 @@
+/* Lock contention profiler.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* With glibc.pthread.lock_profile set, the slow paths of low-level
+   locks, mutexes, rwlocks and condition variables record how long the
+   thread waited, per lock address and calling function.  Only the
+   contended acquisitions are counted, because counting the others
+   would slow down the uncontended paths.
+
+   The records are kept in a fixed-size open addressing table, which
+   is allocated at startup and updated with atomic operations only, so
+   that recording never takes a lock or allocates memory, and so that
+   the table can be dumped from a signal handler.  A record that is
+   claimed is never released.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <_itoa.h>
+#include <atomic.h>
+#include <not-cancel.h>
+#include <nptl-lock-profile.h>
+
+/* Number of records.  Must be a power of two.  */
+#define LOCK_PROFILE_SLOTS 4096
+
+/* Values of the lock field of a record which is not in use.  They are
+   never the address of a lock.  */
+#define LOCK_PROFILE_EMPTY 0
+#define LOCK_PROFILE_BUSY 1
+
+/* The counters wrap around on targets without 64-bit atomics.  */
+#if __HAVE_64B_ATOMICS
+typedef uint64_t lock_profile_counter_t;
+#else
+typedef unsigned long int lock_profile_counter_t;
+#endif
+
+struct lock_profile_record
+{
+  uintptr_t lock;
+  uintptr_t caller;
+  int type;
+  /* Number of contended acquisitions, and the total and the longest
+     time spent waiting for them, in nanoseconds.  */
+  lock_profile_counter_t count;
+  lock_profile_counter_t wait;
+  lock_profile_counter_t max_wait;
+};
+
+int __nptl_lock_profile;
+
+static struct lock_profile_record *lock_profile_table;
+
+/* Number of waits not recorded because the table was full.  */
+static lock_profile_counter_t lock_profile_dropped;
+
+/* The file written at exit, and the process that set it up.  */
+static const char *lock_profile_file;
+static pid_t lock_profile_pid;
+
+static const char *const lock_profile_types[] =
+  {
+    [NPTL_LOCK_PROFILE_LOCK] = "lock",
+    [NPTL_LOCK_PROFILE_MUTEX] = "mutex",
+    [NPTL_LOCK_PROFILE_RWLOCK] = "rwlock",
+    [NPTL_LOCK_PROFILE_COND] = "cond",
+  };
+
+uint64_t
+__nptl_lock_profile_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline size_t
+lock_profile_hash (uintptr_t lock, uintptr_t caller)
+{
+  return (((lock >> 3) ^ (caller >> 2)) * 2654435761U)
+	 & (LOCK_PROFILE_SLOTS - 1);
+}
+
+void
+__nptl_lock_profile_record (void *lock, void *caller, int type,
+			    uint64_t start)
+{
+  lock_profile_counter_t wait = __nptl_lock_profile_now () - start;
+  struct lock_profile_record *table = lock_profile_table;
+  uintptr_t key = (uintptr_t) lock;
+  uintptr_t site = (uintptr_t) caller;
+
+  if (table == NULL)
+    return;
+
+  size_t hash = lock_profile_hash (key, site);
+  for (size_t n = 0; n < LOCK_PROFILE_SLOTS; ++n)
+    {
+      struct lock_profile_record *r
+	= &table[(hash + n) & (LOCK_PROFILE_SLOTS - 1)];
+      uintptr_t cur = atomic_load_acquire (&r->lock);
+
+      /* Claim an empty record.  Acquire MO on failure is provided by
+	 the load in the loop below.  */
+      while (cur == LOCK_PROFILE_EMPTY)
+	if (atomic_compare_exchange_weak_relaxed (&r->lock, &cur,
+						  LOCK_PROFILE_BUSY))
+	  {
+	    r->caller = site;
+	    r->type = type;
+	    atomic_store_release (&r->lock, key);
+	    cur = key;
+	  }
+
+      /* Wait for another thread to fill in the record it claimed.  */
+      while (cur == LOCK_PROFILE_BUSY)
+	{
+	  atomic_spin_nop ();
+	  cur = atomic_load_acquire (&r->lock);
+	}
+
+      if (cur == key && r->caller == site)
+	{
+	  atomic_fetch_add_relaxed (&r->count, 1);
+	  atomic_fetch_add_relaxed (&r->wait, wait);
+	  lock_profile_counter_t max = atomic_load_relaxed (&r->max_wait);
+	  while (wait > max
+		 && !atomic_compare_exchange_weak_relaxed (&r->max_wait,
+							   &max, wait))
+	    ;
+	  return;
+	}
+    }
+
+  atomic_fetch_add_relaxed (&lock_profile_dropped, 1);
+}
+
+/* Buffered output for pthread_lock_profile_dump_np, which must not
+   allocate memory or take locks.  */
+struct lock_profile_writer
+{
+  int fd;
+  bool failed;
+  size_t len;
+  char buf[512];
+};
+
+static void
+lock_profile_flush (struct lock_profile_writer *w)
+{
+  size_t off = 0;
+
+  while (off < w->len && !w->failed)
+    {
+      ssize_t n = __write_nocancel (w->fd, w->buf + off, w->len - off);
+      if (n > 0)
+	off += n;
+      else if (n == 0 || errno != EINTR)
+	w->failed = true;
+    }
+  w->len = 0;
+}
+
+static void
+lock_profile_puts (struct lock_profile_writer *w, const char *s)
+{
+  for (; *s != '\0'; ++s)
+    {
+      if (w->len == sizeof (w->buf))
+	lock_profile_flush (w);
+      w->buf[w->len++] = *s;
+    }
+}
+
+static void
+lock_profile_putnum (struct lock_profile_writer *w,
+		     lock_profile_counter_t value, unsigned int base)
+{
+  char buf[3 * sizeof (value) + 1];
+
+  buf[sizeof (buf) - 1] = '\0';
+  if (sizeof (value) > sizeof (unsigned long int))
+    lock_profile_puts (w, _itoa (value, &buf[sizeof (buf) - 1], base, 0));
+  else
+    lock_profile_puts (w, _itoa_word (value, &buf[sizeof (buf) - 1],
+				      base, 0));
+}
+
+static void
+lock_profile_puthex (struct lock_profile_writer *w, uintptr_t value)
+{
+  lock_profile_puts (w, "\"0x");
+  lock_profile_putnum (w, value, 16);
+  lock_profile_puts (w, "\"");
+}
+
+int
+__pthread_lock_profile_dump_np (int fd)
+{
+  struct lock_profile_writer w = { .fd = fd };
+  struct lock_profile_record *table = lock_profile_table;
+  bool first = true;
+
+  lock_profile_puts (&w, "{\"version\":1,\"dropped\":");
+  lock_profile_putnum (&w, atomic_load_relaxed (&lock_profile_dropped), 10);
+  lock_profile_puts (&w, ",\"locks\":[");
+
+  for (size_t i = 0; table != NULL && i < LOCK_PROFILE_SLOTS; ++i)
+    {
+      struct lock_profile_record *r = &table[i];
+      uintptr_t lock = atomic_load_acquire (&r->lock);
+      if (lock == LOCK_PROFILE_EMPTY || lock == LOCK_PROFILE_BUSY)
+	continue;
+
+      lock_profile_puts (&w, first ? "\n" : ",\n");
+      first = false;
+      lock_profile_puts (&w, "{\"lock\":");
+      lock_profile_puthex (&w, lock);
+      lock_profile_puts (&w, ",\"caller\":");
+      lock_profile_puthex (&w, r->caller);
+      lock_profile_puts (&w, ",\"type\":\"");
+      lock_profile_puts (&w, lock_profile_types[r->type]);
+      lock_profile_puts (&w, "\",\"count\":");
+      lock_profile_putnum (&w, atomic_load_relaxed (&r->count), 10);
+      lock_profile_puts (&w, ",\"wait_ns\":");
+      lock_profile_putnum (&w, atomic_load_relaxed (&r->wait), 10);
+      lock_profile_puts (&w, ",\"max_wait_ns\":");
+      lock_profile_putnum (&w, atomic_load_relaxed (&r->max_wait), 10);
+      lock_profile_puts (&w, "}");
+    }
+
+  lock_profile_puts (&w, "\n]}\n");
+  lock_profile_flush (&w);
+
+  return w.failed ? -1 : 0;
+}
+weak_alias (__pthread_lock_profile_dump_np, pthread_lock_profile_dump_np)
+
+/* Write the profile to glibc.pthread.lock_profile_file, or to standard
+   error if it is not set.  A forked child writes to a file of its own,
+   with its process ID appended to the name.  */
+void
+__nptl_lock_profile_report (void *closure)
+{
+  int fd = STDERR_FILENO;
+
+  if (lock_profile_file != NULL)
+    {
+      char name[256];
+      size_t len = __strnlen (lock_profile_file, sizeof (name) - 16);
+      memcpy (name, lock_profile_file, len);
+      pid_t pid = __getpid ();
+      if (pid != lock_profile_pid)
+	{
+	  char buf[3 * sizeof (pid_t) + 1];
+	  char *p = _itoa_word (pid, &buf[sizeof (buf)], 10, 0);
+	  name[len++] = '.';
+	  memcpy (&name[len], p, &buf[sizeof (buf)] - p);
+	  len += &buf[sizeof (buf)] - p;
+	}
+      name[len] = '\0';
+
+      fd = __open64_nocancel (name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			      0600);
+      if (fd < 0)
+	return;
+    }
+
+  __pthread_lock_profile_dump_np (fd);
+
+  if (fd != STDERR_FILENO)
+    __close_nocancel_nostatus (fd);
+}
+
+void
+__nptl_lock_profile_fork_subprocess (void)
+{
+  /* Only the calling thread runs in the child.  */
+  if (lock_profile_table != NULL)
+    memset (lock_profile_table, 0,
+	    LOCK_PROFILE_SLOTS * sizeof (struct lock_profile_record));
+  lock_profile_dropped = 0;
+}
+
+bool
+__nptl_lock_profile_init (const char *file)
+{
+  size_t size = LOCK_PROFILE_SLOTS * sizeof (struct lock_profile_record);
+  void *table = __mmap (NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (table == MAP_FAILED)
+    {
+      __nptl_lock_profile = 0;
+      return false;
+    }
+  lock_profile_table = table;
+
+  if (file != NULL && file[0] != '\0')
+    lock_profile_file = file;
+  lock_profile_pid = __getpid ();
+  return true;
+}
@@ -0,0 +1,97 @@
+/* Lock contention profiler.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _NPTL_LOCK_PROFILE_H
+#define _NPTL_LOCK_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The kind of wait recorded by the profiler.  */
+enum
+  {
+    /* A low-level lock, or the mutex of a condition variable reacquired
+       after waiting.  */
+    NPTL_LOCK_PROFILE_LOCK,
+    NPTL_LOCK_PROFILE_MUTEX,
+    NPTL_LOCK_PROFILE_RWLOCK,
+    NPTL_LOCK_PROFILE_COND,
+  };
+
+/* Nonzero if glibc.pthread.lock_profile is set.  */
+extern int __nptl_lock_profile attribute_hidden;
+
+/* Set up the profile table.  FILE is the value of
+   glibc.pthread.lock_profile_file.  Called during startup.  Return
+   false if the profiler had to be disabled.  */
+bool __nptl_lock_profile_init (const char *file) attribute_hidden;
+
+/* Write the profile, at exit.  The caller of __nptl_lock_profile_init
+   registers it, so that the lock functions used by the dynamic loader
+   do not pull in atexit.  */
+void __nptl_lock_profile_report (void *closure) attribute_hidden;
+
+/* Clear the profile in a forked child, so that its report only shows
+   its own waits.  */
+void __nptl_lock_profile_fork_subprocess (void) attribute_hidden;
+
+/* Return the current time in nanoseconds.  */
+uint64_t __nptl_lock_profile_now (void) attribute_hidden;
+
+/* Add a wait for LOCK by CALLER since START to the profile.  */
+void __nptl_lock_profile_record (void *lock, void *caller, int type,
+				 uint64_t start) attribute_hidden;
+
+/* Return the time at which the calling thread starts to wait for a
+   lock, or zero if the profiler is disabled.  Only called on slow
+   paths, so the uncontended paths do not pay for the profiler.  The
+   locks of the dynamic loader are not profiled.  */
+static inline uint64_t
+__nptl_lock_profile_start (void)
+{
+#if IS_IN (rtld)
+  return 0;
+#else
+  if (__glibc_likely (__nptl_lock_profile == 0))
+    return 0;
+  return __nptl_lock_profile_now ();
+#endif
+}
+
+/* Start the wait at *START unless it has already been started, for
+   lock algorithms which may block several times before they acquire
+   the lock.  */
+static inline void
+__nptl_lock_profile_start_once (uint64_t *start)
+{
+  if (*start == 0)
+    *start = __nptl_lock_profile_start ();
+}
+
+/* Record the wait started at START, if any, once the lock has been
+   acquired.  */
+static inline void
+__nptl_lock_profile_end (void *lock, void *caller, int type, uint64_t start)
+{
+#if !IS_IN (rtld)
+  if (__glibc_unlikely (start != 0))
+    __nptl_lock_profile_record (lock, caller, type, start);
+#endif
+}
+
+#endif /* nptl-lock-profile.h */
@@ -21,6 +21,7 @@
 #include <pthreadP.h>
 
 size_t __nptl_stack_cache_maxsize = 40 * 1024 * 1024;
+int __nptl_stack_cache_purge = NPTL_STACK_PURGE_LAZY;
 
 void
 __nptl_stack_list_del (list_t *elem)
@@ -52,6 +53,32 @@ __nptl_stack_list_add (list_t *elem, list_t *list)
 }
 libc_hidden_def (__nptl_stack_list_add)
 
+void
+__nptl_stack_cache_remove (struct pthread *pd)
+{
+  list_del (&pd->stack_bucket);
+  __nptl_stack_list_del (&pd->list);
+
+  GL (dl_stack_cache_actsize) -= pd->stackblock_size;
+}
+
+void
+__nptl_stack_cache_rebuild (void)
+{
+  for (size_t i = 0; i < DL_STACK_CACHE_BUCKETS; ++i)
+    INIT_LIST_HEAD (&GL (dl_stack_cache_buckets)[i]);
+
+  /* Walk the cache backwards, so that the buckets keep the order of the
+     cache, most recently used stacks first.  */
+  list_t *entry;
+  list_for_each_prev (entry, &GL (dl_stack_cache))
+    {
+      struct pthread *curr = list_entry (entry, struct pthread, list);
+      list_add (&curr->stack_bucket, &GL (dl_stack_cache_buckets)
+		[__nptl_stack_bucket (curr->stackblock_size)]);
+    }
+}
+
 void
 __nptl_free_stacks (size_t limit)
 {
@@ -68,11 +95,8 @@ __nptl_free_stacks (size_t limit)
       curr = list_entry (entry, struct pthread, list);
       if (__nptl_stack_in_use (curr))
 	{
-	  /* Unlink the block.  */
-	  __nptl_stack_list_del (entry);
-
-	  /* Account for the freed memory.  */
-	  GL (dl_stack_cache_actsize) -= curr->stackblock_size;
+	  /* Unlink the block and account for the freed memory.  */
+	  __nptl_stack_cache_remove (curr);
 
 	  /* Free the memory associated with the ELF TLS.  */
 	  _dl_deallocate_tls (TLS_TPADJ (curr), false);
@@ -99,6 +123,8 @@ queue_stack (struct pthread *stack)
      still be in use but it will not be reused until the kernel marks
      the stack as not used anymore.  */
   __nptl_stack_list_add (&stack->list, &GL (dl_stack_cache));
+  list_add (&stack->stack_bucket, &GL (dl_stack_cache_buckets)
+	    [__nptl_stack_bucket (stack->stackblock_size)]);
 
   GL (dl_stack_cache_actsize) += stack->stackblock_size;
   if (__glibc_unlikely (GL (dl_stack_cache_actsize)
@@ -27,6 +27,41 @@
 /* Maximum size of the cache, in bytes.  40 MiB by default.  */
 extern size_t __nptl_stack_cache_maxsize attribute_hidden;
 
+/* Values of __nptl_stack_cache_purge, which is set by the
+   glibc.pthread.stack_cache_purge tunable.  It selects how the unused
+   part of the stack of an exiting thread is returned to the kernel.  */
+enum
+  {
+    /* Keep the pages.  */
+    NPTL_STACK_PURGE_NONE,
+    /* MADV_FREE: the kernel reclaims the pages under memory pressure
+       only.  */
+    NPTL_STACK_PURGE_LAZY,
+    /* MADV_DONTNEED: the pages are released immediately.  */
+    NPTL_STACK_PURGE_EAGER,
+  };
+extern int __nptl_stack_cache_purge attribute_hidden;
+
+/* The stacks on GL (dl_stack_cache) are also on one of the lists
+   GL (dl_stack_cache_buckets), so that a stack of a given size is found
+   without walking the whole cache.  Bucket 0 holds the stacks smaller
+   than 2^(NPTL_STACK_BUCKET_SHIFT + 1) bytes, each following bucket the
+   stacks up to twice as large, and the last bucket all larger ones.  */
+#define NPTL_STACK_BUCKET_SHIFT 16
+
+/* Return the index of the bucket for stacks of SIZE bytes.  */
+static inline size_t
+__nptl_stack_bucket (size_t size)
+{
+  int log2 = (int) (sizeof (unsigned long long) * 8 - 1)
+	     - __builtin_clzll (size);
+  if (log2 <= NPTL_STACK_BUCKET_SHIFT)
+    return 0;
+  if (log2 - NPTL_STACK_BUCKET_SHIFT >= DL_STACK_CACHE_BUCKETS)
+    return DL_STACK_CACHE_BUCKETS - 1;
+  return log2 - NPTL_STACK_BUCKET_SHIFT;
+}
+
 /* Check whether the stack is still used or not.  */
 static inline bool
 __nptl_stack_in_use (struct pthread *pd)
@@ -50,6 +85,15 @@ libc_hidden_proto (__nptl_deallocate_stack)
 /* Free stacks until cache size is lower than LIMIT.  */
 void __nptl_free_stacks (size_t limit) attribute_hidden;
 
+/* Remove the stack PD from the cache.  Must be called with the cache
+   lock held.  */
+void __nptl_stack_cache_remove (struct pthread *pd) attribute_hidden;
+
+/* Put the stacks on GL (dl_stack_cache) into their buckets again.  Used
+   after fork, when the bucket lists may have been left inconsistent or
+   stacks of other threads were moved to the cache.  */
+void __nptl_stack_cache_rebuild (void) attribute_hidden;
+
 /* Compute the size of the static TLS area based on data from the
    dynamic loader.  */
 static inline size_t
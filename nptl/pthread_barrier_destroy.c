@@ -26,6 +26,12 @@ __pthread_barrier_destroy (pthread_barrier_t *barrier)
 {
   struct pthread_barrier *bar = (struct pthread_barrier *) barrier;
 
+  if (bar->count & BARRIER_COUNT_TREE)
+    {
+      __pthread_barrier_tree_destroy (bar);
+      return 0;
+    }
+
   /* Destroying a barrier is only allowed if no thread is blocked on it.
      Thus, there is no unfinished round, and all modifications to IN will
      have happened before us (either because the calling thread took part
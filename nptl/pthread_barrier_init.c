@@ -23,7 +23,8 @@
 
 static const struct pthread_barrierattr default_barrierattr =
   {
-    .pshared = PTHREAD_PROCESS_PRIVATE
+    .pshared = PTHREAD_PROCESS_PRIVATE,
+    .kind = PTHREAD_BARRIER_DEFAULT_NP
   };
 
 
@@ -58,6 +59,12 @@ ___pthread_barrier_init (pthread_barrier_t *barrier,
   ibarrier->shared = (iattr->pshared == PTHREAD_PROCESS_PRIVATE
 		      ? FUTEX_PRIVATE : FUTEX_SHARED);
 
+  /* The tree is allocated with malloc and cannot be shared with other
+     processes.  Use the default kind instead.  */
+  if (iattr->kind == PTHREAD_BARRIER_TREE_NP
+      && iattr->pshared == PTHREAD_PROCESS_PRIVATE)
+    return __pthread_barrier_tree_init (ibarrier, count);
+
   return 0;
 }
 versioned_symbol (libc, ___pthread_barrier_init, pthread_barrier_init,
@@ -0,0 +1,356 @@
+/* Barriers with a combining tree.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic.h>
+#include <futex-internal.h>
+#include <pthreadP.h>
+
+/* A barrier of kind PTHREAD_BARRIER_TREE_NP is a combining tree of
+   nodes, each in a cache line of its own.  Each node expects a fixed
+   number of arrivals per round: up to FANIN threads for a leaf, and one
+   for each of its children for the other nodes, so that the leaves
+   together expect COUNT threads.  The thread that arrives last at a
+   node goes on to arrive at its parent; the others wait on the node
+   until it is released.  The thread that arrives last at the root
+   completes the round, and releases the nodes it arrived at on its
+   way up.  Each thread that is released in turn releases the nodes it
+   arrived at on its way up, from the top down, so that the threads are
+   woken up along the tree instead of all by one thread.  Waiting
+   threads spin on the word of their node for a while, and then block
+   on it with a futex.
+
+   Threads do not have a fixed leaf.  A thread starts with the leaf of
+   the CPU it runs on, so that threads on nearby CPUs combine first,
+   and takes the next leaf if that one is full.  Because the leaves
+   together expect exactly COUNT threads, every leaf is full once a
+   round is complete.  A thread of the next round that finds all leaves
+   full waits for the oldest one to be released.
+
+   The word of a node holds the number of threads that have arrived in
+   the current round, a flag that is set when threads may be blocked
+   on the futex, and a generation number that is incremented when the
+   node is released.  Releasing a node resets it for the next round in
+   the same store.
+
+   A barrier can be destroyed as soon as its last round is complete,
+   while threads may still access the nodes.  The thread that arrives
+   last at a node subtracts the number of threads expected at it from
+   the OUT counter of the node, and each of these threads increments
+   it when it is done with the node, so pthread_barrier_destroy waits
+   for all OUT counters to be zero.
+
+   The fields of struct pthread_barrier are used as follows:
+
+   in, current_round: The address of the tree, split into the lower and
+     the upper 32 bits.
+   count: The number of threads, with BARRIER_COUNT_TREE set.
+   shared: Always FUTEX_PRIVATE.  The tree is allocated with malloc, so
+     the kind is not available for process-shared barriers.  */
+
+/* Cache lines are 64 bytes on most CPUs.  */
+#define NODE_ALIGN 64
+
+/* Threads that arrive at a leaf.  A larger fan-in makes the tree
+   shallower, but makes more threads write to the same cache line.  */
+#define FANIN 4
+
+/* More than the number of levels of a tree for BARRIER_IN_THRESHOLD
+   threads.  */
+#define MAX_DEPTH 32
+
+/* Number of times a thread checks its node before blocking.  */
+#define SPIN_COUNT 1000
+
+#define NODE_ARRIVED_MASK 0xff
+#define NODE_WAITERS 0x100
+#define NODE_GEN_INC 0x200
+#define NODE_GEN_MASK (~(NODE_GEN_INC - 1))
+
+struct barrier_node
+{
+  unsigned int state;
+  unsigned int out;
+  /* Number of threads that arrive in a round.  */
+  unsigned int expected;
+  /* Index of the parent node, or the index of this node for the
+     root.  */
+  unsigned int parent;
+} __attribute__ ((aligned (NODE_ALIGN)));
+
+struct barrier_tree
+{
+  unsigned int nleaves;
+  unsigned int nnodes;
+  /* The leaves come first, then the levels of the tree above them.  */
+  struct barrier_node node[];
+};
+
+static inline struct barrier_tree *
+get_tree (struct pthread_barrier *bar)
+{
+  uintptr_t p = bar->in;
+  if (sizeof (uintptr_t) > sizeof (unsigned int))
+    p |= ((uintptr_t) bar->current_round << 16) << 16;
+  return (struct barrier_tree *) p;
+}
+
+static inline void
+set_tree (struct pthread_barrier *bar, struct barrier_tree *tree)
+{
+  uintptr_t p = (uintptr_t) tree;
+  bar->in = (unsigned int) p;
+  bar->current_round = 0;
+  if (sizeof (uintptr_t) > sizeof (unsigned int))
+    bar->current_round = (unsigned int) ((p >> 16) >> 16);
+}
+
+int
+__pthread_barrier_tree_init (struct pthread_barrier *bar,
+			     unsigned int count)
+{
+  unsigned int nnodes = 0;
+  for (unsigned int n = count; ; n = (n + FANIN - 1) / FANIN)
+    {
+      nnodes += (n + FANIN - 1) / FANIN;
+      if (n <= FANIN)
+	break;
+    }
+
+  /* The alignment of the nodes gives the header a cache line of its
+     own, which is only read.  */
+  size_t size = (sizeof (struct barrier_tree)
+		 + nnodes * sizeof (struct barrier_node));
+  void *p;
+  if (__posix_memalign (&p, NODE_ALIGN, size) != 0)
+    return ENOMEM;
+  struct barrier_tree *tree = p;
+  memset (tree, 0, size);
+  tree->nleaves = (count + FANIN - 1) / FANIN;
+  tree->nnodes = nnodes;
+
+  /* Build the tree level by level.  The nodes of a level expect FANIN
+     arrivals each, except the last one, which expects the rest.  */
+  unsigned int base = 0;
+  for (unsigned int n = count; ; )
+    {
+      unsigned int width = (n + FANIN - 1) / FANIN;
+      for (unsigned int i = 0; i < width; ++i)
+	{
+	  struct barrier_node *node = &tree->node[base + i];
+	  node->expected = i + 1 < width ? FANIN : n - i * FANIN;
+	  node->parent = width == 1 ? base : base + width + i / FANIN;
+	}
+      if (width == 1)
+	break;
+      base += width;
+      n = width;
+    }
+
+  set_tree (bar, tree);
+  bar->count |= BARRIER_COUNT_TREE;
+  bar->shared = FUTEX_PRIVATE;
+  return 0;
+}
+
+void
+__pthread_barrier_tree_destroy (struct pthread_barrier *bar)
+{
+  struct barrier_tree *tree = get_tree (bar);
+
+  /* Wait until all threads are done with the nodes.  Acquire MO so that
+     freeing the tree happens after their accesses.  */
+  for (unsigned int i = 0; i < tree->nnodes; ++i)
+    {
+      unsigned int *out = &tree->node[i].out;
+      unsigned int val;
+      while ((val = atomic_load_acquire (out)) != 0)
+	futex_wait_simple (out, val, FUTEX_PRIVATE);
+    }
+
+  free (tree);
+  set_tree (bar, NULL);
+}
+
+/* Return true if the generation of node state A is older than the
+   generation of node state B.  */
+static inline bool
+node_older (unsigned int a, unsigned int b)
+{
+  return (int) ((a & NODE_GEN_MASK) - (b & NODE_GEN_MASK)) < 0;
+}
+
+/* Wait until NODE is released from the generation of STATE.  */
+static void
+node_wait (struct barrier_node *node, unsigned int state)
+{
+  unsigned int gen = state & NODE_GEN_MASK;
+
+  for (int i = 0; i < SPIN_COUNT; ++i)
+    {
+      if ((atomic_load_relaxed (&node->state) & NODE_GEN_MASK) != gen)
+	goto released;
+      atomic_spin_nop ();
+    }
+
+  for (;;)
+    {
+      state = atomic_load_relaxed (&node->state);
+      if ((state & NODE_GEN_MASK) != gen)
+	break;
+      if ((state & NODE_WAITERS) == 0)
+	{
+	  if (!atomic_compare_exchange_weak_relaxed (&node->state, &state,
+						     state | NODE_WAITERS))
+	    continue;
+	  state |= NODE_WAITERS;
+	}
+      futex_wait_simple (&node->state, state, FUTEX_PRIVATE);
+    }
+
+ released:
+  /* Synchronize with the release MO in node_release.  */
+  atomic_thread_fence_acquire ();
+}
+
+/* Release the threads that wait on NODE, and reset it for the next
+   round.  Only the thread that arrived last at NODE modifies it until
+   then, so the generation cannot change in between.  */
+static void
+node_release (struct barrier_node *node)
+{
+  unsigned int state = atomic_load_relaxed (&node->state);
+  state = atomic_exchange_release (&node->state,
+				   (state & NODE_GEN_MASK) + NODE_GEN_INC);
+  if ((state & NODE_WAITERS) != 0)
+    futex_wake (&node->state, INT_MAX, FUTEX_PRIVATE);
+}
+
+/* Tell pthread_barrier_destroy that the calling thread is done with
+   NODE.  */
+static void
+node_leave (struct barrier_node *node)
+{
+  if (atomic_fetch_add_release (&node->out, 1) == UINT_MAX)
+    futex_wake (&node->out, 1, FUTEX_PRIVATE);
+}
+
+/* Arrive at a leaf of TREE.  Return the leaf, and store the state of
+   the leaf after our arrival in *STATE.  */
+static struct barrier_node *
+leaf_arrive (struct barrier_tree *tree, unsigned int *state)
+{
+  /* __nptl_runstate_getcpu returns zero if the CPU is not known; spread
+     the threads by their TID then.  */
+  int cpu = __nptl_runstate_getcpu ();
+  unsigned int start = (cpu != 0
+			? (unsigned int) (cpu - 1) / FANIN
+			: (unsigned int) THREAD_GETMEM (THREAD_SELF, tid));
+
+  for (;;)
+    {
+      struct barrier_node *oldest = NULL;
+      unsigned int oldest_state = 0;
+
+      for (unsigned int i = 0; i < tree->nleaves; ++i)
+	{
+	  struct barrier_node *leaf
+	    = &tree->node[(start + i) % tree->nleaves];
+	  unsigned int s = atomic_load_relaxed (&leaf->state);
+	  while ((s & NODE_ARRIVED_MASK) < leaf->expected)
+	    {
+	      /* Release MO so that the threads of the round see our
+		 writes before the barrier, and acquire MO so that we see
+		 theirs once the round is complete.  */
+	      atomic_thread_fence_release ();
+	      if (atomic_compare_exchange_weak_acquire (&leaf->state, &s,
+							s + 1))
+		{
+		  *state = s + 1;
+		  return leaf;
+		}
+	    }
+	  if (oldest == NULL || node_older (s, oldest_state))
+	    {
+	      oldest = leaf;
+	      oldest_state = s;
+	    }
+	}
+
+      /* All leaves are full, so the previous round is not completely
+	 released yet, or more than COUNT threads use the barrier.  The
+	 leaves of the previous round are older than the ones that have
+	 been released and filled again.  */
+      node_wait (oldest, oldest_state);
+    }
+}
+
+int
+__pthread_barrier_tree_wait (struct pthread_barrier *bar)
+{
+  struct barrier_tree *tree = get_tree (bar);
+  unsigned int path[MAX_DEPTH];
+  unsigned int depth = 0;
+  int result = 0;
+
+  unsigned int state;
+  struct barrier_node *node = leaf_arrive (tree, &state);
+
+  /* Go up the tree as long as we are the last to arrive.  */
+  while ((state & NODE_ARRIVED_MASK) == node->expected)
+    {
+      unsigned int idx = node - tree->node;
+      atomic_fetch_add_relaxed (&node->out, -node->expected);
+      path[depth++] = idx;
+
+      if (node->parent == idx)
+	{
+	  /* We completed the round.  */
+	  result = PTHREAD_BARRIER_SERIAL_THREAD;
+	  node = NULL;
+	  break;
+	}
+
+      /* No thread of the next round can arrive at the parent before it
+	 has been released, so there is no need to check its count.  See
+	 leaf_arrive for the MO.  */
+      node = &tree->node[node->parent];
+      state = atomic_fetch_add_acq_rel (&node->state, 1) + 1;
+    }
+
+  if (node != NULL)
+    {
+      node_wait (node, state);
+      node_leave (node);
+    }
+
+  /* Release the nodes we arrived at last, from the top down.  */
+  while (depth > 0)
+    {
+      node = &tree->node[path[--depth]];
+      node_release (node);
+      node_leave (node);
+    }
+
+  return result;
+}
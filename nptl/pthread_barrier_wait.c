@@ -99,6 +99,9 @@ ___pthread_barrier_wait (pthread_barrier_t *barrier)
   /* How many threads entered so far, including ourself.  */
   unsigned int i;
 
+  if (bar->count & BARRIER_COUNT_TREE)
+    return __pthread_barrier_tree_wait (bar);
+
  reset_restart:
   /* Try to enter the barrier.  We need acquire MO to (1) ensure that if we
      observe that our round can be completed (see below for our attempt to do
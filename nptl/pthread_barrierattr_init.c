@@ -26,6 +26,7 @@ __pthread_barrierattr_init (pthread_barrierattr_t *attr)
 				struct pthread_barrierattr);
 
   ((struct pthread_barrierattr *) attr)->pshared = PTHREAD_PROCESS_PRIVATE;
+  ((struct pthread_barrierattr *) attr)->kind = PTHREAD_BARRIER_DEFAULT_NP;
 
   return 0;
 }
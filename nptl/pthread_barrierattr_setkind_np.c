@@ -0,0 +1,32 @@
+/* pthread_barrierattr_setkind_np -- set the kind of a barrier attribute.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include "pthreadP.h"
+
+int
+__pthread_barrierattr_setkind_np (pthread_barrierattr_t *attr, int kind)
+{
+  if (kind != PTHREAD_BARRIER_DEFAULT_NP && kind != PTHREAD_BARRIER_TREE_NP)
+    return EINVAL;
+
+  ((struct pthread_barrierattr *) attr)->kind = kind;
+
+  return 0;
+}
+weak_alias (__pthread_barrierattr_setkind_np, pthread_barrierattr_setkind_np)
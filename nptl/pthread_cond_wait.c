@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <sysdep.h>
 #include <futex-internal.h>
+#include <nptl-lock-profile.h>
 #include <pthread.h>
 #include <pthreadP.h>
 #include <sys/time.h>
@@ -377,11 +378,13 @@ __condvar_cleanup_waiting (void *arg)
 */
 static __always_inline int
 __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
-    clockid_t clockid, const struct __timespec64 *abstime)
+    clockid_t clockid, const struct __timespec64 *abstime, void *caller)
 {
   const int maxspin = 0;
   int err;
   int result = 0;
+  /* When the thread first blocked, for the lock profiler.  */
+  uint64_t wait_start = 0;
 
   LIBC_PROBE (cond_wait, 2, cond, mutex);
 
@@ -500,6 +503,8 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 	  cbuffer.private = private;
 	  __pthread_cleanup_push (&buffer, __condvar_cleanup_waiting, &cbuffer);
 
+	  if (wait_start == 0)
+	    wait_start = __nptl_lock_profile_start ();
 	  err = __futex_abstimed_wait_cancelable64 (
 	    cond->__data.__g_signals + g, 0, clockid, abstime, private);
 
@@ -597,6 +602,11 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
 
  done:
 
+  /* Timed-out waits are not contention.  */
+  if (result == 0)
+    __nptl_lock_profile_end (cond, caller, NPTL_LOCK_PROFILE_COND,
+			     wait_start);
+
   /* Confirm that we have been woken.  We do that before acquiring the mutex
      to allow for execution of pthread_cond_destroy while having acquired the
      mutex.  */
@@ -615,7 +625,8 @@ int
 ___pthread_cond_wait (pthread_cond_t *cond, pthread_mutex_t *mutex)
 {
   /* clockid is unused when abstime is NULL. */
-  return __pthread_cond_wait_common (cond, mutex, 0, NULL);
+  return __pthread_cond_wait_common (cond, mutex, 0, NULL,
+				     __builtin_return_address (0));
 }
 
 versioned_symbol (libc, ___pthread_cond_wait, pthread_cond_wait,
@@ -625,10 +636,12 @@ libc_hidden_ver (___pthread_cond_wait, __pthread_cond_wait)
 strong_alias (___pthread_cond_wait, __pthread_cond_wait)
 #endif
 
-/* See __pthread_cond_wait_common.  */
-int
-___pthread_cond_timedwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
-			     const struct __timespec64 *abstime)
+/* The lock profiler attributes the waits to CALLER, the caller of
+   pthread_cond_timedwait.  */
+static __always_inline int
+__pthread_cond_timedwait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
+				 const struct __timespec64 *abstime,
+				 void *caller)
 {
   /* Check parameter validity.  This should also tell the compiler that
      it can assume that abstime is not NULL.  */
@@ -640,7 +653,16 @@ ___pthread_cond_timedwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
   unsigned int flags = atomic_load_relaxed (&cond->__data.__wrefs);
   clockid_t clockid = (flags & __PTHREAD_COND_CLOCK_MONOTONIC_MASK)
                     ? CLOCK_MONOTONIC : CLOCK_REALTIME;
-  return __pthread_cond_wait_common (cond, mutex, clockid, abstime);
+  return __pthread_cond_wait_common (cond, mutex, clockid, abstime, caller);
+}
+
+/* See __pthread_cond_wait_common.  */
+int
+___pthread_cond_timedwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
+			     const struct __timespec64 *abstime)
+{
+  return __pthread_cond_timedwait_common (cond, mutex, abstime,
+					  __builtin_return_address (0));
 }
 
 #if __TIMESIZE == 64
@@ -655,7 +677,8 @@ ___pthread_cond_timedwait (pthread_cond_t *cond, pthread_mutex_t *mutex,
 {
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return __pthread_cond_timedwait64 (cond, mutex, &ts64);
+  return __pthread_cond_timedwait_common (cond, mutex, &ts64,
+					  __builtin_return_address (0));
 }
 #endif /* __TIMESIZE == 64 */
 versioned_symbol (libc, ___pthread_cond_timedwait,
@@ -665,11 +688,13 @@ libc_hidden_ver (___pthread_cond_timedwait, __pthread_cond_timedwait)
 strong_alias (___pthread_cond_timedwait, __pthread_cond_timedwait)
 #endif
 
-/* See __pthread_cond_wait_common.  */
-int
-___pthread_cond_clockwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
-			      clockid_t clockid,
-			      const struct __timespec64 *abstime)
+/* The lock profiler attributes the waits to CALLER, the caller of
+   pthread_cond_clockwait.  */
+static __always_inline int
+__pthread_cond_clockwait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
+				 clockid_t clockid,
+				 const struct __timespec64 *abstime,
+				 void *caller)
 {
   /* Check parameter validity.  This should also tell the compiler that
      it can assume that abstime is not NULL.  */
@@ -679,7 +704,17 @@ ___pthread_cond_clockwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
   if (!futex_abstimed_supported_clockid (clockid))
     return EINVAL;
 
-  return __pthread_cond_wait_common (cond, mutex, clockid, abstime);
+  return __pthread_cond_wait_common (cond, mutex, clockid, abstime, caller);
+}
+
+/* See __pthread_cond_wait_common.  */
+int
+___pthread_cond_clockwait64 (pthread_cond_t *cond, pthread_mutex_t *mutex,
+			      clockid_t clockid,
+			      const struct __timespec64 *abstime)
+{
+  return __pthread_cond_clockwait_common (cond, mutex, clockid, abstime,
+					  __builtin_return_address (0));
 }
 
 #if __TIMESIZE == 64
@@ -695,7 +730,8 @@ ___pthread_cond_clockwait (pthread_cond_t *cond, pthread_mutex_t *mutex,
 {
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return __pthread_cond_clockwait64 (cond, mutex, clockid, &ts64);
+  return __pthread_cond_clockwait_common (cond, mutex, clockid, &ts64,
+					  __builtin_return_address (0));
 }
 #endif /* __TIMESIZE == 64 */
 libc_hidden_ver (___pthread_cond_clockwait, __pthread_cond_clockwait)
@@ -457,6 +457,9 @@ start_thread (void *arg)
   /* Clean up any state libc stored in thread-local variables.  */
   __libc_thread_freeres ();
 
+  /* Give up the slot for queued spinlocks.  */
+  call_function_static_weak (__nptl_spin_queue_release, pd);
+
   /* Report the death of the thread if this is wanted.  */
   if (__glibc_unlikely (pd->report_events))
     {
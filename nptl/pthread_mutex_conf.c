@@ -21,9 +21,11 @@
 #include <pthread_mutex_conf.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <unistd.h>  /* Get STDOUT_FILENO for _dl_printf.  */
 #include <elf/dl-tunables.h>
 #include <nptl-stack.h>
+#include <nptl-lock-profile.h>
 
 struct mutex_config __mutex_aconf =
 {
@@ -45,6 +47,18 @@ TUNABLE_CALLBACK (set_stack_cache_size) (tunable_val_t *valp)
   __nptl_stack_cache_maxsize = valp->numval;
 }
 
+static void
+TUNABLE_CALLBACK (set_stack_cache_purge) (tunable_val_t *valp)
+{
+  __nptl_stack_cache_purge = (int32_t) valp->numval;
+}
+
+static void
+TUNABLE_CALLBACK (set_lock_profile) (tunable_val_t *valp)
+{
+  __nptl_lock_profile = (int32_t) valp->numval;
+}
+
 void
 __pthread_tunables_init (void)
 {
@@ -52,5 +66,13 @@ __pthread_tunables_init (void)
                TUNABLE_CALLBACK (set_mutex_spin_count));
   TUNABLE_GET (stack_cache_size, size_t,
                TUNABLE_CALLBACK (set_stack_cache_size));
+  TUNABLE_GET (stack_cache_purge, int32_t,
+               TUNABLE_CALLBACK (set_stack_cache_purge));
+  TUNABLE_GET (lock_profile, int32_t,
+               TUNABLE_CALLBACK (set_lock_profile));
+  if (__nptl_lock_profile
+      && __nptl_lock_profile_init (TUNABLE_GET (lock_profile_file,
+						const char *, NULL)))
+    __cxa_atexit (__nptl_lock_profile_report, NULL, NULL);
 }
 #endif
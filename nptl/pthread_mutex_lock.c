@@ -24,15 +24,27 @@
 #include "pthreadP.h"
 #include <atomic.h>
 #include <futex-internal.h>
+#include <nptl-lock-profile.h>
 #include <stap-probe.h>
 #include <shlib-compat.h>
 
 /* Some of the following definitions differ when pthread_mutex_cond_lock.c
    includes this file.  */
 #ifndef LLL_MUTEX_LOCK
+/* lll_lock, except that the lock profiler attributes the time spent
+   waiting for a contended mutex to CALLER, the caller of
+   pthread_mutex_lock, and not to pthread_mutex_lock itself.  */
+static __always_inline void
+lll_mutex_lock (pthread_mutex_t *mutex, void *caller)
+{
+  int *futex = &mutex->__data.__lock;
+  if (__glibc_unlikely (atomic_compare_and_exchange_bool_acq (futex, 1, 0)))
+    __lll_lock_wait_mutex (futex, PTHREAD_MUTEX_PSHARED (mutex), caller);
+}
+
 /* lll_lock with single-thread optimization.  */
-static inline void
-lll_mutex_lock_optimized (pthread_mutex_t *mutex)
+static __always_inline void
+lll_mutex_lock_optimized (pthread_mutex_t *mutex, void *caller)
 {
   /* The single-threaded optimization is only valid for private
      mutexes.  For process-shared mutexes, the mutex could be in a
@@ -45,12 +57,13 @@ lll_mutex_lock_optimized (pthread_mutex_t *mutex)
   if (private == LLL_PRIVATE && SINGLE_THREAD_P && mutex->__data.__lock == 0)
     mutex->__data.__lock = 1;
   else
-    lll_lock (mutex->__data.__lock, private);
+    lll_mutex_lock (mutex, caller);
 }
 
 # define LLL_MUTEX_LOCK(mutex)						\
-  lll_lock ((mutex)->__data.__lock, PTHREAD_MUTEX_PSHARED (mutex))
-# define LLL_MUTEX_LOCK_OPTIMIZED(mutex) lll_mutex_lock_optimized (mutex)
+  lll_mutex_lock (mutex, __builtin_return_address (0))
+# define LLL_MUTEX_LOCK_OPTIMIZED(mutex)				\
+  lll_mutex_lock_optimized (mutex, __builtin_return_address (0))
 # define LLL_MUTEX_TRYLOCK(mutex) \
   lll_trylock ((mutex)->__data.__lock)
 # define LLL_ROBUST_MUTEX_LOCK_MODIFIER 0
@@ -69,7 +82,7 @@ lll_mutex_lock_optimized (pthread_mutex_t *mutex)
   atomic_load_relaxed (&(mutex)->__data.__lock)
 #endif
 
-static int __pthread_mutex_lock_full (pthread_mutex_t *mutex)
+static int __pthread_mutex_lock_full (pthread_mutex_t *mutex, void *caller)
      __attribute_noinline__;
 
 int
@@ -83,7 +96,7 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 
   if (__builtin_expect (type & ~(PTHREAD_MUTEX_KIND_MASK_NP
 				 | PTHREAD_MUTEX_ELISION_FLAGS_NP), 0))
-    return __pthread_mutex_lock_full (mutex);
+    return __pthread_mutex_lock_full (mutex, __builtin_return_address (0));
 
   if (__glibc_likely (type == PTHREAD_MUTEX_TIMED_NP))
     {
@@ -153,6 +166,16 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 		  LLL_MUTEX_LOCK (mutex);
 		  break;
 		}
+	      if (__nptl_mutex_owner_off_cpu (mutex))
+		{
+		  /* The owner cannot release the mutex before it runs
+		     again, so go to the wait queue at once.  This says
+		     nothing about how long the mutex is usually held, so
+		     leave the average spin count alone.  */
+		  cnt = mutex->__data.__spins;
+		  LLL_MUTEX_LOCK (mutex);
+		  break;
+		}
 	      do
 		atomic_spin_nop ();
 	      while (--spin_count > 0);
@@ -165,6 +188,7 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 	  mutex->__data.__spins += (cnt - mutex->__data.__spins) / 8;
 	}
       assert (mutex->__data.__owner == 0);
+      __nptl_runstate_acquired (THREAD_GETMEM (THREAD_SELF, tid));
     }
   else
     {
@@ -190,10 +214,11 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 }
 
 static int
-__pthread_mutex_lock_full (pthread_mutex_t *mutex)
+__pthread_mutex_lock_full (pthread_mutex_t *mutex, void *caller)
 {
   int oldval;
   pid_t id = THREAD_GETMEM (THREAD_SELF, tid);
+  uint64_t wait_start = 0;
 
   switch (PTHREAD_MUTEX_TYPE (mutex))
     {
@@ -332,6 +357,7 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
 	  assume_other_futex_waiters |= FUTEX_WAITERS;
 
 	  /* Block using the futex and reload current lock value.  */
+	  __nptl_lock_profile_start_once (&wait_start);
 	  futex_wait ((unsigned int *) &mutex->__data.__lock, oldval,
 		      PTHREAD_ROBUST_MUTEX_PSHARED (mutex));
 	  oldval = mutex->__data.__lock;
@@ -438,6 +464,7 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
 	    int private = (robust
 			   ? PTHREAD_ROBUST_MUTEX_PSHARED (mutex)
 			   : PTHREAD_MUTEX_PSHARED (mutex));
+	    wait_start = __nptl_lock_profile_start ();
 	    int e = __futex_lock_pi64 (&mutex->__data.__lock, 0 /* ununsed  */,
 				       NULL, private);
 	    if (e == ESRCH || e == EDEADLK)
@@ -594,9 +621,12 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
 		  break;
 
 		if (oldval != ceilval)
-		  futex_wait ((unsigned int * ) &mutex->__data.__lock,
-			      ceilval | 2,
-			      PTHREAD_MUTEX_PSHARED (mutex));
+		  {
+		    __nptl_lock_profile_start_once (&wait_start);
+		    futex_wait ((unsigned int * ) &mutex->__data.__lock,
+				ceilval | 2,
+				PTHREAD_MUTEX_PSHARED (mutex));
+		  }
 	      }
 	    while (atomic_compare_and_exchange_val_acq (&mutex->__data.__lock,
 							ceilval | 2, ceilval)
@@ -622,6 +652,8 @@ __pthread_mutex_lock_full (pthread_mutex_t *mutex)
 
   LIBC_PROBE (mutex_acquired, 1, mutex);
 
+  __nptl_lock_profile_end (mutex, caller, NPTL_LOCK_PROFILE_MUTEX,
+			   wait_start);
   return 0;
 }
 
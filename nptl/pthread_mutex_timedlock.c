@@ -25,17 +25,35 @@
 #include <lowlevellock.h>
 #include <not-cancel.h>
 #include <futex-internal.h>
+#include <nptl-lock-profile.h>
 
 #include <stap-probe.h>
 
+/* __futex_clocklock64 on the lock of MUTEX, which starts the wait for
+   the lock profiler at *WAIT_START if the mutex is contended.  */
+static __always_inline int
+mutex_clocklock (pthread_mutex_t *mutex, clockid_t clockid,
+		 const struct __timespec64 *abstime, uint64_t *wait_start)
+{
+  if (__glibc_likely (lll_trylock (mutex->__data.__lock) == 0))
+    return 0;
+  *wait_start = __nptl_lock_profile_start ();
+  return __futex_clocklock64 (&mutex->__data.__lock, clockid, abstime,
+			      PTHREAD_MUTEX_PSHARED (mutex));
+}
+
+/* The lock profiler attributes the waits to CALLER, the caller of
+   pthread_mutex_clocklock or pthread_mutex_timedlock.  */
 int
 __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 				  clockid_t clockid,
-				  const struct __timespec64 *abstime)
+				  const struct __timespec64 *abstime,
+				  void *caller)
 {
   int oldval;
   pid_t id = THREAD_GETMEM (THREAD_SELF, tid);
   int result = 0;
+  uint64_t wait_start = 0;
 
   /* We must not check ABSTIME here.  If the thread does not block
      abstime must not be checked for a valid value.  */
@@ -62,8 +80,7 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 	}
 
       /* We have to get the mutex.  */
-      result = __futex_clocklock64 (&mutex->__data.__lock, clockid, abstime,
-                                    PTHREAD_MUTEX_PSHARED (mutex));
+      result = mutex_clocklock (mutex, clockid, abstime, &wait_start);
 
       if (result != 0)
 	goto out;
@@ -85,8 +102,7 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
       FORCE_ELISION (mutex, goto elision);
     simple:
       /* Normal mutex.  */
-      result = __futex_clocklock64 (&mutex->__data.__lock, clockid, abstime,
-                                    PTHREAD_MUTEX_PSHARED (mutex));
+      result = mutex_clocklock (mutex, clockid, abstime, &wait_start);
       break;
 
     case PTHREAD_MUTEX_TIMED_ELISION_NP:
@@ -108,9 +124,16 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 	    {
 	      if (cnt++ >= max_cnt)
 		{
-		  result = __futex_clocklock64 (&mutex->__data.__lock,
-		                                clockid, abstime,
-		                                PTHREAD_MUTEX_PSHARED (mutex));
+		  result = mutex_clocklock (mutex, clockid, abstime,
+					    &wait_start);
+		  break;
+		}
+	      if (__nptl_mutex_owner_off_cpu (mutex))
+		{
+		  /* See __pthread_mutex_lock.  */
+		  cnt = mutex->__data.__spins;
+		  result = mutex_clocklock (mutex, clockid, abstime,
+					    &wait_start);
 		  break;
 		}
 	      atomic_spin_nop ();
@@ -119,6 +142,8 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 
 	  mutex->__data.__spins += (cnt - mutex->__data.__spins) / 8;
 	}
+      if (result == 0)
+	__nptl_runstate_acquired (id);
       break;
 
     case PTHREAD_MUTEX_ROBUST_RECURSIVE_NP:
@@ -250,6 +275,7 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 	  assume_other_futex_waiters |= FUTEX_WAITERS;
 
 	  /* Block using the futex.  */
+	  __nptl_lock_profile_start_once (&wait_start);
 	  int err = __futex_abstimed_wait64 (
 	      (unsigned int *) &mutex->__data.__lock,
 	      oldval, clockid, abstime,
@@ -361,6 +387,7 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 	    int private = (robust
 			   ? PTHREAD_ROBUST_MUTEX_PSHARED (mutex)
 			   : PTHREAD_MUTEX_PSHARED (mutex));
+	    wait_start = __nptl_lock_profile_start ();
 	    int e = __futex_lock_pi64 (&mutex->__data.__lock, clockid, abstime,
 				       private);
 	    if (e == ETIMEDOUT)
@@ -526,6 +553,7 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 			goto failpp;
 		      }
 
+		    __nptl_lock_profile_start_once (&wait_start);
 		    int e = __futex_abstimed_wait64 (
 		      (unsigned int *) &mutex->__data.__lock, ceilval | 2,
 		      clockid, abstime, PTHREAD_MUTEX_PSHARED (mutex));
@@ -556,6 +584,9 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
       ++mutex->__data.__nusers;
 
       LIBC_PROBE (mutex_timedlock_acquired, 1, mutex);
+
+      __nptl_lock_profile_end (mutex, caller, NPTL_LOCK_PROFILE_MUTEX,
+			       wait_start);
     }
 
  out:
@@ -571,7 +602,8 @@ ___pthread_mutex_clocklock64 (pthread_mutex_t *mutex,
     return EINVAL;
 
   LIBC_PROBE (mutex_clocklock_entry, 3, mutex, clockid, abstime);
-  return __pthread_mutex_clocklock_common (mutex, clockid, abstime);
+  return __pthread_mutex_clocklock_common (mutex, clockid, abstime,
+					   __builtin_return_address (0));
 }
 
 #if __TIMESIZE == 64
@@ -585,9 +617,14 @@ ___pthread_mutex_clocklock (pthread_mutex_t *mutex,
 			    clockid_t clockid,
 			    const struct timespec *abstime)
 {
+  if (__glibc_unlikely (!futex_abstimed_supported_clockid (clockid)))
+    return EINVAL;
+
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return ___pthread_mutex_clocklock64 (mutex, clockid, &ts64);
+  LIBC_PROBE (mutex_clocklock_entry, 3, mutex, clockid, &ts64);
+  return __pthread_mutex_clocklock_common (mutex, clockid, &ts64,
+					   __builtin_return_address (0));
 }
 #endif /* __TIMESPEC64 != 64 */
 libc_hidden_ver (___pthread_mutex_clocklock, __pthread_mutex_clocklock)
@@ -606,7 +643,8 @@ ___pthread_mutex_timedlock64 (pthread_mutex_t *mutex,
 			     const struct __timespec64 *abstime)
 {
   LIBC_PROBE (mutex_timedlock_entry, 2, mutex, abstime);
-  return __pthread_mutex_clocklock_common (mutex, CLOCK_REALTIME, abstime);
+  return __pthread_mutex_clocklock_common (mutex, CLOCK_REALTIME, abstime,
+					   __builtin_return_address (0));
 }
 
 #if __TIMESIZE == 64
@@ -621,7 +659,9 @@ ___pthread_mutex_timedlock (pthread_mutex_t *mutex,
 {
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return __pthread_mutex_timedlock64 (mutex, &ts64);
+  LIBC_PROBE (mutex_timedlock_entry, 2, mutex, &ts64);
+  return __pthread_mutex_clocklock_common (mutex, CLOCK_REALTIME, &ts64,
+					   __builtin_return_address (0));
 }
 #endif /* __TIMESPEC64 != 64 */
 versioned_symbol (libc, ___pthread_mutex_timedlock,
@@ -40,7 +40,9 @@ ___pthread_rwlock_clockrdlock (pthread_rwlock_t *rwlock, clockid_t clockid,
 {
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return __pthread_rwlock_clockrdlock64 (rwlock, clockid, &ts64);
+  /* Call the implementation directly, so that the lock profiler
+     attributes the waits to our caller.  */
+  return __pthread_rwlock_rdlock_full64 (rwlock, clockid, &ts64);
 }
 #endif /* __TIMESPEC64 != 64 */
 versioned_symbol (libc, ___pthread_rwlock_clockrdlock,
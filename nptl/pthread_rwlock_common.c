@@ -24,6 +24,7 @@
 #include <stap-probe.h>
 #include <atomic.h>
 #include <futex-internal.h>
+#include <nptl-lock-profile.h>
 #include <time.h>
 
 
@@ -282,6 +283,8 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
                                 const struct __timespec64 *abstime)
 {
   unsigned int r;
+  /* When the thread first blocked, for the lock profiler.  */
+  uint64_t wait_start = 0;
 
   /* Make sure any passed in clockid and timeout value are valid.  Note that
      the previous implementation assumed that this check *must* not be
@@ -299,6 +302,10 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 			== THREAD_GETMEM (THREAD_SELF, tid)))
     return EDEADLK;
 
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    return __pthread_rwlock_percpu_rdlock (rwlock, clockid, abstime, false,
+					   __builtin_return_address (0));
+
   /* If we prefer writers, recursive rdlock is disallowed, we are in a read
      phase, and there are other readers present, we try to wait without
      extending the read phase.  We will be unblocked by either one of the
@@ -329,6 +336,8 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 		      & PTHREAD_RWLOCK_RWAITING) != 0)
 		{
 		  int private = __pthread_rwlock_get_private (rwlock);
+		  if (wait_start == 0)
+		    wait_start = __nptl_lock_profile_start ();
 		  int err = __futex_abstimed_wait64 (&rwlock->__data.__readers,
 		                                     r, clockid, abstime,
 		                                     private);
@@ -388,7 +397,11 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      this seems to be a corner case and handling it specially not be worth the
      complexity.  */
   if (__glibc_likely ((r & PTHREAD_RWLOCK_WRPHASE) == 0))
-    return 0;
+    {
+      __nptl_lock_profile_end (rwlock, __builtin_return_address (0),
+			       NPTL_LOCK_PROFILE_RWLOCK, wait_start);
+      return 0;
+    }
   /* Otherwise, if we were in a write phase (states #6 or #8), we must wait
      for explicit hand-over of the read phase; the only exception is if we
      can start a read phase if there is no primary writer currently.  */
@@ -416,6 +429,8 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 	      int private = __pthread_rwlock_get_private (rwlock);
 	      futex_wake (&rwlock->__data.__wrphase_futex, INT_MAX, private);
 	    }
+	  __nptl_lock_profile_end (rwlock, __builtin_return_address (0),
+				   NPTL_LOCK_PROFILE_RWLOCK, wait_start);
 	  return 0;
 	}
       else
@@ -457,6 +472,8 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 		  (&rwlock->__data.__wrphase_futex,
 		   &wpf, wpf | PTHREAD_RWLOCK_FUTEX_USED)))
 	    continue;
+	  if (wait_start == 0)
+	    wait_start = __nptl_lock_profile_start ();
 	  int err = __futex_abstimed_wait64 (&rwlock->__data.__wrphase_futex,
 					     1 | PTHREAD_RWLOCK_FUTEX_USED,
 					     clockid, abstime, private);
@@ -519,6 +536,8 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 	ready = true;
     }
 
+  __nptl_lock_profile_end (rwlock, __builtin_return_address (0),
+			   NPTL_LOCK_PROFILE_RWLOCK, wait_start);
   return 0;
 }
 
@@ -604,6 +623,10 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 			== THREAD_GETMEM (THREAD_SELF, tid)))
     return EDEADLK;
 
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    return __pthread_rwlock_percpu_wrlock (rwlock, clockid, abstime, false,
+					   __builtin_return_address (0));
+
   /* First we try to acquire the role of primary writer by setting WRLOCKED;
      if it was set before, there already is a primary writer.  Acquire MO so
      that we synchronize with previous primary writers.
@@ -619,6 +642,8 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
      We could try to CAS from a state with no readers to a write phase, but
      this could be less scalable if readers arrive and leave frequently.  */
   bool may_share_futex_used_flag = false;
+  /* When the thread first blocked, for the lock profiler.  */
+  uint64_t wait_start = 0;
   unsigned int r = atomic_fetch_or_acquire (&rwlock->__data.__readers,
 					    PTHREAD_RWLOCK_WRLOCKED);
   if (__glibc_unlikely ((r & PTHREAD_RWLOCK_WRLOCKED) != 0))
@@ -727,6 +752,8 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 	     share the flag, and another writer will wake one of the writers
 	     in this group.  */
 	  may_share_futex_used_flag = true;
+	  if (wait_start == 0)
+	    wait_start = __nptl_lock_profile_start ();
 	  int err = __futex_abstimed_wait64 (&rwlock->__data.__writers_futex,
 					     1 | PTHREAD_RWLOCK_FUTEX_USED,
 					     clockid, abstime, private);
@@ -826,6 +853,8 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 		  (&rwlock->__data.__wrphase_futex, &wpf,
 		   PTHREAD_RWLOCK_FUTEX_USED)))
 	    continue;
+	  if (wait_start == 0)
+	    wait_start = __nptl_lock_profile_start ();
 	  int err = __futex_abstimed_wait64 (&rwlock->__data.__wrphase_futex,
 					     PTHREAD_RWLOCK_FUTEX_USED,
 					     clockid, abstime, private);
@@ -946,5 +975,7 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
  done:
   atomic_store_relaxed (&rwlock->__data.__cur_writer,
 			THREAD_GETMEM (THREAD_SELF, tid));
+  __nptl_lock_profile_end (rwlock, __builtin_return_address (0),
+			   NPTL_LOCK_PROFILE_RWLOCK, wait_start);
   return 0;
 }
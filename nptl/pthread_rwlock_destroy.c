@@ -24,7 +24,9 @@ ___pthread_rwlock_destroy (pthread_rwlock_t *rwlock)
 {
   LIBC_PROBE (rwlock_destroy, 1, rwlock);
 
-  /* Nothing to be done.  For now.  */
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    __pthread_rwlock_percpu_destroy (rwlock);
+
   return 0;
 }
 versioned_symbol (libc, ___pthread_rwlock_destroy, pthread_rwlock_destroy,
@@ -52,6 +52,16 @@ ___pthread_rwlock_init (pthread_rwlock_t *rwlock,
   /* The value of __SHARED in a private rwlock must be zero.  */
   rwlock->__data.__shared = (iattr->pshared != PTHREAD_PROCESS_PRIVATE);
 
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    {
+      /* The reader counters cannot be shared with other processes.  Use
+	 the kind that is closest to it instead.  */
+      if (rwlock->__data.__shared)
+	rwlock->__data.__flags = PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP;
+      else
+	return __pthread_rwlock_percpu_init (rwlock);
+    }
+
   return 0;
 }
 versioned_symbol (libc, ___pthread_rwlock_init, pthread_rwlock_init,
@@ -0,0 +1,319 @@
+/* Rwlocks with per-CPU reader counters.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <atomic.h>
+#include <futex-internal.h>
+#include <libc-pointer-arith.h>
+#include <nptl-lock-profile.h>
+#include <pthreadP.h>
+
+/* A rwlock of kind PTHREAD_RWLOCK_PERCPU_READER_NP counts its readers in
+   an array of counters, one per CPU, each in a cache line of its own.  A
+   reader increments the counter of the CPU it runs on, as read from its
+   rseq area, and decrements the counter of the CPU it runs on when it
+   releases the lock, which may be a different one; only the sum of the
+   counters is meaningful.  As long as there are no writers, readers
+   thus never write to a cache line shared with readers on other CPUs.
+   Without rseq, readers use the counter selected by their TID instead,
+   which spreads them as well, but not by CPU.
+
+   A writer first acquires a lock that excludes other writers, then sets
+   a flag that makes new readers back off and wait, and then waits until
+   the sum of the counters is zero.  The reader increments its counter
+   before it checks the flag, and the writer sets the flag before it
+   reads the counters, with a full fence in between on both sides, so
+   either the reader sees the flag or the writer sees the increment.
+   Readers therefore cannot starve writers, but a read lock must not be
+   acquired recursively: a writer that arrives in between waits for the
+   outer read lock, and the inner one waits for the writer.
+
+   The fields of struct __pthread_rwlock_arch_t are used as follows:
+
+   __pad3, __pad4: The address of the counters, split into the lower and
+     the upper 32 bits.
+   __writers: A lock with the same protocol as lll_lock, which excludes
+     other writers.
+   __writers_futex: The flag, 1 if there is a writer, and 2 if readers
+     may be blocked waiting for it.
+   __wrphase_futex: A sequence number incremented by a reader that
+     releases the lock while the writer waits for the readers.
+   __readers: 1 if the writer may be blocked on __wrphase_futex.
+   __cur_writer: The TID of the writer that holds the lock.
+
+   The counters are allocated with malloc, so the kind is not available
+   for process-shared rwlocks.  */
+
+/* Cache lines are 64 bytes on most CPUs.  A larger value would only
+   make the array larger.  */
+#define COUNTER_ALIGN 64
+
+/* More CPUs share counters.  */
+#define MAX_COUNTERS 256
+
+struct percpu_counter
+{
+  unsigned int readers;
+} __attribute__ ((aligned (COUNTER_ALIGN)));
+
+struct percpu_counters
+{
+  unsigned int count;
+  /* The block returned by malloc.  */
+  void *block;
+  struct percpu_counter counter[];
+};
+
+/* Number of counters of new rwlocks, or zero if not yet known.  */
+static unsigned int ncounters;
+
+static inline struct percpu_counters *
+get_counters (pthread_rwlock_t *rwlock)
+{
+  uintptr_t p = rwlock->__data.__pad3;
+  if (sizeof (uintptr_t) > sizeof (unsigned int))
+    p |= ((uintptr_t) rwlock->__data.__pad4 << 16) << 16;
+  return (struct percpu_counters *) p;
+}
+
+static inline void
+set_counters (pthread_rwlock_t *rwlock, struct percpu_counters *c)
+{
+  uintptr_t p = (uintptr_t) c;
+  rwlock->__data.__pad3 = (unsigned int) p;
+  if (sizeof (uintptr_t) > sizeof (unsigned int))
+    rwlock->__data.__pad4 = (unsigned int) ((p >> 16) >> 16);
+}
+
+/* Return the counter of the CPU the calling thread runs on.  */
+static inline unsigned int *
+cpu_counter (struct percpu_counters *c)
+{
+  /* __nptl_runstate_getcpu returns zero if the CPU is not known, for
+     example if rseq is disabled; spread the threads by their TID then,
+     so that they do not all share one counter.  Only the sum of the
+     counters matters, so a reader may release the lock on another
+     counter than the one it acquired it on.  */
+  int cpu = __nptl_runstate_getcpu ();
+  unsigned int idx = (cpu != 0
+		      ? (unsigned int) cpu - 1
+		      : (unsigned int) THREAD_GETMEM (THREAD_SELF, tid));
+  return &c->counter[idx % c->count].readers;
+}
+
+static unsigned int
+sum_readers (struct percpu_counters *c)
+{
+  unsigned int sum = 0;
+  for (unsigned int i = 0; i < c->count; ++i)
+    sum += atomic_load_relaxed (&c->counter[i].readers);
+  return sum;
+}
+
+int
+__pthread_rwlock_percpu_init (pthread_rwlock_t *rwlock)
+{
+  unsigned int count = atomic_load_relaxed (&ncounters);
+  if (count == 0)
+    {
+      int n = __get_nprocs_conf ();
+      count = n <= 0 ? 1 : n > MAX_COUNTERS ? MAX_COUNTERS : n;
+      atomic_store_relaxed (&ncounters, count);
+    }
+
+  /* The alignment of the counters gives the header a cache line of its
+     own, which is only read.  The array is aligned by hand, since a
+     malloc replacement need not provide posix_memalign.  */
+  size_t size = (sizeof (struct percpu_counters)
+		 + count * sizeof (struct percpu_counter));
+  void *block = malloc (size + COUNTER_ALIGN - 1);
+  if (block == NULL)
+    return ENOMEM;
+  struct percpu_counters *c = PTR_ALIGN_UP (block, COUNTER_ALIGN);
+  memset (c, 0, size);
+  c->count = count;
+  c->block = block;
+  set_counters (rwlock, c);
+  return 0;
+}
+
+void
+__pthread_rwlock_percpu_destroy (pthread_rwlock_t *rwlock)
+{
+  struct percpu_counters *c = get_counters (rwlock);
+  if (c != NULL)
+    free (c->block);
+  set_counters (rwlock, NULL);
+}
+
+/* Release a read lock, or back off, by decrementing READERS.  Wake up
+   the writer if it waits for the readers.  */
+static void
+reader_leave (pthread_rwlock_t *rwlock, unsigned int *readers)
+{
+  /* Release MO so that the writer that sees the decrement synchronizes
+     with the critical section of the reader.  */
+  atomic_fetch_add_release (readers, -1);
+  /* See __pthread_rwlock_percpu_wrlock.  */
+  atomic_thread_fence_seq_cst ();
+  if (atomic_load_relaxed (&rwlock->__data.__readers) != 0
+      && atomic_exchange_relaxed (&rwlock->__data.__readers, 0) != 0)
+    {
+      /* Release MO so that the writer that sees the new sequence number
+	 also sees our decrement.  */
+      atomic_fetch_add_release (&rwlock->__data.__wrphase_futex, 1);
+      futex_wake (&rwlock->__data.__wrphase_futex, 1, FUTEX_PRIVATE);
+    }
+}
+
+/* Clear the writer flag and wake up blocked readers, then let the next
+   writer in.  */
+static void
+writer_leave (pthread_rwlock_t *rwlock)
+{
+  atomic_store_relaxed (&rwlock->__data.__readers, 0);
+  /* Release MO so that readers synchronize with the critical section of
+     the writer.  */
+  if (atomic_exchange_release (&rwlock->__data.__writers_futex, 0) == 2)
+    futex_wake (&rwlock->__data.__writers_futex, INT_MAX, FUTEX_PRIVATE);
+  lll_unlock (*(int *) &rwlock->__data.__writers, LLL_PRIVATE);
+}
+
+int
+__pthread_rwlock_percpu_rdlock (pthread_rwlock_t *rwlock, clockid_t clockid,
+				const struct __timespec64 *abstime, bool try,
+				void *caller)
+{
+  struct percpu_counters *c = get_counters (rwlock);
+  uint64_t wait_start = 0;
+  for (;;)
+    {
+      unsigned int *readers = cpu_counter (c);
+      atomic_fetch_add_relaxed (readers, 1);
+      /* Either the writer sees the increment, or we see its flag.  */
+      atomic_thread_fence_seq_cst ();
+      if (atomic_load_relaxed (&rwlock->__data.__writers_futex) == 0)
+	{
+	  /* Synchronize with the release of the previous writer.  */
+	  atomic_thread_fence_acquire ();
+	  __nptl_lock_profile_end (rwlock, caller, NPTL_LOCK_PROFILE_RWLOCK,
+				   wait_start);
+	  return 0;
+	}
+
+      /* There is a writer.  Back off so that it does not wait for us,
+	 and wait until it has released the lock.  */
+      reader_leave (rwlock, readers);
+      if (try)
+	return EBUSY;
+      unsigned int w = atomic_load_relaxed (&rwlock->__data.__writers_futex);
+      while (w != 0)
+	{
+	  if (w == 1
+	      && !atomic_compare_exchange_weak_relaxed
+		   (&rwlock->__data.__writers_futex, &w, 2))
+	    continue;
+	  __nptl_lock_profile_start_once (&wait_start);
+	  int err = __futex_abstimed_wait64 (&rwlock->__data.__writers_futex,
+					     2, clockid, abstime,
+					     FUTEX_PRIVATE);
+	  if (err == ETIMEDOUT || err == EOVERFLOW)
+	    return err;
+	  w = atomic_load_relaxed (&rwlock->__data.__writers_futex);
+	}
+    }
+}
+
+int
+__pthread_rwlock_percpu_wrlock (pthread_rwlock_t *rwlock, clockid_t clockid,
+				const struct __timespec64 *abstime, bool try,
+				void *caller)
+{
+  struct percpu_counters *c = get_counters (rwlock);
+  int err = 0;
+  uint64_t wait_start = 0;
+
+  if (lll_trylock (*(int *) &rwlock->__data.__writers) != 0)
+    {
+      if (try)
+	return EBUSY;
+      wait_start = __nptl_lock_profile_start ();
+      err = __futex_clocklock64 ((int *) &rwlock->__data.__writers,
+				 clockid, abstime, FUTEX_PRIVATE);
+      if (err != 0)
+	return err;
+    }
+
+  /* Make new readers back off.  Either they see the flag, or we see
+     their increments when we read the counters below.  */
+  atomic_store_relaxed (&rwlock->__data.__writers_futex, 1);
+  atomic_thread_fence_seq_cst ();
+  while (sum_readers (c) != 0)
+    {
+      if (try)
+	{
+	  err = EBUSY;
+	  goto fail;
+	}
+      /* Ask the readers to wake us up.  A reader that decremented its
+	 counter after we read it sees the request, and increments the
+	 sequence number before it wakes us up.  If we see the new
+	 sequence number, we also see the decrement.  */
+      atomic_store_relaxed (&rwlock->__data.__readers, 1);
+      atomic_thread_fence_seq_cst ();
+      unsigned int seq = atomic_load_acquire (&rwlock->__data.__wrphase_futex);
+      if (sum_readers (c) == 0)
+	break;
+      __nptl_lock_profile_start_once (&wait_start);
+      err = __futex_abstimed_wait64 (&rwlock->__data.__wrphase_futex, seq,
+				     clockid, abstime, FUTEX_PRIVATE);
+      if (err == ETIMEDOUT || err == EOVERFLOW)
+	goto fail;
+    }
+  atomic_store_relaxed (&rwlock->__data.__readers, 0);
+  /* Synchronize with the release of the counters by the readers.  */
+  atomic_thread_fence_acquire ();
+
+  atomic_store_relaxed (&rwlock->__data.__cur_writer,
+			THREAD_GETMEM (THREAD_SELF, tid));
+  __nptl_lock_profile_end (rwlock, caller, NPTL_LOCK_PROFILE_RWLOCK,
+			   wait_start);
+  return 0;
+
+ fail:
+  writer_leave (rwlock);
+  return err;
+}
+
+void
+__pthread_rwlock_percpu_unlock (pthread_rwlock_t *rwlock)
+{
+  /* See __pthread_rwlock_unlock.  */
+  if (atomic_load_relaxed (&rwlock->__data.__cur_writer)
+      == THREAD_GETMEM (THREAD_SELF, tid))
+    {
+      atomic_store_relaxed (&rwlock->__data.__cur_writer, 0);
+      writer_leave (rwlock);
+    }
+  else
+    reader_leave (rwlock, cpu_counter (get_counters (rwlock)));
+}
@@ -38,7 +38,9 @@ ___pthread_rwlock_timedwrlock (pthread_rwlock_t *rwlock,
 {
   struct __timespec64 ts64 = valid_timespec_to_timespec64 (*abstime);
 
-  return __pthread_rwlock_timedwrlock64 (rwlock, &ts64);
+  /* Call the implementation directly, so that the lock profiler
+     attributes the waits to our caller.  */
+  return __pthread_rwlock_wrlock_full64 (rwlock, CLOCK_REALTIME, &ts64);
 }
 #endif /* __TIMESPEC64 != 64 */
 versioned_symbol (libc, ___pthread_rwlock_timedwrlock,
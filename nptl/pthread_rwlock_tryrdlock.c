@@ -26,6 +26,9 @@
 int
 ___pthread_rwlock_tryrdlock (pthread_rwlock_t *rwlock)
 {
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    return __pthread_rwlock_percpu_rdlock (rwlock, 0, NULL, true, NULL);
+
   /* For tryrdlock, we could speculate that we will succeed and go ahead and
      register as a reader.  However, if we misspeculate, we have to do the
      same steps as a timed-out rdlock, which will increase contention.
@@ -24,6 +24,9 @@
 int
 ___pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
 {
+  if (rwlock->__data.__flags == PTHREAD_RWLOCK_PERCPU_READER_NP)
+    return __pthread_rwlock_percpu_wrlock (rwlock, 0, NULL, true, NULL);
+
   /* When in a trywrlock, we can acquire the write lock if it is in states
      #1 (idle and read phase) and #5 (idle and write phase), and also in #6
      (readers waiting, write phase) if we prefer writers.
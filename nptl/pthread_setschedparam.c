@@ -68,4 +68,5 @@ __pthread_setschedparam (pthread_t threadid, int policy,
 
   return result;
 }
+libc_hidden_def (__pthread_setschedparam)
 strong_alias (__pthread_setschedparam, pthread_setschedparam)
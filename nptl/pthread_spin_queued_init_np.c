@@ -0,0 +1,33 @@
+/* pthread_spin_queued_init_np -- initialize a queued spin lock.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <atomic.h>
+#include "pthreadP.h"
+
+int
+__pthread_spin_queued_init_np (pthread_spinlock_t *lock, int pshared)
+{
+  /* The slots of the queue are only valid in this process.  */
+  int val = (pshared == PTHREAD_PROCESS_PRIVATE
+	     ? 0 : PTHREAD_SPIN_QUEUED_SHARED);
+
+  /* Relaxed MO is fine because this is an initializing store.  */
+  atomic_store_relaxed (lock, val);
+  return 0;
+}
+weak_alias (__pthread_spin_queued_init_np, pthread_spin_queued_init_np)
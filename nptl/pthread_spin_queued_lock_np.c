@@ -0,0 +1,175 @@
+/* pthread_spin_queued_lock_np -- lock a queued spin lock.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <atomic.h>
+#include "pthreadP.h"
+
+/* Queued spinlocks are MCS locks squeezed into the int of
+   pthread_spinlock_t, in the way of the qspinlock of Linux.  The lock
+   word holds the slot of the last thread in the queue instead of a
+   pointer to its queue node, and the queue nodes are in the thread
+   descriptors.  Each waiting thread but the first one spins on its own
+   SPIN_QWAIT flag until its predecessor sets it; only the first thread
+   in the queue spins on the lock word, waiting for the owner to clear
+   the locked bit.  A lock that is not locked and has no waiters is
+   acquired by setting the locked bit, as usual.
+
+   A thread that cannot get a slot, or waits for a process-shared lock,
+   spins on the locked bit without queueing and competes with the first
+   thread in the queue.  Threads in the queue still get the lock in
+   order.
+
+   A thread is in at most one queue at a time, which requires that the
+   lock is not acquired in signal handlers, like other spinlocks.  */
+
+#define TAIL_MASK (~0U << PTHREAD_SPIN_QUEUED_TAIL_SHIFT)
+
+struct pthread *__nptl_spin_queue[NPTL_SPIN_QUEUE_SLOTS];
+
+/* Return the slot of SELF, allocating one if needed, or
+   NPTL_SPIN_QUEUE_NOSLOT if all slots are in use.  */
+static unsigned int
+get_slot (struct pthread *self)
+{
+  unsigned int slot = self->spin_qslot;
+  if (__glibc_likely (slot != 0))
+    return slot;
+
+  /* Start at a different index in every thread, so that threads do not
+     compete for the same slots.  The slot is published to other threads
+     with release MO when the thread enters a queue.  */
+  unsigned int start = THREAD_GETMEM (self, tid);
+  for (unsigned int i = 0; i < NPTL_SPIN_QUEUE_SLOTS; ++i)
+    {
+      unsigned int idx = (start + i) % NPTL_SPIN_QUEUE_SLOTS;
+      struct pthread *expected = NULL;
+      if (atomic_load_relaxed (&__nptl_spin_queue[idx]) == NULL
+	  && atomic_compare_exchange_weak_relaxed (&__nptl_spin_queue[idx],
+						   &expected, self))
+	{
+	  self->spin_qslot = idx + 1;
+	  return idx + 1;
+	}
+    }
+
+  self->spin_qslot = NPTL_SPIN_QUEUE_NOSLOT;
+  return NPTL_SPIN_QUEUE_NOSLOT;
+}
+
+void
+__nptl_spin_queue_release (struct pthread *pd)
+{
+  unsigned int slot = pd->spin_qslot;
+  if (slot != 0 && slot != NPTL_SPIN_QUEUE_NOSLOT)
+    atomic_store_relaxed (&__nptl_spin_queue[slot - 1], NULL);
+  pd->spin_qslot = 0;
+}
+
+void
+__nptl_spin_queue_fork_subprocess (void)
+{
+  struct pthread *self = THREAD_SELF;
+  for (unsigned int i = 0; i < NPTL_SPIN_QUEUE_SLOTS; ++i)
+    if (__nptl_spin_queue[i] != NULL && __nptl_spin_queue[i] != self)
+      __nptl_spin_queue_release (__nptl_spin_queue[i]);
+}
+
+int
+__pthread_spin_queued_lock_np (pthread_spinlock_t *lock)
+{
+  /* Acquire MO to synchronize-with the release MO in
+     pthread_spin_queued_unlock_np, as in pthread_spin_lock.  */
+  int val = 0;
+  if (__glibc_likely (atomic_compare_exchange_weak_acquire
+		      (lock, &val, PTHREAD_SPIN_QUEUED_LOCKED)))
+    return 0;
+
+  struct pthread *self = THREAD_SELF;
+  unsigned int slot;
+  if ((val & PTHREAD_SPIN_QUEUED_SHARED) != 0
+      || (slot = get_slot (self)) == NPTL_SPIN_QUEUE_NOSLOT)
+    {
+      do
+	{
+	  while ((val & PTHREAD_SPIN_QUEUED_LOCKED) != 0)
+	    {
+	      atomic_spin_nop ();
+	      val = atomic_load_relaxed (lock);
+	    }
+	}
+      while (!atomic_compare_exchange_weak_acquire
+	     (lock, &val, val | PTHREAD_SPIN_QUEUED_LOCKED));
+      return 0;
+    }
+
+  /* Enter the queue.  Release MO so that a successor that reads our
+     slot from the lock word sees our node initialized.  */
+  atomic_store_relaxed (&self->spin_qnext, 0);
+  atomic_store_relaxed (&self->spin_qwait, 0);
+  int tail = slot << PTHREAD_SPIN_QUEUED_TAIL_SHIFT;
+  val = atomic_load_relaxed (lock);
+  while (!atomic_compare_exchange_weak_release
+	 (lock, &val, (val & ~TAIL_MASK) | tail))
+    ;
+  /* Synchronize with the predecessor that published its slot.  */
+  atomic_thread_fence_acquire ();
+
+  unsigned int prev = (unsigned int) val >> PTHREAD_SPIN_QUEUED_TAIL_SHIFT;
+  if (prev != 0)
+    {
+      /* Link ourselves to the predecessor, and wait until it is our
+	 turn.  Release MO so that the predecessor does not set our flag
+	 before we have cleared it.  */
+      struct pthread *p = __nptl_spin_queue[prev - 1];
+      atomic_store_release (&p->spin_qnext, slot);
+      while (atomic_load_acquire (&self->spin_qwait) == 0)
+	atomic_spin_nop ();
+    }
+
+  /* We are the first in the queue.  Wait for the owner to release the
+     lock, and take it.  If we are also the last in the queue, empty
+     the queue at the same time.  */
+  val = atomic_load_relaxed (lock);
+  for (;;)
+    {
+      if ((val & PTHREAD_SPIN_QUEUED_LOCKED) != 0)
+	{
+	  atomic_spin_nop ();
+	  val = atomic_load_relaxed (lock);
+	  continue;
+	}
+      if ((val & TAIL_MASK) == tail)
+	{
+	  if (atomic_compare_exchange_weak_acquire
+	      (lock, &val, PTHREAD_SPIN_QUEUED_LOCKED))
+	    return 0;
+	}
+      else if (atomic_compare_exchange_weak_acquire
+	       (lock, &val, val | PTHREAD_SPIN_QUEUED_LOCKED))
+	break;
+    }
+
+  /* There are other threads in the queue.  Wait until the next one has
+     linked itself to us, and make it the first in the queue.  */
+  unsigned int next;
+  while ((next = atomic_load_acquire (&self->spin_qnext)) == 0)
+    atomic_spin_nop ();
+  atomic_store_release (&__nptl_spin_queue[next - 1]->spin_qwait, 1);
+  return 0;
+}
+weak_alias (__pthread_spin_queued_lock_np, pthread_spin_queued_lock_np)
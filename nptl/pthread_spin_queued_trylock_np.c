@@ -0,0 +1,35 @@
+/* pthread_spin_queued_trylock_np -- trylock a queued spin lock.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <atomic.h>
+#include "pthreadP.h"
+
+int
+__pthread_spin_queued_trylock_np (pthread_spinlock_t *lock)
+{
+  /* Do not overtake queued threads, as pthread_spin_queued_lock_np does
+     not either.  Retry only if the CAS fails spuriously.  */
+  int val = atomic_load_relaxed (lock);
+  while ((val & ~PTHREAD_SPIN_QUEUED_SHARED) == 0)
+    if (atomic_compare_exchange_weak_acquire
+	(lock, &val, val | PTHREAD_SPIN_QUEUED_LOCKED))
+      return 0;
+  return EBUSY;
+}
+weak_alias (__pthread_spin_queued_trylock_np, pthread_spin_queued_trylock_np)
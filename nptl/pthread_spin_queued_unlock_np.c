@@ -0,0 +1,30 @@
+/* pthread_spin_queued_unlock_np -- unlock a queued spin lock.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <atomic.h>
+#include "pthreadP.h"
+
+int
+__pthread_spin_queued_unlock_np (pthread_spinlock_t *lock)
+{
+  /* Release MO to synchronize-with the acquisition of the lock.  The
+     other bits belong to the queue.  */
+  atomic_fetch_and_release (lock, ~PTHREAD_SPIN_QUEUED_LOCKED);
+  return 0;
+}
+weak_alias (__pthread_spin_queued_unlock_np, pthread_spin_queued_unlock_np)
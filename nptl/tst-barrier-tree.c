@@ -0,0 +1,117 @@
+/* Test barriers of kind PTHREAD_BARRIER_TREE_NP.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum { max_threads = 40 };
+enum { nrounds = 50 };
+
+static pthread_barrierattr_t attr;
+static pthread_barrier_t barriers[2];
+static unsigned int nthreads;
+
+/* The round each thread has reached.  */
+static unsigned int rounds[max_threads];
+static unsigned int serials;
+
+static void *
+thread_func (void *closure)
+{
+  uintptr_t id = (uintptr_t) closure;
+  for (unsigned int r = 1; r <= nrounds; ++r)
+    {
+      __atomic_store_n (&rounds[id], r, __ATOMIC_RELAXED);
+      pthread_barrier_t *barrier = &barriers[r % 2];
+      int ret = pthread_barrier_wait (barrier);
+
+      /* All threads have arrived in this round.  */
+      for (unsigned int i = 0; i < nthreads; ++i)
+	TEST_VERIFY (__atomic_load_n (&rounds[i], __ATOMIC_RELAXED) >= r);
+
+      /* The serial thread can destroy the barrier as soon as it has
+	 returned, while the other threads may still be leaving it.  They
+	 do not use it again before the serial thread has arrived at the
+	 other barrier.  */
+      if (ret == PTHREAD_BARRIER_SERIAL_THREAD)
+	{
+	  ++serials;
+	  xpthread_barrier_destroy (barrier);
+	  xpthread_barrier_init (barrier, &attr, nthreads);
+	}
+      else
+	TEST_COMPARE (ret, 0);
+    }
+  return NULL;
+}
+
+static void
+run_threads (unsigned int n)
+{
+  pthread_t threads[max_threads];
+
+  nthreads = n;
+  serials = 0;
+  for (unsigned int i = 0; i < n; ++i)
+    rounds[i] = 0;
+  xpthread_barrier_init (&barriers[0], &attr, n);
+  xpthread_barrier_init (&barriers[1], &attr, n);
+  for (uintptr_t i = 0; i < n; ++i)
+    threads[i] = xpthread_create (NULL, thread_func, (void *) i);
+  for (unsigned int i = 0; i < n; ++i)
+    xpthread_join (threads[i]);
+  xpthread_barrier_destroy (&barriers[0]);
+  xpthread_barrier_destroy (&barriers[1]);
+  TEST_COMPARE (serials, nrounds);
+}
+
+static int
+do_test (void)
+{
+  int kind;
+
+  xpthread_barrierattr_init (&attr);
+  TEST_COMPARE (pthread_barrierattr_getkind_np (&attr, &kind), 0);
+  TEST_COMPARE (kind, PTHREAD_BARRIER_DEFAULT_NP);
+  TEST_COMPARE (pthread_barrierattr_setkind_np (&attr, -1), EINVAL);
+  TEST_COMPARE (pthread_barrierattr_setkind_np (&attr,
+						PTHREAD_BARRIER_TREE_NP), 0);
+  TEST_COMPARE (pthread_barrierattr_getkind_np (&attr, &kind), 0);
+  TEST_COMPARE (kind, PTHREAD_BARRIER_TREE_NP);
+
+  /* Trees with a single node, full and partial leaves, and several
+     levels.  */
+  static const unsigned int counts[] = { 1, 2, 4, 5, 16, 17, 39 };
+  for (int i = 0; i < array_length (counts); ++i)
+    run_threads (counts[i]);
+
+  /* A process-shared barrier of this kind works, if not with a
+     tree.  */
+  xpthread_barrierattr_setpshared (&attr, PTHREAD_PROCESS_SHARED);
+  run_threads (5);
+
+  xpthread_barrierattr_destroy (&attr);
+  return 0;
+}
+
+#include <support/test-driver.c>
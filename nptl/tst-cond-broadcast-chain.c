@@ -0,0 +1,148 @@
+/* Test that pthread_cond_broadcast wakes all waiters across group switches.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <support/check.h>
+#include <support/timespec.h>
+#include <support/xtime.h>
+#include <support/xthread.h>
+
+enum { nwaiters = 24 };
+enum { nrounds = 200 };
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t main_cond = PTHREAD_COND_INITIALIZER;
+
+/* Incremented by each broadcast.  */
+static unsigned int generation;
+/* Number of waiters that have seen the current generation.  */
+static unsigned int seen;
+/* Set when the test is done.  */
+static bool stop;
+static bool pinger_stop;
+
+static void *
+waiter (void *closure)
+{
+  /* Every other waiter uses a timed wait with a timeout that does not
+     expire.  */
+  bool timed = (uintptr_t) closure % 2 != 0;
+  unsigned int gen = 0;
+
+  xpthread_mutex_lock (&mutex);
+  while (!stop)
+    {
+      while (generation == gen && !stop)
+	{
+	  if (timed)
+	    {
+	      struct timespec ts = timespec_add (xclock_now (CLOCK_MONOTONIC),
+						 make_timespec (3600, 0));
+	      TEST_COMPARE (pthread_cond_clockwait (&cond, &mutex,
+						    CLOCK_MONOTONIC, &ts), 0);
+	    }
+	  else
+	    xpthread_cond_wait (&cond, &mutex);
+	}
+      gen = generation;
+      if (++seen == nwaiters)
+	xpthread_cond_signal (&main_cond);
+    }
+  xpthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+/* Send signals while holding the mutex, so that groups are switched while
+   the waiters of a broadcast are still waking up.  */
+static void *
+pinger (void *closure)
+{
+  for (;;)
+    {
+      xpthread_mutex_lock (&mutex);
+      bool done = pinger_stop;
+      xpthread_cond_signal (&cond);
+      xpthread_mutex_unlock (&mutex);
+      if (done)
+	break;
+      sched_yield ();
+    }
+  return NULL;
+}
+
+static void
+run_rounds (bool with_pinger)
+{
+  pthread_t threads[nwaiters];
+  pthread_t ping_thread = 0;
+
+  generation = 0;
+  stop = false;
+  pinger_stop = false;
+  for (uintptr_t i = 0; i < nwaiters; ++i)
+    threads[i] = xpthread_create (NULL, waiter, (void *) i);
+  if (with_pinger)
+    ping_thread = xpthread_create (NULL, pinger, NULL);
+
+  for (unsigned int r = 0; r < nrounds; ++r)
+    {
+      xpthread_mutex_lock (&mutex);
+      seen = 0;
+      ++generation;
+      /* Broadcast with and without holding the mutex.  */
+      if (r % 2 == 0)
+	TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+      else
+	{
+	  xpthread_mutex_unlock (&mutex);
+	  TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+	  xpthread_mutex_lock (&mutex);
+	}
+      while (seen < nwaiters)
+	xpthread_cond_wait (&main_cond, &mutex);
+      xpthread_mutex_unlock (&mutex);
+    }
+
+  xpthread_mutex_lock (&mutex);
+  stop = true;
+  pinger_stop = true;
+  TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+  xpthread_mutex_unlock (&mutex);
+
+  for (unsigned int i = 0; i < nwaiters; ++i)
+    xpthread_join (threads[i]);
+  if (with_pinger)
+    xpthread_join (ping_thread);
+}
+
+static int
+do_test (void)
+{
+  run_rounds (false);
+  run_rounds (true);
+  return 0;
+}
+
+#include <support/test-driver.c>
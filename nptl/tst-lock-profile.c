@@ -0,0 +1,253 @@
+/* Test the lock contention profiler.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/process_state.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/timespec.h>
+#include <support/xthread.h>
+#include <support/xtime.h>
+#include <support/xunistd.h>
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t cond_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool cond_flag;
+static pthread_mutex_t robust_mutex;
+static pthread_rwlock_t percpu_rwlock;
+static pthread_cond_t timeout_cond = PTHREAD_COND_INITIALIZER;
+
+static volatile pid_t thread_tid;
+
+static void *
+mutex_func (void *closure)
+{
+  thread_tid = gettid ();
+  xpthread_mutex_lock (&mutex);
+  xpthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+static void *
+rwlock_func (void *closure)
+{
+  thread_tid = gettid ();
+  xpthread_rwlock_rdlock (&rwlock);
+  xpthread_rwlock_unlock (&rwlock);
+  return NULL;
+}
+
+static void *
+robust_func (void *closure)
+{
+  thread_tid = gettid ();
+  struct timespec ts = timespec_add (xclock_now (CLOCK_REALTIME),
+				     make_timespec (3600, 0));
+  TEST_COMPARE (pthread_mutex_timedlock (&robust_mutex, &ts), 0);
+  xpthread_mutex_unlock (&robust_mutex);
+  return NULL;
+}
+
+static void *
+percpu_func (void *closure)
+{
+  thread_tid = gettid ();
+  xpthread_rwlock_rdlock (&percpu_rwlock);
+  xpthread_rwlock_unlock (&percpu_rwlock);
+  return NULL;
+}
+
+static void *
+cond_func (void *closure)
+{
+  xpthread_mutex_lock (&cond_mutex);
+  thread_tid = gettid ();
+  while (!cond_flag)
+    xpthread_cond_wait (&cond, &cond_mutex);
+  xpthread_mutex_unlock (&cond_mutex);
+  return NULL;
+}
+
+/* Start a thread running FUNC and wait until it blocks.  */
+static pthread_t
+start_blocked (void *(*func) (void *))
+{
+  thread_tid = 0;
+  pthread_t thr = xpthread_create (NULL, func, NULL);
+  while (thread_tid == 0)
+    usleep (1000);
+  support_process_state_wait (thread_tid, support_process_state_sleeping);
+  return thr;
+}
+
+/* Check that the profile in BUF has a record of TYPE for LOCK.  */
+static void
+check_record (const char *buf, void *lock, const char *type)
+{
+  char *key = xasprintf ("{\"lock\":\"%p\"", lock);
+  char *expected = xasprintf ("\"type\":\"%s\"", type);
+  const char *p = strstr (buf, key);
+  if (p == NULL)
+    {
+      support_record_failure ();
+      printf ("error: no record for %s %p\n", type, lock);
+    }
+  else
+    {
+      const char *end = strchr (p, '}');
+      TEST_VERIFY (end != NULL);
+      p = strstr (p, expected);
+      TEST_VERIFY (p != NULL && p < end);
+    }
+  free (expected);
+  free (key);
+}
+
+/* Check that the profile in BUF has no record for LOCK.  */
+static void
+check_no_record (const char *buf, void *lock)
+{
+  char *key = xasprintf ("{\"lock\":\"%p\"", lock);
+  if (strstr (buf, key) != NULL)
+    {
+      support_record_failure ();
+      printf ("error: unexpected record for %p\n", lock);
+    }
+  free (key);
+}
+
+static int
+do_test (void)
+{
+  support_need_proc ("needs /proc to check thread state");
+
+  pthread_mutexattr_t mattr;
+  xpthread_mutexattr_init (&mattr);
+  xpthread_mutexattr_setrobust (&mattr, PTHREAD_MUTEX_ROBUST);
+  xpthread_mutex_init (&robust_mutex, &mattr);
+  xpthread_mutexattr_destroy (&mattr);
+
+  pthread_rwlockattr_t rwattr;
+  xpthread_rwlockattr_init (&rwattr);
+  xpthread_rwlockattr_setkind_np (&rwattr, PTHREAD_RWLOCK_PERCPU_READER_NP);
+  xpthread_rwlock_init (&percpu_rwlock, &rwattr);
+  pthread_rwlockattr_destroy (&rwattr);
+
+  xpthread_mutex_lock (&mutex);
+  pthread_t thr = start_blocked (mutex_func);
+  xpthread_mutex_unlock (&mutex);
+  xpthread_join (thr);
+
+  xpthread_rwlock_wrlock (&rwlock);
+  thr = start_blocked (rwlock_func);
+  xpthread_rwlock_unlock (&rwlock);
+  xpthread_join (thr);
+
+  /* The full mutex path, through pthread_mutex_timedlock.  */
+  xpthread_mutex_lock (&robust_mutex);
+  thr = start_blocked (robust_func);
+  xpthread_mutex_unlock (&robust_mutex);
+  xpthread_join (thr);
+
+  xpthread_rwlock_wrlock (&percpu_rwlock);
+  thr = start_blocked (percpu_func);
+  xpthread_rwlock_unlock (&percpu_rwlock);
+  xpthread_join (thr);
+
+  /* A wait that times out is not recorded.  */
+  struct timespec ts = timespec_add (xclock_now (CLOCK_REALTIME),
+				     make_timespec (0, 10000000));
+  xpthread_mutex_lock (&cond_mutex);
+  TEST_COMPARE (pthread_cond_timedwait (&timeout_cond, &cond_mutex, &ts),
+		ETIMEDOUT);
+  xpthread_mutex_unlock (&cond_mutex);
+
+  thr = start_blocked (cond_func);
+  xpthread_mutex_lock (&cond_mutex);
+  cond_flag = true;
+  xpthread_cond_signal (&cond);
+  xpthread_mutex_unlock (&cond_mutex);
+  xpthread_join (thr);
+
+  char *name;
+  int fd = create_temp_file ("tst-lock-profile", &name);
+  TEST_VERIFY_EXIT (fd >= 0);
+  TEST_COMPARE (pthread_lock_profile_dump_np (fd), 0);
+
+  static char buf[65536];
+  xlseek (fd, 0, SEEK_SET);
+  ssize_t len = read (fd, buf, sizeof (buf) - 1);
+  TEST_VERIFY_EXIT (len > 0);
+  buf[len] = '\0';
+  printf ("%s", buf);
+
+  TEST_VERIFY (strncmp (buf, "{\"version\":1,", 13) == 0);
+  check_record (buf, &mutex, "mutex");
+  check_record (buf, &rwlock, "rwlock");
+  check_record (buf, &cond, "cond");
+  check_record (buf, &robust_mutex, "mutex");
+  check_record (buf, &percpu_rwlock, "rwlock");
+  check_no_record (buf, &timeout_cond);
+
+  /* Writing to a bad descriptor fails.  */
+  TEST_COMPARE (pthread_lock_profile_dump_np (-1), -1);
+
+  /* A forked child starts with an empty profile.  */
+  int fds[2];
+  xpipe (fds);
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      xclose (fds[0]);
+      TEST_COMPARE (pthread_lock_profile_dump_np (fds[1]), 0);
+      _exit (0);
+    }
+  xclose (fds[1]);
+  len = 0;
+  ssize_t ret;
+  while ((ret = read (fds[0], buf + len, sizeof (buf) - 1 - len)) > 0)
+    len += ret;
+  TEST_VERIFY (ret == 0);
+  buf[len] = '\0';
+  xclose (fds[0]);
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+  TEST_VERIFY (strncmp (buf, "{\"version\":1,", 13) == 0);
+  check_no_record (buf, &mutex);
+  check_no_record (buf, &rwlock);
+  check_no_record (buf, &cond);
+
+  xclose (fd);
+  free (name);
+  xpthread_rwlock_destroy (&percpu_rwlock);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,132 @@
+/* Test the run state hints of threads blocked on futexes.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A thread waiting for a semaphore or a mutex must be marked as blocked
+   in the table that adaptive mutexes consult, and as running again once
+   it has been woken up, or once a signal handler has left the wait with
+   siglongjmp.  The test is linked statically to read the table.  */
+
+#include <pthreadP.h>
+#include <semaphore.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/xsignal.h>
+#include <support/xthread.h>
+
+static sem_t sem;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile pid_t tid;
+static volatile bool woken;
+static volatile bool done;
+static sigjmp_buf jmpbuf;
+
+static void
+handler (int sig)
+{
+  siglongjmp (jmpbuf, 1);
+}
+
+/* Let the main thread check the hint while the thread runs.  */
+static void
+spin (void)
+{
+  woken = true;
+  while (!done)
+    ;
+  woken = false;
+  done = false;
+}
+
+static void *
+thread_func (void *closure)
+{
+  tid = gettid ();
+
+  TEST_COMPARE (sem_wait (&sem), 0);
+  spin ();
+
+  xpthread_mutex_lock (&mutex);
+  xpthread_mutex_unlock (&mutex);
+  spin ();
+
+  if (sigsetjmp (jmpbuf, 1) == 0)
+    {
+      sem_wait (&sem);
+      FAIL_EXIT1 ("sem_wait returned");
+    }
+  spin ();
+
+  return NULL;
+}
+
+static int
+blocked (void)
+{
+  return atomic_load_relaxed (&__nptl_runstate_slot (tid)->blocked) == tid;
+}
+
+static void
+wait_blocked (void)
+{
+  while (blocked () == 0)
+    usleep (1000);
+}
+
+static void
+check_running (void)
+{
+  while (!woken)
+    usleep (1000);
+  TEST_COMPARE (blocked (), 0);
+  done = true;
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (sem_init (&sem, 0, 0), 0);
+  xsignal (SIGUSR1, handler);
+
+  pthread_t thr = xpthread_create (NULL, thread_func, NULL);
+  while (tid == 0)
+    usleep (1000);
+
+  wait_blocked ();
+  TEST_COMPARE (sem_post (&sem), 0);
+  check_running ();
+
+  /* Only lock the mutex once the thread spins, so that it blocks in
+     __lll_lock_wait.  */
+  xpthread_mutex_lock (&mutex);
+  wait_blocked ();
+  xpthread_mutex_unlock (&mutex);
+  check_running ();
+
+  wait_blocked ();
+  xpthread_kill (thr, SIGUSR1);
+  check_running ();
+
+  xpthread_join (thr);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,125 @@
+/* Test rwlocks with per-CPU reader counters.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum { nthreads = 8 };
+enum { niters = 20000 };
+
+static pthread_rwlock_t lock;
+
+/* Written by the writers, and read by the readers with the lock held,
+   which must never see them differ.  */
+static volatile unsigned int value1;
+static volatile unsigned int value2;
+
+static void *
+thread_func (void *closure)
+{
+  uintptr_t id = (uintptr_t) closure;
+  for (int i = 0; i < niters; ++i)
+    if (i % 64 == (int) id)
+      {
+	xpthread_rwlock_wrlock (&lock);
+	++value1;
+	++value2;
+	xpthread_rwlock_unlock (&lock);
+      }
+    else
+      {
+	xpthread_rwlock_rdlock (&lock);
+	TEST_COMPARE (value1, value2);
+	xpthread_rwlock_unlock (&lock);
+      }
+  return NULL;
+}
+
+/* Try to acquire the lock in another thread.  */
+static void *
+try_func (void *closure)
+{
+  int *results = closure;
+  results[0] = pthread_rwlock_tryrdlock (&lock);
+  if (results[0] == 0)
+    xpthread_rwlock_unlock (&lock);
+  results[1] = pthread_rwlock_trywrlock (&lock);
+  if (results[1] == 0)
+    xpthread_rwlock_unlock (&lock);
+  return NULL;
+}
+
+static void
+check_try (int rdlock_result, int wrlock_result)
+{
+  int results[2];
+  xpthread_join (xpthread_create (NULL, try_func, results));
+  TEST_COMPARE (results[0], rdlock_result);
+  TEST_COMPARE (results[1], wrlock_result);
+}
+
+static int
+do_test (void)
+{
+  pthread_rwlockattr_t attr;
+  xpthread_rwlockattr_init (&attr);
+  xpthread_rwlockattr_setkind_np (&attr, PTHREAD_RWLOCK_PERCPU_READER_NP);
+  int kind;
+  TEST_COMPARE (pthread_rwlockattr_getkind_np (&attr, &kind), 0);
+  TEST_COMPARE (kind, PTHREAD_RWLOCK_PERCPU_READER_NP);
+  xpthread_rwlock_init (&lock, &attr);
+
+  check_try (0, 0);
+  xpthread_rwlock_rdlock (&lock);
+  check_try (0, EBUSY);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_wrlock (&lock);
+  check_try (EBUSY, EBUSY);
+  TEST_COMPARE (pthread_rwlock_rdlock (&lock), EDEADLK);
+  TEST_COMPARE (pthread_rwlock_wrlock (&lock), EDEADLK);
+  xpthread_rwlock_unlock (&lock);
+  check_try (0, 0);
+
+  pthread_t threads[nthreads];
+  for (uintptr_t i = 0; i < nthreads; ++i)
+    threads[i] = xpthread_create (NULL, thread_func, (void *) i);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+  TEST_COMPARE (value1, nthreads * (niters / 64 + 1));
+  TEST_COMPARE (value2, value1);
+  xpthread_rwlock_destroy (&lock);
+
+  /* A process-shared rwlock of this kind works, if not per CPU.  */
+  TEST_COMPARE (pthread_rwlockattr_setpshared (&attr,
+					       PTHREAD_PROCESS_SHARED), 0);
+  xpthread_rwlock_init (&lock, &attr);
+  check_try (0, 0);
+  xpthread_rwlock_rdlock (&lock);
+  check_try (0, EBUSY);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_destroy (&lock);
+
+  TEST_COMPARE (pthread_rwlockattr_destroy (&attr), 0);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,166 @@
+/* Test queued spinlocks.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+enum { nthreads = 4 };
+enum { niters = 2000 };
+
+static pthread_spinlock_t lock;
+
+/* Only modified with LOCK held.  */
+static unsigned int counter;
+static bool inside;
+
+static void *
+thread_func (void *closure)
+{
+  for (int i = 0; i < niters; ++i)
+    {
+      if (i % 8 == 0)
+	{
+	  if (pthread_spin_queued_trylock_np (&lock) != 0)
+	    continue;
+	}
+      else
+	TEST_COMPARE (pthread_spin_queued_lock_np (&lock), 0);
+      TEST_VERIFY (!inside);
+      inside = true;
+      ++counter;
+      inside = false;
+      TEST_COMPARE (pthread_spin_queued_unlock_np (&lock), 0);
+
+      /* Let the other threads queue up, even on a single CPU.  */
+      if (i % 64 == 0)
+	sched_yield ();
+    }
+  return NULL;
+}
+
+/* Run threads that contend for LOCK.  The threads get new queue slots
+   or reuse the ones of exited threads.  */
+static void
+run_threads (void)
+{
+  counter = 0;
+  pthread_t threads[nthreads];
+  for (int i = 0; i < nthreads; ++i)
+    threads[i] = xpthread_create (NULL, thread_func, NULL);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+  TEST_VERIFY (counter > 0);
+  TEST_VERIFY (counter <= nthreads * niters);
+}
+
+static void *
+trylock_func (void *closure)
+{
+  return (void *) (long) pthread_spin_queued_trylock_np (&lock);
+}
+
+/* Threads which have acquired LOCK in fifo_func, in order.  */
+static int order[nthreads];
+static int norder;
+
+static void *
+fifo_func (void *closure)
+{
+  TEST_COMPARE (pthread_spin_queued_lock_np (&lock), 0);
+  order[norder++] = (int) (intptr_t) closure;
+  TEST_COMPARE (pthread_spin_queued_unlock_np (&lock), 0);
+  return NULL;
+}
+
+/* Start the threads one after the other while LOCK is held, each once
+   the previous one has entered the queue, which changes the lock word,
+   and check that they get the lock in that order.  */
+static void
+check_fifo (void)
+{
+  pthread_t threads[nthreads];
+  norder = 0;
+  TEST_COMPARE (pthread_spin_queued_lock_np (&lock), 0);
+  for (int i = 0; i < nthreads; ++i)
+    {
+      int val = *(volatile int *) &lock;
+      threads[i] = xpthread_create (NULL, fifo_func, (void *) (intptr_t) i);
+      while (*(volatile int *) &lock == val)
+	sched_yield ();
+    }
+  TEST_COMPARE (pthread_spin_queued_unlock_np (&lock), 0);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+  TEST_COMPARE (norder, nthreads);
+  for (int i = 0; i < nthreads; ++i)
+    TEST_COMPARE (order[i], i);
+}
+
+static void
+check_lock (void)
+{
+  TEST_COMPARE (pthread_spin_queued_trylock_np (&lock), 0);
+  TEST_COMPARE ((long) xpthread_join (xpthread_create (NULL, trylock_func,
+						       NULL)), EBUSY);
+  TEST_COMPARE (pthread_spin_queued_trylock_np (&lock), EBUSY);
+  TEST_COMPARE (pthread_spin_queued_unlock_np (&lock), 0);
+  TEST_COMPARE (pthread_spin_queued_lock_np (&lock), 0);
+  TEST_COMPARE (pthread_spin_queued_unlock_np (&lock), 0);
+
+  run_threads ();
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (pthread_spin_queued_init_np (&lock, PTHREAD_PROCESS_PRIVATE),
+		0);
+  check_lock ();
+  check_fifo ();
+
+  /* Threads of a forked child can queue too.  */
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      check_lock ();
+      _exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+  TEST_COMPARE (pthread_spin_destroy (&lock), 0);
+
+  /* Process-shared queued spinlocks do not queue waiters.  */
+  TEST_COMPARE (pthread_spin_queued_init_np (&lock, PTHREAD_PROCESS_SHARED),
+		0);
+  check_lock ();
+  TEST_COMPARE (pthread_spin_destroy (&lock), 0);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,2 @@
+#define PURGE 0
+#include "tst-stack-cache.c"
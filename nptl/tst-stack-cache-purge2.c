@@ -0,0 +1,2 @@
+#define PURGE 2
+#include "tst-stack-cache.c"
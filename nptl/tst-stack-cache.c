@@ -0,0 +1,171 @@
+/* Test reuse of thread stacks of different sizes from the stack cache.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+/* The value of glibc.pthread.stack_cache_purge the test is run with.
+   With 0, the contents of a cached stack are kept, and with 2 they are
+   cleared.  With 1, the default, either is possible.  */
+#ifndef PURGE
+# define PURGE 1
+#endif
+
+static const size_t stack_sizes[] =
+  { 256 * 1024, 512 * 1024, 1024 * 1024, 3 * 1024 * 1024 };
+static const size_t guard_pages[] = { 0, 1, 4 };
+
+static size_t pagesize;
+
+/* Set by a thread to its stack and guard area.  */
+static unsigned char *thread_stack;
+static size_t thread_stacksize;
+static size_t thread_guardsize;
+
+/* A page in the middle of the stack, which is not used by a thread
+   that runs only briefly, whichever way the stack grows.  */
+static unsigned char *
+middle_page (void)
+{
+  return (unsigned char *) (((uintptr_t) thread_stack
+			     + thread_stacksize / 2) & -pagesize);
+}
+
+static void *
+record_stack (void *closure)
+{
+  pthread_attr_t attr;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  void *stack;
+  TEST_COMPARE (pthread_attr_getstack (&attr, &stack, &thread_stacksize), 0);
+  TEST_COMPARE (pthread_attr_getguardsize (&attr, &thread_guardsize), 0);
+  xpthread_attr_destroy (&attr);
+  thread_stack = stack;
+
+  /* Leave a mark in the unused part of the stack.  */
+  if (closure != NULL && thread_stacksize >= 1024 * 1024)
+    memset (middle_page (), 0xa5, pagesize);
+
+  return NULL;
+}
+
+/* Run a thread with a stack of SIZE bytes and a guard area of GUARD
+   bytes, and check the stack it got.  */
+static void
+run_thread (size_t size, size_t guard, bool mark)
+{
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, size);
+  xpthread_attr_setguardsize (&attr, guard);
+  xpthread_join (xpthread_create (&attr, record_stack,
+				  (void *) (uintptr_t) mark));
+  xpthread_attr_destroy (&attr);
+
+  TEST_VERIFY (thread_stacksize >= size);
+  TEST_COMPARE (thread_guardsize, guard);
+}
+
+static void
+check_reuse (size_t size, size_t guard)
+{
+  run_thread (size, guard, true);
+  unsigned char *stack = thread_stack;
+  run_thread (size, guard, false);
+
+  /* The stack of a joined thread is the first one in the cache.  */
+  TEST_VERIFY (thread_stack == stack);
+
+  if (thread_stack == stack && thread_stacksize >= 1024 * 1024)
+    {
+      unsigned char *page = middle_page ();
+      if (PURGE == 0)
+	TEST_VERIFY (page[0] == 0xa5 && page[pagesize - 1] == 0xa5);
+      else if (PURGE == 2)
+	TEST_VERIFY (page[0] == 0 && page[pagesize - 1] == 0);
+    }
+}
+
+static void
+run_tests (void)
+{
+  for (size_t i = 0; i < array_length (stack_sizes); ++i)
+    for (size_t j = 0; j < array_length (guard_pages); ++j)
+      check_reuse (stack_sizes[i], guard_pages[j] * pagesize);
+
+  /* Interleave the sizes, so that the cache holds stacks of all of them
+     and stacks with the same size but different guard areas.  */
+  for (int round = 0; round < 3; ++round)
+    for (size_t j = 0; j < array_length (guard_pages); ++j)
+      for (size_t i = 0; i < array_length (stack_sizes); ++i)
+	run_thread (stack_sizes[i], guard_pages[j] * pagesize, round == 0);
+}
+
+static void *
+wait_thread (void *closure)
+{
+  xpthread_barrier_wait (closure);
+  xpthread_barrier_wait (closure);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pagesize = sysconf (_SC_PAGESIZE);
+
+  run_tests ();
+
+  /* After fork, the stacks of the other threads are put into the
+     cache of the new process.  */
+  pthread_barrier_t barrier;
+  xpthread_barrier_init (&barrier, NULL, 2);
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, stack_sizes[1]);
+  pthread_t thr = xpthread_create (&attr, wait_thread, &barrier);
+  xpthread_attr_destroy (&attr);
+  xpthread_barrier_wait (&barrier);
+
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      run_tests ();
+      _exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_COMPARE (status, 0);
+
+  xpthread_barrier_wait (&barrier);
+  xpthread_join (thr);
+  xpthread_barrier_destroy (&barrier);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
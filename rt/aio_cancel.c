@@ -68,6 +68,11 @@ __aio_cancel (int fildes, struct aiocb *aiocbp)
 	{
 	  struct requestlist *last = NULL;
 
+	  /* The request may be run by the kernel.  */
+	  result = __aio_kernel_cancel (fildes, (aiocb_union *) aiocbp, &req);
+	  if (result != AIO_ALLDONE)
+	    goto notify;
+
 	  req = __aio_find_req_fd (fildes);
 
 	  if (req == NULL)
@@ -132,8 +137,24 @@ __aio_cancel (int fildes, struct aiocb *aiocbp)
 	      __aio_remove_request (NULL, req, 1);
 	    }
 	}
+
+      /* Add the requests run by the kernel.  */
+      struct requestlist *kreq;
+      int kresult = __aio_kernel_cancel (fildes, NULL, &kreq);
+      if (kresult == AIO_NOTCANCELED
+	  || (kresult == AIO_CANCELED && result == AIO_ALLDONE))
+	result = kresult;
+      if (kreq != NULL)
+	{
+	  struct requestlist *last = kreq;
+	  while (last->next_prio != NULL)
+	    last = last->next_prio;
+	  last->next_prio = req;
+	  req = kreq;
+	}
     }
 
+ notify:
   /* Mark requests as canceled and send signal.  */
   while (req != NULL)
     {
@@ -0,0 +1,48 @@
+/* Run asynchronous I/O requests in the kernel.  Stub version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <aio.h>
+#include <aio_misc.h>
+
+/* Without an asynchronous I/O interface of the kernel, all requests are
+   run by helper threads.  */
+
+bool
+__aio_kernel_enqueue (struct requestlist *req)
+{
+  return false;
+}
+
+void
+__aio_kernel_batch (bool batch)
+{
+}
+
+struct requestlist *
+__aio_kernel_find_req (aiocb_union *elem)
+{
+  return NULL;
+}
+
+int
+__aio_kernel_cancel (int fildes, aiocb_union *elem,
+		     struct requestlist **reqs)
+{
+  *reqs = NULL;
+  return AIO_ALLDONE;
+}
@@ -198,6 +198,9 @@ __aio_find_req (aiocb_union *elem)
 	  runp = runp->next_prio;
     }
 
+  if (runp == NULL)
+    runp = __aio_kernel_find_req (elem);
+
   return runp;
 }
 
@@ -365,6 +368,13 @@ __aio_enqueue_request (aiocb_union *aiocbp, int operation)
   aiocbp->aiocb.__error_code = EINPROGRESS;
   aiocbp->aiocb.__return_value = 0;
 
+  if (__aio_kernel_enqueue (newp))
+    {
+      /* The kernel runs the request, so no thread is needed.  */
+      __pthread_mutex_unlock (&__aio_requests_mutex);
+      return newp;
+    }
+
   if (runp != NULL
       && runp->aiocbp->aiocb.aio_fildes == aiocbp->aiocb.aio_fildes)
     {
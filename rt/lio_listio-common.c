@@ -90,7 +90,10 @@ lio_listio_internal (int mode, struct AIOCB *const list[], int nent,
   __pthread_mutex_lock (&__aio_requests_mutex);
 
   /* Now we can enqueue all requests.  Since we already acquired the
-     mutex the enqueue function need not do this.  */
+     mutex the enqueue function need not do this.  The requests run by
+     the kernel are passed to it at once, after the waiting lists have
+     been set up, because some of them may fail right away.  */
+  __aio_kernel_batch (true);
   for (cnt = 0; cnt < nent; ++cnt)
     if (list[cnt] != NULL && list[cnt]->aio_lio_opcode != LIO_NOP)
       {
@@ -117,6 +120,8 @@ lio_listio_internal (int mode, struct AIOCB *const list[], int nent,
       /* We don't have anything to do except signalling if we work
 	 asynchronously.  */
 
+      __aio_kernel_batch (false);
+
       /* Release the mutex.  We do this before raising a signal since the
 	 signal handler might do a `siglongjmp' and then the mutex is
 	 locked forever.  */
@@ -154,6 +159,8 @@ lio_listio_internal (int mode, struct AIOCB *const list[], int nent,
 	    }
 	}
 
+      __aio_kernel_batch (false);
+
 #ifdef DONT_NEED_AIO_MISC_COND
       AIO_MISC_WAIT (result, total, NULL, 0);
 #else
@@ -220,6 +227,8 @@ lio_listio_internal (int mode, struct AIOCB *const list[], int nent,
 	  waitlist->counter = total;
 	  waitlist->sigev = *sig;
 	}
+
+      __aio_kernel_batch (false);
     }
 
   /* Release the mutex.  */
@@ -20,6 +20,7 @@
 
 #include <aio.h>
 #include <pthread.h>
+#include <stdbool.h>
 
 
 /* Extend the operation enum.  */
@@ -119,4 +120,29 @@ extern int __aio_notify_only (struct sigevent *sigev) attribute_hidden;
 extern int __aio_sigqueue (int sig, const union sigval val, pid_t caller_pid)
   attribute_hidden;
 
+/* Requests can also be run by an asynchronous I/O interface of the
+   kernel, where one exists, instead of helper threads.  The following
+   functions are called with __aio_requests_mutex held.  */
+
+/* Pass request REQ to the kernel.  Return false if it must be run by a
+   helper thread.  */
+extern bool __aio_kernel_enqueue (struct requestlist *req) attribute_hidden;
+
+/* If BATCH, defer passing the requests of __aio_kernel_enqueue to the
+   kernel.  Otherwise, pass the deferred requests.  */
+extern void __aio_kernel_batch (bool batch) attribute_hidden;
+
+/* Find request entry for given AIO control block among the requests
+   run by the kernel.  */
+extern struct requestlist *__aio_kernel_find_req (aiocb_union *elem)
+  attribute_hidden;
+
+/* Remove the requests for FILDES run by the kernel which have not been
+   started yet, or only the one for ELEM if it is not NULL.  Store the
+   removed requests, linked by next_prio, in *REQS.  Return AIO_ALLDONE
+   if there is no such request, AIO_NOTCANCELED if one of them has been
+   started, and AIO_CANCELED otherwise.  */
+extern int __aio_kernel_cancel (int fildes, aiocb_union *elem,
+				struct requestlist **reqs) attribute_hidden;
+
 #endif /* aio_misc.h */
@@ -480,6 +480,11 @@ struct rtld_global
   /* List of queued thread stacks.  */
   EXTERN list_t _dl_stack_cache;
 
+  /* The stacks on _dl_stack_cache again, grouped by size (see
+     nptl-stack.h).  */
+#define DL_STACK_CACHE_BUCKETS 16
+  EXTERN list_t _dl_stack_cache_buckets[DL_STACK_CACHE_BUCKETS];
+
   /* Total size of all stacks in the cache (sum over stackblock_size).  */
   EXTERN size_t _dl_stack_cache_actsize;
 
@@ -26,3 +26,26 @@ check_may_shrink_heap (void)
 {
   return __libc_enable_secure;
 }
+
+/* Return the number of the CPU the calling thread is running on, or a
+   negative value if it is not known.  */
+static inline int
+malloc_getcpu (void)
+{
+  return -1;
+}
+
+/* Store the NUMA node of each CPU below NCPUS in CPU_NODE, and return
+   the number of nodes, or 0 if the layout is not known.  */
+static inline int
+malloc_numa_layout (int *cpu_node, int ncpus)
+{
+  return 0;
+}
+
+/* Ask for the pages of the LEN bytes at ADDR to be allocated on NUMA
+   node NODE.  */
+static inline void
+malloc_bind_node (void *addr, size_t len, int node)
+{
+}
@@ -56,6 +56,8 @@ __tls_pre_init_tp (void)
   INIT_LIST_HEAD (&GL (dl_stack_used));
   INIT_LIST_HEAD (&GL (dl_stack_user));
   INIT_LIST_HEAD (&GL (dl_stack_cache));
+  for (size_t i = 0; i < DL_STACK_CACHE_BUCKETS; ++i)
+    INIT_LIST_HEAD (&GL (dl_stack_cache_buckets)[i]);
 
 #ifdef SHARED
   ___rtld_mutex_lock = rtld_mutex_dummy;
@@ -19,11 +19,14 @@
 #ifndef _FORK_H
 #define _FORK_H
 
+#include <aio.h>
 #include <assert.h>
 #include <kernel-posix-timers.h>
 #include <ldsodefs.h>
 #include <list.h>
 #include <mqueue.h>
+#include <nptl/nptl-lock-profile.h>
+#include <nptl/nptl-stack.h>
 #include <pthreadP.h>
 #include <sysdep.h>
 
@@ -46,6 +49,9 @@ fork_system_setup_after_fork (void)
 
   call_function_static_weak (__mq_notify_fork_subprocess);
   call_function_static_weak (__timer_fork_subprocess);
+  call_function_static_weak (__aio_fork_subprocess);
+  call_function_static_weak (__nptl_spin_queue_fork_subprocess);
+  call_function_static_weak (__nptl_lock_profile_fork_subprocess);
 }
 
 /* In case of a fork() call the memory allocation in the child will be
@@ -147,6 +153,9 @@ reclaim_stacks (void)
     list_add (&self->list, &GL (dl_stack_user));
   else
     list_add (&self->list, &GL (dl_stack_used));
+
+  /* Sort the stacks now in the cache into the size buckets.  */
+  __nptl_stack_cache_rebuild ();
 }
 
 
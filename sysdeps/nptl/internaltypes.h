@@ -117,12 +117,16 @@ struct pthread_barrier
 };
 /* See pthread_barrier_wait for a description.  */
 #define BARRIER_IN_THRESHOLD (UINT_MAX/2)
+/* Set in COUNT of a barrier of kind PTHREAD_BARRIER_TREE_NP.  See
+   pthread_barrier_tree.c for how the other fields are used.  */
+#define BARRIER_COUNT_TREE (BARRIER_IN_THRESHOLD + 1)
 
 
 /* Barrier variable attribute data structure.  */
 struct pthread_barrierattr
 {
-  int pshared;
+  short int pshared;
+  short int kind;
 };
 
 
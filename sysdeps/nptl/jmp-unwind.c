@@ -24,5 +24,8 @@
 void
 _longjmp_unwind (jmp_buf env, int val)
 {
+  /* A signal handler may leave a futex wait with longjmp.  */
+  __nptl_runstate_blocked (0);
+
   __pthread_cleanup_upto (env->__jmpbuf, CURRENT_STACK_FRAME);
 }
@@ -80,6 +80,10 @@ extern void __lll_lock_wait_private (int *futex);
 libc_hidden_proto (__lll_lock_wait_private)
 extern void __lll_lock_wait (int *futex, int private);
 libc_hidden_proto (__lll_lock_wait)
+/* Like __lll_lock_wait, for the lock of a mutex.  The lock profiler
+   attributes the wait to CALLER.  */
+extern void __lll_lock_wait_mutex (int *futex, int private, void *caller)
+  attribute_hidden;
 
 /* This is an expression rather than a statement even though its value is
    void, so that it can be used in a comma expression or as an expression
@@ -106,6 +106,12 @@ enum
   PTHREAD_RWLOCK_PREFER_READER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP,
+  /* Readers are counted per CPU, so that read locks scale with the
+     number of CPUs, at the expense of writers.  Like
+     PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP, read locks must not
+     be acquired recursively.  Not available for process-shared
+     locks.  */
+  PTHREAD_RWLOCK_PERCPU_READER_NP,
   PTHREAD_RWLOCK_DEFAULT_NP = PTHREAD_RWLOCK_PREFER_READER_NP
 };
 
@@ -191,6 +197,19 @@ enum
    the required number of threads have called this function.
    -1 is distinct from 0 and all errno constants */
 # define PTHREAD_BARRIER_SERIAL_THREAD -1
+
+# ifdef __USE_GNU
+/* Barrier kinds.  */
+enum
+{
+  /* All threads arrive at and wait on a single counter.  */
+  PTHREAD_BARRIER_DEFAULT_NP,
+  /* Threads arrive at the leaves of a combining tree, and wait on the
+     nodes of the tree, which scales better with many threads.  Not
+     available for process-shared barriers.  */
+  PTHREAD_BARRIER_TREE_NP
+};
+# endif
 #endif
 
 
@@ -1246,6 +1265,33 @@ extern int pthread_spin_trylock (pthread_spinlock_t *__lock)
 extern int pthread_spin_unlock (pthread_spinlock_t *__lock)
      __THROWNL __nonnull ((1));
 
+# ifdef __USE_GNU
+/* Queued spinlocks.  Threads waiting for a queued spinlock acquire it
+   in FIFO order, and each spins on a flag of its own instead of the
+   lock, which scales better under heavy contention.  A spinlock
+   initialized with pthread_spin_queued_init_np must only be used with
+   the functions below and pthread_spin_destroy.  */
+
+/* Initialize the queued spinlock LOCK.  If PSHARED is nonzero the
+   spinlock can be shared between different processes, but waiting
+   threads are not queued.  */
+extern int pthread_spin_queued_init_np (pthread_spinlock_t *__lock,
+					int __pshared)
+     __THROW __nonnull ((1));
+
+/* Wait until the queued spinlock LOCK is retrieved.  */
+extern int pthread_spin_queued_lock_np (pthread_spinlock_t *__lock)
+     __THROWNL __nonnull ((1));
+
+/* Try to lock the queued spinlock LOCK.  */
+extern int pthread_spin_queued_trylock_np (pthread_spinlock_t *__lock)
+     __THROWNL __nonnull ((1));
+
+/* Release the queued spinlock LOCK.  */
+extern int pthread_spin_queued_unlock_np (pthread_spinlock_t *__lock)
+     __THROWNL __nonnull ((1));
+# endif
+
 
 /* Functions to handle barriers.  */
 
@@ -1283,6 +1329,19 @@ extern int pthread_barrierattr_getpshared (const pthread_barrierattr_t *
 extern int pthread_barrierattr_setpshared (pthread_barrierattr_t *__attr,
 					   int __pshared)
      __THROW __nonnull ((1));
+
+# ifdef __USE_GNU
+/* Get the kind of the barrier attribute ATTR.  */
+extern int pthread_barrierattr_getkind_np (const pthread_barrierattr_t *
+					   __restrict __attr,
+					   int *__restrict __kind)
+     __THROW __nonnull ((1, 2));
+
+/* Set the kind of the barrier attribute ATTR.  */
+extern int pthread_barrierattr_setkind_np (pthread_barrierattr_t *__attr,
+					   int __kind)
+     __THROW __nonnull ((1));
+# endif
 #endif
 
 
@@ -1333,6 +1392,13 @@ extern int pthread_atfork (void (*__prepare) (void),
 			   void (*__parent) (void),
 			   void (*__child) (void)) __THROW;
 
+#ifdef __USE_GNU
+/* Write the lock contention profile collected with the
+   glibc.pthread.lock_profile tunable to FD, as a JSON object.  Return
+   0 on success and -1 if writing fails.  Async-signal-safe.  */
+extern int pthread_lock_profile_dump_np (int __fd) __THROW;
+#endif
+
 
 #ifdef __USE_EXTERN_INLINES
 /* Optimizations.  */
@@ -52,6 +52,73 @@ static inline short max_adaptive_count (void)
 #endif
 }
 
+/* Hints about the run state of threads, which let a thread spinning on
+   an adaptive mutex stop as soon as the owner cannot release the mutex
+   soon.  The kernel does not tell whether another thread is on a CPU,
+   and the descriptor of the owner may be freed at any time, so the
+   hints are kept in a table indexed by the TID of the thread modulo
+   NPTL_RUNSTATE_SLOTS.  Threads whose TIDs collide share an entry,
+   which only makes the hints less accurate.  */
+#define NPTL_RUNSTATE_SLOTS 1024
+
+struct nptl_runstate
+{
+  /* One plus the CPU the thread ran on when it last acquired an adaptive
+     mutex, or zero if unknown.  */
+  int cpu;
+  /* The TID of a thread blocked on a futex, or zero.  Storing the TID
+     keeps threads whose TIDs collide from being taken for blocked.  */
+  pid_t blocked;
+};
+
+extern struct nptl_runstate __nptl_runstate[NPTL_RUNSTATE_SLOTS]
+  attribute_hidden;
+
+static inline struct nptl_runstate *
+__nptl_runstate_slot (pid_t tid)
+{
+  return &__nptl_runstate[(unsigned int) tid % NPTL_RUNSTATE_SLOTS];
+}
+
+/* Return one plus the CPU the calling thread runs on, or zero if it is
+   not known.  */
+static inline int
+__nptl_runstate_getcpu (void)
+{
+#ifdef RSEQ_SIG
+  int cpu = (int) THREAD_GETMEM_VOLATILE (THREAD_SELF, rseq_area.cpu_id);
+  return cpu >= 0 ? cpu + 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+/* Record the CPU of the calling thread TID, which has acquired an
+   adaptive mutex.  The entry is only written when the thread has
+   migrated, so that it is not bounced between CPUs.  */
+static inline void
+__nptl_runstate_acquired (pid_t tid)
+{
+  struct nptl_runstate *rs = __nptl_runstate_slot (tid);
+  int cpu = __nptl_runstate_getcpu ();
+  if (atomic_load_relaxed (&rs->cpu) != cpu)
+    atomic_store_relaxed (&rs->cpu, cpu);
+}
+
+/* Mark the calling thread as blocked on a futex, or no longer.  A
+   thread only clears the entry if it still holds its own TID, so that it
+   does not clear the mark of a colliding thread which blocked since.  */
+static inline void
+__nptl_runstate_blocked (int blocked)
+{
+  pid_t tid = THREAD_GETMEM (THREAD_SELF, tid);
+  struct nptl_runstate *rs = __nptl_runstate_slot (tid);
+  if (blocked)
+    atomic_store_relaxed (&rs->blocked, tid);
+  else if (atomic_load_relaxed (&rs->blocked) == tid)
+    atomic_compare_and_exchange_val_acq (&rs->blocked, 0, tid);
+}
+
 
 /* Magic cookie representing robust mutex with dead owner.  */
 #define PTHREAD_MUTEX_INCONSISTENT	INT_MAX
@@ -129,6 +196,27 @@ enum
    ? LLL_SHARED : LLL_PRIVATE)
 #endif
 
+/* Return true if the owner of the adaptive MUTEX is probably not on a
+   CPU: it is blocked on a futex, or the calling thread runs on the CPU
+   the owner acquired the mutex on, so the owner has been preempted.  In
+   either case, spinning only delays the caller.  The owner of a
+   process-shared mutex may be a thread of another process, whose state
+   is not recorded here.  */
+static inline bool
+__nptl_mutex_owner_off_cpu (pthread_mutex_t *mutex)
+{
+  if (PTHREAD_MUTEX_PSHARED (mutex) != LLL_PRIVATE)
+    return false;
+  pid_t owner = atomic_load_relaxed (&mutex->__data.__owner);
+  if (owner <= 0)
+    return false;
+  struct nptl_runstate *rs = __nptl_runstate_slot (owner);
+  if (atomic_load_relaxed (&rs->blocked) == owner)
+    return true;
+  int cpu = atomic_load_relaxed (&rs->cpu);
+  return cpu != 0 && cpu == __nptl_runstate_getcpu ();
+}
+
 /* The kernel when waking robust mutexes on exit never uses
    FUTEX_PRIVATE_FLAG FUTEX_WAKE.  */
 #define PTHREAD_ROBUST_MUTEX_PSHARED(m) LLL_SHARED
@@ -165,6 +253,61 @@ enum
 					 << (sizeof (unsigned int) * 8 - 1))
 #define PTHREAD_RWLOCK_FUTEX_USED	2
 
+/* Rwlocks of kind PTHREAD_RWLOCK_PERCPU_READER_NP, implemented in
+   pthread_rwlock_percpu.c.  The lock functions are called after the
+   arguments have been checked and return the same errors as the
+   functions of the other kinds; with TRY set, they fail with EBUSY
+   instead of blocking.  The lock profiler attributes their waits to
+   CALLER.  */
+extern int __pthread_rwlock_percpu_init (pthread_rwlock_t *rwlock)
+  attribute_hidden;
+extern void __pthread_rwlock_percpu_destroy (pthread_rwlock_t *rwlock)
+  attribute_hidden;
+extern int __pthread_rwlock_percpu_rdlock (pthread_rwlock_t *rwlock,
+					   clockid_t clockid,
+					   const struct __timespec64 *abstime,
+					   bool try, void *caller)
+  attribute_hidden;
+extern int __pthread_rwlock_percpu_wrlock (pthread_rwlock_t *rwlock,
+					   clockid_t clockid,
+					   const struct __timespec64 *abstime,
+					   bool try, void *caller)
+  attribute_hidden;
+extern void __pthread_rwlock_percpu_unlock (pthread_rwlock_t *rwlock)
+  attribute_hidden;
+
+/* Barriers of kind PTHREAD_BARRIER_TREE_NP, implemented in
+   pthread_barrier_tree.c.  */
+extern int __pthread_barrier_tree_init (struct pthread_barrier *bar,
+					unsigned int count) attribute_hidden;
+extern void __pthread_barrier_tree_destroy (struct pthread_barrier *bar)
+  attribute_hidden;
+extern int __pthread_barrier_tree_wait (struct pthread_barrier *bar)
+  attribute_hidden;
+
+
+/* Queued spinlocks.  The lock word of a spinlock initialized with
+   pthread_spin_queued_init_np holds a locked bit, a bit that disables
+   queueing for process-shared spinlocks, and the slot in
+   __nptl_spin_queue of the last thread in the queue, plus one.  */
+#define PTHREAD_SPIN_QUEUED_LOCKED	1
+#define PTHREAD_SPIN_QUEUED_SHARED	2
+#define PTHREAD_SPIN_QUEUED_TAIL_SHIFT	16
+
+/* Threads that do not get one of the slots wait for queued spinlocks
+   without queueing.  */
+#define NPTL_SPIN_QUEUE_SLOTS		4096
+#define NPTL_SPIN_QUEUE_NOSLOT		((unsigned int) -1)
+
+/* Threads that have a slot, by slot index.  */
+extern struct pthread *__nptl_spin_queue[NPTL_SPIN_QUEUE_SLOTS]
+  attribute_hidden;
+
+/* Give up the slot of PD, if any, when PD exits.  */
+void __nptl_spin_queue_release (struct pthread *pd) attribute_hidden;
+
+/* Give up the slots of the threads that did not survive fork.  */
+void __nptl_spin_queue_fork_subprocess (void) attribute_hidden;
 
 /* Bits used in robust mutex implementation.  */
 #define FUTEX_WAITERS		0x80000000
@@ -272,6 +415,9 @@ __do_cancel (void)
   /* Make sure we get no more cancellations.  */
   atomic_fetch_or_relaxed (&self->cancelhandling, EXITING_BITMASK);
 
+  /* The thread may have been cancelled while blocked on a futex.  */
+  __nptl_runstate_blocked (0);
+
   __pthread_unwind ((__pthread_unwind_buf_t *)
 		    THREAD_GETMEM (self, cleanup_jmp_buf));
 }
@@ -334,6 +480,7 @@ extern int __pthread_getschedparam (pthread_t thread_id, int *policy,
 libc_hidden_proto (__pthread_getschedparam)
 extern int __pthread_setschedparam (pthread_t thread_id, int policy,
 				    const struct sched_param *param);
+libc_hidden_proto (__pthread_setschedparam)
 extern int __pthread_mutex_init (pthread_mutex_t *__mutex,
 				 const pthread_mutexattr_t *__mutexattr);
 libc_hidden_proto (__pthread_mutex_init)
@@ -0,0 +1,136 @@
+/* Restartable sequences on per-CPU data.  AArch64 version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef RSEQ_PERCPU_H
+#define RSEQ_PERCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/rseq.h>
+
+/* See sysdeps/unix/sysv/linux/rseq-percpu.h.  */
+#define RSEQ_PERCPU_CS 1
+
+#define RSEQ_PERCPU_STR(x) __STRING (x)
+
+/* The critical section runs from label 1 to label 2, and its abort
+   handler is at label 4.  Its descriptor is at label 3.  Setting the
+   rseq_cs field at label 6 arms it, using the TMP operand.  The rseq_cs
+   field is not cleared afterwards, because libc is never unloaded.  */
+#define RSEQ_PERCPU_CS_START					\
+  ".pushsection __rseq_cs, \"aw\"\n\t"				\
+  ".balign 32\n\t"						\
+  "3:\n\t"							\
+  ".long 0x0, 0x0\n\t"						\
+  ".quad 1f, (2f - 1f), 4f\n\t"					\
+  ".popsection\n\t"						\
+  "6:\n\t"							\
+  "adrp %[tmp], 3b\n\t"						\
+  "add %[tmp], %[tmp], :lo12:3b\n\t"				\
+  "str %[tmp], %[rseq_cs]\n\t"					\
+  "1:\n\t"
+
+/* The abort handler follows the signature instruction, and restarts the
+   critical section.  */
+#define RSEQ_PERCPU_CS_ABORT					\
+  ".pushsection __rseq_failure, \"ax\"\n\t"			\
+  ".inst " RSEQ_PERCPU_STR (RSEQ_SIG_CODE) "\n\t"		\
+  "4:\n\t"							\
+  "b 6b\n\t"							\
+  ".popsection\n\t"
+
+static inline int
+rseq_percpu_cs_add (struct rseq *rs, intptr_t *base, size_t stride,
+		    intptr_t value)
+{
+  int cpu;
+  uintptr_t tmp;
+  intptr_t val;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"ldr %w[cpu], %[cpu_id]\n\t"
+			"madd %[tmp], %x[cpu], %[stride], %[base]\n\t"
+			"ldr %[val], [%[tmp]]\n\t"
+			"add %[val], %[val], %[value]\n\t"
+			"str %[val], [%[tmp]]\n\t"
+			"2:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [cpu] "=&r" (cpu), [tmp] "=&r" (tmp),
+			  [val] "=&r" (val), [rseq_cs] "=m" (rs->rseq_cs)
+			: [cpu_id] "m" (rs->cpu_id), [base] "r" (base),
+			  [stride] "r" (stride), [value] "r" (value)
+			: "memory", "cc");
+  return cpu;
+}
+
+static inline int
+rseq_percpu_cs_cmpstore (struct rseq *rs, intptr_t *slot, int cpu,
+			 intptr_t expected, intptr_t desired)
+{
+  int result;
+  uintptr_t tmp;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"mov %w[result], #-1\n\t"
+			"ldr %w[tmp], %[cpu_id]\n\t"
+			"cmp %w[tmp], %w[cpu]\n\t"
+			"b.ne 5f\n\t"
+			"mov %w[result], #1\n\t"
+			"ldr %[tmp], %[slot]\n\t"
+			"cmp %[tmp], %[expected]\n\t"
+			"b.ne 5f\n\t"
+			"str %[desired], %[slot]\n\t"
+			"2:\n\t"
+			"mov %w[result], #0\n\t"
+			"5:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [result] "=&r" (result), [tmp] "=&r" (tmp),
+			  [rseq_cs] "=m" (rs->rseq_cs), [slot] "+m" (*slot)
+			: [cpu_id] "m" (rs->cpu_id), [cpu] "r" (cpu),
+			  [expected] "r" (expected), [desired] "r" (desired)
+			: "memory", "cc");
+  return result;
+}
+
+static inline intptr_t
+rseq_percpu_cs_pop (struct rseq *rs, intptr_t *base, size_t stride,
+		    ptrdiff_t offset, int *cpup)
+{
+  intptr_t head;
+  intptr_t next;
+  int cpu;
+  uintptr_t tmp;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"ldr %w[cpu], %[cpu_id]\n\t"
+			"madd %[tmp], %x[cpu], %[stride], %[base]\n\t"
+			"ldr %[head], [%[tmp]]\n\t"
+			"cbz %[head], 2f\n\t"
+			"ldr %[next], [%[head], %[offset]]\n\t"
+			"str %[next], [%[tmp]]\n\t"
+			"2:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [head] "=&r" (head), [next] "=&r" (next),
+			  [cpu] "=&r" (cpu), [tmp] "=&r" (tmp),
+			  [rseq_cs] "=m" (rs->rseq_cs)
+			: [cpu_id] "m" (rs->cpu_id), [base] "r" (base),
+			  [stride] "r" (stride), [offset] "r" (offset)
+			: "memory", "cc");
+  *cpup = cpu;
+  return head;
+}
+
+#endif /* rseq-percpu.h */
@@ -0,0 +1,533 @@
+/* Run asynchronous I/O requests in the kernel.  Linux version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <aio.h>
+#include <atomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <not-cancel.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sysdep.h>
+#include <unistd.h>
+#include <aio_misc.h>
+#include <kernel-io_uring.h>
+
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE aio
+# include <elf/dl-tunables.h>
+#endif
+
+#ifdef __NR_io_uring_setup
+
+/* Reads, writes and synchronizations are run with io_uring if the
+   kernel supports it, instead of helper threads: the submitting thread
+   writes a submission queue entry for each request and passes it to the
+   kernel, and a single helper thread waits for the completions and
+   notifies the initiators.  lio_listio passes all of its requests with
+   one system call.
+
+   The kernel runs the requests in any order.  A synchronization request
+   is passed to the kernel only after the requests for its descriptor
+   that were enqueued before it are complete.  Requests wait in
+   kernel_requests while there is no room in the rings; those can still
+   be canceled.
+
+   Writes to a descriptor opened with O_APPEND, and all requests on a
+   descriptor which cannot seek, such as a pipe or a socket, use the
+   current position, so they must be run in the order they were
+   enqueued.  These descriptors are left to the helper threads, which
+   run the requests of a descriptor one after the other.
+
+   The ring is set up with the first request.  If this fails, or
+   glibc.aio.io_uring is 0, all requests are run by helper threads, so
+   the requests of a descriptor never use both methods unless its
+   flags change.  */
+
+/* Number of submission queue entries.  The completion queue has twice
+   as many, which bounds the number of requests in the kernel.  */
+#define RING_ENTRIES 256
+
+/* The kernel transfers at most this many bytes in a read or write.  */
+#define MAX_TRANSFER 0x7ffff000
+
+static enum
+{
+  ring_unknown,
+  ring_ready,
+  ring_unavailable
+} ring_state;
+
+static int ring_fd;
+
+/* The mapped rings and submission queue entries.  */
+static void *ring_map;
+static size_t ring_map_size;
+static struct io_uring_sqe *ring_sqes;
+static size_t ring_sqes_size;
+
+static unsigned int *sq_head;
+static unsigned int *sq_tail;
+static unsigned int *sq_array;
+static unsigned int sq_mask;
+static unsigned int sq_entries;
+
+static unsigned int *cq_head;
+static unsigned int *cq_tail;
+static struct io_uring_cqe *cq_cqes;
+static unsigned int cq_mask;
+static unsigned int cq_entries;
+
+/* Requests run by the kernel in the order they were enqueued, linked by
+   next_fd and last_fd.  Their state is queued if they wait for room in
+   the rings, and allocated once their submission queue entry has been
+   written.  */
+static struct requestlist *kernel_requests;
+static struct requestlist *kernel_requests_last;
+
+/* Number of requests in state queued.  */
+static unsigned int nqueued;
+
+/* Number of requests in state allocated.  */
+static unsigned int nsubmitted;
+
+/* Number of submission queue entries not yet passed to the kernel.  */
+static unsigned int npending;
+
+/* True while lio_listio enqueues requests.  */
+static bool batch;
+
+
+static void
+unlink_request (struct requestlist *req)
+{
+  if (req->last_fd != NULL)
+    req->last_fd->next_fd = req->next_fd;
+  else
+    kernel_requests = req->next_fd;
+  if (req->next_fd != NULL)
+    req->next_fd->last_fd = req->last_fd;
+  else
+    kernel_requests_last = req->last_fd;
+}
+
+/* Record the result RES of REQ, which is the result of a system call or
+   a negated error number, and notify its initiator.  */
+static void
+complete_request (struct requestlist *req, int res)
+{
+  struct aiocb *aiocbp = &req->aiocbp->aiocb;
+
+  if (res < 0)
+    {
+      aiocbp->__return_value = -1;
+      aiocbp->__error_code = -res;
+    }
+  else
+    {
+      aiocbp->__return_value = res;
+      aiocbp->__error_code = 0;
+    }
+
+  unlink_request (req);
+  --nsubmitted;
+
+  __aio_notify (req);
+
+  req->running = done;
+  __aio_free_request (req);
+}
+
+static off64_t
+request_offset (aiocb_union *aiocbp)
+{
+  if (sizeof (off_t) != sizeof (off64_t)
+      && aiocbp->aiocb.aio_lio_opcode & 128)
+    return aiocbp->aiocb64.aio_offset;
+  return aiocbp->aiocb.aio_offset;
+}
+
+static bool
+ring_has_room (void)
+{
+  /* The entries up to the head may be reused.  Acquire MO to
+     synchronize with the kernel reading them.  */
+  return (nsubmitted < cq_entries
+	  && *sq_tail - atomic_load_acquire (sq_head) < sq_entries);
+}
+
+/* Return true if REQ may be passed to the kernel, which is the case
+   unless it synchronizes a descriptor with requests enqueued before
+   it.  */
+static bool
+request_ready (struct requestlist *req)
+{
+  int opcode = req->aiocbp->aiocb.aio_lio_opcode;
+  if (opcode != LIO_SYNC && opcode != LIO_DSYNC)
+    return true;
+
+  int fildes = req->aiocbp->aiocb.aio_fildes;
+  for (struct requestlist *runp = kernel_requests; runp != req;
+       runp = runp->next_fd)
+    if (runp->aiocbp->aiocb.aio_fildes == fildes)
+      return false;
+  return true;
+}
+
+/* Return true if the requests on FILDES may be run in any order.  */
+static bool
+fd_unordered (int fildes)
+{
+  int saved_errno = errno;
+  int flags = __fcntl64_nocancel (fildes, F_GETFL);
+  bool result = (flags != -1 && (flags & O_APPEND) == 0
+		 && __lseek64 (fildes, 0, SEEK_CUR) != -1);
+  __set_errno (saved_errno);
+  return result;
+}
+
+/* Write the submission queue entry for REQ.  */
+static void
+write_sqe (struct requestlist *req)
+{
+  aiocb_union *aiocbp = req->aiocbp;
+  unsigned int tail = *sq_tail;
+  unsigned int index = tail & sq_mask;
+  struct io_uring_sqe *sqe = &ring_sqes[index];
+
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->fd = aiocbp->aiocb.aio_fildes;
+  sqe->user_data = (uintptr_t) req;
+  switch (aiocbp->aiocb.aio_lio_opcode & 127)
+    {
+    case LIO_READ:
+    case LIO_WRITE:
+      sqe->opcode = ((aiocbp->aiocb.aio_lio_opcode & 127) == LIO_READ
+		     ? IORING_OP_READ : IORING_OP_WRITE);
+      sqe->addr = (uintptr_t) aiocbp->aiocb.aio_buf;
+      sqe->len = MIN (aiocbp->aiocb.aio_nbytes, MAX_TRANSFER);
+      sqe->off = request_offset (aiocbp);
+      break;
+    case LIO_DSYNC:
+      sqe->op_flags = IORING_FSYNC_DATASYNC;
+      /* Fall through.  */
+    default:
+      sqe->opcode = IORING_OP_FSYNC;
+      break;
+    }
+  sq_array[index] = index;
+
+  /* Release MO so that the kernel sees the entry.  */
+  atomic_store_release (sq_tail, tail + 1);
+
+  req->running = allocated;
+  ++nsubmitted;
+  ++npending;
+}
+
+/* Write the entries for the queued requests while there is room, and
+   pass the entries to the kernel.  */
+static void
+submit_requests (void)
+{
+  struct requestlist *runp = kernel_requests;
+
+  while (true)
+    {
+      for (; nqueued > 0 && runp != NULL && ring_has_room ();
+	   runp = runp->next_fd)
+	if (runp->running == queued && request_ready (runp))
+	  {
+	    --nqueued;
+	    write_sqe (runp);
+	  }
+
+      if (npending == 0)
+	return;
+
+      int ret = INTERNAL_SYSCALL_CALL (io_uring_enter, ring_fd, npending,
+				       0, 0, NULL, 0);
+      if (!INTERNAL_SYSCALL_ERROR_P (ret) && ret > 0)
+	{
+	  npending -= ret;
+	  continue;
+	}
+
+      /* The kernel is out of resources.  It is asked again after the
+	 next completion.  */
+      if (nsubmitted > npending)
+	return;
+
+      /* No completion is to be expected, so fail the entries that have
+	 not been passed.  The kernel has not read them yet.  */
+      int err = (INTERNAL_SYSCALL_ERROR_P (ret)
+		 ? INTERNAL_SYSCALL_ERRNO (ret) : EAGAIN);
+      unsigned int tail = *sq_tail;
+      unsigned int first = tail - npending;
+      atomic_store_relaxed (sq_tail, first);
+      npending = 0;
+      for (unsigned int i = first; i != tail; ++i)
+	complete_request ((struct requestlist *) (uintptr_t)
+			  ring_sqes[sq_array[i & sq_mask]].user_data, -err);
+      return;
+    }
+}
+
+/* Helper thread which waits for the completions.  */
+static void *
+reap_completions (void *arg)
+{
+  while (true)
+    {
+      /* Only this thread writes the head.  Acquire MO to see the
+	 entries the kernel has written.  */
+      unsigned int head = atomic_load_relaxed (cq_head);
+      if (head == atomic_load_acquire (cq_tail))
+	{
+	  INTERNAL_SYSCALL_CALL (io_uring_enter, ring_fd, 0, 1,
+				 IORING_ENTER_GETEVENTS, NULL, 0);
+	  continue;
+	}
+
+      __pthread_mutex_lock (&__aio_requests_mutex);
+
+      unsigned int tail = atomic_load_acquire (cq_tail);
+      for (; head != tail; ++head)
+	{
+	  struct io_uring_cqe *cqe = &cq_cqes[head & cq_mask];
+	  complete_request ((struct requestlist *) (uintptr_t)
+			    cqe->user_data, cqe->res);
+	}
+      /* Release MO so that the kernel reuses the entries only after they
+	 have been read.  */
+      atomic_store_release (cq_head, head);
+
+      if (nqueued > 0 || npending > 0)
+	submit_requests ();
+
+      __pthread_mutex_unlock (&__aio_requests_mutex);
+    }
+
+  return NULL;
+}
+
+static bool
+ring_setup (void)
+{
+#if HAVE_TUNABLES
+  if (TUNABLE_GET (io_uring, int32_t, NULL) == 0)
+    return false;
+#endif
+
+  struct io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  int fd = INTERNAL_SYSCALL_CALL (io_uring_setup, RING_ENTRIES, &params);
+  if (INTERNAL_SYSCALL_ERROR_P (fd))
+    return false;
+
+  /* Reads and writes at the current position come with
+     IORING_OP_READ and IORING_OP_WRITE in Linux 5.6.  */
+  uint32_t features = (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+		       | IORING_FEAT_RW_CUR_POS);
+  if ((params.features & features) != features)
+    goto close;
+
+  ring_map_size = MAX (params.sq_off.array
+		       + params.sq_entries * sizeof (unsigned int),
+		       params.cq_off.cqes
+		       + params.cq_entries * sizeof (struct io_uring_cqe));
+  ring_map = __mmap (NULL, ring_map_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring_map == MAP_FAILED)
+    goto close;
+  ring_sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+  ring_sqes = __mmap (NULL, ring_sqes_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring_sqes == MAP_FAILED)
+    goto unmap_ring;
+
+  char *map = ring_map;
+  sq_head = (unsigned int *) (map + params.sq_off.head);
+  sq_tail = (unsigned int *) (map + params.sq_off.tail);
+  sq_array = (unsigned int *) (map + params.sq_off.array);
+  sq_mask = *(unsigned int *) (map + params.sq_off.ring_mask);
+  sq_entries = params.sq_entries;
+  cq_head = (unsigned int *) (map + params.cq_off.head);
+  cq_tail = (unsigned int *) (map + params.cq_off.tail);
+  cq_cqes = (struct io_uring_cqe *) (map + params.cq_off.cqes);
+  cq_mask = *(unsigned int *) (map + params.cq_off.ring_mask);
+  cq_entries = params.cq_entries;
+  ring_fd = fd;
+
+  pthread_t thid;
+  if (aio_create_helper_thread (&thid, reap_completions, NULL) == 0)
+    return true;
+
+  __munmap (ring_sqes, ring_sqes_size);
+ unmap_ring:
+  __munmap (ring_map, ring_map_size);
+ close:
+  __close_nocancel_nostatus (fd);
+  return false;
+}
+
+
+bool
+__aio_kernel_enqueue (struct requestlist *req)
+{
+  if (ring_state == ring_unknown)
+    ring_state = ring_setup () ? ring_ready : ring_unavailable;
+  if (ring_state != ring_ready)
+    return false;
+
+  aiocb_union *aiocbp = req->aiocbp;
+  switch (aiocbp->aiocb.aio_lio_opcode & 127)
+    {
+    case LIO_READ:
+    case LIO_WRITE:
+      /* The kernel uses the current position for the offset -1.  Leave
+	 the error of negative offsets to the helper threads.  */
+      if (request_offset (aiocbp) < 0)
+	return false;
+      break;
+    case LIO_DSYNC:
+    case LIO_SYNC:
+      break;
+    default:
+      /* The helper threads report invalid opcodes.  */
+      return false;
+    }
+
+  /* This also leaves invalid descriptors to the helper threads.  */
+  if (!fd_unordered (aiocbp->aiocb.aio_fildes))
+    return false;
+
+  req->next_fd = NULL;
+  req->last_fd = kernel_requests_last;
+  if (kernel_requests_last != NULL)
+    kernel_requests_last->next_fd = req;
+  else
+    kernel_requests = req;
+  kernel_requests_last = req;
+
+  if (nqueued == 0 && ring_has_room () && request_ready (req))
+    write_sqe (req);
+  else
+    {
+      req->running = queued;
+      ++nqueued;
+    }
+
+  if (!batch)
+    submit_requests ();
+
+  return true;
+}
+
+
+void
+__aio_kernel_batch (bool start)
+{
+  batch = start;
+  if (!start && ring_state == ring_ready)
+    submit_requests ();
+}
+
+
+struct requestlist *
+__aio_kernel_find_req (aiocb_union *elem)
+{
+  struct requestlist *runp = kernel_requests;
+
+  while (runp != NULL && runp->aiocbp != elem)
+    runp = runp->next_fd;
+
+  return runp;
+}
+
+
+int
+__aio_kernel_cancel (int fildes, aiocb_union *elem,
+		     struct requestlist **reqs)
+{
+  struct requestlist *runp = kernel_requests;
+  int result = AIO_ALLDONE;
+
+  *reqs = NULL;
+  while (runp != NULL)
+    {
+      struct requestlist *next = runp->next_fd;
+
+      if (runp->aiocbp->aiocb.aio_fildes == fildes
+	  && (elem == NULL || runp->aiocbp == elem))
+	{
+	  if (runp->running == queued)
+	    {
+	      unlink_request (runp);
+	      --nqueued;
+	      runp->next_prio = *reqs;
+	      *reqs = runp;
+	      if (result == AIO_ALLDONE)
+		result = AIO_CANCELED;
+	    }
+	  else
+	    result = AIO_NOTCANCELED;
+	}
+
+      runp = next;
+    }
+
+  /* A synchronization request may have waited for the removed
+     requests.  */
+  if (*reqs != NULL && nqueued > 0)
+    submit_requests ();
+
+  return result;
+}
+
+
+void
+__aio_fork_subprocess (void)
+{
+  /* The requests of the parent are not inherited, and the child must
+     not use the rings of the parent.  */
+  if (ring_state == ring_ready)
+    {
+      __munmap (ring_sqes, ring_sqes_size);
+      __munmap (ring_map, ring_map_size);
+      __close_nocancel_nostatus (ring_fd);
+    }
+  ring_state = ring_unknown;
+  kernel_requests = NULL;
+  kernel_requests_last = NULL;
+  nqueued = 0;
+  nsubmitted = 0;
+  npending = 0;
+  batch = false;
+}
+
+#else /* !__NR_io_uring_setup */
+# include <rt/aio_kernel.c>
+
+void
+__aio_fork_subprocess (void)
+{
+}
+#endif
@@ -0,0 +1,111 @@
+/* The io_uring interface of the Linux kernel.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _KERNEL_IO_URING_H
+#define _KERNEL_IO_URING_H
+
+#include <stdint.h>
+
+/* The subset of <linux/io_uring.h> used by the POSIX AIO functions,
+   which does not depend on the version of the kernel headers.  */
+
+struct io_uring_sqe
+{
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t op_flags;
+  uint64_t user_data;
+  uint16_t buf_index;
+  uint16_t personality;
+  int32_t splice_fd_in;
+  uint64_t pad[2];
+};
+
+struct io_uring_cqe
+{
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct io_sqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct io_cqring_offsets
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint32_t flags;
+  uint32_t resv1;
+  uint64_t resv2;
+};
+
+struct io_uring_params
+{
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t wq_fd;
+  uint32_t resv[3];
+  struct io_sqring_offsets sq_off;
+  struct io_cqring_offsets cq_off;
+};
+
+/* Opcodes of io_uring_sqe.  */
+#define IORING_OP_FSYNC		3
+#define IORING_OP_READ		22
+#define IORING_OP_WRITE		23
+
+/* op_flags of IORING_OP_FSYNC.  */
+#define IORING_FSYNC_DATASYNC	(1U << 0)
+
+/* Flags of io_uring_enter.  */
+#define IORING_ENTER_GETEVENTS	(1U << 0)
+
+/* Features of io_uring_params.  */
+#define IORING_FEAT_SINGLE_MMAP	(1U << 0)
+#define IORING_FEAT_NODROP	(1U << 1)
+#define IORING_FEAT_RW_CUR_POS	(1U << 3)
+
+/* Offsets for mmap.  */
+#define IORING_OFF_SQ_RING	0ULL
+#define IORING_OFF_SQES		0x10000000ULL
+
+#endif /* kernel-io_uring.h */
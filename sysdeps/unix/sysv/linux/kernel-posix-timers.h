@@ -43,6 +43,13 @@ extern struct timer *__timer_active_sigev_thread attribute_hidden;
 /* Lock for __timer_active_sigev_thread.  */
 extern pthread_mutex_t __timer_active_sigev_thread_lock attribute_hidden;
 
+/* Remove TIMER from the notification threads.  Called with
+   __timer_active_sigev_thread_lock held, after TIMER has been removed
+   from __timer_active_sigev_thread.  Return false if the notification
+   function of TIMER is running; the thread that runs it frees TIMER
+   afterwards.  */
+extern bool __timer_pool_delete (struct timer *timer) attribute_hidden;
+
 extern __typeof (timer_create) __timer_create;
 libc_hidden_proto (__timer_create)
 extern __typeof (timer_delete) __timer_delete;
@@ -64,6 +71,13 @@ struct timer
 
   /* Next element in list of active SIGEV_THREAD timers.  */
   struct timer *next;
+
+  /* Notification state: a combination of the TIMER_POOL_* flags in
+     timer_routines.c.  */
+  unsigned int pool_state;
+
+  /* Next element in the queue of pending notifications.  */
+  struct timer *pool_next;
 };
 
 
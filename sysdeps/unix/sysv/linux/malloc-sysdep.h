@@ -16,8 +16,13 @@
    License along with the GNU C Library; if not, see
    <https://www.gnu.org/licenses/>.  */
 
+#include <_itoa.h>
 #include <fcntl.h>
 #include <not-cancel.h>
+#include <string.h>
+#include <sys/rseq.h>
+#include <sysdep.h>
+#include <tls.h>
 
 /* The Linux kernel overcommits address space by default and if there is not
    enough memory available, it uses various parameters to decide the process to
@@ -56,4 +61,121 @@ check_may_shrink_heap (void)
   return may_shrink_heap;
 }
 
+/* Return the number of the CPU the calling thread is running on, or a
+   negative value if it is not known.  The CPU number is read from the
+   rseq area registered for the thread, so this does not need a system
+   call.  The result is only a hint, since the thread may be migrated
+   to another CPU at any time.  */
+static inline int
+malloc_getcpu (void)
+{
+#ifdef RSEQ_SIG
+  return (int) THREAD_GETMEM_VOLATILE (THREAD_SELF, rseq_area.cpu_id);
+#else
+  return -1;
+#endif
+}
+
+/* Read the sysfs file PATH into BUF, which has room for LEN bytes
+   including the terminating null byte.  */
+static inline bool
+malloc_read_sysfs (const char *path, char *buf, size_t len)
+{
+  int fd = __open64_nocancel (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  ssize_t n = __read_nocancel (fd, buf, len - 1);
+  __close_nocancel_nostatus (fd);
+  if (n <= 0)
+    return false;
+  buf[n] = '\0';
+  return true;
+}
+
+/* Parse the next range of a sysfs list such as "0-3,8,10-11" at *S.
+   Store its bounds in *FIRST and *LAST and return true, or return false
+   at the end of the list.  */
+static inline bool
+malloc_parse_range (const char **s, int *first, int *last)
+{
+  const char *p = *s;
+
+  if (*p < '0' || *p > '9')
+    return false;
+
+  *first = 0;
+  while (*p >= '0' && *p <= '9')
+    *first = *first * 10 + *p++ - '0';
+  *last = *first;
+  if (*p == '-')
+    {
+      *last = 0;
+      for (++p; *p >= '0' && *p <= '9'; ++p)
+	*last = *last * 10 + *p - '0';
+    }
+  if (*p == ',')
+    ++p;
+
+  *s = p;
+  return true;
+}
+
+/* Store the NUMA node of each CPU below NCPUS in CPU_NODE, and return
+   the number of nodes, or 0 if the layout is not known.  The layout is
+   read from the cpulist file of each node in sysfs.  CPUs which are not
+   listed under any node are left unchanged.  */
+static inline int
+malloc_numa_layout (int *cpu_node, int ncpus)
+{
+  char buf[4096];
+  const char *s = buf;
+  int first, last, nnodes = 0;
+
+  if (!malloc_read_sysfs ("/sys/devices/system/node/possible", buf,
+			  sizeof (buf)))
+    return 0;
+  while (malloc_parse_range (&s, &first, &last))
+    nnodes = last + 1;
+
+  for (int node = 0; node < nnodes; ++node)
+    {
+      char path[64];
+      char num[3 * sizeof (int) + 1];
+
+      num[sizeof (num) - 1] = '\0';
+      char *p = __stpcpy (path, "/sys/devices/system/node/node");
+      p = __stpcpy (p, _itoa_word (node, &num[sizeof (num) - 1], 10, 0));
+      __stpcpy (p, "/cpulist");
+
+      if (!malloc_read_sysfs (path, buf, sizeof (buf)))
+	continue;
+      for (s = buf; malloc_parse_range (&s, &first, &last); )
+	for (int cpu = first; cpu <= last && cpu < ncpus; ++cpu)
+	  cpu_node[cpu] = node;
+    }
+
+  return nnodes;
+}
+
+/* Ask for the pages of the LEN bytes at ADDR to be allocated on NUMA
+   node NODE.  The policy is only a preference, so that allocations
+   still succeed when the node runs out of memory.  */
+static inline void
+malloc_bind_node (void *addr, size_t len, int node)
+{
+#ifdef __NR_mbind
+  /* MPOL_PREFERRED from <linux/mempolicy.h>.  */
+  enum { mpol_preferred = 1 };
+  enum { bits = sizeof (unsigned long) * 8 };
+  unsigned long mask[node / bits + 1];
+
+  memset (mask, 0, sizeof (mask));
+  mask[node / bits] = 1UL << (node % bits);
+  /* The kernel ignores the last bit of MAXNODE.  */
+  INTERNAL_SYSCALL_CALL (mbind, addr, len, mpol_preferred, mask,
+			 sizeof (mask) * 8 + 1, 0);
+#endif
+}
+
 #define HAVE_MREMAP 1
@@ -0,0 +1,47 @@
+/* Restartable sequences on per-CPU data.  Generic version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef RSEQ_PERCPU_H
+#define RSEQ_PERCPU_H
+
+/* An architecture that implements the critical sections of the
+   rseq_percpu_* functions defines RSEQ_PERCPU_CS to 1 and provides:
+
+   int rseq_percpu_cs_add (struct rseq *rs, intptr_t *base, size_t stride,
+			   intptr_t value);
+     Add VALUE to the slot of the CPU in the cpu_id field of RS, and
+     return the number of the CPU.
+
+   int rseq_percpu_cs_cmpstore (struct rseq *rs, intptr_t *slot, int cpu,
+				intptr_t expected, intptr_t desired);
+     If the cpu_id field of RS is CPU and *SLOT is EXPECTED, store
+     DESIRED in *SLOT and return 0.  Otherwise return -1 if the CPU
+     differs, and 1 if *SLOT does.
+
+   intptr_t rseq_percpu_cs_pop (struct rseq *rs, intptr_t *base,
+				size_t stride, ptrdiff_t offset, int *cpu);
+     If the slot of the CPU in the cpu_id field of RS is not zero, store
+     the value at OFFSET bytes from it in the slot.  Return the old value
+     of the slot and store the number of the CPU in *CPU.
+
+   Each function is a single critical section, which the abort handler
+   restarts from the beginning.  Otherwise, the generic code uses atomic
+   operations.  */
+#define RSEQ_PERCPU_CS 0
+
+#endif /* rseq-percpu.h */
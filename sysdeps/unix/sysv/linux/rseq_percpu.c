@@ -0,0 +1,153 @@
+/* Per-CPU data with restartable sequences.  Linux version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <atomic.h>
+#include <lowlevellock.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/rseq.h>
+#include <tls.h>
+#include <rseq-percpu.h>
+
+/* If the calling thread has registered its rseq area, these functions
+   update the slot of its CPU in a restartable sequence, which the kernel
+   aborts if the thread is preempted or migrated before it completes.
+   Otherwise, they use atomic operations on the slot.  A thread inherits
+   the registration of the thread that creates it, so all threads of a
+   process use the same method, and the two never access the same slot
+   concurrently.
+
+   Popping the head of a free list with a compare-and-swap is subject to
+   ABA: after the next pointer has been read from the head, other threads
+   may pop the head and its successor and push the head back.  This
+   cannot happen within a restartable sequence, and the atomic fallback
+   serializes the pops on a slot with a lock.  Pushes need no lock,
+   because the head only returns to an object that is being popped after
+   a pop of that object.  */
+
+/* Number of locks for the pops of the atomic fallback.  A prime, so
+   that the slots of an array with a power-of-two stride use different
+   locks.  */
+#define POP_LOCKS 61
+
+static int pop_locks[POP_LOCKS];
+
+static inline intptr_t *
+percpu_slot (intptr_t *base, size_t stride, int cpu)
+{
+  return (intptr_t *) ((char *) base + (size_t) cpu * stride);
+}
+
+#if RSEQ_PERCPU_CS
+/* Return the rseq area of the calling thread, or NULL if it is not
+   registered.  */
+static inline struct rseq *
+percpu_rseq_area (void)
+{
+  struct pthread *self = THREAD_SELF;
+  if ((int) THREAD_GETMEM_VOLATILE (self, rseq_area.cpu_id) < 0)
+    return NULL;
+  return &self->rseq_area;
+}
+#endif
+
+/* Return the CPU for the atomic fallback.  Any CPU is correct.  */
+static int
+percpu_fallback_cpu (void)
+{
+  unsigned int cpu;
+  if (__getcpu (&cpu, NULL) != 0)
+    return 0;
+  return cpu;
+}
+
+int
+__rseq_percpu_add (intptr_t *base, size_t stride, intptr_t value)
+{
+#if RSEQ_PERCPU_CS
+  struct rseq *rs = percpu_rseq_area ();
+  if (rs != NULL)
+    return rseq_percpu_cs_add (rs, base, stride, value);
+#endif
+
+  int cpu = percpu_fallback_cpu ();
+  atomic_fetch_add_relaxed (percpu_slot (base, stride, cpu), value);
+  return cpu;
+}
+weak_alias (__rseq_percpu_add, rseq_percpu_add)
+
+int
+__rseq_percpu_cmpstore (intptr_t *base, size_t stride, int cpu,
+			intptr_t expected, intptr_t desired)
+{
+  intptr_t *slot = percpu_slot (base, stride, cpu);
+
+#if RSEQ_PERCPU_CS
+  struct rseq *rs = percpu_rseq_area ();
+  if (rs != NULL)
+    return rseq_percpu_cs_cmpstore (rs, slot, cpu, expected, desired);
+#endif
+
+  /* Release MO so that a thread that pops DESIRED sees the writes to the
+     object before.  */
+  intptr_t old = expected;
+  do
+    if (atomic_compare_exchange_weak_release (slot, &old, desired))
+      return 0;
+  while (old == expected);
+  return 1;
+}
+weak_alias (__rseq_percpu_cmpstore, rseq_percpu_cmpstore)
+
+intptr_t
+__rseq_percpu_pop (intptr_t *base, size_t stride, ptrdiff_t offset,
+		   int *cpup)
+{
+  intptr_t head;
+  int cpu;
+
+#if RSEQ_PERCPU_CS
+  struct rseq *rs = percpu_rseq_area ();
+  if (rs != NULL)
+    head = rseq_percpu_cs_pop (rs, base, stride, offset, &cpu);
+  else
+#endif
+    {
+      cpu = percpu_fallback_cpu ();
+      intptr_t *slot = percpu_slot (base, stride, cpu);
+      int *lock = &pop_locks[((uintptr_t) slot / sizeof (intptr_t))
+			     % POP_LOCKS];
+
+      lll_lock (*lock, LLL_PRIVATE);
+      /* Acquire MO to synchronize with the release MO in
+	 __rseq_percpu_cmpstore.  */
+      head = atomic_load_acquire (slot);
+      while (head != 0)
+	{
+	  intptr_t next = *(intptr_t *) ((char *) head + offset);
+	  if (atomic_compare_exchange_weak_acquire (slot, &head, next))
+	    break;
+	}
+      lll_unlock (*lock, LLL_PRIVATE);
+    }
+
+  if (cpup != NULL)
+    *cpup = cpu;
+  return head;
+}
+weak_alias (__rseq_percpu_pop, rseq_percpu_pop)
@@ -26,5 +26,8 @@ _longjmp_unwind (jmp_buf env, int val)
 {
   char local_var;
 
+  /* A signal handler may leave a futex wait with longjmp.  */
+  __nptl_runstate_blocked (0);
+
   __pthread_cleanup_upto (env->__jmpbuf, &local_var);
 }
@@ -166,4 +166,39 @@ extern const unsigned int __rseq_size;
 /* Flags used during rseq registration.  */
 extern const unsigned int __rseq_flags;
 
+__BEGIN_DECLS
+
+/* The following functions operate on an array of per-CPU slots at BASE,
+   where the slot of CPU N is at (char *) BASE + N * STRIDE.  The array
+   needs a slot for each CPU that get_nprocs_conf counts.  They use
+   restartable sequences if the rseq area is registered, and atomic
+   operations otherwise.  */
+
+/* Add VALUE to the slot of the CPU the calling thread runs on, and
+   return the number of that CPU.  */
+extern int rseq_percpu_add (intptr_t *__base, size_t __stride,
+			    intptr_t __value) __THROW __nonnull ((1));
+
+/* If the slot of CPU holds EXPECTED, store DESIRED in it and return 0.
+   Otherwise return 1.  With restartable sequences, return -1 if the
+   calling thread does not run on CPU, which can only happen if it has
+   been migrated since it obtained CPU.  With atomic operations, the
+   slot of CPU is updated wherever the thread runs, and -1 is never
+   returned.  */
+extern int rseq_percpu_cmpstore (intptr_t *__base, size_t __stride,
+				 int __cpu, intptr_t __expected,
+				 intptr_t __desired) __THROW __nonnull ((1));
+
+/* If the slot of the CPU the calling thread runs on is not zero, replace
+   it with the value at OFFSET bytes from the address it holds, and
+   return the old value.  Otherwise return zero.  If CPU is not NULL,
+   store the number of the CPU in *CPU.  With rseq_percpu_cmpstore for
+   pushes, this implements per-CPU free lists linked through the word at
+   OFFSET.  */
+extern intptr_t rseq_percpu_pop (intptr_t *__base, size_t __stride,
+				 ptrdiff_t __offset, int *__cpu)
+     __THROW __nonnull ((1));
+
+__END_DECLS
+
 #endif /* sys/rseq.h */
@@ -82,6 +82,8 @@ ___timer_create (clockid_t clock_id, struct sigevent *evp, timer_t *timerid)
 	/* Copy the thread parameters the user provided.  */
 	newp->sival = evp->sigev_value;
 	newp->thrfunc = evp->sigev_notify_function;
+	newp->pool_state = 0;
+	newp->pool_next = NULL;
 
 	/* We cannot simply copy the thread attributes since the
 	   implementation might keep internal information for
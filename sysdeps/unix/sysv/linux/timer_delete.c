@@ -51,9 +51,11 @@ ___timer_delete (timer_t timerid)
 		else
 		  prevp = prevp->next;
 	    }
+	  bool unused = __timer_pool_delete (kt);
 	  __pthread_mutex_unlock (&__timer_active_sigev_thread_lock);
 
-	  free (kt);
+	  if (unused)
+	    free (kt);
 	}
 
       return 0;
@@ -19,10 +19,16 @@
 #include <setjmp.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <sys/sysinfo.h>
 #include <sysdep-cancel.h>
 #include <pthreadP.h>
 #include "kernel-posix-timers.h"
 
+#if HAVE_TUNABLES
+# define TUNABLE_NAMESPACE pthread
+# include <elf/dl-tunables.h>
+#endif
+
 
 /* List of active SIGEV_THREAD timers.  */
 struct timer *__timer_active_sigev_thread;
@@ -30,34 +36,355 @@ struct timer *__timer_active_sigev_thread;
 /* Lock for _timer_active_sigev_thread.  */
 pthread_mutex_t __timer_active_sigev_thread_lock = PTHREAD_MUTEX_INITIALIZER;
 
-struct thread_start_data
+
+/* The notification functions of SIGEV_THREAD timers run in a pool of
+   persistent worker threads, instead of a new thread per expiration.
+   Each worker is created with the attributes of the timer it is created
+   for, and only runs the notifications of timers with the same
+   attributes.  The number of workers is bounded by the
+   glibc.pthread.timer_threads tunable.
+
+   The notifications of one timer are serialized: an expiration while
+   the notification function of its timer is queued or running is merged
+   into the pending notification, the way the kernel merges the signals
+   of a timer into its overrun count.
+
+   If all workers are busy, notifications wait in a FIFO queue.  A
+   worker that finishes queues the pending notification of its timer,
+   if any, behind the others, so that busy timers do not starve the
+   rest, and takes the first queued notification with its attributes.
+   If only notifications with other attributes are queued, it exits and
+   starts a worker for the first of them, and idle workers are retired
+   in the same way when a new worker is needed.
+
+   Each notification function starts with the state of a new thread: a
+   worker runs the destructors of the thread-specific data after each
+   notification function, and restores the signal mask, the scheduling
+   policy and priority, and the cancellation state and type the worker
+   started with.
+
+   The pool state and the pool_state and pool_next members of the timers
+   are protected by __timer_active_sigev_thread_lock.  */
+
+/* The notification is in timer_pool_queue.  */
+#define TIMER_POOL_QUEUED	1
+/* A worker runs the notification function.  */
+#define TIMER_POOL_RUNNING	2
+/* Run the notification function again after it returns.  */
+#define TIMER_POOL_PENDING	4
+/* The timer has been deleted while the notification function was
+   running; the worker frees it.  */
+#define TIMER_POOL_DELETED	8
+
+struct timer_worker
 {
-  void (*thrfunc) (sigval_t);
-  sigval_t sival;
+  /* The attributes the worker was created with.  */
+  struct pthread_attr attr;
+
+  /* The timer whose notification function the worker runs next.  NULL
+     after an idle worker has been retired.  */
+  struct timer *work;
+
+  /* Next element in timer_pool_idle.  */
+  struct timer_worker *next;
+
+  /* True while the worker is in timer_pool_idle.  */
+  bool idle;
+
+  /* Signaled when the worker leaves timer_pool_idle.  */
+  pthread_cond_t cond;
 };
 
+/* Maximum number of workers, set when the helper thread starts.  */
+static unsigned int timer_pool_max;
+
+/* Number of workers, including the ones that are about to exit.  */
+static unsigned int timer_pool_threads;
+
+/* Idle workers, the most recently used first.  */
+static struct timer_worker *timer_pool_idle;
+
+/* Queue of notifications that wait for a worker.  */
+static struct timer *timer_pool_queue;
+static struct timer **timer_pool_queue_tail = &timer_pool_queue;
+
+
+/* Return true if workers created with the attributes of timers A and B
+   are interchangeable.  The attributes of timers are built by
+   timer_create from these members only.  */
+static bool
+timer_pool_attr_equal (const struct pthread_attr *a,
+		       const struct pthread_attr *b)
+{
+  return (a->schedparam.sched_priority == b->schedparam.sched_priority
+	  && a->schedpolicy == b->schedpolicy
+	  && a->flags == b->flags
+	  && a->guardsize == b->guardsize
+	  && a->stackaddr == b->stackaddr
+	  && a->stacksize == b->stacksize);
+}
+
+static const struct pthread_attr *
+timer_pool_attr (const struct timer *tk)
+{
+  return (const struct pthread_attr *) &tk->attr;
+}
+
+static void *timer_pool_worker (void *arg);
+
+/* Start a worker for the attributes of TK, which runs the notification
+   function of TK first.  Return false if no thread can be created.  */
+static bool
+timer_pool_start (struct timer *tk)
+{
+  struct timer_worker *w = malloc (sizeof (*w));
+  if (w == NULL)
+    return false;
+  w->attr = *timer_pool_attr (tk);
+  w->work = tk;
+  w->next = NULL;
+  w->idle = false;
+  __pthread_cond_init (&w->cond, NULL);
+
+  pthread_t th;
+  if (__pthread_create (&th, &tk->attr, timer_pool_worker, w) != 0)
+    {
+      free (w);
+      return false;
+    }
+  ++timer_pool_threads;
+  tk->pool_state = TIMER_POOL_RUNNING;
+  return true;
+}
+
+/* Make an idle worker exit.  */
+static void
+timer_pool_retire_idle (void)
+{
+  struct timer_worker *w = timer_pool_idle;
+  timer_pool_idle = w->next;
+  w->idle = false;
+  w->work = NULL;
+  --timer_pool_threads;
+  __pthread_cond_signal (&w->cond);
+}
+
+/* Remove TK from timer_pool_queue.  */
+static void
+timer_pool_unqueue (struct timer **tkp)
+{
+  struct timer *tk = *tkp;
+  *tkp = tk->pool_next;
+  if (timer_pool_queue_tail == &tk->pool_next)
+    timer_pool_queue_tail = tkp;
+  tk->pool_next = NULL;
+  tk->pool_state &= ~TIMER_POOL_QUEUED;
+}
 
-/* Helper thread to call the user-provided function.  */
+/* Append TK to timer_pool_queue.  */
+static void
+timer_pool_enqueue (struct timer *tk)
+{
+  tk->pool_state = TIMER_POOL_QUEUED;
+  *timer_pool_queue_tail = tk;
+  timer_pool_queue_tail = &tk->pool_next;
+}
+
+/* Dispatch a notification of the active timer TK.  */
+static void
+timer_pool_notify (struct timer *tk)
+{
+  if (tk->pool_state & TIMER_POOL_RUNNING)
+    {
+      tk->pool_state |= TIMER_POOL_PENDING;
+      return;
+    }
+  if (tk->pool_state & TIMER_POOL_QUEUED)
+    return;
+
+  for (struct timer_worker **wp = &timer_pool_idle; *wp != NULL;
+       wp = &(*wp)->next)
+    if (timer_pool_attr_equal (&(*wp)->attr, timer_pool_attr (tk)))
+      {
+	struct timer_worker *w = *wp;
+	*wp = w->next;
+	w->idle = false;
+	w->work = tk;
+	tk->pool_state = TIMER_POOL_RUNNING;
+	__pthread_cond_signal (&w->cond);
+	return;
+      }
+
+  if (timer_pool_threads >= timer_pool_max && timer_pool_idle != NULL)
+    timer_pool_retire_idle ();
+  if (timer_pool_threads < timer_pool_max && timer_pool_start (tk))
+    return;
+
+  /* There is not much we can do if no worker exists and none can be
+     created.  */
+  if (timer_pool_threads == 0)
+    return;
+
+  timer_pool_enqueue (tk);
+}
+
+/* Called by worker W after the notification function of TK has
+   returned.  Return the timer whose notification function W runs next,
+   or NULL if W exits.  */
+static struct timer *
+timer_pool_done (struct timer_worker *w, struct timer *tk)
+{
+  if (tk->pool_state & TIMER_POOL_DELETED)
+    free (tk);
+  else if (tk->pool_state & TIMER_POOL_PENDING)
+    timer_pool_enqueue (tk);
+  else
+    tk->pool_state = 0;
+
+  for (struct timer **tkp = &timer_pool_queue; *tkp != NULL;
+       tkp = &(*tkp)->pool_next)
+    if (timer_pool_attr_equal (&w->attr, timer_pool_attr (*tkp)))
+      {
+	tk = *tkp;
+	timer_pool_unqueue (tkp);
+	tk->pool_state = TIMER_POOL_RUNNING;
+	return tk;
+      }
+
+  if (timer_pool_queue != NULL)
+    {
+      /* Make room for a worker with the attributes of the first queued
+	 notification.  If it cannot be created, W stays, and the
+	 notification waits for another worker.  */
+      --timer_pool_threads;
+      if (timer_pool_start (timer_pool_queue))
+	{
+	  timer_pool_unqueue (&timer_pool_queue);
+	  return NULL;
+	}
+      ++timer_pool_threads;
+    }
+
+  w->idle = true;
+  w->next = timer_pool_idle;
+  timer_pool_idle = w;
+  do
+    __pthread_cond_wait (&w->cond, &__timer_active_sigev_thread_lock);
+  while (w->idle);
+  return w->work;
+}
+
+/* Cleanup handler for a worker that exits in a notification function,
+   with pthread_exit or by cancellation.  */
+static void
+timer_pool_worker_exit (void *arg)
+{
+  struct timer_worker *w = arg;
+
+  __pthread_mutex_lock (&__timer_active_sigev_thread_lock);
+  --timer_pool_threads;
+  struct timer *tk = w->work;
+  if (tk->pool_state & TIMER_POOL_DELETED)
+    free (tk);
+  else if (tk->pool_state & TIMER_POOL_PENDING)
+    {
+      tk->pool_state = 0;
+      timer_pool_notify (tk);
+    }
+  else
+    tk->pool_state = 0;
+  __pthread_mutex_unlock (&__timer_active_sigev_thread_lock);
+
+  free (w);
+}
+
+/* Undo the changes the notification function that just returned made
+   to the state of the calling worker.  MASK, POLICY and PARAM are the
+   signal mask and scheduling parameters the worker started with.  */
+static void
+timer_pool_worker_reset (const internal_sigset_t *mask, int policy,
+			 const struct sched_param *param)
+{
+  __nptl_deallocate_tsd ();
+
+  internal_signal_restore_set (mask);
+
+  pthread_t self = (pthread_t) THREAD_SELF;
+  int cur_policy;
+  struct sched_param cur_param;
+  if (__pthread_getschedparam (self, &cur_policy, &cur_param) == 0
+      && (cur_policy != policy
+	  || cur_param.sched_priority != param->sched_priority))
+    __pthread_setschedparam (self, policy, param);
+}
+
+/* Worker thread to call the user-provided functions.  */
 static void *
-timer_sigev_thread (void *arg)
+timer_pool_worker (void *arg)
 {
   signal_unblock_sigtimer ();
 
-  struct thread_start_data *td = (struct thread_start_data *) arg;
-  void (*thrfunc) (sigval_t) = td->thrfunc;
-  sigval_t sival = td->sival;
+  internal_sigset_t mask;
+  internal_sigprocmask (SIG_BLOCK, NULL, &mask);
+  int policy;
+  struct sched_param param;
+  __pthread_getschedparam ((pthread_t) THREAD_SELF, &policy, &param);
 
-  /* The TD object was allocated in timer_helper_thread.  */
-  free (td);
+  struct timer_worker *w = arg;
+
+  __pthread_mutex_lock (&__timer_active_sigev_thread_lock);
+  struct timer *tk = w->work;
+  while (tk != NULL)
+    {
+      void (*thrfunc) (sigval_t) = tk->thrfunc;
+      sigval_t sival = tk->sival;
+      w->work = tk;
+      __pthread_mutex_unlock (&__timer_active_sigev_thread_lock);
 
-  /* Call the user-provided function.  */
-  thrfunc (sival);
+      /* A previous notification function may have changed them.  */
+      __pthread_setcanceltype (PTHREAD_CANCEL_DEFERRED, NULL);
+      __pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL);
 
+      /* Call the user-provided function.  */
+      pthread_cleanup_push (timer_pool_worker_exit, w);
+      thrfunc (sival);
+      pthread_cleanup_pop (0);
+
+      timer_pool_worker_reset (&mask, policy, &param);
+
+      __pthread_mutex_lock (&__timer_active_sigev_thread_lock);
+      tk = timer_pool_done (w, tk);
+    }
+  __pthread_mutex_unlock (&__timer_active_sigev_thread_lock);
+
+  free (w);
   return NULL;
 }
 
 
-/* Helper function to support starting threads for SIGEV_THREAD.  */
+bool
+__timer_pool_delete (struct timer *tk)
+{
+  if (tk->pool_state & TIMER_POOL_RUNNING)
+    {
+      tk->pool_state |= TIMER_POOL_DELETED;
+      return false;
+    }
+
+  if (tk->pool_state & TIMER_POOL_QUEUED)
+    for (struct timer **tkp = &timer_pool_queue; *tkp != NULL;
+	 tkp = &(*tkp)->pool_next)
+      if (*tkp == tk)
+	{
+	  timer_pool_unqueue (tkp);
+	  break;
+	}
+  return true;
+}
+
+
+/* Helper function to dispatch the notifications of SIGEV_THREAD
+   timers.  */
 static _Noreturn void *
 timer_helper_thread (void *arg)
 {
@@ -84,20 +411,8 @@ timer_helper_thread (void *arg)
 	    runp = runp->next;
 
 	  if (runp != NULL)
-	    {
-	      struct thread_start_data *td = malloc (sizeof (*td));
-
-	      /* There is not much we can do if the allocation fails.  */
-	      if (td != NULL)
-		{
-		  /* This is the signal we are waiting for.  */
-		  td->thrfunc = tk->thrfunc;
-		  td->sival = tk->sival;
-
-		  pthread_t th;
-		  __pthread_create (&th, &tk->attr, timer_sigev_thread, td);
-		}
-	    }
+	    /* This is the signal we are waiting for.  */
+	    timer_pool_notify (tk);
 
 	  __pthread_mutex_unlock (&__timer_active_sigev_thread_lock);
 	}
@@ -119,12 +434,33 @@ __timer_fork_subprocess (void)
 {
   __timer_helper_once = PTHREAD_ONCE_INIT;
   __timer_helper_tid = 0;
+
+  /* The workers do not exist in the new process.  */
+  timer_pool_threads = 0;
+  timer_pool_idle = NULL;
+  timer_pool_queue = NULL;
+  timer_pool_queue_tail = &timer_pool_queue;
+  for (struct timer *tk = __timer_active_sigev_thread; tk != NULL;
+       tk = tk->next)
+    {
+      tk->pool_state = 0;
+      tk->pool_next = NULL;
+    }
 }
 
 
 void
 __timer_start_helper_thread (void)
 {
+  int max = 0;
+#if HAVE_TUNABLES
+  max = TUNABLE_GET (timer_threads, int32_t, NULL);
+#endif
+  /* By default, one worker per CPU.  */
+  if (max == 0)
+    max = __get_nprocs_sched ();
+  timer_pool_max = max > 0 ? max : 1;
+
   /* The helper thread needs only very little resources
      and should go away automatically when canceled.  */
   pthread_attr_t attr;
@@ -0,0 +1,306 @@
+/* Test POSIX AIO with many requests in flight.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The requests are run with io_uring if the kernel supports it, and by
+   helper threads in tst-aio-uring-threads, which defines
+   USE_HELPER_THREADS.  The test checks which of them ran the requests by
+   looking for the io_uring descriptor.  Writes to a descriptor opened
+   with O_APPEND and to a pipe must be done in the order they were
+   enqueued with both.  */
+
+#include <aio.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+#include <kernel-io_uring.h>
+
+/* More requests than fit into the rings at once.  */
+enum { nblocks = 600 };
+enum { block_size = 512 };
+
+static int fd;
+static char data[nblocks][block_size];
+static char buf[nblocks][block_size];
+static struct aiocb cbs[nblocks];
+static struct aiocb *list[nblocks];
+
+static void
+prepare (int opcode, void *base)
+{
+  for (int i = 0; i < nblocks; ++i)
+    {
+      memset (&cbs[i], 0, sizeof (cbs[i]));
+      cbs[i].aio_fildes = fd;
+      cbs[i].aio_buf = (char *) base + i * block_size;
+      cbs[i].aio_nbytes = block_size;
+      cbs[i].aio_offset = i * block_size;
+      cbs[i].aio_lio_opcode = opcode;
+      cbs[i].aio_sigevent.sigev_notify = SIGEV_NONE;
+      list[i] = &cbs[i];
+    }
+}
+
+static void
+check_done (void)
+{
+  for (int i = 0; i < nblocks; ++i)
+    {
+      TEST_COMPARE (aio_error (&cbs[i]), 0);
+      TEST_COMPARE (aio_return (&cbs[i]), block_size);
+    }
+}
+
+static void
+wait_for (struct aiocb *cb)
+{
+  const struct aiocb *l[1] = { cb };
+  while (aio_error (cb) == EINPROGRESS)
+    TEST_VERIFY (aio_suspend (l, 1, NULL) == 0 || errno == EINTR);
+}
+
+/* Return 1 if the process has an io_uring descriptor, 0 if not, and -1
+   if this cannot be told.  */
+static int
+ring_in_use (void)
+{
+  int result = 0;
+  DIR *dir = opendir ("/proc/self/fd");
+  if (dir == NULL)
+    return -1;
+  struct dirent *e;
+  while ((e = readdir (dir)) != NULL)
+    {
+      char *path = xasprintf ("/proc/self/fd/%s", e->d_name);
+      char target[64];
+      ssize_t len = readlink (path, target, sizeof (target) - 1);
+      free (path);
+      if (len > 0)
+	{
+	  target[len] = '\0';
+	  if (strcmp (target, "anon_inode:[io_uring]") == 0)
+	    result = 1;
+	}
+    }
+  closedir (dir);
+  return result;
+}
+
+#ifndef USE_HELPER_THREADS
+/* Return true if the kernel has the io_uring features glibc needs.  */
+static bool
+ring_supported (void)
+{
+# ifdef __NR_io_uring_setup
+  struct io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  int ring = syscall (__NR_io_uring_setup, 1, &params);
+  if (ring < 0)
+    return false;
+  xclose (ring);
+  uint32_t features = (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+		       | IORING_FEAT_RW_CUR_POS);
+  return (params.features & features) == features;
+# else
+  return false;
+# endif
+}
+#endif
+
+/* Write all blocks to OUT, which writes at the current position, with
+   one request each.  */
+static void
+enqueue_writes (int out)
+{
+  prepare (LIO_WRITE, data);
+  for (int i = 0; i < nblocks; ++i)
+    {
+      cbs[i].aio_fildes = out;
+      TEST_COMPARE (aio_write (&cbs[i]), 0);
+    }
+}
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool list_done;
+
+static void
+list_notify (union sigval sv)
+{
+  TEST_VERIFY (sv.sival_ptr == &list_done);
+  xpthread_mutex_lock (&lock);
+  list_done = true;
+  xpthread_cond_signal (&cond);
+  xpthread_mutex_unlock (&lock);
+}
+
+static int
+do_test (void)
+{
+  char *name;
+  fd = create_temp_file ("tst-aio-uring.", &name);
+  TEST_VERIFY_EXIT (fd >= 0);
+
+  for (int i = 0; i < nblocks; ++i)
+    memset (data[i], 'a' + i % 26, block_size);
+
+  /* Write all blocks with one lio_listio call.  */
+  prepare (LIO_WRITE, data);
+  TEST_COMPARE (lio_listio (LIO_WAIT, list, nblocks, NULL), 0);
+  check_done ();
+
+  int ring = ring_in_use ();
+  if (ring < 0)
+    puts ("info: /proc/self/fd is not available");
+  else
+    {
+      printf ("info: requests run %s\n",
+	      ring ? "with io_uring" : "on helper threads");
+#ifdef USE_HELPER_THREADS
+      TEST_COMPARE (ring, 0);
+#else
+      if (ring_supported ())
+	TEST_COMPARE (ring, 1);
+#endif
+    }
+
+  /* A synchronization after writes that have not completed yet.  */
+  prepare (LIO_WRITE, data);
+  for (int i = 0; i < nblocks; ++i)
+    TEST_COMPARE (aio_write (&cbs[i]), 0);
+  struct aiocb sync_cb = { .aio_fildes = fd };
+  TEST_COMPARE (aio_fsync (O_DSYNC, &sync_cb), 0);
+  wait_for (&sync_cb);
+  TEST_COMPARE (aio_error (&sync_cb), 0);
+  TEST_COMPARE (aio_return (&sync_cb), 0);
+  /* The writes were enqueued before the synchronization, so they have
+     completed.  */
+  check_done ();
+
+  /* Read the blocks back with individual requests.  */
+  memset (buf, 0, sizeof (buf));
+  prepare (LIO_READ, buf);
+  for (int i = 0; i < nblocks; ++i)
+    TEST_COMPARE (aio_read (&cbs[i]), 0);
+  for (int i = 0; i < nblocks; ++i)
+    wait_for (&cbs[i]);
+  check_done ();
+  TEST_VERIFY (memcmp (buf, data, sizeof (buf)) == 0);
+
+  /* lio_listio with a notification for the whole list.  */
+  memset (buf, 0, sizeof (buf));
+  prepare (LIO_READ, buf);
+  struct sigevent sev =
+    {
+      .sigev_notify = SIGEV_THREAD,
+      .sigev_notify_function = list_notify,
+      .sigev_value.sival_ptr = &list_done,
+    };
+  TEST_COMPARE (lio_listio (LIO_NOWAIT, list, nblocks, &sev), 0);
+  xpthread_mutex_lock (&lock);
+  while (!list_done)
+    xpthread_cond_wait (&cond, &lock);
+  xpthread_mutex_unlock (&lock);
+  check_done ();
+  TEST_VERIFY (memcmp (buf, data, sizeof (buf)) == 0);
+
+  /* Errors are reported for the request.  */
+  struct aiocb bad_cb =
+    {
+      .aio_fildes = fd,
+      .aio_buf = buf,
+      .aio_nbytes = block_size,
+      .aio_offset = -1,
+    };
+  TEST_COMPARE (aio_read (&bad_cb), 0);
+  wait_for (&bad_cb);
+  TEST_COMPARE (aio_error (&bad_cb), EINVAL);
+  TEST_COMPARE (aio_return (&bad_cb), -1);
+
+  /* A read from a pipe stays in progress until there is data, and cannot
+     be canceled meanwhile.  */
+  int fds[2];
+  xpipe (fds);
+  struct aiocb pipe_cb =
+    {
+      .aio_fildes = fds[0],
+      .aio_buf = buf,
+      .aio_nbytes = block_size,
+    };
+  TEST_COMPARE (aio_read (&pipe_cb), 0);
+  usleep (10000);
+  TEST_COMPARE (aio_error (&pipe_cb), EINPROGRESS);
+  TEST_COMPARE (aio_cancel (fds[0], &pipe_cb), AIO_NOTCANCELED);
+  xwrite (fds[1], "x", 1);
+  wait_for (&pipe_cb);
+  TEST_COMPARE (aio_error (&pipe_cb), 0);
+  TEST_COMPARE (aio_return (&pipe_cb), 1);
+  TEST_COMPARE (buf[0][0], 'x');
+  TEST_COMPARE (aio_cancel (fds[0], NULL), AIO_ALLDONE);
+
+  /* Writes to a pipe, more than it holds at once, arrive in order.  */
+  enqueue_writes (fds[1]);
+  for (int i = 0; i < nblocks; ++i)
+    {
+      size_t done = 0;
+      while (done < block_size)
+	{
+	  ssize_t ret = read (fds[0], buf[i] + done, block_size - done);
+	  TEST_VERIFY_EXIT (ret > 0);
+	  done += ret;
+	}
+    }
+  for (int i = 0; i < nblocks; ++i)
+    wait_for (&cbs[i]);
+  check_done ();
+  TEST_VERIFY (memcmp (buf, data, sizeof (buf)) == 0);
+  xclose (fds[0]);
+  xclose (fds[1]);
+
+  /* Writes to a descriptor opened with O_APPEND are appended in
+     order.  */
+  int append_fd = xopen (name, O_WRONLY | O_APPEND, 0);
+  enqueue_writes (append_fd);
+  for (int i = 0; i < nblocks; ++i)
+    wait_for (&cbs[i]);
+  check_done ();
+  TEST_COMPARE (pread (fd, buf, sizeof (buf), sizeof (data)),
+		sizeof (buf));
+  TEST_VERIFY (memcmp (buf, data, sizeof (buf)) == 0);
+  xclose (append_fd);
+
+  xclose (fd);
+  free (name);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,186 @@
+/* Test the rseq_percpu_* functions.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/rseq.h>
+#include <sys/sysinfo.h>
+
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xthread.h>
+
+enum { nthreads = 8 };
+enum { iterations = 100000 };
+enum { nobjects = 64 };
+
+/* Slots in cache lines of their own.  */
+struct slot
+{
+  intptr_t value;
+} __attribute__ ((aligned (64)));
+
+static struct slot *counters;
+static struct slot *lists;
+static int ncpus;
+
+struct object
+{
+  int payload;
+  /* The link of the free lists.  */
+  struct object *next;
+  /* True while a thread has popped the object.  */
+  bool taken;
+};
+
+static struct object objects[nthreads * nobjects];
+
+static void *
+counter_thread (void *closure)
+{
+  for (int i = 0; i < iterations; ++i)
+    {
+      int cpu = rseq_percpu_add (&counters[0].value, sizeof (struct slot),
+				 i % 2 == 0 ? 3 : -1);
+      TEST_VERIFY (cpu >= 0 && cpu < ncpus);
+    }
+  return NULL;
+}
+
+/* Push OBJ on the free list of the CPU the calling thread runs on.  */
+static void
+push (struct object *obj)
+{
+  for (;;)
+    {
+      int cpu = sched_getcpu ();
+      TEST_VERIFY_EXIT (cpu >= 0 && cpu < ncpus);
+      intptr_t head = __atomic_load_n (&lists[cpu].value, __ATOMIC_RELAXED);
+      obj->next = (struct object *) head;
+      int ret = rseq_percpu_cmpstore (&lists[0].value, sizeof (struct slot),
+				      cpu, head, (intptr_t) obj);
+      TEST_VERIFY (ret >= -1 && ret <= 1);
+      if (ret == 0)
+	return;
+    }
+}
+
+static void *
+list_thread (void *closure)
+{
+  struct object *own[nobjects];
+  int nown = 0;
+
+  for (int i = 0; i < iterations; ++i)
+    {
+      /* Pop up to all objects we may hold, and push them back.  */
+      if (nown < nobjects && i % 3 != 2)
+	{
+	  int cpu;
+	  struct object *obj = (struct object *)
+	    rseq_percpu_pop (&lists[0].value, sizeof (struct slot),
+			     offsetof (struct object, next), &cpu);
+	  TEST_VERIFY (cpu >= 0 && cpu < ncpus);
+	  if (obj == NULL)
+	    continue;
+	  TEST_VERIFY (!obj->taken);
+	  obj->taken = true;
+	  own[nown++] = obj;
+	}
+      else if (nown > 0)
+	{
+	  struct object *obj = own[--nown];
+	  obj->taken = false;
+	  push (obj);
+	}
+    }
+  while (nown > 0)
+    {
+      struct object *obj = own[--nown];
+      obj->taken = false;
+      push (obj);
+    }
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  ncpus = get_nprocs_conf ();
+  counters = xcalloc (ncpus, sizeof (struct slot));
+  lists = xcalloc (ncpus, sizeof (struct slot));
+  printf ("info: rseq %s, %d CPUs\n",
+	  __rseq_size > 0 ? "registered" : "not registered", ncpus);
+
+  pthread_t threads[nthreads];
+  for (int i = 0; i < nthreads; ++i)
+    threads[i] = xpthread_create (NULL, counter_thread, NULL);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+  intptr_t sum = 0;
+  for (int i = 0; i < ncpus; ++i)
+    sum += counters[i].value;
+  TEST_COMPARE (sum, (intptr_t) nthreads * iterations);
+
+  /* An empty list.  */
+  int cpu = -1;
+  TEST_COMPARE (rseq_percpu_pop (&lists[0].value, sizeof (struct slot),
+				 offsetof (struct object, next), &cpu), 0);
+  TEST_VERIFY (cpu >= 0 && cpu < ncpus);
+  /* A slot that differs from the expected value.  */
+  int ret;
+  do
+    {
+      cpu = sched_getcpu ();
+      ret = rseq_percpu_cmpstore (&lists[0].value, sizeof (struct slot),
+				  cpu, 1, 2);
+    }
+  while (ret == -1);
+  TEST_COMPARE (ret, 1);
+  TEST_COMPARE (lists[cpu].value, 0);
+
+  for (int i = 0; i < array_length (objects); ++i)
+    push (&objects[i]);
+  for (int i = 0; i < nthreads; ++i)
+    threads[i] = xpthread_create (NULL, list_thread, NULL);
+  for (int i = 0; i < nthreads; ++i)
+    xpthread_join (threads[i]);
+
+  /* All objects are back on the lists, each once.  */
+  int count = 0;
+  for (int i = 0; i < ncpus; ++i)
+    for (struct object *obj = (struct object *) lists[i].value; obj != NULL;
+	 obj = obj->next)
+      {
+	TEST_VERIFY (!obj->taken);
+	obj->taken = true;
+	++count;
+      }
+  TEST_COMPARE (count, array_length (objects));
+
+  free (lists);
+  free (counters);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,235 @@
+/* Test the worker threads of SIGEV_THREAD timers.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test runs with glibc.pthread.timer_threads=2.  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <support/check.h>
+#include <support/xthread.h>
+
+enum { ntimers = 4 };
+enum { max_workers = 2 };
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Per timer, the number of running notification functions and the
+   number of calls.  Protected by LOCK.  */
+static int running[ntimers];
+static int calls[ntimers];
+
+/* The threads that have run notification functions of the timers with
+   the default attributes.  Protected by LOCK.  */
+static pthread_t workers[ntimers * 1000];
+static int nworkers;
+
+static void
+record_worker (void)
+{
+  pthread_t self = pthread_self ();
+  for (int i = 0; i < nworkers; ++i)
+    if (pthread_equal (workers[i], self))
+      return;
+  workers[nworkers++] = self;
+}
+
+/* Thread-specific data set by each notification function, and the
+   number of times its destructor ran.  Protected by LOCK.  */
+static pthread_key_t key;
+static int destructor_calls;
+
+static void
+destructor (void *arg)
+{
+  xpthread_mutex_lock (&lock);
+  ++destructor_calls;
+  xpthread_mutex_unlock (&lock);
+}
+
+/* Whether SIGUSR1 is blocked when the notification functions start, as
+   seen by the first one, or -1.  Protected by LOCK.  */
+static int sigusr1_blocked = -1;
+
+/* Check that the notification function starts with the state of a new
+   thread, even if it runs in a worker which ran other notification
+   functions before, and then change that state.  */
+static void
+check_and_change_state (void)
+{
+  sigset_t set;
+  TEST_COMPARE (pthread_sigmask (SIG_BLOCK, NULL, &set), 0);
+  int blocked = sigismember (&set, SIGUSR1);
+  if (sigusr1_blocked < 0)
+    sigusr1_blocked = blocked;
+  TEST_COMPARE (blocked, sigusr1_blocked);
+  sigemptyset (&set);
+  sigaddset (&set, SIGUSR1);
+  TEST_COMPARE (pthread_sigmask (blocked ? SIG_UNBLOCK : SIG_BLOCK,
+				 &set, NULL), 0);
+
+  int state;
+  TEST_COMPARE (pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &state), 0);
+  TEST_COMPARE (state, PTHREAD_CANCEL_ENABLE);
+  int type;
+  TEST_COMPARE (pthread_setcanceltype (PTHREAD_CANCEL_ASYNCHRONOUS, &type),
+		0);
+  TEST_COMPARE (type, PTHREAD_CANCEL_DEFERRED);
+
+  TEST_VERIFY (pthread_getspecific (key) == NULL);
+  TEST_COMPARE (pthread_setspecific (key, &key), 0);
+}
+
+static void
+notify (union sigval sv)
+{
+  int i = sv.sival_int;
+
+  xpthread_mutex_lock (&lock);
+  record_worker ();
+  /* The notifications of a timer do not overlap.  */
+  TEST_COMPARE (++running[i], 1);
+  check_and_change_state ();
+  xpthread_mutex_unlock (&lock);
+
+  /* Run longer than the timer interval.  */
+  usleep (5000);
+
+  xpthread_mutex_lock (&lock);
+  --running[i];
+  ++calls[i];
+  xpthread_mutex_unlock (&lock);
+}
+
+static timer_t attr_timer;
+static size_t attr_stacksize;
+static int attr_calls;
+static bool attr_deleted;
+
+/* Notification function of a timer with attributes, which deletes its
+   own timer.  */
+static void
+notify_attr (union sigval sv)
+{
+  pthread_attr_t attr;
+  size_t stacksize;
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  TEST_COMPARE (pthread_attr_getstacksize (&attr, &stacksize), 0);
+  TEST_VERIFY (stacksize >= attr_stacksize);
+  xpthread_attr_destroy (&attr);
+
+  xpthread_mutex_lock (&lock);
+  TEST_VERIFY (!attr_deleted);
+  if (++attr_calls == 3)
+    {
+      TEST_COMPARE (timer_delete (attr_timer), 0);
+      attr_deleted = true;
+      xpthread_cond_signal (&cond);
+    }
+  xpthread_mutex_unlock (&lock);
+}
+
+static timer_t
+create_timer (void (*func) (union sigval), int value, pthread_attr_t *attr)
+{
+  struct sigevent sev =
+    {
+      .sigev_notify = SIGEV_THREAD,
+      .sigev_notify_function = func,
+      .sigev_notify_attributes = attr,
+      .sigev_value.sival_int = value,
+    };
+  timer_t timer;
+  TEST_COMPARE (timer_create (CLOCK_MONOTONIC, &sev, &timer), 0);
+
+  struct itimerspec its =
+    {
+      .it_value = { .tv_nsec = 1000000 },
+      .it_interval = { .tv_nsec = 1000000 },
+    };
+  TEST_COMPARE (timer_settime (timer, 0, &its, NULL), 0);
+  return timer;
+}
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (pthread_key_create (&key, destructor), 0);
+
+  timer_t timers[ntimers];
+  for (int i = 0; i < ntimers; ++i)
+    timers[i] = create_timer (notify, i, NULL);
+
+  usleep (200000);
+
+  for (int i = 0; i < ntimers; ++i)
+    TEST_COMPARE (timer_delete (timers[i]), 0);
+
+  /* Wait for the notification functions that are still running.  */
+  xpthread_mutex_lock (&lock);
+  for (int i = 0; i < ntimers; ++i)
+    while (running[i] != 0)
+      {
+	xpthread_mutex_unlock (&lock);
+	usleep (1000);
+	xpthread_mutex_lock (&lock);
+      }
+  printf ("info: %d workers\n", nworkers);
+  TEST_VERIFY (nworkers >= 1);
+  TEST_VERIFY (nworkers <= max_workers);
+  for (int i = 0; i < ntimers; ++i)
+    TEST_VERIFY (calls[i] > 0);
+  xpthread_mutex_unlock (&lock);
+
+  /* The destructor runs after the notification function returns.  */
+  usleep (20000);
+  xpthread_mutex_lock (&lock);
+  int total_calls = 0;
+  for (int i = 0; i < ntimers; ++i)
+    total_calls += calls[i];
+  TEST_COMPARE (destructor_calls, total_calls);
+  xpthread_mutex_unlock (&lock);
+
+  /* A timer with a larger stack than the default workers.  */
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  attr_stacksize = 4 * 1024 * 1024;
+  xpthread_attr_setstacksize (&attr, attr_stacksize);
+  xpthread_mutex_lock (&lock);
+  attr_timer = create_timer (notify_attr, 0, &attr);
+  xpthread_attr_destroy (&attr);
+  while (!attr_deleted)
+    xpthread_cond_wait (&cond, &lock);
+  xpthread_mutex_unlock (&lock);
+
+  /* No notification runs after the timer has been deleted.  */
+  usleep (20000);
+  xpthread_mutex_lock (&lock);
+  TEST_COMPARE (attr_calls, 3);
+  xpthread_mutex_unlock (&lock);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
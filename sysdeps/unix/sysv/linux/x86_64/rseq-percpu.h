@@ -0,0 +1,135 @@
+/* Restartable sequences on per-CPU data.  x86-64 version.
+   Copyright (C) 2023 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifdef __ILP32__
+/* The sequences below use 64-bit pointers.  */
+# include <sysdeps/unix/sysv/linux/rseq-percpu.h>
+#else
+
+#ifndef RSEQ_PERCPU_H
+#define RSEQ_PERCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/rseq.h>
+
+/* See sysdeps/unix/sysv/linux/rseq-percpu.h.  */
+#define RSEQ_PERCPU_CS 1
+
+#define RSEQ_PERCPU_STR(x) __STRING (x)
+
+/* The critical section runs from label 1 to label 2, and its abort
+   handler is at label 4.  Its descriptor is at label 3.  Setting the
+   rseq_cs field at label 6 arms it.  The rseq_cs field is not cleared
+   afterwards, because libc is never unloaded.  */
+#define RSEQ_PERCPU_CS_START					\
+  ".pushsection __rseq_cs, \"aw\"\n\t"				\
+  ".balign 32\n\t"						\
+  "3:\n\t"							\
+  ".long 0x0, 0x0\n\t"						\
+  ".quad 1f, (2f - 1f), 4f\n\t"					\
+  ".popsection\n\t"						\
+  "6:\n\t"							\
+  "leaq 3b(%%rip), %%rax\n\t"					\
+  "movq %%rax, %[rseq_cs]\n\t"					\
+  "1:\n\t"
+
+/* The abort handler follows the signature ud1 RSEQ_SIG(%rip), %edi,
+   and restarts the critical section.  */
+#define RSEQ_PERCPU_CS_ABORT					\
+  ".pushsection __rseq_failure, \"ax\"\n\t"			\
+  ".byte 0x0f, 0xb9, 0x3d\n\t"					\
+  ".long " RSEQ_PERCPU_STR (RSEQ_SIG) "\n\t"			\
+  "4:\n\t"							\
+  "jmp 6b\n\t"							\
+  ".popsection\n\t"
+
+static inline int
+rseq_percpu_cs_add (struct rseq *rs, intptr_t *base, size_t stride,
+		    intptr_t value)
+{
+  int cpu;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"movl %[cpu_id], %[cpu]\n\t"
+			"movl %[cpu], %%eax\n\t"
+			"imulq %[stride], %%rax\n\t"
+			"addq %[value], (%[base], %%rax)\n\t"
+			"2:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [cpu] "=&r" (cpu), [rseq_cs] "=m" (rs->rseq_cs)
+			: [cpu_id] "m" (rs->cpu_id), [base] "r" (base),
+			  [stride] "r" (stride), [value] "r" (value)
+			: "rax", "memory", "cc");
+  return cpu;
+}
+
+static inline int
+rseq_percpu_cs_cmpstore (struct rseq *rs, intptr_t *slot, int cpu,
+			 intptr_t expected, intptr_t desired)
+{
+  int result;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"movl $-1, %[result]\n\t"
+			"cmpl %[cpu_id], %[cpu]\n\t"
+			"jne 5f\n\t"
+			"movl $1, %[result]\n\t"
+			"cmpq %[expected], %[slot]\n\t"
+			"jne 5f\n\t"
+			"movq %[desired], %[slot]\n\t"
+			"2:\n\t"
+			"xorl %[result], %[result]\n\t"
+			"5:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [result] "=&r" (result),
+			  [rseq_cs] "=m" (rs->rseq_cs), [slot] "+m" (*slot)
+			: [cpu_id] "m" (rs->cpu_id), [cpu] "r" (cpu),
+			  [expected] "r" (expected), [desired] "r" (desired)
+			: "rax", "memory", "cc");
+  return result;
+}
+
+static inline intptr_t
+rseq_percpu_cs_pop (struct rseq *rs, intptr_t *base, size_t stride,
+		    ptrdiff_t offset, int *cpup)
+{
+  intptr_t head;
+  int cpu;
+  __asm__ __volatile__ (RSEQ_PERCPU_CS_START
+			"movl %[cpu_id], %[cpu]\n\t"
+			"movl %[cpu], %%eax\n\t"
+			"imulq %[stride], %%rax\n\t"
+			"addq %[base], %%rax\n\t"
+			"movq (%%rax), %[head]\n\t"
+			"testq %[head], %[head]\n\t"
+			"jz 2f\n\t"
+			"movq (%[head], %[offset]), %%rcx\n\t"
+			"movq %%rcx, (%%rax)\n\t"
+			"2:\n\t"
+			RSEQ_PERCPU_CS_ABORT
+			: [head] "=&r" (head), [cpu] "=&r" (cpu),
+			  [rseq_cs] "=m" (rs->rseq_cs)
+			: [cpu_id] "m" (rs->cpu_id), [base] "r" (base),
+			  [stride] "r" (stride), [offset] "r" (offset)
+			: "rax", "rcx", "memory", "cc");
+  *cpup = cpu;
+  return head;
+}
+
+#endif /* rseq-percpu.h */
+#endif /* __ILP32__ */